@@ -0,0 +1,406 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DesktopCapture.h"
+#include "../../../src/log.h"
+
+// the X11 headers define macros (None, Bool, Status, ...) that break Qt headers, so they come last
+#if ENABLE_X11_CAPTURE
+    #include <X11/Xlib.h>
+    #include <X11/Xutil.h>
+    #include <X11/extensions/XShm.h>
+    #include <X11/extensions/Xdamage.h>
+    #include <X11/extensions/Xfixes.h>
+    #include <sys/ipc.h>
+    #include <sys/shm.h>
+#endif
+
+#if ENABLE_X11_CAPTURE
+
+struct DesktopCaptureX11 {
+    // our own connection, so capture doesn't interfere with Qt's
+    Display * display;
+    Window root;
+
+    // damage accumulated on the root window, and a region to fetch it into
+    Damage damage;
+    XserverRegion region;
+
+    // shared memory image for the captured rectangle
+    XShmSegmentInfo shmSegmentInfo;
+    XImage * image;
+    int x;
+    int y;
+};
+
+// set by the error handler installed during requests that may fail
+static bool g_desktopCaptureX11Error = false;
+
+static int desktopCaptureX11ErrorHandler(Display * display, XErrorEvent * event)
+{
+    g_desktopCaptureX11Error = true;
+
+    return 0;
+}
+
+static void desktopCaptureDestroyImage(DesktopCaptureX11 * x11)
+{
+    if(x11->image != NULL)
+    {
+        XShmDetach(x11->display, &x11->shmSegmentInfo);
+        XSync(x11->display, False);
+
+        // shared memory images don't free their data
+        XDestroyImage(x11->image);
+        x11->image = NULL;
+
+        shmdt(x11->shmSegmentInfo.shmaddr);
+    }
+}
+
+static bool desktopCaptureCreateImage(DesktopCaptureX11 * x11, int width, int height)
+{
+    int screen = DefaultScreen(x11->display);
+
+    XImage * image = XShmCreateImage(x11->display, DefaultVisual(x11->display, screen), DefaultDepth(x11->display, screen), ZPixmap, NULL, &x11->shmSegmentInfo, width, height);
+
+    if(image == NULL)
+    {
+        return false;
+    }
+
+    // the image data is used directly as a QImage::Format_RGB32 image
+    if(image->bits_per_pixel != 32 || image->red_mask != 0xff0000 || image->green_mask != 0xff00 || image->blue_mask != 0xff)
+    {
+        put_flog(LOG_WARN, "unsupported X11 pixel format");
+
+        XDestroyImage(image);
+        return false;
+    }
+
+    x11->shmSegmentInfo.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+
+    if(x11->shmSegmentInfo.shmid == -1)
+    {
+        put_flog(LOG_ERROR, "could not create shared memory");
+
+        XDestroyImage(image);
+        return false;
+    }
+
+    x11->shmSegmentInfo.shmaddr = image->data = (char *)shmat(x11->shmSegmentInfo.shmid, NULL, 0);
+    x11->shmSegmentInfo.readOnly = False;
+
+    // attaching fails if the X server is on another host
+    g_desktopCaptureX11Error = false;
+    XErrorHandler previousHandler = XSetErrorHandler(desktopCaptureX11ErrorHandler);
+
+    XShmAttach(x11->display, &x11->shmSegmentInfo);
+    XSync(x11->display, False);
+
+    XSetErrorHandler(previousHandler);
+
+    // the segment is removed once the X server and we have detached
+    shmctl(x11->shmSegmentInfo.shmid, IPC_RMID, NULL);
+
+    if(g_desktopCaptureX11Error == true)
+    {
+        put_flog(LOG_WARN, "could not attach shared memory to X server");
+
+        XDestroyImage(image);
+        shmdt(x11->shmSegmentInfo.shmaddr);
+        return false;
+    }
+
+    x11->image = image;
+
+    return true;
+}
+
+#else
+
+struct DesktopCaptureX11 {
+};
+
+#endif
+
+DesktopCapture::DesktopCapture()
+{
+    // defaults
+    x11Captured_ = false;
+    reset_ = true;
+    x11_ = NULL;
+
+    initializeX11();
+}
+
+DesktopCapture::~DesktopCapture()
+{
+    finalizeX11();
+}
+
+void DesktopCapture::setX11Capture(bool set)
+{
+    if(set == true)
+    {
+        initializeX11();
+    }
+    else
+    {
+        finalizeX11();
+    }
+}
+
+bool DesktopCapture::isX11Capture()
+{
+    return x11Captured_;
+}
+
+void DesktopCapture::reset()
+{
+    reset_ = true;
+}
+
+bool DesktopCapture::capture(int x, int y, int width, int height, QImage & image, QRegion & damage)
+{
+    if(x11_ != NULL && captureX11(x, y, width, height, image, damage) == true)
+    {
+        x11Captured_ = true;
+        return true;
+    }
+
+    x11Captured_ = false;
+
+    if(captureGrabWindow(x, y, width, height, image, damage) != true)
+    {
+        // image may still refer to the X11 image, which was destroyed if X11 capture failed
+        image = QImage();
+        damage = QRegion();
+
+        return false;
+    }
+
+    return true;
+}
+
+bool DesktopCapture::initializeX11()
+{
+#if ENABLE_X11_CAPTURE
+    if(x11_ != NULL)
+    {
+        return true;
+    }
+
+    Display * display = XOpenDisplay(NULL);
+
+    if(display == NULL)
+    {
+        put_flog(LOG_WARN, "could not open X display");
+        return false;
+    }
+
+    int major, minor;
+    Bool sharedPixmaps;
+    int eventBase, errorBase;
+
+    // the XFIXES and DAMAGE versions must be queried before the extensions are used
+    if(XShmQueryVersion(display, &major, &minor, &sharedPixmaps) != True || XFixesQueryExtension(display, &eventBase, &errorBase) != True || XFixesQueryVersion(display, &major, &minor) == 0 || XDamageQueryExtension(display, &eventBase, &errorBase) != True || XDamageQueryVersion(display, &major, &minor) == 0)
+    {
+        put_flog(LOG_WARN, "MIT-SHM, XFIXES, or DAMAGE extension unavailable");
+
+        XCloseDisplay(display);
+        return false;
+    }
+
+    x11_ = new DesktopCaptureX11();
+
+    x11_->display = display;
+    x11_->root = DefaultRootWindow(display);
+    x11_->damage = XDamageCreate(display, x11_->root, XDamageReportNonEmpty);
+    x11_->region = XFixesCreateRegion(display, NULL, 0);
+    x11_->image = NULL;
+    x11_->x = 0;
+    x11_->y = 0;
+
+    reset_ = true;
+
+    put_flog(LOG_INFO, "using X11 capture");
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void DesktopCapture::finalizeX11()
+{
+#if ENABLE_X11_CAPTURE
+    if(x11_ == NULL)
+    {
+        return;
+    }
+
+    desktopCaptureDestroyImage(x11_);
+
+    XFixesDestroyRegion(x11_->display, x11_->region);
+    XDamageDestroy(x11_->display, x11_->damage);
+    XCloseDisplay(x11_->display);
+
+    delete x11_;
+    x11_ = NULL;
+#endif
+}
+
+bool DesktopCapture::captureX11(int x, int y, int width, int height, QImage & image, QRegion & damage)
+{
+#if ENABLE_X11_CAPTURE
+    // the rectangle must be on the root window
+    XWindowAttributes attributes;
+
+    if(XGetWindowAttributes(x11_->display, x11_->root, &attributes) == 0 || x < 0 || y < 0 || x + width > attributes.width || y + height > attributes.height)
+    {
+        return false;
+    }
+
+    if(x11_->image == NULL || x11_->image->width != width || x11_->image->height != height)
+    {
+        desktopCaptureDestroyImage(x11_);
+
+        if(desktopCaptureCreateImage(x11_, width, height) != true)
+        {
+            // don't try again
+            finalizeX11();
+            return false;
+        }
+
+        reset_ = true;
+    }
+
+    // the image holds a different rectangle
+    if(x != x11_->x || y != x11_->y)
+    {
+        x11_->x = x;
+        x11_->y = y;
+
+        reset_ = true;
+    }
+
+    // the damage object accumulates damage itself, so the notification events aren't needed
+    while(XPending(x11_->display) > 0)
+    {
+        XEvent event;
+        XNextEvent(x11_->display, &event);
+    }
+
+    // take the damage before grabbing, so changes made during the grab are reported next time
+    XDamageSubtract(x11_->display, x11_->damage, None, x11_->region);
+
+    int count = 0;
+    XRectangle * rectangles = XFixesFetchRegion(x11_->display, x11_->region, &count);
+
+    QRect rect(x, y, width, height);
+
+    damage = QRegion();
+
+    for(int i=0; i<count; i++)
+    {
+        damage += QRect(rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height).intersected(rect).translated(-x, -y);
+    }
+
+    if(rectangles != NULL)
+    {
+        XFree(rectangles);
+    }
+
+    if(reset_ == true)
+    {
+        damage = QRegion(0, 0, width, height);
+        reset_ = false;
+    }
+
+    // if nothing changed, the last image is still current
+    if(damage.isEmpty() != true)
+    {
+        g_desktopCaptureX11Error = false;
+        XErrorHandler previousHandler = XSetErrorHandler(desktopCaptureX11ErrorHandler);
+
+        Bool success = XShmGetImage(x11_->display, x11_->root, x11_->image, x, y, AllPlanes);
+
+        XSetErrorHandler(previousHandler);
+
+        if(success != True || g_desktopCaptureX11Error == true)
+        {
+            put_flog(LOG_ERROR, "XShmGetImage() failed");
+
+            reset_ = true;
+            return false;
+        }
+    }
+
+    // no copy; the image refers to the shared memory
+    image = QImage((uchar *)x11_->image->data, width, height, x11_->image->bytes_per_line, QImage::Format_RGB32);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DesktopCapture::captureGrabWindow(int x, int y, int width, int height, QImage & image, QRegion & damage)
+{
+    QPixmap pixmap = QPixmap::grabWindow(QApplication::desktop()->winId(), x, y, width, height);
+
+    if(pixmap.isNull() == true)
+    {
+        return false;
+    }
+
+    image = pixmap.toImage();
+
+    if(image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32 && image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        image = image.convertToFormat(QImage::Format_RGB32);
+    }
+
+    damage = QRegion(0, 0, width, height);
+
+    // the X11 image is out of date now
+    reset_ = true;
+
+    return true;
+}
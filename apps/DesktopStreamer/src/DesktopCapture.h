@@ -0,0 +1,87 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DESKTOP_CAPTURE_H
+#define DESKTOP_CAPTURE_H
+
+#include <QtGui>
+
+// X11 capture state; defined in DesktopCapture.cpp, since the X11 headers conflict with Qt's
+struct DesktopCaptureX11;
+
+// captures a rectangle of the desktop, and finds the areas that changed since the last capture.
+// on X11 with the MIT-SHM and DAMAGE extensions, the image is grabbed directly into shared memory and the X server
+// reports the damaged areas. otherwise QPixmap::grabWindow() is used, and the whole image is reported as damaged.
+class DesktopCapture {
+
+    public:
+
+        DesktopCapture();
+        ~DesktopCapture();
+
+        // use X11 capture if it is available (the default); otherwise always use QPixmap::grabWindow().
+        // disabling X11 capture invalidates images captured with it.
+        void setX11Capture(bool set);
+
+        // true if the last capture used X11 capture
+        bool isX11Capture();
+
+        // report the whole image as damaged on the next capture
+        void reset();
+
+        // capture the rectangle (x, y, width, height) into image, with 32 bits per pixel. damage is set to the areas
+        // changed since the last capture, in image coordinates. with X11 capture, image refers to memory that is
+        // overwritten by the next capture. on failure, image is cleared.
+        bool capture(int x, int y, int width, int height, QImage & image, QRegion & damage);
+
+    private:
+
+        bool x11Captured_;
+        bool reset_;
+
+        // NULL if X11 capture is unavailable or disabled
+        DesktopCaptureX11 * x11_;
+
+        bool initializeX11();
+        void finalizeX11();
+
+        bool captureX11(int x, int y, int width, int height, QImage & image, QRegion & damage);
+        bool captureGrabWindow(int x, int y, int width, int height, QImage & image, QRegion & damage);
+};
+
+#endif
@@ -40,8 +40,11 @@
 #include "main.h"
 #include "../../../src/log.h"
 #include "../../../src/MessageHeader.h"
+#include "../../../src/PixelStreamCodec.h"
+#include "../../../src/PixelStreamSegmentation.h"
 #include "DesktopSelectionRectangle.h"
 #include <turbojpeg.h>
+#include <string.h>
 
 #ifdef _WIN32
     typedef __int32 int32_t;
@@ -50,11 +53,68 @@
     #include <stdint.h>
 #endif
 
-ParallelPixelStreamSegment computeSegmentJpeg(const ParallelPixelStreamSegment & segment)
+bool isSegmentUnchanged(const QImage & image, const QImage & previousImage, const ParallelPixelStreamSegmentParameters & parameters)
+{
+    if(previousImage.isNull() == true || previousImage.size() != image.size() || previousImage.format() != image.format())
+    {
+        return false;
+    }
+
+    int bytesPerPixel = image.depth() / 8;
+
+    for(int i=0; i<parameters.height; i++)
+    {
+        const uchar * line = image.scanLine(parameters.y + i) + parameters.x * bytesPerPixel;
+        const uchar * previousLine = previousImage.scanLine(parameters.y + i) + parameters.x * bytesPerPixel;
+
+        if(memcmp(line, previousLine, parameters.width * bytesPerPixel) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// chroma subsampling names, by TJSAMP value
+static const char * g_subsamplingNames[] = { "4:4:4", "4:2:2", "4:2:0" };
+
+ParallelPixelStreamSegment computeSegmentImageData(const ParallelPixelStreamSegment & segment)
 {
     ParallelPixelStreamSegment newSegment = segment;
 
-    QImage image = g_mainWindow->getImage();
+    // const, so reading scanlines doesn't copy the shared image
+    const QImage image = g_mainWindow->getImage();
+
+    SegmentCompressionSettings settings;
+
+    // unchanged segments are sent without image data
+    if(g_mainWindow->getSegmentCompressionSettings(newSegment.parameters.sourceIndex, settings) != true)
+    {
+        newSegment.imageData = QByteArray();
+
+        return newSegment;
+    }
+
+    newSegment.parameters.codec = settings.codec;
+
+    const unsigned char * segmentImage = image.scanLine(newSegment.parameters.y) + newSegment.parameters.x * image.depth()/8;
+
+    if(settings.codec == PIXEL_STREAM_CODEC_LZ4)
+    {
+        pixelStreamEncodeLz4(segmentImage, newSegment.parameters.width, image.bytesPerLine(), newSegment.parameters.height, TJPF_BGRX, false, newSegment.imageData);
+
+        return newSegment;
+    }
+    else if(settings.codec == PIXEL_STREAM_CODEC_RAW)
+    {
+        pixelStreamEncodeRaw(segmentImage, newSegment.parameters.width, image.bytesPerLine(), newSegment.parameters.height, TJPF_BGRX, false, newSegment.imageData);
+
+        return newSegment;
+    }
+
+    int jpegQual = settings.quality;
+    int jpegSubsamp = settings.subsampling;
 
     // use libjpeg-turbo for JPEG conversion
     tjhandle handle = tjInitCompress();
@@ -63,11 +123,9 @@ ParallelPixelStreamSegment computeSegmentJpeg(const ParallelPixelStreamSegment &
     unsigned char * jpegBufPtr = NULL;
     jpegBuf = &jpegBufPtr;
     unsigned long jpegSize = 0;
-    int jpegSubsamp = TJSAMP_444;
-    int jpegQual = JPEG_QUALITY;
     int flags = 0;
 
-    int success = tjCompress2(handle, image.scanLine(newSegment.parameters.y) + newSegment.parameters.x * image.depth()/8, newSegment.parameters.width, image.bytesPerLine(), newSegment.parameters.height, pixelFormat, jpegBuf, &jpegSize, jpegSubsamp, jpegQual, flags);
+    int success = tjCompress2(handle, (unsigned char *)segmentImage, newSegment.parameters.width, image.bytesPerLine(), newSegment.parameters.height, pixelFormat, jpegBuf, &jpegSize, jpegSubsamp, jpegQual, flags);
 
     if(success != 0)
     {
@@ -91,6 +149,10 @@ MainWindow::MainWindow()
     // defaults
     updatedDimensions_ = true;
     parallelStreaming_ = false;
+    captureTimestamp_ = 0;
+    refreshed_ = false;
+    numSentSegments_ = 0;
+    updatedWallLayout_ = false;
 
     QWidget * widget = new QWidget();
     QFormLayout * layout = new QFormLayout();
@@ -156,6 +218,13 @@ MainWindow::MainWindow()
     setParallelStreamingAction->setChecked(parallelStreaming_);
     connect(setParallelStreamingAction, SIGNAL(toggled(bool)), this, SLOT(setParallelStreaming(bool)));
 
+    // set X11 capture action
+    QAction * setX11CaptureAction = new QAction("Enable X11 Capture", this);
+    setX11CaptureAction->setStatusTip("Capture with the MIT-SHM and DAMAGE extensions, if available");
+    setX11CaptureAction->setCheckable(true);
+    setX11CaptureAction->setChecked(true);
+    connect(setX11CaptureAction, SIGNAL(toggled(bool)), this, SLOT(setX11Capture(bool)));
+
     // create toolbar
     QToolBar * toolbar = addToolBar("toolbar");
 
@@ -168,6 +237,7 @@ MainWindow::MainWindow()
 
     // add actions to options menu
     optionsMenu->addAction(setParallelStreamingAction);
+    optionsMenu->addAction(setX11CaptureAction);
 
     // timer will trigger updating of the desktop image
     connect(&shareDesktopUpdateTimer_, SIGNAL(timeout()), this, SLOT(shareDesktopUpdate()));
@@ -204,6 +274,19 @@ QImage MainWindow::getImage()
     return image_;
 }
 
+bool MainWindow::getSegmentCompressionSettings(int sourceIndex, SegmentCompressionSettings & settings)
+{
+    // only read while segments are compressed, so no locking is needed
+    if(segmentsCompressionSettings_.count(sourceIndex) == 0)
+    {
+        return false;
+    }
+
+    settings = segmentsCompressionSettings_[sourceIndex];
+
+    return true;
+}
+
 void MainWindow::shareDesktop(bool set)
 {
     if(set == true)
@@ -247,9 +330,40 @@ void MainWindow::shareDesktop(bool set)
             return;
         }
 
+        // request the wall layout, so segments can be cut along screen boundaries
+        MessageHeader mh;
+        mh.size = 0;
+        mh.type = MESSAGE_TYPE_BIND_WALL_LAYOUT;
+
+        // add the truncated URI to the header
+        size_t len = uri_.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
+        mh.uri[len] = '\0';
+
+        int sent = tcpSocket_.write((const char *)&mh, sizeof(MessageHeader));
+
+        while(sent < (int)sizeof(MessageHeader))
+        {
+            sent += tcpSocket_.write((const char *)&mh + sent, sizeof(MessageHeader) - sent);
+        }
+
+        // until the layout is received, segments are cut uniformly
+        wallLayout_ = WallLayout();
+        updatedWallLayout_ = true;
+
+        waitForAck();
+
+        // a new connection has no segments
+        numSentSegments_ = 0;
+
         // make sure dimensions get updated
         updatedDimensions_ = true;
 
+        // make sure the full image is sent
+        previousImage_ = QImage();
+        desktopCapture_.reset();
+        segmentsRefreshed_.clear();
+        refreshed_ = false;
+
         shareDesktopUpdateTimer_.start(SHARE_DESKTOP_UPDATE_DELAY);
     }
     else
@@ -285,6 +399,18 @@ void MainWindow::setParallelStreaming(bool set)
     parallelStreaming_ = set;
 }
 
+void MainWindow::setX11Capture(bool set)
+{
+    // the image may refer to the X11 capture memory, which is freed when X11 capture is disabled
+    if(set != true)
+    {
+        image_ = QImage();
+        previousImage_ = QImage();
+    }
+
+    desktopCapture_.setX11Capture(set);
+}
+
 void MainWindow::shareDesktopUpdate()
 {
     // time the frame
@@ -300,10 +426,13 @@ void MainWindow::shareDesktopUpdate()
         return;
     }
 
+    // keep the previous frame, unless X11 capture is about to overwrite it
+    previousImage_ = desktopCapture_.isX11Capture() == true ? QImage() : image_;
+
     // take screenshot
-    QPixmap desktopPixmap = QPixmap::grabWindow(QApplication::desktop()->winId(), x_,y_,width_,height_);
+    captureTimestamp_ = QDateTime::currentMSecsSinceEpoch() * 1000;
 
-    if(desktopPixmap.isNull() == true)
+    if(desktopCapture_.capture(x_,y_,width_,height_, image_, damage_) != true)
     {
         put_flog(LOG_ERROR, "got NULL desktop pixmap");
         QMessageBox::warning(this, "Error", "Got NULL desktop pixmap.", QMessageBox::Ok, QMessageBox::Ok);
@@ -313,8 +442,8 @@ void MainWindow::shareDesktopUpdate()
         return;
     }
 
-    // convert to QImage
-    image_ = desktopPixmap.toImage();
+    // adapt JPEG settings to achieve the max frame rate
+    rateController_.setTargetFrameRate((float)frameRateSpinBox_.value());
 
     bool success;
 
@@ -361,14 +490,7 @@ void MainWindow::shareDesktopUpdate()
             updatedDimensions_ = false;
 
             // wait for acknowledgment
-            while(tcpSocket_.waitForReadyRead() && tcpSocket_.bytesAvailable() < 3)
-            {
-    #ifndef _WIN32
-                usleep(10);
-    #endif
-            }
-
-            tcpSocket_.read(3);
+            waitForAck();
         }
     }
     else
@@ -420,7 +542,7 @@ void MainWindow::shareDesktopUpdate()
     {
         float fps = (float)frameSentTimes_.size() / (float)frameSentTimes_.front().msecsTo(frameSentTimes_.back()) * 1000.;
 
-        frameRateLabel_.setText(QString::number(fps) + QString(" fps"));
+        frameRateLabel_.setText(QString::number(fps) + QString(" fps (quality ") + QString::number(rateController_.getQuality()) + QString(", ") + QString(g_subsamplingNames[rateController_.getSubsampling()]) + QString(")"));
     }
 }
 
@@ -444,37 +566,41 @@ void MainWindow::updateCoordinates()
 
     // update ParallelPixelStreamSegment parameters, whether or not we are currently streaming in parallel
     // users can toggle parallel streaming at any time
-    segments_.clear();
+    updateSegments();
+}
 
-    // segment dimensions will be approximately this
-    int nominalSegmentSize = 512;
+bool MainWindow::serialStream()
+{
+    // time the frame until it is acknowledged
+    QTime frameTime;
+    frameTime.start();
 
-    // number of subdivisions in each dimensions
-    int numSubdivisionsX = (int)floor((float)width_ / (float)nominalSegmentSize + 0.5);
-    int numSubdivisionsY = (int)floor((float)height_ / (float)nominalSegmentSize + 0.5);
+    int jpegQual = rateController_.getQuality();
+    int jpegSubsamp = rateController_.getSubsampling();
 
-    // now, create segments with appropriate parameters
-    for(int i=0; i<numSubdivisionsX; i++)
+    ParallelPixelStreamSegmentParameters parameters;
+    parameters.x = 0;
+    parameters.y = 0;
+    parameters.width = image_.width();
+    parameters.height = image_.height();
+
+    // unchanged images are sent once more at refresh quality, and then not at all
+    if(isSegmentUnchanged(parameters) == true)
     {
-        for(int j=0; j<numSubdivisionsY; j++)
+        if(refreshed_ == true)
         {
-            ParallelPixelStreamSegment segment;
-
-            segment.parameters.sourceIndex = i*numSubdivisionsY + j;
-            segment.parameters.x = i * (int)((float)width_ / (float)numSubdivisionsX);
-            segment.parameters.y = j * (int)((float)height_ / (float)numSubdivisionsY);
-            segment.parameters.width = (int)((float)width_ / (float)numSubdivisionsX);
-            segment.parameters.height = (int)((float)height_ / (float)numSubdivisionsY);
-            segment.parameters.totalWidth = width_;
-            segment.parameters.totalHeight = height_;
-
-            segments_.push_back(segment);
+            return true;
         }
+
+        jpegQual = DC_REFRESH_JPEG_QUALITY;
+        jpegSubsamp = DC_REFRESH_JPEG_SUBSAMPLING;
+        refreshed_ = true;
+    }
+    else
+    {
+        refreshed_ = rateController_.isHighestQuality();
     }
-}
 
-bool MainWindow::serialStream()
-{
     // use libjpeg-turbo for JPEG conversion
     tjhandle handle = tjInitCompress();
     int pixelFormat = TJPF_BGRX;
@@ -482,8 +608,6 @@ bool MainWindow::serialStream()
     unsigned char * jpegBufPtr = NULL;
     jpegBuf = &jpegBufPtr;
     unsigned long jpegSize = 0;
-    int jpegSubsamp = TJSAMP_444;
-    int jpegQual = JPEG_QUALITY;
     int flags = 0;
 
     int success = tjCompress2(handle, image_.scanLine(0), image_.width(), image_.bytesPerLine(), image_.height(), pixelFormat, jpegBuf, &jpegSize, jpegSubsamp, jpegQual, flags);
@@ -529,14 +653,12 @@ bool MainWindow::serialStream()
         previousImageData_ = byteArray;
 
         // wait for acknowledgment
-        while(tcpSocket_.waitForReadyRead() && tcpSocket_.bytesAvailable() < 3)
+        if(waitForAck() != true)
         {
-#ifndef _WIN32
-            usleep(10);
-#endif
+            return false;
         }
 
-        tcpSocket_.read(3);
+        rateController_.frameSent(byteArray.size(), frameTime.elapsed());
     }
 
     return true;
@@ -547,62 +669,106 @@ bool MainWindow::parallelStream()
     // frame index
     static int frameIndex = 0;
 
-    // create JPEGs for each segment, in parallel
-    std::vector<ParallelPixelStreamSegment> segments = QtConcurrent::blockingMapped<std::vector<ParallelPixelStreamSegment> >(segments_, &computeSegmentJpeg);
+    // time the frame until all segments are acknowledged
+    QTime frameTime;
+    frameTime.start();
 
-    // stream segments
-    // we have to stream all of them in case stream synchronization is on (we can't ignore unchanged segments... todo: fix this)
-    for(unsigned int i=0; i<segments.size(); i++)
+    // cut new segments if our window moved on the tiled display
+    if(updatedWallLayout_ == true)
     {
-        // update frame index
-        segments[i].parameters.frameIndex = frameIndex;
+        updateSegments();
 
-        // send the parameters and image data
-        MessageHeader mh;
-        mh.size = sizeof(ParallelPixelStreamSegmentParameters) + segments[i].imageData.size();
-        mh.type = MESSAGE_TYPE_PARALLEL_PIXELSTREAM;
+        updatedWallLayout_ = false;
+    }
 
-        // add the truncated URI to the header
-        size_t len = uri_.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
-        mh.uri[len] = '\0';
+    // delete segments we no longer send; a blank parameters object triggers remote deletion of a segment
+    for(unsigned int i=segments_.size(); i<numSentSegments_; i++)
+    {
+        ParallelPixelStreamSegment segment;
 
-        // send the header
-        int sent = tcpSocket_.write((const char *)&mh, sizeof(MessageHeader));
+        segment.parameters.sourceIndex = i;
+        segment.parameters.x = segment.parameters.y = segment.parameters.width = segment.parameters.height = 0;
+        segment.parameters.totalWidth = segment.parameters.totalHeight = 0;
 
-        while(sent < (int)sizeof(MessageHeader))
+        if(sendSegment(segment) != true)
         {
-            sent += tcpSocket_.write((const char *)&mh + sent, sizeof(MessageHeader) - sent);
+            return false;
         }
+    }
 
-        // send the message
+    numSentSegments_ = segments_.size();
+
+    // periodically send all segments, so no display is left without image data for a segment
+    bool sendAll = (frameIndex % SEGMENT_REFRESH_INTERVAL == 0);
+
+    // choose compression settings for each segment
+    // unchanged segments are sent once more at refresh quality, and then only as unchanged markers
+    segmentsCompressionSettings_.clear();
+
+    for(unsigned int i=0; i<segments_.size(); i++)
+    {
+        int sourceIndex = segments_[i].parameters.sourceIndex;
 
-        // part 1: parameters
-        sent = tcpSocket_.write((const char *)&(segments[i].parameters), sizeof(ParallelPixelStreamSegmentParameters));
+        bool unchanged = isSegmentUnchanged(segments_[i].parameters);
 
-        while(sent < (int)sizeof(ParallelPixelStreamSegmentParameters))
+        if(unchanged == true && segmentsRefreshed_[sourceIndex] == true && sendAll == false)
         {
-            sent += tcpSocket_.write((const char *)&(segments[i].parameters) + sent, sizeof(ParallelPixelStreamSegmentParameters) - sent);
+            continue;
         }
 
-        // part 2: image data
-        sent = tcpSocket_.write((const char *)segments[i].imageData.data(), segments[i].imageData.size());
+        SegmentCompressionSettings settings;
 
-        while(sent < segments[i].imageData.size())
+        // low-entropy content (UI, text) is sent losslessly
+        const ParallelPixelStreamSegmentParameters & p = segments_[i].parameters;
+        float entropy = pixelStreamComputeEntropy(image_.scanLine(p.y) + p.x * image_.depth()/8, p.width, image_.bytesPerLine(), p.height, TJPF_BGRX);
+
+        settings.codec = rateController_.chooseCodec(entropy, p.width, p.height, p.totalWidth, p.totalHeight);
+
+        if(settings.codec != PIXEL_STREAM_CODEC_JPEG)
+        {
+            settings.quality = 100;
+            settings.subsampling = 0;
+            segmentsRefreshed_[sourceIndex] = true;
+        }
+        else if(unchanged == true)
+        {
+            settings.quality = DC_REFRESH_JPEG_QUALITY;
+            settings.subsampling = DC_REFRESH_JPEG_SUBSAMPLING;
+            segmentsRefreshed_[sourceIndex] = true;
+        }
+        else
         {
-            sent += tcpSocket_.write((const char *)segments[i].imageData.data() + sent, segments[i].imageData.size() - sent);
+            settings.quality = rateController_.getQuality();
+            settings.subsampling = rateController_.getSubsampling();
+            segmentsRefreshed_[sourceIndex] = rateController_.isHighestQuality();
         }
 
-        // wait for acknowledgment
-        while(tcpSocket_.waitForReadyRead() && tcpSocket_.bytesAvailable() < 3)
+        segmentsCompressionSettings_[sourceIndex] = settings;
+    }
+
+    int frameSize = 0;
+
+    // compress each changed segment, in parallel
+    std::vector<ParallelPixelStreamSegment> segments = QtConcurrent::blockingMapped<std::vector<ParallelPixelStreamSegment> >(segments_, &computeSegmentImageData);
+
+    // stream segments
+    // we have to stream all of them in case stream synchronization is on, but unchanged segments are sent without image data
+    for(unsigned int i=0; i<segments.size(); i++)
+    {
+        // update frame index
+        segments[i].parameters.frameIndex = frameIndex;
+        segments[i].parameters.captureTimestamp = captureTimestamp_;
+
+        if(sendSegment(segments[i]) != true)
         {
-#ifndef _WIN32
-            usleep(10);
-#endif
+            return false;
         }
 
-        tcpSocket_.read(3);
+        frameSize += segments[i].imageData.size();
     }
 
+    rateController_.frameSent(frameSize, frameTime.elapsed());
+
     // update segments vector
     segments_ = segments;
 
@@ -611,3 +777,131 @@ bool MainWindow::parallelStream()
 
     return true;
 }
+
+bool MainWindow::isSegmentUnchanged(const ParallelPixelStreamSegmentParameters & parameters)
+{
+    // only damaged areas can have changed
+    if(damage_.intersects(QRect(parameters.x, parameters.y, parameters.width, parameters.height)) != true)
+    {
+        return true;
+    }
+
+    // without the previous frame, damaged segments are assumed changed
+    return ::isSegmentUnchanged(image_, previousImage_, parameters);
+}
+
+void MainWindow::updateSegments()
+{
+    segments_.clear();
+    segmentsRefreshed_.clear();
+
+    // segment dimensions will be approximately this, cut along the screen boundaries of the tiled display
+    int nominalSegmentSize = 512;
+
+    std::vector<ParallelPixelStreamSegmentParameters> parameters = pixelStreamComputeSegments(wallLayout_, nominalSegmentSize, nominalSegmentSize, 0, 0, width_, height_, width_, height_);
+
+    // now, create segments with appropriate parameters
+    for(unsigned int i=0; i<parameters.size(); i++)
+    {
+        ParallelPixelStreamSegment segment;
+
+        segment.parameters = parameters[i];
+        segment.parameters.sourceIndex = i;
+
+        segments_.push_back(segment);
+    }
+}
+
+bool MainWindow::sendSegment(const ParallelPixelStreamSegment & segment)
+{
+    // send the parameters and image data
+    MessageHeader mh;
+    mh.size = sizeof(ParallelPixelStreamSegmentParameters) + segment.imageData.size();
+    mh.type = MESSAGE_TYPE_PARALLEL_PIXELSTREAM;
+
+    // add the truncated URI to the header
+    size_t len = uri_.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
+    mh.uri[len] = '\0';
+
+    // send the header
+    int sent = tcpSocket_.write((const char *)&mh, sizeof(MessageHeader));
+
+    while(sent < (int)sizeof(MessageHeader))
+    {
+        sent += tcpSocket_.write((const char *)&mh + sent, sizeof(MessageHeader) - sent);
+    }
+
+    // send the message
+
+    // part 1: parameters
+    sent = tcpSocket_.write((const char *)&(segment.parameters), sizeof(ParallelPixelStreamSegmentParameters));
+
+    while(sent < (int)sizeof(ParallelPixelStreamSegmentParameters))
+    {
+        sent += tcpSocket_.write((const char *)&(segment.parameters) + sent, sizeof(ParallelPixelStreamSegmentParameters) - sent);
+    }
+
+    // part 2: image data
+    sent = tcpSocket_.write((const char *)segment.imageData.data(), segment.imageData.size());
+
+    while(sent < segment.imageData.size())
+    {
+        sent += tcpSocket_.write((const char *)segment.imageData.data() + sent, segment.imageData.size() - sent);
+    }
+
+    // wait for acknowledgment
+    return waitForAck();
+}
+
+bool MainWindow::waitForAck()
+{
+    // the server may send wall layout updates before the acknowledgment
+    while(true)
+    {
+        // read the message header
+        MessageHeader mh;
+        int received = 0;
+
+        while(received < (int)sizeof(MessageHeader))
+        {
+            if(tcpSocket_.bytesAvailable() == 0 && tcpSocket_.waitForReadyRead() != true)
+            {
+                put_flog(LOG_ERROR, "error receiving message");
+
+                return false;
+            }
+
+            received += tcpSocket_.read((char *)&mh + received, sizeof(MessageHeader) - received);
+        }
+
+        // read the message
+        QByteArray message;
+
+        while(message.size() < mh.size)
+        {
+            if(tcpSocket_.bytesAvailable() == 0 && tcpSocket_.waitForReadyRead() != true)
+            {
+                put_flog(LOG_ERROR, "error receiving message");
+
+                return false;
+            }
+
+            message.append(tcpSocket_.read(mh.size - message.size()));
+        }
+
+        if(mh.type == MESSAGE_TYPE_ACK)
+        {
+            return true;
+        }
+        else if(mh.type == MESSAGE_TYPE_WALL_LAYOUT && message.size() == sizeof(WallLayout))
+        {
+            WallLayout wallLayout = *(WallLayout *)message.data();
+
+            if(wallLayout != wallLayout_)
+            {
+                wallLayout_ = wallLayout;
+                updatedWallLayout_ = true;
+            }
+        }
+    }
+}
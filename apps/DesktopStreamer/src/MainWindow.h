@@ -39,20 +39,32 @@
 #ifndef MAIN_WINDOW_H
 #define MAIN_WINDOW_H
 
-#define SUPPORTED_NETWORK_PROTOCOL_VERSION 5
+#define SUPPORTED_NETWORK_PROTOCOL_VERSION 12
 
 #define SHARE_DESKTOP_UPDATE_DELAY 1
 
 #define FRAME_RATE_AVERAGE_NUM_FRAMES 10
 
-#define JPEG_QUALITY 75
+// send all segments at least this often (in frames), even if unchanged
+#define SEGMENT_REFRESH_INTERVAL 100
 
 #include "../../../src/ParallelPixelStream.h"
+#include "../../../src/WallLayout.h"
+#include "../../../src/lib/DcRateController.h"
+#include "DesktopCapture.h"
 #include <QtGui>
 #include <QtNetwork/QTcpSocket>
 #include <string>
 
-ParallelPixelStreamSegment computeSegmentJpeg(const ParallelPixelStreamSegment & segment);
+// codec (PIXEL_STREAM_CODEC) and JPEG settings for a segment
+struct SegmentCompressionSettings {
+    int codec;
+    int quality;
+    int subsampling;
+};
+
+bool isSegmentUnchanged(const QImage & image, const QImage & previousImage, const ParallelPixelStreamSegmentParameters & parameters);
+ParallelPixelStreamSegment computeSegmentImageData(const ParallelPixelStreamSegment & segment);
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -66,11 +78,15 @@ class MainWindow : public QMainWindow {
 
         QImage getImage();
 
+        // get the compression settings for a segment in this frame; returns false if the segment is unchanged and not compressed
+        bool getSegmentCompressionSettings(int sourceIndex, SegmentCompressionSettings & settings);
+
     public slots:
 
         void shareDesktop(bool set);
         void showDesktopSelectionWindow(bool set);
         void setParallelStreaming(bool set);
+        void setX11Capture(bool set);
         void shareDesktopUpdate();
         void updateCoordinates();
 
@@ -99,15 +115,47 @@ class MainWindow : public QMainWindow {
 
         bool parallelStreaming_;
 
+        // captures the desktop, and finds the areas that changed
+        DesktopCapture desktopCapture_;
+
         // full image
         QImage image_;
 
+        // areas of the image changed since the previous frame
+        QRegion damage_;
+
+        // time the image was captured, in microseconds since the epoch, sent with the segments for latency measurement
+        qint64 captureTimestamp_;
+
+        // full image of the previous frame, for detecting unchanged segments; not kept with X11 capture, which
+        // overwrites the image in place and reports the changed areas exactly
+        QImage previousImage_;
+
+        // chooses codecs, and JPEG quality and subsampling for the target frame rate
+        DcRateController rateController_;
+
         // for regular pixel streaming
         QByteArray previousImageData_;
 
+        // whether the last image sent was at least refresh quality
+        bool refreshed_;
+
         // for parallel pixel streaming
         std::vector<ParallelPixelStreamSegment> segments_;
 
+        // number of segments (source indices) the server has for the stream
+        unsigned int numSentSegments_;
+
+        // layout of the tiled display and our window on it; segments are cut along its screen boundaries
+        WallLayout wallLayout_;
+        bool updatedWallLayout_;
+
+        // compression settings for the segments compressed this frame, by source index
+        std::map<int, SegmentCompressionSettings> segmentsCompressionSettings_;
+
+        // whether the last image sent for each segment was at least refresh quality, by source index
+        std::map<int, bool> segmentsRefreshed_;
+
         QTimer shareDesktopUpdateTimer_;
 
         // used for frame rate calculations
@@ -117,6 +165,15 @@ class MainWindow : public QMainWindow {
 
         bool serialStream();
         bool parallelStream();
+
+        // true if the segment is unchanged since the previous frame
+        bool isSegmentUnchanged(const ParallelPixelStreamSegmentParameters & parameters);
+
+        void updateSegments();
+        bool sendSegment(const ParallelPixelStreamSegment & segment);
+
+        // read messages until an acknowledgment is received, handling wall layout updates
+        bool waitForAck();
 };
 
 #endif
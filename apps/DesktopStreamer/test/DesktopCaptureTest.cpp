@@ -0,0 +1,239 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "../src/DesktopCapture.h"
+#include <iostream>
+
+// tests DesktopCapture against a real X server: draws into a window, captures it, and checks the damaged areas and
+// the pixels, for X11 capture and for the QPixmap::grabWindow() fallback. meant to run on a virtual display:
+//
+//   xvfb-run -a -s "-screen 0 640x480x24" ./desktopcapturetest
+//
+// the display needs 24 bit depth for X11 capture. returns 0 if all checks pass.
+
+#define TEST_WINDOW_X 50
+#define TEST_WINDOW_Y 40
+#define TEST_WINDOW_WIDTH 200
+#define TEST_WINDOW_HEIGHT 150
+
+int g_failures = 0;
+
+void check(bool condition, const char * description)
+{
+    std::cout << (condition == true ? "PASS: " : "FAIL: ") << description << std::endl;
+
+    if(condition != true)
+    {
+        g_failures++;
+    }
+}
+
+// fills the window with a background color and one rectangle with another color
+class TestWindow : public QWidget {
+
+    public:
+
+        TestWindow()
+        {
+            // defaults
+            background_ = Qt::red;
+            color_ = Qt::blue;
+        }
+
+        void setRect(QRect rect)
+        {
+            QRect previousRect = rect_;
+            rect_ = rect;
+
+            update(previousRect);
+            update(rect_);
+        }
+
+        QColor getPixel(QPoint point)
+        {
+            return rect_.contains(point) == true ? color_ : background_;
+        }
+
+    protected:
+
+        void paintEvent(QPaintEvent * event)
+        {
+            QPainter painter(this);
+            painter.fillRect(rect(), background_);
+            painter.fillRect(rect_, color_);
+        }
+
+    private:
+
+        QColor background_;
+        QColor color_;
+        QRect rect_;
+};
+
+// let the window paint, and make sure the X server has drawn it
+void waitForPaint()
+{
+    QTime time;
+    time.start();
+
+    while(time.elapsed() < 250)
+    {
+        QApplication::processEvents(QEventLoop::AllEvents, 10);
+        QApplication::syncX();
+    }
+}
+
+// true if every pixel of image matches window
+bool checkPixels(TestWindow & window, const QImage & image)
+{
+    for(int y=0; y<image.height(); y++)
+    {
+        for(int x=0; x<image.width(); x++)
+        {
+            if((image.pixel(x, y) & 0xffffff) != (window.getPixel(QPoint(x, y)).rgb() & 0xffffff))
+            {
+                std::cout << "pixel (" << x << ", " << y << ") differs" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// true if both images have the same pixels
+bool comparePixels(const QImage & image1, const QImage & image2)
+{
+    if(image1.size() != image2.size())
+    {
+        return false;
+    }
+
+    for(int y=0; y<image1.height(); y++)
+    {
+        for(int x=0; x<image1.width(); x++)
+        {
+            if((image1.pixel(x, y) & 0xffffff) != (image2.pixel(x, y) & 0xffffff))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    QApplication app(argc, argv);
+
+    // without a window manager the window is placed exactly
+    TestWindow window;
+    window.setWindowFlags(Qt::FramelessWindowHint | Qt::X11BypassWindowManagerHint);
+    window.setGeometry(TEST_WINDOW_X, TEST_WINDOW_Y, TEST_WINDOW_WIDTH, TEST_WINDOW_HEIGHT);
+    window.show();
+
+    waitForPaint();
+
+    QPoint origin = window.mapToGlobal(QPoint(0, 0));
+    QRegion fullDamage(0, 0, TEST_WINDOW_WIDTH, TEST_WINDOW_HEIGHT);
+
+    QImage image;
+    QRegion damage;
+
+    // X11 capture
+    DesktopCapture x11Capture;
+
+    bool success = x11Capture.capture(origin.x(), origin.y(), TEST_WINDOW_WIDTH, TEST_WINDOW_HEIGHT, image, damage);
+
+#if ENABLE_X11_CAPTURE
+    check(success == true && x11Capture.isX11Capture() == true, "X11 capture is used");
+#else
+    std::cout << "SKIP: built without X11 capture" << std::endl;
+#endif
+    check(success == true && damage == fullDamage, "first capture reports the whole image as damaged");
+    check(success == true && checkPixels(window, image) == true, "first capture pixels");
+
+    // nothing changed
+    success = x11Capture.capture(origin.x(), origin.y(), TEST_WINDOW_WIDTH, TEST_WINDOW_HEIGHT, image, damage);
+
+    if(x11Capture.isX11Capture() == true)
+    {
+        check(success == true && damage.isEmpty() == true, "unchanged capture reports no damage");
+    }
+
+    check(success == true && checkPixels(window, image) == true, "unchanged capture pixels");
+
+    // change a rectangle
+    QRect changedRect(20, 30, 40, 25);
+
+    window.setRect(changedRect);
+    waitForPaint();
+
+    success = x11Capture.capture(origin.x(), origin.y(), TEST_WINDOW_WIDTH, TEST_WINDOW_HEIGHT, image, damage);
+
+    check(success == true && QRegion(changedRect).subtracted(damage).isEmpty() == true, "damage covers the changed rectangle");
+    check(success == true && checkPixels(window, image) == true, "changed capture pixels");
+
+    // the X11 image is overwritten by the next capture
+    QImage x11Image = image.copy();
+    bool x11Captured = x11Capture.isX11Capture();
+
+    // fallback capture
+    DesktopCapture fallbackCapture;
+    fallbackCapture.setX11Capture(false);
+
+    success = fallbackCapture.capture(origin.x(), origin.y(), TEST_WINDOW_WIDTH, TEST_WINDOW_HEIGHT, image, damage);
+
+    check(success == true && fallbackCapture.isX11Capture() != true, "fallback capture is used");
+    check(success == true && damage == fullDamage, "fallback capture reports the whole image as damaged");
+    check(success == true && checkPixels(window, image) == true, "fallback capture pixels");
+
+    if(x11Captured == true)
+    {
+        check(success == true && comparePixels(x11Image, image) == true, "X11 and fallback captures match");
+    }
+
+    if(g_failures > 0)
+    {
+        std::cout << g_failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
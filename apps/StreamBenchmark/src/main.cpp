@@ -0,0 +1,436 @@
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// DisplayCluster streaming
+#include <dcStream.h>
+
+// for the local acknowledging server
+#include <MessageHeader.h>
+#include <NetworkProtocol.h>
+#include <SharedMemoryRing.h>
+
+// measures the cost of dcStreamSend() for a synthetic animated image: frames per second, bandwidth, and heap
+// allocations per frame once the stream has reached a steady state. segments are streamed to a DisplayCluster
+// instance, or to a local server that only acknowledges messages if no hostname is given. running it with -m 0 and
+// -m 1 compares the socket and shared memory transports.
+
+std::string dcStreamName = "StreamBenchmark";
+int dcWidth = 1920;
+int dcHeight = 1080;
+int dcSegmentSize = 512;
+int dcWarmupFrames = 20;
+int dcFrames = 200;
+SEGMENT_CODEC dcCodec = CODEC_AUTO;
+bool dcNoise = false;
+bool dcAsync = false;
+bool dcSharedMemory = true;
+char * dcHostname = NULL;
+
+void syntax(char * app);
+void fillImage(unsigned char * imageData, int frame);
+pid_t startServer();
+
+// heap allocation counting; malloc() and friends are interposed, and forward to glibc
+std::atomic<long> g_allocationCount(0);
+
+#ifdef __GLIBC__
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * ptr, size_t size);
+
+extern "C" void * malloc(size_t size)
+{
+    g_allocationCount++;
+    return __libc_malloc(size);
+}
+
+extern "C" void * calloc(size_t count, size_t size)
+{
+    g_allocationCount++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void * realloc(void * ptr, size_t size)
+{
+    g_allocationCount++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    // parse arguments
+    for(int i=1; i<argc; i++)
+    {
+        if(argv[i][0] == '-' && strlen(argv[i]) == 2)
+        {
+            if(i+1 >= argc)
+            {
+                syntax(argv[0]);
+            }
+
+            switch(argv[i][1])
+            {
+                case 'w':
+                    dcWidth = atoi(argv[++i]);
+                    break;
+                case 'h':
+                    dcHeight = atoi(argv[++i]);
+                    break;
+                case 's':
+                    dcSegmentSize = atoi(argv[++i]);
+                    break;
+                case 'f':
+                    dcFrames = atoi(argv[++i]);
+                    break;
+                case 'c':
+                    i++;
+                    if(strcmp(argv[i], "jpeg") == 0)
+                        dcCodec = CODEC_JPEG;
+                    else if(strcmp(argv[i], "raw") == 0)
+                        dcCodec = CODEC_RAW;
+                    else if(strcmp(argv[i], "lz4") == 0)
+                        dcCodec = CODEC_LZ4;
+                    else if(strcmp(argv[i], "auto") == 0)
+                        dcCodec = CODEC_AUTO;
+                    else
+                        syntax(argv[0]);
+                    break;
+                case 'n':
+                    dcNoise = atoi(argv[++i]) != 0;
+                    break;
+                case 'a':
+                    dcAsync = atoi(argv[++i]) != 0;
+                    break;
+                case 'm':
+                    dcSharedMemory = atoi(argv[++i]) != 0;
+                    break;
+                default:
+                    syntax(argv[0]);
+            }
+        }
+        else if(i == argc-1)
+        {
+            dcHostname = argv[i];
+        }
+        else
+        {
+            syntax(argv[0]);
+        }
+    }
+
+    // without a hostname, stream to a local server that only acknowledges messages
+    pid_t serverPid = 0;
+
+    if(dcHostname == NULL)
+    {
+        serverPid = startServer();
+
+        if(serverPid <= 0)
+        {
+            std::cerr << "could not start local server" << std::endl;
+            return 1;
+        }
+
+        dcHostname = (char *)"127.0.0.1";
+    }
+
+    DcSocket * dcSocket = dcStreamConnect(dcHostname, dcSharedMemory);
+
+    if(dcSocket == NULL)
+    {
+        std::cerr << "could not connect to DisplayCluster host: " << dcHostname << std::endl;
+        return 1;
+    }
+
+    dcStreamSetCodec(dcStreamName, dcCodec);
+
+    // block rather than drop frames, so every frame is measured
+    if(dcAsync == true)
+    {
+        dcStreamSetAsyncPolicy(dcSocket, ASYNC_BLOCK, 1);
+    }
+
+    unsigned char * imageData = (unsigned char *)malloc(dcWidth * dcHeight * 4);
+
+    std::vector<DcStreamParameters> parameters = dcStreamGenerateParameters(dcStreamName, 0, dcSegmentSize,dcSegmentSize, 0,0,dcWidth,dcHeight, dcWidth,dcHeight);
+
+    long allocationCount = 0;
+    struct timeval startTime;
+
+    for(int frame=0; frame<dcWarmupFrames + dcFrames; frame++)
+    {
+        // start measuring after the warmup frames
+        if(frame == dcWarmupFrames)
+        {
+            allocationCount = g_allocationCount;
+            gettimeofday(&startTime, NULL);
+        }
+
+        fillImage(imageData, frame);
+
+        if(dcAsync == true)
+        {
+            if(dcStreamSendAsync(dcSocket, imageData, 0,0,dcWidth,0,dcHeight, RGBA, parameters) != true)
+            {
+                std::cerr << "failure in dcStreamSendAsync()" << std::endl;
+                return 1;
+            }
+        }
+        else if(dcStreamSend(dcSocket, imageData, 0,0,dcWidth,0,dcHeight, RGBA, parameters) != true)
+        {
+            std::cerr << "failure in dcStreamSend()" << std::endl;
+            return 1;
+        }
+
+        dcStreamIncrementFrameIndex();
+    }
+
+    if(dcAsync == true && dcStreamWaitForAsync(dcSocket) != true)
+    {
+        std::cerr << "failure in dcStreamSendAsync()" << std::endl;
+        return 1;
+    }
+
+    allocationCount = g_allocationCount - allocationCount;
+
+    struct timeval endTime;
+    gettimeofday(&endTime, NULL);
+
+    double seconds = (double)(endTime.tv_sec - startTime.tv_sec) + (double)(endTime.tv_usec - startTime.tv_usec) / 1000000.;
+
+    DcStreamRateStatus status = dcStreamGetRateStatus(dcStreamName);
+
+    std::cout << "transport: " << (dcStreamIsSharedMemory(dcSocket) == true ? "shared memory" : "socket") << std::endl;
+    std::cout << "frames: " << dcFrames << " (" << dcWidth << "x" << dcHeight << ", " << parameters.size() << " segments)" << std::endl;
+    std::cout << "frame rate: " << (double)dcFrames / seconds << " fps" << std::endl;
+    std::cout << "bandwidth: " << status.bandwidth << " Mbps" << std::endl;
+    std::cout << "JPEG quality: " << status.quality << std::endl;
+#ifdef __GLIBC__
+    std::cout << "heap allocations per frame: " << (double)allocationCount / (double)dcFrames << std::endl;
+#else
+    std::cout << "heap allocations per frame: not measured on this platform" << std::endl;
+#endif
+
+    dcStreamDisconnect(dcSocket);
+
+    free(imageData);
+
+    if(serverPid > 0)
+    {
+        kill(serverPid, SIGTERM);
+        waitpid(serverPid, NULL, 0);
+    }
+
+    return 0;
+}
+
+void syntax(char * app)
+{
+    std::cerr << "syntax: " << app << " [options] [hostname]" << std::endl;
+    std::cerr << "without a hostname, segments are streamed to a local server that only acknowledges them" << std::endl;
+    std::cerr << "options:" << std::endl;
+    std::cerr << " -w <width>           set image width (default 1920)" << std::endl;
+    std::cerr << " -h <height>          set image height (default 1080)" << std::endl;
+    std::cerr << " -s <segment size>    set segment size (default 512)" << std::endl;
+    std::cerr << " -f <frames>          set number of measured frames (default 200)" << std::endl;
+    std::cerr << " -c <codec>           set codec: jpeg, raw, lz4, or auto (default auto)" << std::endl;
+    std::cerr << " -n <0|1>             add noise to the image, so it is high-entropy (default 0)" << std::endl;
+    std::cerr << " -a <0|1>             send asynchronously with dcStreamSendAsync() (default 0)" << std::endl;
+    std::cerr << " -m <0|1>             use shared memory if the server is on this host (default 1)" << std::endl;
+
+    exit(1);
+}
+
+void fillImage(unsigned char * imageData, int frame)
+{
+    // flat background with a moving bar, like a user interface; only the segments under the bar change
+    int barX = (frame * 16) % dcWidth;
+    int barWidth = dcWidth / 8;
+
+    // xorshift noise
+    static unsigned int noise = 2463534242U;
+
+    for(int j=0; j<dcHeight; j++)
+    {
+        unsigned char * line = imageData + j * dcWidth * 4;
+
+        for(int i=0; i<dcWidth; i++)
+        {
+            bool bar = (i >= barX && i < barX + barWidth);
+
+            unsigned char value = bar == true ? 200 : 64;
+
+            if(dcNoise == true)
+            {
+                noise ^= noise << 13;
+                noise ^= noise >> 17;
+                noise ^= noise << 5;
+
+                value += (noise & 63) + frame;
+            }
+
+            line[4*i] = value;
+            line[4*i + 1] = bar == true ? 64 : value;
+            line[4*i + 2] = value;
+            line[4*i + 3] = 255;
+        }
+    }
+}
+
+pid_t startServer()
+{
+    // the server signals on this pipe once it is listening
+    int readyPipe[2];
+
+    if(pipe(readyPipe) != 0)
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+
+    if(pid != 0)
+    {
+        close(readyPipe[1]);
+
+        char ready = 0;
+
+        if(read(readyPipe[0], &ready, 1) != 1 || ready != 1)
+        {
+            close(readyPipe[0]);
+            return -1;
+        }
+
+        close(readyPipe[0]);
+
+        return pid;
+    }
+
+    close(readyPipe[0]);
+
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(1701);
+
+    char ready = 0;
+
+    if(bind(listenSocket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listenSocket, 1) != 0)
+    {
+        ready = 0;
+        write(readyPipe[1], &ready, 1);
+        _exit(1);
+    }
+
+    ready = 1;
+    write(readyPipe[1], &ready, 1);
+    close(readyPipe[1]);
+
+    int clientSocket = accept(listenSocket, NULL, NULL);
+
+    int32_t protocolVersion = NETWORK_PROTOCOL_VERSION;
+    send(clientSocket, &protocolVersion, sizeof(int32_t), 0);
+
+    // receive messages and acknowledge each one
+    static char message[1 << 16];
+
+    // messages from shared memory, once the client binds it; they are acknowledged by reading them
+    SharedMemoryRing sharedMemoryRing;
+
+    while(true)
+    {
+        if(sharedMemoryRing.isAttached() == true)
+        {
+            const char * data;
+            int size;
+
+            // copy each message out, like DisplayCluster does
+            while(sharedMemoryRing.peek(data, size) == true)
+            {
+                if(size < 0)
+                {
+                    std::cerr << "corrupt shared memory record" << std::endl;
+                    sharedMemoryRing.finalize();
+                    break;
+                }
+
+                for(int offset=0; offset<size; offset+=sizeof(message))
+                {
+                    memcpy(message, data + offset, size - offset < (int)sizeof(message) ? size - offset : (int)sizeof(message));
+                }
+
+                sharedMemoryRing.pop();
+            }
+
+            // wait briefly for socket messages
+            struct pollfd pfd;
+            pfd.fd = clientSocket;
+            pfd.events = POLLIN;
+
+            if(poll(&pfd, 1, 1) <= 0)
+            {
+                continue;
+            }
+        }
+
+        MessageHeader mh;
+
+        if(recv(clientSocket, &mh, sizeof(MessageHeader), MSG_WAITALL) != (ssize_t)sizeof(MessageHeader))
+        {
+            break;
+        }
+
+        int remaining = mh.size;
+
+        while(remaining > 0)
+        {
+            ssize_t received = recv(clientSocket, message, remaining < (int)sizeof(message) ? remaining : (int)sizeof(message), 0);
+
+            if(received <= 0)
+            {
+                _exit(0);
+            }
+
+            remaining -= received;
+        }
+
+        MessageHeader mhAck;
+        mhAck.size = 0;
+        mhAck.type = MESSAGE_TYPE_ACK;
+
+        send(clientSocket, &mhAck, sizeof(MessageHeader), 0);
+
+        if(mh.type == MESSAGE_TYPE_BIND_SHARED_MEMORY)
+        {
+            int32_t result = sharedMemoryRing.attach(std::string(mh.uri)) == true ? 1 : 0;
+
+            MessageHeader mhResult;
+            mhResult.size = sizeof(int32_t);
+            mhResult.type = MESSAGE_TYPE_BIND_SHARED_MEMORY;
+
+            send(clientSocket, &mhResult, sizeof(MessageHeader), 0);
+            send(clientSocket, &result, sizeof(int32_t), 0);
+        }
+    }
+
+    _exit(0);
+}
@@ -0,0 +1,31 @@
+# - Try to find LZ4
+# Once done, this will define
+#
+#  LZ4_FOUND - system has LZ4
+#  LZ4_INCLUDE_DIRS - the LZ4 include directories
+#  LZ4_LIBRARIES - link these to use LZ4
+#
+# this file is modeled after http://www.cmake.org/Wiki/CMake:How_To_Find_Libraries
+
+include(LibFindMacros)
+
+# Use pkg-config to get hints about paths
+libfind_pkg_check_modules(LZ4_PKGCONF liblz4)
+
+# Include dir
+find_path(LZ4_INCLUDE_DIR
+  NAMES lz4.h
+  PATHS ${LZ4_PKGCONF_INCLUDE_DIRS}
+)
+
+# Finally the library itself
+find_library(LZ4_LIBRARY
+  NAMES lz4
+  PATHS ${LZ4_PKGCONF_LIBRARY_DIRS}
+)
+
+# Set the include dir variables and the libraries and let libfind_process do the rest.
+# NOTE: Singular variables for this library, plural for libraries this this lib depends on.
+set(LZ4_PROCESS_INCLUDES LZ4_INCLUDE_DIR)
+set(LZ4_PROCESS_LIBS LZ4_LIBRARY)
+libfind_process(LZ4)
\ No newline at end of file
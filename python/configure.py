@@ -19,13 +19,10 @@ parser.add_argument('-l', metavar='directoryList',
 
 args = parser.parse_args()
 
-includeDirs = ""
+includeDirs = []
 if args.includeDirs:
     for i in args.includeDirs:
-        if includeDirs == "":
-            includeDirs = i[0]
-        else:
-            includeDirs = includeDirs + ';' + i[0]
+        includeDirs.append(i[0])
 
 libraryDirs = ""
 if args.libraryDirs:
@@ -75,7 +72,7 @@ makefile = pyqtconfig.QtGuiModuleMakefile(
 )
 
 makefile.extra_include_dirs.append("../src")
-makefile.extra_include_dirs.append(includeDirs)
+makefile.extra_include_dirs.extend(includeDirs)
 
 # Add the library we are wrapping.  The name doesn't include any platform
 # specific prefixes or extensions (e.g. the "lib" prefix on UNIX, or the
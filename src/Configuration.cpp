@@ -39,6 +39,7 @@
 #include "Configuration.h"
 #include "log.h"
 #include "main.h"
+#include "StreamMetrics.h"
 
 Configuration::Configuration(const char * filename)
 {
@@ -92,6 +93,49 @@ Configuration::Configuration(const char * filename)
         fullscreen_ = 0;
     }
 
+    // host-wide shared tile cache size in megabytes (optional element)
+    query_.setQuery("string(/configuration/sharedTileCache/@size)");
+
+    if(query_.evaluateTo(&qstring) == true && qstring.isEmpty() != true)
+    {
+        sharedTileCacheSize_ = qstring.toInt();
+    }
+    else
+    {
+        sharedTileCacheSize_ = DEFAULT_SHARED_TILE_CACHE_SIZE;
+    }
+
+    // image pyramid cache directory (optional element); must be accessible to all processes
+    query_.setQuery("string(/configuration/imagePyramidCache/@directory)");
+
+    if(query_.evaluateTo(&qstring) == true && qstring.trimmed().isEmpty() != true)
+    {
+        imagePyramidCacheDirectory_ = qstring.trimmed().toStdString();
+    }
+    else
+    {
+        imagePyramidCacheDirectory_ = g_displayClusterDir + "/pyramids";
+    }
+
+    // stream metrics export file and interval in seconds (optional element); .json files are written as JSON, others as CSV
+    query_.setQuery("string(/configuration/streamMetrics/@file)");
+
+    if(query_.evaluateTo(&qstring) == true)
+    {
+        streamMetricsFilename_ = qstring.trimmed().toStdString();
+    }
+
+    query_.setQuery("string(/configuration/streamMetrics/@interval)");
+
+    if(query_.evaluateTo(&qstring) == true && qstring.isEmpty() != true)
+    {
+        streamMetricsInterval_ = qstring.toInt();
+    }
+    else
+    {
+        streamMetricsInterval_ = DEFAULT_STREAM_METRICS_EXPORT_INTERVAL;
+    }
+
     put_flog(LOG_INFO, "dimensions: numTilesWidth = %i, numTilesHeight = %i, screenWidth = %i, screenHeight = %i, mullionWidth = %i, mullionHeight = %i. fullscreen = %i", numTilesWidth_, numTilesHeight_, screenWidth_, screenHeight_, mullionWidth_, mullionHeight_, fullscreen_);
 
     // get tile parameters (if we're not rank 0)
@@ -214,6 +258,26 @@ int Configuration::getTotalHeight()
     return numTilesHeight_ * screenHeight_ + (numTilesHeight_ - 1) * getMullionHeight();
 }
 
+int Configuration::getSharedTileCacheSize()
+{
+    return sharedTileCacheSize_;
+}
+
+std::string Configuration::getImagePyramidCacheDirectory()
+{
+    return imagePyramidCacheDirectory_;
+}
+
+std::string Configuration::getStreamMetricsFilename()
+{
+    return streamMetricsFilename_;
+}
+
+int Configuration::getStreamMetricsInterval()
+{
+    return streamMetricsInterval_;
+}
+
 std::string Configuration::getMyHost()
 {
     return host_;
@@ -39,6 +39,9 @@
 #ifndef CONFIGURATION_H
 #define CONFIGURATION_H
 
+// default size in megabytes of the host-wide shared tile cache
+#define DEFAULT_SHARED_TILE_CACHE_SIZE 256
+
 #include <QtGui>
 #include <QtXmlPatterns>
 
@@ -57,6 +60,10 @@ class Configuration {
         bool getFullscreen();
         int getTotalWidth();
         int getTotalHeight();
+        int getSharedTileCacheSize(); // megabytes; 0 if disabled
+        std::string getImagePyramidCacheDirectory();
+        std::string getStreamMetricsFilename(); // empty if stream metrics are not exported
+        int getStreamMetricsInterval(); // seconds
 
         std::string getMyHost();
         std::string getMyDisplay();
@@ -78,6 +85,10 @@ class Configuration {
         int mullionWidth_;
         int mullionHeight_;
         int fullscreen_;
+        int sharedTileCacheSize_;
+        std::string imagePyramidCacheDirectory_;
+        std::string streamMetricsFilename_;
+        int streamMetricsInterval_;
 
         std::string host_;
         std::string display_;
@@ -42,6 +42,7 @@
 #include "DynamicTextureContent.h"
 #include "SVGContent.h"
 #include "MovieContent.h"
+#include "ImagePyramidCache.h"
 #include "main.h"
 #include "GLWindow.h"
 #include "log.h"
@@ -99,6 +100,19 @@ void Content::render(boost::shared_ptr<ContentWindowManager> window)
     // render the factory object
     renderFactoryObject(tX, tY, tW, tH);
 
+    // if the view is moving, prefetch for where it will be, including a margin around it
+    double predictedCenterX, predictedCenterY, predictedZoom;
+
+    if(window->getPredictedView(PREFETCH_LOOKAHEAD_MILLISECONDS, predictedCenterX, predictedCenterY, predictedZoom) == true)
+    {
+        float pW = (1. + 2. * PREFETCH_MARGIN) / predictedZoom;
+        float pH = (1. + 2. * PREFETCH_MARGIN) / predictedZoom;
+        float pX = predictedCenterX - 0.5 * pW;
+        float pY = predictedCenterY - 0.5 * pH;
+
+        prefetchFactoryObject(pX, pY, pW, pH);
+    }
+
     // render the context view
     if(g_displayGroupManager->getOptions()->getShowZoomContext() == true && zoom > 1.)
     {
@@ -204,7 +218,11 @@ boost::shared_ptr<Content> Content::getContent(std::string uri)
         }
         else
         {
-            boost::shared_ptr<Content> temp(new DynamicTextureContent(uri));
+            // large images are shown from a cached image pyramid, which is generated in the background on first use
+            // nothing is shown until the image pyramid cache resolves its source
+            boost::shared_ptr<DynamicTextureContent> temp(new DynamicTextureContent(uri));
+            temp->setImageSourceURI("");
+            g_imagePyramidCache.requestImageSource(temp);
             c = temp;
         }
 
@@ -41,6 +41,12 @@
 
 #define ERROR_IMAGE_FILENAME "error.png"
 
+// how far ahead to predict the view of a moving window for prefetching
+#define PREFETCH_LOOKAHEAD_MILLISECONDS 300
+
+// fraction of the predicted view size to also prefetch around it
+#define PREFETCH_MARGIN 0.25
+
 #include <string>
 #include <QtGui>
 #include <boost/shared_ptr.hpp>
@@ -79,6 +85,9 @@ class Content : public QObject {
 
         void dimensionsChanged(int width, int height);
 
+        // emitted when state sent with the display group changes, other than the dimensions
+        void modified();
+
     protected:
         friend class boost::serialization::access;
 
@@ -95,6 +104,9 @@ class Content : public QObject {
         int height_;
 
         virtual void renderFactoryObject(float tX, float tY, float tW, float tH) = 0;
+
+        // optionally prepare the factory object for a future view; called with the same transformation as renderFactoryObject()
+        virtual void prefetchFactoryObject(float tX, float tY, float tW, float tH) { }
 };
 
 BOOST_SERIALIZATION_ASSUME_ABSTRACT(Content)
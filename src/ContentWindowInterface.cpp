@@ -56,6 +56,10 @@ ContentWindowInterface::ContentWindowInterface(boost::shared_ptr<ContentWindowMa
         centerX_ = contentWindowManager->centerX_;
         centerY_ = contentWindowManager->centerY_;
         zoom_ = contentWindowManager->zoom_;
+        centerVelocityX_ = contentWindowManager->centerVelocityX_;
+        centerVelocityY_ = contentWindowManager->centerVelocityY_;
+        zoomVelocity_ = contentWindowManager->zoomVelocity_;
+        viewChangedTimestamp_ = contentWindowManager->viewChangedTimestamp_;
         windowState_ = contentWindowManager->windowState_;
         interactionState_ = contentWindowManager->interactionState_;
     }
@@ -164,6 +168,37 @@ bool ContentWindowInterface::getHighlighted()
     }
 }
 
+bool ContentWindowInterface::getPredictedView(long lookaheadMilliseconds, double &centerX, double &centerY, double &zoom)
+{
+    centerX = centerX_;
+    centerY = centerY_;
+    zoom = zoom_;
+
+    if(viewChangedTimestamp_.is_not_a_date_time() == true)
+    {
+        return false;
+    }
+
+    long dtMilliseconds = (*(g_displayGroupManager->getTimestamp()) - viewChangedTimestamp_).total_milliseconds();
+
+    if(dtMilliseconds > VIEW_VELOCITY_TIMEOUT_MILLISECONDS || (centerVelocityX_ == 0. && centerVelocityY_ == 0. && zoomVelocity_ == 0.))
+    {
+        return false;
+    }
+
+    double dt = (double)lookaheadMilliseconds / 1000.;
+
+    zoom = std::max(zoom_ * exp(zoomVelocity_ * dt), 1.);
+
+    // clamp the center point such that the view rectangle is within [0,1], as in setCenter()
+    double halfSize = 0.5 / zoom;
+
+    centerX = std::min(std::max(centerX_ + centerVelocityX_ * dt, halfSize), 1. - halfSize);
+    centerY = std::min(std::max(centerY_ + centerVelocityY_ * dt, halfSize), 1. - halfSize);
+
+    return true;
+}
+
 void ContentWindowInterface::getButtonDimensions(float &width, float &height)
 {
     float sceneHeightFraction = 0.125;
@@ -358,6 +393,9 @@ void ContentWindowInterface::setCenter(double centerX, double centerY, ContentWi
         return;
     }
 
+    double previousCenterX = centerX_;
+    double previousCenterY = centerY_;
+
     // clamp center point such that view rectangle dimensions are constrained [0,1]
     float tX = centerX - 0.5 / zoom_;
     float tY = centerY - 0.5 / zoom_;
@@ -392,6 +430,8 @@ void ContentWindowInterface::setCenter(double centerX, double centerY, ContentWi
         centerY_ = 1. - tH + 0.5 / zoom_;
     }
 
+    updateViewVelocity(previousCenterX, previousCenterY, zoom_);
+
     if(source == NULL || dynamic_cast<ContentWindowManager *>(this) != NULL)
     {
         if(source == NULL)
@@ -416,6 +456,8 @@ void ContentWindowInterface::setZoom(double zoom, ContentWindowInterface * sourc
         zoom = 1.;
     }
 
+    double previousZoom = zoom_;
+
     zoom_ = zoom;
 
     float tX = centerX_ - 0.5 / zoom;
@@ -449,6 +491,8 @@ void ContentWindowInterface::setZoom(double zoom, ContentWindowInterface * sourc
         setCenter(centerX_, centerY_);
     }
 
+    updateViewVelocity(centerX_, centerY_, previousZoom);
+
     if(source == NULL || dynamic_cast<ContentWindowManager *>(this) != NULL)
     {
         if(source == NULL)
@@ -556,3 +600,41 @@ void ContentWindowInterface::close(ContentWindowInterface * source)
         emit(closed(source));
     }
 }
+
+void ContentWindowInterface::updateViewVelocity(double previousCenterX, double previousCenterY, double previousZoom)
+{
+    boost::posix_time::ptime timestamp = *(g_displayGroupManager->getTimestamp());
+
+    if(viewChangedTimestamp_.is_not_a_date_time() == true)
+    {
+        centerVelocityX_ = centerVelocityY_ = zoomVelocity_ = 0.;
+        viewChangedTimestamp_ = timestamp;
+        return;
+    }
+
+    long dtMilliseconds = (timestamp - viewChangedTimestamp_).total_milliseconds();
+
+    // multiple updates in the same millisecond (e.g. setZoom() calling setCenter()) carry no velocity information
+    if(dtMilliseconds <= 0)
+    {
+        return;
+    }
+
+    if(dtMilliseconds > VIEW_VELOCITY_TIMEOUT_MILLISECONDS)
+    {
+        // the view was at rest; start a new estimate
+        centerVelocityX_ = centerVelocityY_ = zoomVelocity_ = 0.;
+    }
+    else
+    {
+        // exponentially smooth the instantaneous velocities
+        double alpha = 0.5;
+        double dt = (double)dtMilliseconds / 1000.;
+
+        centerVelocityX_ = alpha * (centerX_ - previousCenterX) / dt + (1. - alpha) * centerVelocityX_;
+        centerVelocityY_ = alpha * (centerY_ - previousCenterY) / dt + (1. - alpha) * centerVelocityY_;
+        zoomVelocity_ = alpha * log(zoom_ / previousZoom) / dt + (1. - alpha) * zoomVelocity_;
+    }
+
+    viewChangedTimestamp_ = timestamp;
+}
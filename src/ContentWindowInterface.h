@@ -42,6 +42,9 @@
 #define HIGHLIGHT_TIMEOUT_MILLISECONDS 1500
 #define HIGHLIGHT_BLINK_INTERVAL 250 // milliseconds
 
+// the view is considered at rest if it hasn't changed in this long
+#define VIEW_VELOCITY_TIMEOUT_MILLISECONDS 250
+
 #include "InteractionState.h"
 #include <QtGui>
 #include <boost/shared_ptr.hpp>
@@ -89,6 +92,9 @@ class ContentWindowInterface : public QObject {
         void getCenter(double &centerX, double &centerY);
         double getZoom();
         bool getHighlighted();
+
+        // extrapolate the center and zoom from the recent pan / zoom velocity; returns false if the view is at rest
+        bool getPredictedView(long lookaheadMilliseconds, double &centerX, double &centerY, double &zoom);
         ContentWindowInterface::WindowState getWindowState();
         InteractionState getInteractionState();
 
@@ -153,6 +159,12 @@ class ContentWindowInterface : public QObject {
 
         double zoom_;
 
+        // pan (per second) and zoom (log scale, per second) velocities, and when the view last changed
+        double centerVelocityX_;
+        double centerVelocityY_;
+        double zoomVelocity_;
+        boost::posix_time::ptime viewChangedTimestamp_;
+
         // window state
         ContentWindowInterface::WindowState windowState_;
 
@@ -161,6 +173,8 @@ class ContentWindowInterface : public QObject {
 
         // highlighted timestamp
         boost::posix_time::ptime highlightedTimestamp_;
+
+        void updateViewVelocity(double previousCenterX, double previousCenterY, double previousZoom);
 };
 
 #endif
@@ -72,6 +72,11 @@ ContentWindowManager::ContentWindowManager(boost::shared_ptr<Content> content)
     // default to no zoom
     zoom_ = 1.;
 
+    // default to a view at rest
+    centerVelocityX_ = 0.;
+    centerVelocityY_ = 0.;
+    zoomVelocity_ = 0.;
+
     // default window state
     windowState_ = UNSELECTED;
 
@@ -100,6 +105,11 @@ void ContentWindowManager::setDisplayGroupManager(boost::shared_ptr<DisplayGroup
     if(oldDisplayGroupManager != NULL)
     {
         disconnect(this, 0, oldDisplayGroupManager.get(), 0);
+
+        if(content_ != NULL)
+        {
+            disconnect(content_.get(), 0, oldDisplayGroupManager.get(), 0);
+        }
     }
 
     displayGroupManager_ = displayGroupManager;
@@ -117,6 +127,11 @@ void ContentWindowManager::setDisplayGroupManager(boost::shared_ptr<DisplayGroup
         connect(this, SIGNAL(windowStateChanged(ContentWindowInterface::WindowState, ContentWindowInterface *)), displayGroupManager.get(), SLOT(sendDisplayGroup()));
         connect(this, SIGNAL(interactionStateChanged(InteractionState, ContentWindowInterface *)), displayGroupManager.get(), SLOT(sendDisplayGroup()));
 
+        if(content_ != NULL)
+        {
+            connect(content_.get(), SIGNAL(modified()), displayGroupManager.get(), SLOT(sendDisplayGroup()));
+        }
+
         // we don't call sendDisplayGroup() on movedToFront() or destroyed() since it happens already
     }
 }
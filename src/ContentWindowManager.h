@@ -88,6 +88,10 @@ class ContentWindowManager : public ContentWindowInterface, public boost::enable
             ar & centerX_;
             ar & centerY_;
             ar & zoom_;
+            ar & centerVelocityX_;
+            ar & centerVelocityY_;
+            ar & zoomVelocity_;
+            ar & viewChangedTimestamp_;
             ar & windowState_;
             ar & interactionState_;
             ar & highlightedTimestamp_;
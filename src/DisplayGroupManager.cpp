@@ -45,6 +45,7 @@
 #include "PixelStreamSource.h"
 #include "PixelStreamContent.h"
 #include "ParallelPixelStreamContent.h"
+#include "ParallelPixelStreamSynchronizer.h"
 #include "SVGStreamSource.h"
 #include "SVGContent.h"
 #include <sstream>
@@ -57,6 +58,9 @@
 #include <QDomDocument>
 #include <fstream>
 
+long DisplayGroupManager::receivedCount_ = 0;
+std::atomic<long long> DisplayGroupManager::clusterTimestampOffset_(0);
+
 DisplayGroupManager::DisplayGroupManager()
 {
     // create new Options object
@@ -162,6 +166,18 @@ void DisplayGroupManager::moveContentWindowManagerToFront(boost::shared_ptr<Cont
     }
 }
 
+long DisplayGroupManager::getReceivedCount()
+{
+    return receivedCount_;
+}
+
+long long DisplayGroupManager::getClusterTimestamp()
+{
+    static const boost::posix_time::ptime epoch(boost::gregorian::date(1970,1,1));
+
+    return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds() + clusterTimestampOffset_.load(std::memory_order_relaxed);
+}
+
 void DisplayGroupManager::calibrateTimestampOffset()
 {
     // can't calibrate timestamps unless we have at least 2 processes
@@ -235,6 +251,8 @@ void DisplayGroupManager::calibrateTimestampOffset()
         // now, calculate and store the timestamp offset
         timestampOffset_ = rank1Timestamp - timestamp;
 
+        clusterTimestampOffset_ = timestampOffset_.total_microseconds();
+
         put_flog(LOG_DEBUG, "timestamp offset = %s", (boost::posix_time::to_simple_string(timestampOffset_)).c_str());
     }
 }
@@ -540,10 +558,14 @@ void DisplayGroupManager::receiveMessages()
             {
                 receiveParallelPixelStreams(mh);
             }
-            else if(mh.type == MESSAGE_TYPE_SVG_STREAM)
+            else if(mh.type == MESSAGE_TYPE_SVG_STREAM || mh.type == MESSAGE_TYPE_SVG_STREAM_UPDATE || mh.type == MESSAGE_TYPE_SVG_STREAM_CACHED)
             {
                 receiveSVGStreams(mh);
             }
+            else if(mh.type == MESSAGE_TYPE_STREAM_METRICS)
+            {
+                receiveStreamMetricsRequest(mh);
+            }
             else if(mh.type == MESSAGE_TYPE_QUIT)
             {
                 g_app->quit();
@@ -646,6 +668,57 @@ void DisplayGroupManager::sendContentsDimensionsRequest()
     delete [] buf;
 }
 
+std::vector<StreamMetricsSnapshot> DisplayGroupManager::getStreamMetrics()
+{
+    // metrics of this process
+    std::vector<StreamMetricsSnapshot> snapshots = g_streamMetrics.getSnapshots();
+
+    // send the header
+    MessageHeader mh;
+    mh.type = MESSAGE_TYPE_STREAM_METRICS;
+
+    // the header is sent via a send, so that we can probe it on the render processes
+    for(int i=1; i<g_mpiSize; i++)
+    {
+        MPI_Send((void *)&mh, sizeof(MessageHeader), MPI_BYTE, i, 0, MPI_COMM_WORLD);
+    }
+
+    // now, receive responses from all render processes
+    for(int i=1; i<g_mpiSize; i++)
+    {
+        MPI_Status status;
+        MPI_Recv((void *)&mh, sizeof(MessageHeader), MPI_BYTE, i, 0, MPI_COMM_WORLD, &status);
+
+        // receive serialized data
+        char * buf = new char[mh.size];
+
+        // read message into the buffer
+        MPI_Recv((void *)buf, mh.size, MPI_BYTE, i, 0, MPI_COMM_WORLD, &status);
+
+        // de-serialize...
+        std::istringstream iss(std::istringstream::binary);
+
+        if(iss.rdbuf()->pubsetbuf(buf, mh.size) == NULL)
+        {
+            put_flog(LOG_FATAL, "rank %i: error setting stream buffer", g_mpiRank);
+            exit(-1);
+        }
+
+        // read to a new vector
+        std::vector<StreamMetricsSnapshot> rankSnapshots;
+
+        boost::archive::binary_iarchive ia(iss);
+        ia >> rankSnapshots;
+
+        snapshots.insert(snapshots.end(), rankSnapshots.begin(), rankSnapshots.end());
+
+        // free mpi buffer
+        delete [] buf;
+    }
+
+    return snapshots;
+}
+
 void DisplayGroupManager::sendPixelStreams()
 {
     // iterate through all pixel streams and send updates if needed
@@ -755,6 +828,14 @@ void DisplayGroupManager::sendParallelPixelStreams()
                 addContentWindowManager(cwm);
             }
 
+            // record the broadcast time for latency measurement
+            long long broadcastTimestamp = getClusterTimestamp();
+
+            for(unsigned int i=0; i<segments.size(); i++)
+            {
+                segments[i].timestamps.broadcast = broadcastTimestamp;
+            }
+
             // serialize the vector
             std::ostringstream oss(std::ostringstream::binary);
 
@@ -806,6 +887,9 @@ void DisplayGroupManager::sendParallelPixelStreams()
             }
         }
     }
+
+    // export the stream metrics of this process periodically
+    g_streamMetrics.update();
 }
 
 void DisplayGroupManager::sendSVGStreams()
@@ -818,11 +902,12 @@ void DisplayGroupManager::sendSVGStreams()
         std::string uri = (*it).first;
         boost::shared_ptr<SVGStreamSource> svgStreamSource = (*it).second;
 
-        // get buffer
+        // get buffer and incremental updates
         bool updated;
-        QByteArray imageData = svgStreamSource->getImageData(updated);
+        std::vector<QByteArray> updates;
+        QByteArray imageData = svgStreamSource->getImageData(updated, updates);
 
-        if(updated == true)
+        if(updated == true || updates.size() > 0)
         {
             // make sure Content/ContentWindowManager exists for the URI
 
@@ -839,16 +924,60 @@ void DisplayGroupManager::sendSVGStreams()
             }
 
             // check for updated dimensions
-            QSvgRenderer svgRenderer;
+            // only the root element is read here; the render processes parse the document
+            std::map<QString, QString> & rootAttributes = svgStreamSource->getRootAttributes();
 
-            if(svgRenderer.load(imageData) != true || svgRenderer.isValid() == false)
+            if(updated == true)
+            {
+                if(SVGDocumentCache::probeRootAttributes(imageData, rootAttributes) != true)
+                {
+                    put_flog(LOG_ERROR, "error loading %s", uri.c_str());
+                    continue;
+                }
+            }
+            else if(rootAttributes.size() == 0)
             {
-                put_flog(LOG_ERROR, "error loading %s", uri.c_str());
+                put_flog(LOG_WARN, "ignoring updates for %s received before a document", uri.c_str());
                 continue;
             }
 
-            int newWidth = svgRenderer.defaultSize().width();
-            int newHeight = svgRenderer.defaultSize().height();
+            // the root element may be updated too
+            for(unsigned int i=0; i<updates.size(); i++)
+            {
+                std::vector<SVGElementUpdate> elementUpdates;
+                SVGDocumentCache::parseUpdates(updates[i], elementUpdates);
+
+                for(unsigned int j=0; j<elementUpdates.size(); j++)
+                {
+                    if(rootAttributes.count("id") > 0 && elementUpdates[j].id == rootAttributes["id"])
+                    {
+                        std::map<QString, QString>::iterator attributesIt;
+
+                        for(attributesIt = elementUpdates[j].attributes.begin(); attributesIt != elementUpdates[j].attributes.end(); attributesIt++)
+                        {
+                            rootAttributes[attributesIt->first] = attributesIt->second;
+                        }
+                    }
+                }
+            }
+
+            int newWidth, newHeight;
+            QRectF viewBox;
+
+            if(SVGDocumentCache::getDefaultSize(rootAttributes, newWidth, newHeight, viewBox) != true)
+            {
+                // the size depends on the content, so we need the full parse after all
+                QSvgRenderer svgRenderer;
+
+                if(updated != true || svgRenderer.load(imageData) != true || svgRenderer.isValid() == false)
+                {
+                    put_flog(LOG_ERROR, "error loading %s", uri.c_str());
+                    continue;
+                }
+
+                newWidth = svgRenderer.defaultSize().width();
+                newHeight = svgRenderer.defaultSize().height();
+            }
 
             boost::shared_ptr<ContentWindowManager> cwm = getContentWindowManager(uri, CONTENT_TYPE_SVG);
 
@@ -865,29 +994,46 @@ void DisplayGroupManager::sendSVGStreams()
                 }
             }
 
-            int size = imageData.size();
-
-            // send the header and the message
-            MessageHeader mh;
-            mh.size = size;
-            mh.type = MESSAGE_TYPE_SVG_STREAM;
+            if(updated == true)
+            {
+                // documents the render processes already have are sent by hash only
+                QByteArray message;
+                MESSAGE_TYPE type = SVGDocumentCache::getProcessCache().prepareMessage(imageData, message);
 
-            // add the truncated URI to the header
-            size_t len = uri.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
-            mh.uri[len] = '\0';
+                sendSVGStreamMessage(uri, type, message);
+            }
 
-            // the header is sent via a send, so that we can probe it on the render processes
-            for(int i=1; i<g_mpiSize; i++)
+            for(unsigned int i=0; i<updates.size(); i++)
             {
-                MPI_Send((void *)&mh, sizeof(MessageHeader), MPI_BYTE, i, 0, MPI_COMM_WORLD);
+                sendSVGStreamMessage(uri, MESSAGE_TYPE_SVG_STREAM_UPDATE, updates[i]);
             }
-
-            // broadcast the message
-            MPI_Bcast((void *)imageData.data(), size, MPI_BYTE, 0, MPI_COMM_WORLD);
         }
     }
 }
 
+void DisplayGroupManager::sendSVGStreamMessage(std::string uri, MESSAGE_TYPE type, QByteArray data)
+{
+    int size = data.size();
+
+    // send the header and the message
+    MessageHeader mh;
+    mh.size = size;
+    mh.type = type;
+
+    // add the truncated URI to the header
+    size_t len = uri.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
+    mh.uri[len] = '\0';
+
+    // the header is sent via a send, so that we can probe it on the render processes
+    for(int i=1; i<g_mpiSize; i++)
+    {
+        MPI_Send((void *)&mh, sizeof(MessageHeader), MPI_BYTE, i, 0, MPI_COMM_WORLD);
+    }
+
+    // broadcast the message
+    MPI_Bcast((void *)data.data(), size, MPI_BYTE, 0, MPI_COMM_WORLD);
+}
+
 void DisplayGroupManager::sendFrameClockUpdate()
 {
     // this should only be called by the rank 1 process
@@ -975,6 +1121,12 @@ void DisplayGroupManager::receiveFrameClockUpdate()
 
     // update timestamp
     timestamp_ = timestamp;
+
+    // the frame clock was just sent by rank 1, so this is its clock, late only by the broadcast
+    if(timestamp != NULL)
+    {
+        clusterTimestampOffset_ = (*timestamp - boost::posix_time::microsec_clock::universal_time()).total_microseconds();
+    }
 }
 
 void DisplayGroupManager::sendQuit()
@@ -1035,6 +1187,8 @@ void DisplayGroupManager::receiveDisplayGroup(MessageHeader messageHeader)
     // overwrite old display group
     g_displayGroupManager = displayGroupManager;
 
+    receivedCount_++;
+
     // free mpi buffer
     delete [] buf;
 }
@@ -1079,6 +1233,32 @@ void DisplayGroupManager::receiveContentsDimensionsRequest(MessageHeader message
     }
 }
 
+void DisplayGroupManager::receiveStreamMetricsRequest(MessageHeader messageHeader)
+{
+    std::vector<StreamMetricsSnapshot> snapshots = g_streamMetrics.getSnapshots();
+
+    // serialize
+    std::ostringstream oss(std::ostringstream::binary);
+
+    // brace this so destructor is called on archive before we use the stream
+    {
+        boost::archive::binary_oarchive oa(oss);
+        oa << snapshots;
+    }
+
+    // serialized data to string
+    std::string serializedString = oss.str();
+    int size = serializedString.size();
+
+    // send the header and the message
+    MessageHeader mh;
+    mh.size = size;
+    mh.type = MESSAGE_TYPE_STREAM_METRICS;
+
+    MPI_Send((void *)&mh, sizeof(MessageHeader), MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+    MPI_Send((void *)serializedString.data(), size, MPI_BYTE, 0, 0, MPI_COMM_WORLD);
+}
+
 void DisplayGroupManager::receivePixelStreams(MessageHeader messageHeader)
 {
     // receive serialized data
@@ -1123,14 +1303,26 @@ void DisplayGroupManager::receiveParallelPixelStreams(MessageHeader messageHeade
     boost::archive::binary_iarchive ia(iss);
     ia >> segments;
 
+    long long receivedTimestamp = getClusterTimestamp();
+
+    for(unsigned int i=0; i<segments.size(); i++)
+    {
+        segments[i].timestamps.rankReceived = receivedTimestamp;
+    }
+
+    boost::shared_ptr<ParallelPixelStream> parallelPixelStream = g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(uri);
+
     // now, insert all segments
     for(unsigned int i=0; i<segments.size(); i++)
     {
-        g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(uri)->insertSegment(segments[i]);
+        parallelPixelStream->insertSegment(segments[i]);
     }
 
+    // all render processes receive this message, so streams are added to the synchronizer in the same order
+    g_parallelPixelStreamSynchronizer.addStream(uri, parallelPixelStream);
+
     // update pixel streams corresponding to new segments
-    g_mainWindow->getGLWindow()->getParallelPixelStreamFactory().getObject(uri)->updatePixelStreams();
+    parallelPixelStream->updatePixelStreams();
 
     // free mpi buffer
     delete [] buf;
@@ -1147,8 +1339,28 @@ void DisplayGroupManager::receiveSVGStreams(MessageHeader messageHeader)
     // URI
     std::string uri = std::string(messageHeader.uri);
 
-    // de-serialize...
-    g_mainWindow->getGLWindow()->getSVGFactory().getObject(uri)->setImageData(QByteArray(buf, messageHeader.size));
+    QByteArray data(buf, messageHeader.size);
+
+    boost::shared_ptr<SVG> svg = g_mainWindow->getGLWindow()->getSVGFactory().getObject(uri);
+
+    // keep the document cache identical to the master's
+    if(messageHeader.type == MESSAGE_TYPE_SVG_STREAM || messageHeader.type == MESSAGE_TYPE_SVG_STREAM_CACHED)
+    {
+        QByteArray imageData;
+
+        if(SVGDocumentCache::getProcessCache().receiveMessage(messageHeader.type, data, imageData) == true)
+        {
+            svg->setImageData(imageData);
+        }
+        else
+        {
+            put_flog(LOG_ERROR, "SVG document for %s not cached", uri.c_str());
+        }
+    }
+    else if(messageHeader.type == MESSAGE_TYPE_SVG_STREAM_UPDATE)
+    {
+        svg->applyUpdates(data);
+    }
 
     // free mpi buffer
     delete [] buf;
@@ -43,9 +43,12 @@
 #include "DisplayGroupInterface.h"
 #include "Options.h"
 #include "Marker.h"
+#include "SVGDocumentCache.h"
+#include "StreamMetrics.h"
 #include "config.h"
 #include <QtGui>
 #include <vector>
+#include <atomic>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -84,6 +87,15 @@ class DisplayGroupManager : public DisplayGroupInterface, public boost::enable_s
         // find the offset between the rank 0 clock and the rank 1 clock. recall the rank 1 clock is used across rank 1 - n.
         void calibrateTimestampOffset();
 
+        // number of display groups received; on the render processes, window coordinates only change when this does
+        static long getReceivedCount();
+
+        // current time in microseconds since the epoch on the cluster clock, i.e. rank 1's clock. can be called from any thread
+        static long long getClusterTimestamp();
+
+        // gather the stream metrics of all processes (rank 0 only)
+        std::vector<StreamMetricsSnapshot> getStreamMetrics();
+
     public slots:
 
         // this can be invoked from other threads to construct a DisplayGroupInterface and move it to that thread
@@ -141,11 +153,21 @@ class DisplayGroupManager : public DisplayGroupInterface, public boost::enable_s
         // rank 1 - rank 0 timestamp offset
         boost::posix_time::time_duration timestampOffset_;
 
+        // display groups are replaced when received, so this is shared by all objects
+        static long receivedCount_;
+
+        // offset in microseconds from this process's clock to the cluster clock
+        // rank 0 calibrates it once; ranks 2 - n update it with every frame clock update
+        static std::atomic<long long> clusterTimestampOffset_;
+
+        void sendSVGStreamMessage(std::string uri, MESSAGE_TYPE type, QByteArray data);
+
         void receiveDisplayGroup(MessageHeader messageHeader);
         void receiveContentsDimensionsRequest(MessageHeader messageHeader);
         void receivePixelStreams(MessageHeader messageHeader);
         void receiveParallelPixelStreams(MessageHeader messageHeader);
         void receiveSVGStreams(MessageHeader messageHeader);
+        void receiveStreamMetricsRequest(MessageHeader messageHeader);
 };
 
 #endif
@@ -41,6 +41,9 @@
 
 #include "DisplayGroupInterface.h"
 #include "ContentWindowManager.h"
+#include "DisplayGroupManager.h"
+#include "StreamMetrics.h"
+#include "main.h"
 #include <QtGui>
 
 class DisplayGroupPython : public DisplayGroupInterface, public boost::enable_shared_from_this<DisplayGroupPython> {
@@ -61,10 +64,6 @@ class pyDisplayGroupPython
         pyDisplayGroupPython()
         {
             // attach to g_displayGroupManager on construction
-
-            // declared in main.cpp, but we don't want to bring in everything from main.h...
-            extern boost::shared_ptr<DisplayGroupManager> g_displayGroupManager;
-
             ptr_ = boost::shared_ptr<DisplayGroupPython>(new DisplayGroupPython(g_displayGroupManager));
         }
 
@@ -112,6 +111,17 @@ class pyDisplayGroupPython
             return pyContentWindowManager(get()->getContentWindowManagers()[index]);
         }
 
+        // stream metrics of all processes, as a JSON list with one entry per stream and process
+        QString getStreamMetrics()
+        {
+            return QString(StreamMetrics::getJSON(g_displayGroupManager->getStreamMetrics()).c_str());
+        }
+
+        void exportStreamMetrics(const char * filename)
+        {
+            StreamMetrics::writeSnapshots(std::string(filename), g_displayGroupManager->getStreamMetrics());
+        }
+
     private:
 
         boost::shared_ptr<DisplayGroupPython> ptr_;
@@ -44,6 +44,7 @@
 #include <fstream>
 #include <string>
 #include <boost/tokenizer.hpp>
+#include <turbojpeg.h>
 
 #ifdef __APPLE__
     #include <OpenGL/glu.h>
@@ -51,16 +52,54 @@
     #include <GL/glu.h>
 #endif
 
+// libjpeg-turbo decompression handle owned by a loader thread, so handles aren't created and destroyed for every tile;
+// destroyed when the thread exits
+class DynamicTextureDecompressHandle {
+
+    public:
+
+        DynamicTextureDecompressHandle()
+        {
+            handle_ = tjInitDecompress();
+        }
+
+        ~DynamicTextureDecompressHandle()
+        {
+            if(handle_ != NULL)
+            {
+                tjDestroy(handle_);
+            }
+        }
+
+        tjhandle getHandle()
+        {
+            return handle_;
+        }
+
+    private:
+
+        tjhandle handle_;
+};
+
+// per-thread decompression handles
+static QThreadStorage<DynamicTextureDecompressHandle *> g_dynamicTextureDecompressHandles;
+
 DynamicTexture::DynamicTexture(std::string uri, boost::shared_ptr<DynamicTexture> parent, float parentX, float parentY, float parentW, float parentH, int childIndex)
 {
     // defaults
     depth_ = 0;
     useImagePyramid_ = false;
-    threadCount_ = 0;
-    loadImageThreadStarted_ = false;
+    loadImageState_ = DYNAMIC_TEXTURE_LOAD_IDLE;
+    loadImageRequestFrameCount_ = 0;
+    loadImagePrefetched_ = false;
     imageWidth_ = 0;
     imageHeight_ = 0;
+    loadImageScaleDenominator_ = 1;
+    scaledImageScaleDenominator_ = 1;
     textureBound_ = false;
+    textureWidth_ = 0;
+    textureScaleDenominator_ = 1;
+    textureRefinePending_ = false;
 
     // assign values
     uri_ = uri;
@@ -122,14 +161,16 @@ DynamicTexture::DynamicTexture(std::string uri, boost::shared_ptr<DynamicTexture
         }
 
         // always load image for top-level object
-        incrementThreadCount();
-        loadImageThread_ = QtConcurrent::run(loadImageThread, this);
-        loadImageThreadStarted_ = true;
+        g_dynamicTextureLoader.requestPersistentLoad(this);
     }
 }
 
 DynamicTexture::~DynamicTexture()
 {
+    // make sure no load is pending or in progress for this object
+    g_dynamicTextureLoader.cancelLoad(this);
+    g_dynamicTextureLoader.waitForLoad(this);
+
     // delete bound texture
     if(textureBound_ == true)
     {
@@ -155,6 +196,12 @@ void DynamicTexture::loadImage(bool convertToGLFormat)
         root = getRoot().get();
     }
 
+    // key of this tile in the shared tile cache, if it is shared
+    uint64_t sharedTileKey = 0;
+
+    // everything but a DCT scaled decode gives the full resolution
+    scaledImageScaleDenominator_ = 1;
+
     if(root->useImagePyramid_ == true)
     {
         // form filename
@@ -172,6 +219,44 @@ void DynamicTexture::loadImage(bool convertToGLFormat)
 
         filename += ".jpg";
 
+        if(convertToGLFormat == true)
+        {
+            int scaleDenominator = loadImageScaleDenominator_;
+
+            // another process on this host may have already decoded this tile; only full resolution tiles are shared
+            if(scaleDenominator == 1)
+            {
+                sharedTileKey = SharedTileCache::getKey(filename);
+
+                if(sharedTileKey != 0)
+                {
+                    sharedTileReference_ = g_sharedTileCache.find(sharedTileKey);
+                }
+
+                if(sharedTileReference_ != NULL)
+                {
+                    // already in the OpenGL format
+                    scaledImage_ = sharedTileReference_->getImage();
+                    return;
+                }
+            }
+
+            // decode directly into the OpenGL format
+            if(loadJpegImage(filename, scaleDenominator) == true)
+            {
+                scaledImageScaleDenominator_ = scaleDenominator;
+
+                if(sharedTileKey != 0)
+                {
+                    g_sharedTileCache.insert(sharedTileKey, scaledImage_);
+                }
+
+                return;
+            }
+
+            put_flog(LOG_WARN, "libjpeg-turbo could not decode %s; falling back to QImage", filename.c_str());
+        }
+
         scaledImage_.load(QString(filename.c_str()), "jpg");
     }
     else
@@ -282,15 +367,20 @@ void DynamicTexture::loadImage(bool convertToGLFormat)
     if(convertToGLFormat == true)
     {
         scaledImage_ = QGLWidget::convertToGLFormat(scaledImage_);
+
+        if(sharedTileKey != 0)
+        {
+            g_sharedTileCache.insert(sharedTileKey, scaledImage_);
+        }
     }
 }
 
 void DynamicTexture::getDimensions(int &width, int &height)
 {
-    // if we don't have a width and height, and the load image thread is running, wait for it to finish
-    if(imageWidth_ == 0 && imageHeight_ == 0 && loadImageThreadStarted_ == true)
+    // if we don't have a width and height, wait for the image load to finish
+    if(imageWidth_ == 0 && imageHeight_ == 0)
     {
-        loadImageThread_.waitForFinished();
+        g_dynamicTextureLoader.waitForLoad(this);
     }
 
     width = imageWidth_;
@@ -304,7 +394,7 @@ void DynamicTexture::render(float tX, float tY, float tW, float tH, bool compute
         updateRenderedFrameCount();
     }
 
-    if(considerChildren == true && getProjectedPixelArea(true) > 0. && getProjectedPixelArea(false) > TEXTURE_SIZE*TEXTURE_SIZE && (getRoot()->imageWidth_ / pow(2,depth_) > TEXTURE_SIZE || getRoot()->imageHeight_ / pow(2,depth_) > TEXTURE_SIZE))
+    if(considerChildren == true && getRenderChildren() == true)
     {
         // mark this object as having rendered children in this frame
         renderChildrenFrameCount_ = g_frameCount;
@@ -315,32 +405,29 @@ void DynamicTexture::render(float tX, float tY, float tW, float tH, bool compute
     {
         // want to render this object
 
-        // see if we need to start loading the image
-        if(computeOnDemand == true && loadImageThreadStarted_ == false)
+        // if the texture was decoded at a reduced resolution and is now shown larger, reload it at a higher resolution
+        // the current texture is rendered until the new one is ready
+        if(computeOnDemand == true && textureBound_ == true && textureRefinePending_ == false && textureScaleDenominator_ > 1 && sqrt(getProjectedPixelArea(false)) > textureWidth_)
         {
-            // only start the thread if this DynamicTexture tree has one available
-            // each DynamicTexture tree is limited to (maxThreads - 2) threads, where the max is determined by the global QThreadPool instance
-            // we increase responsiveness / interactivity by not queuing up image loading
-            // todo: this doesn't perform well with too many threads; restricting to 1 thread for now
-            int maxThreads = std::max(QThreadPool::globalInstance()->maxThreadCount() - 2, 1);
-
-            if(getThreadCount() < maxThreads)
-            {
-                incrementThreadCount();
-
-                // give the thread shared_ptr's to all of this object's parents to prevent their destruction during thread execution
-                std::vector<boost::shared_ptr<DynamicTexture> > objects;
-                getObjectsAscending(objects);
+            textureRefinePending_ = true;
+            g_dynamicTextureLoader.resetLoad(this);
+        }
 
-                loadImageThread_ = QtConcurrent::run(loadImageThread, shared_from_this(), objects);
-                loadImageThreadStarted_ = true;
-            }
+        // request (or renew the request for) the image load; requests not renewed each frame are cancelled
+        if(computeOnDemand == true && (textureBound_ == false || textureRefinePending_ == true))
+        {
+            g_dynamicTextureLoader.requestLoad(shared_from_this(), getLoadPriority(), getLoadImageScaleDenominator());
         }
 
         // see if we need to load the texture
-        if(loadImageThreadStarted_ == true && loadImageThread_.isFinished() == true && textureBound_ == false)
+        if((textureBound_ == false || textureRefinePending_ == true) && g_dynamicTextureLoader.isLoadFinished(this) == true)
         {
             uploadTexture();
+
+            if(loadImagePrefetched_ == true)
+            {
+                g_dynamicTextureLoader.incrementPrefetchHitCount();
+            }
         }
 
         // if we don't yet have a texture, try to render from parent's texture
@@ -414,6 +501,21 @@ void DynamicTexture::render(float tX, float tY, float tW, float tH, bool compute
     }
 }
 
+void DynamicTexture::prefetch(float tX, float tY, float tW, float tH)
+{
+    if(getRenderChildren() == true)
+    {
+        // keep the children alive; otherwise they would be cleared before the view reaches them
+        renderChildrenFrameCount_ = g_frameCount;
+
+        renderChildren(tX,tY,tW,tH, true);
+    }
+    else if(textureBound_ == false)
+    {
+        g_dynamicTextureLoader.requestLoad(shared_from_this(), getLoadPriority(), getLoadImageScaleDenominator(), true);
+    }
+}
+
 void DynamicTexture::clearOldChildren(long minFrameCount)
 {
     // clear children if renderChildrenFrameCount_ < minFrameCount
@@ -429,7 +531,7 @@ void DynamicTexture::clearOldChildren(long minFrameCount)
     }
 }
 
-void DynamicTexture::computeImagePyramid(std::string imagePyramidPath)
+bool DynamicTexture::computeImagePyramid(std::string imagePyramidPath)
 {
     if(depth_ == 0)
     {
@@ -441,35 +543,17 @@ void DynamicTexture::computeImagePyramid(std::string imagePyramidPath)
             if(success != true)
             {
                 put_flog(LOG_ERROR, "error creating directory %s", imagePyramidPath.c_str());
-                return;
+                return false;
             }
         }
 
-        // wait for initial image load to finish thread
-        loadImageThread_.waitForFinished();
+        // wait for initial image load to finish
+        g_dynamicTextureLoader.waitForLoad(this);
 
-        // write metadata file
-        std::string metadataFilename = imagePyramidPath + "/pyramid.pyr";
-
-        std::ofstream ofs(metadataFilename.c_str());
-        ofs << "\"" << imagePyramidPath << "\" " << imageWidth_ << " " << imageHeight_;
-
-        // write a more conveniently named metadata file in the same directory as the original image, if possible
-        // path ends with ".pyramid"; the new metadata file will end with ".pyr"
-        QString secondMetadataFilename = QString(imagePyramidPath.c_str());
-        int amidLastIndex = secondMetadataFilename.lastIndexOf("amid");
-
-        secondMetadataFilename.truncate(amidLastIndex);
-
-        std::ofstream secondOfs(secondMetadataFilename.toStdString().c_str());
-
-        if(secondOfs.good() == true)
-        {
-            secondOfs << "\"" << imagePyramidPath << "\" " << imageWidth_ << " " << imageHeight_;
-        }
-        else
+        if(imageWidth_ <= 0 || imageHeight_ <= 0)
         {
-            put_flog(LOG_WARN, "could not write second metadata file %s", secondMetadataFilename.toStdString().c_str());
+            put_flog(LOG_ERROR, "could not load image %s", uri_.c_str());
+            return false;
         }
     }
 
@@ -499,7 +583,11 @@ void DynamicTexture::computeImagePyramid(std::string imagePyramidPath)
 
     put_flog(LOG_DEBUG, "saving %s", filename.c_str());
 
-    scaledImage_.save(QString(filename.c_str()), "jpg");
+    if(scaledImage_.isNull() == true || scaledImage_.save(QString(filename.c_str()), "jpg") != true)
+    {
+        put_flog(LOG_ERROR, "error saving %s", filename.c_str());
+        return false;
+    }
 
     // no longer need scaled image
     scaledImage_ = QImage();
@@ -519,22 +607,60 @@ void DynamicTexture::computeImagePyramid(std::string imagePyramidPath)
         {
             boost::shared_ptr<DynamicTexture> c(new DynamicTexture("", shared_from_this(), imageBounds[i].x(), imageBounds[i].y(), imageBounds[i].width(), imageBounds[i].height(), i));
 
-            c->computeImagePyramid(imagePyramidPath);
+            if(c->computeImagePyramid(imagePyramidPath) != true)
+            {
+                return false;
+            }
         }
     }
-}
 
-void DynamicTexture::decrementThreadCount()
-{
     if(depth_ == 0)
     {
-        QMutexLocker locker(&threadCountMutex_);
-        threadCount_ = threadCount_ - 1;
-    }
-    else
-    {
-        return getRoot()->decrementThreadCount();
+        // write metadata file last, so a pyramid with a metadata file is always complete
+        // write to a temporary file first so a partial metadata file is never used
+        std::string metadataFilename = imagePyramidPath + "/pyramid.pyr";
+        std::string temporaryMetadataFilename = metadataFilename + ".tmp";
+
+        {
+            std::ofstream ofs(temporaryMetadataFilename.c_str());
+            ofs << "\"" << imagePyramidPath << "\" " << imageWidth_ << " " << imageHeight_;
+
+            if(ofs.good() != true)
+            {
+                put_flog(LOG_ERROR, "error writing metadata file %s", temporaryMetadataFilename.c_str());
+                return false;
+            }
+        }
+
+        QFile::remove(metadataFilename.c_str());
+
+        if(QFile::rename(temporaryMetadataFilename.c_str(), metadataFilename.c_str()) != true)
+        {
+            put_flog(LOG_ERROR, "error writing metadata file %s", metadataFilename.c_str());
+            QFile::remove(temporaryMetadataFilename.c_str());
+            return false;
+        }
+
+        // write a more conveniently named metadata file in the same directory as the original image, if possible
+        // path ends with ".pyramid"; the new metadata file will end with ".pyr"
+        QString secondMetadataFilename = QString(imagePyramidPath.c_str());
+        int amidLastIndex = secondMetadataFilename.lastIndexOf("amid");
+
+        secondMetadataFilename.truncate(amidLastIndex);
+
+        std::ofstream secondOfs(secondMetadataFilename.toStdString().c_str());
+
+        if(secondOfs.good() == true)
+        {
+            secondOfs << "\"" << imagePyramidPath << "\" " << imageWidth_ << " " << imageHeight_;
+        }
+        else
+        {
+            put_flog(LOG_WARN, "could not write second metadata file %s", secondMetadataFilename.toStdString().c_str());
+        }
     }
+
+    return true;
 }
 
 boost::shared_ptr<DynamicTexture> DynamicTexture::getRoot()
@@ -570,10 +696,7 @@ QRect DynamicTexture::getRootImageCoordinates(float x, float y, float w, float h
     if(depth_ == 0)
     {
         // if necessary, block and wait for image loading to complete
-        if(loadImageThreadStarted_ == true && loadImageThread_.isFinished() == false)
-        {
-            loadImageThread_.waitForFinished();
-        }
+        g_dynamicTextureLoader.waitForLoad(this);
 
         QRect rect = QRect(x*imageWidth_, y*imageHeight_, w*imageWidth_, h*imageHeight_);
         return rect;
@@ -612,11 +735,8 @@ QImage DynamicTexture::getImageFromParent(float x, float y, float w, float h, Dy
         return parent->getImageFromParent(pX, pY, pW, pH, start);
     }
 
-    // wait for the load image thread to complete if it's in progress
-    if(loadImageThreadStarted_ == true && loadImageThread_.isFinished() == false)
-    {
-        loadImageThread_.waitForFinished();
-    }
+    // wait for the image load to complete if it's queued or in progress
+    g_dynamicTextureLoader.waitForLoad(this);
 
     if(image_.isNull() != true)
     {
@@ -647,22 +767,97 @@ QImage DynamicTexture::getImageFromParent(float x, float y, float w, float h, Dy
     }
 }
 
+bool DynamicTexture::loadJpegImage(std::string filename, int scaleDenominator)
+{
+    QFile file(filename.c_str());
+
+    if(file.open(QIODevice::ReadOnly) != true)
+    {
+        put_flog(LOG_ERROR, "could not open %s", filename.c_str());
+        return false;
+    }
+
+    QByteArray jpegData = file.readAll();
+
+    // create the handle on first use, or again if creating it failed before
+    if(g_dynamicTextureDecompressHandles.hasLocalData() != true || g_dynamicTextureDecompressHandles.localData()->getHandle() == NULL)
+    {
+        g_dynamicTextureDecompressHandles.setLocalData(new DynamicTextureDecompressHandle());
+    }
+
+    tjhandle handle = g_dynamicTextureDecompressHandles.localData()->getHandle();
+
+    if(handle == NULL)
+    {
+        put_flog(LOG_ERROR, "could not create libjpeg-turbo decompressor: %s", tjGetErrorStr());
+        return false;
+    }
+
+    // get information from header
+    int width, height, jpegSubsamp;
+    int success = tjDecompressHeader2(handle, (unsigned char *)jpegData.data(), (unsigned long)jpegData.size(), &width, &height, &jpegSubsamp);
+
+    if(success != 0)
+    {
+        put_flog(LOG_ERROR, "libjpeg-turbo header decompression failure");
+        return false;
+    }
+
+    // libjpeg-turbo's DCT scaling
+    tjscalingfactor scalingFactor = { 1, scaleDenominator };
+
+    int scaledWidth = TJSCALED(width, scalingFactor);
+    int scaledHeight = TJSCALED(height, scalingFactor);
+
+    // decompress bottom-up RGBA, which is the layout QGLWidget::convertToGLFormat() would give us
+    // as with convertToGLFormat(), the resulting image can only be used for width(), height(), and bits() calls for OpenGL
+    int pixelFormat = TJPF_RGBA;
+    int pitch = scaledWidth * tjPixelSize[pixelFormat];
+    int flags = TJFLAG_BOTTOMUP;
+
+    QImage image(scaledWidth, scaledHeight, QImage::Format_ARGB32);
+
+    success = tjDecompress2(handle, (unsigned char *)jpegData.data(), (unsigned long)jpegData.size(), (unsigned char *)image.scanLine(0), scaledWidth, pitch, scaledHeight, pixelFormat, flags);
+
+    if(success != 0)
+    {
+        put_flog(LOG_ERROR, "libjpeg-turbo image decompression failure");
+        return false;
+    }
+
+    scaledImage_ = image;
+
+    return true;
+}
+
 void DynamicTexture::uploadTexture()
 {
+    // replace a reduced resolution texture
+    if(textureBound_ == true)
+    {
+        g_mainWindow->getGLWindow()->insertPurgeTextureId(textureId_);
+        textureBound_ = false;
+    }
+
     // generate new texture
     // no need to compute mipmaps
     // note that scaledImage_ is already in the GL format so we can use glTexImage2D directly
     glGenTextures(1, &textureId_);
     glBindTexture(GL_TEXTURE_2D, textureId_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scaledImage_.width(), scaledImage_.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, scaledImage_.bits());
+    // use constBits() so an image referring to the shared tile cache isn't copied
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, scaledImage_.width(), scaledImage_.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, scaledImage_.constBits());
 
     textureBound_ = true;
+    textureWidth_ = scaledImage_.width();
+    textureScaleDenominator_ = scaledImageScaleDenominator_;
+    textureRefinePending_ = false;
 
     // no longer need the scaled image
     scaledImage_ = QImage();
+    sharedTileReference_.reset();
 }
 
-void DynamicTexture::renderChildren(float tX, float tY, float tW, float tH)
+void DynamicTexture::renderChildren(float tX, float tY, float tW, float tH, bool prefetchOnly)
 {
     // texture rectangle we're showing with this parent object
     QRectF textureRect(tX,tY,tW,tH);
@@ -713,12 +908,25 @@ void DynamicTexture::renderChildren(float tX, float tY, float tW, float tH)
         glTranslatef(renderRect.x(), renderRect.y(), 0.);
         glScalef(renderRect.width(), renderRect.height(), 1.);
 
-        children_[i]->render(childTextureRectTranslatedAndScaled.x(), childTextureRectTranslatedAndScaled.y(), childTextureRectTranslatedAndScaled.width(), childTextureRectTranslatedAndScaled.height());
+        if(prefetchOnly == true)
+        {
+            children_[i]->prefetch(childTextureRectTranslatedAndScaled.x(), childTextureRectTranslatedAndScaled.y(), childTextureRectTranslatedAndScaled.width(), childTextureRectTranslatedAndScaled.height());
+        }
+        else
+        {
+            children_[i]->render(childTextureRectTranslatedAndScaled.x(), childTextureRectTranslatedAndScaled.y(), childTextureRectTranslatedAndScaled.width(), childTextureRectTranslatedAndScaled.height());
+        }
 
         glPopMatrix();
     }
 }
 
+bool DynamicTexture::getRenderChildren()
+{
+    // render children if we're visible, larger on screen than our texture, and the image has more detail than we do
+    return (getProjectedPixelArea(true) > 0. && getProjectedPixelArea(false) > TEXTURE_SIZE*TEXTURE_SIZE && (getRoot()->imageWidth_ / pow(2,depth_) > TEXTURE_SIZE || getRoot()->imageHeight_ / pow(2,depth_) > TEXTURE_SIZE));
+}
+
 double DynamicTexture::getProjectedPixelArea(bool onScreenOnly)
 {
     // get four corners in object space (recall we're in normalized 0->1 dimensions)
@@ -803,59 +1011,44 @@ double DynamicTexture::getProjectedPixelArea(bool onScreenOnly)
     return A;
 }
 
-bool DynamicTexture::getThreadsDoneDescending()
+double DynamicTexture::getLoadPriority()
 {
-    if(loadImageThread_.isFinished() == false)
-    {
-        return false;
-    }
-
-    for(unsigned int i=0; i<children_.size(); i++)
-    {
-        if(children_[i]->getThreadsDoneDescending() == false)
-        {
-            return false;
-        }
-    }
+    // screen-space error: screen pixels per texel if this tile were shown at its own resolution
+    double screenSpaceError = sqrt(getProjectedPixelArea(false)) / (double)TEXTURE_SIZE;
 
-    return true;
+    // weight by the visible area, so large on-screen tiles with the coarsest placeholders load first
+    return screenSpaceError * getProjectedPixelArea(true);
 }
 
-int DynamicTexture::getThreadCount()
+int DynamicTexture::getLoadImageScaleDenominator()
 {
-    if(depth_ == 0)
-    {
-        QMutexLocker locker(&threadCountMutex_);
-        return threadCount_;
-    }
-    else
+    // use the largest DCT scaling that still gives at least as many texels as the tile's projected size
+    double projectedSize = sqrt(getProjectedPixelArea(false));
+
+    int scaleDenominator = 1;
+
+    while(scaleDenominator < 8 && (double)TEXTURE_SIZE / (double)(2 * scaleDenominator) >= projectedSize)
     {
-        return getRoot()->getThreadCount();
+        scaleDenominator *= 2;
     }
+
+    return scaleDenominator;
 }
 
-void DynamicTexture::incrementThreadCount()
+bool DynamicTexture::getThreadsDoneDescending()
 {
-    if(depth_ == 0)
+    if(g_dynamicTextureLoader.isLoadRunning(this) == true)
     {
-        QMutexLocker locker(&threadCountMutex_);
-        threadCount_ = threadCount_ + 1;
+        return false;
     }
-    else
+
+    for(unsigned int i=0; i<children_.size(); i++)
     {
-        return getRoot()->incrementThreadCount();
+        if(children_[i]->getThreadsDoneDescending() == false)
+        {
+            return false;
+        }
     }
-}
-
-void loadImageThread(boost::shared_ptr<DynamicTexture> dynamicTexture, std::vector<boost::shared_ptr<DynamicTexture> > objects)
-{
-    loadImageThread(dynamicTexture.get());
-    return;
-}
 
-void loadImageThread(DynamicTexture * dynamicTexture)
-{
-    dynamicTexture->loadImage();
-    dynamicTexture->decrementThreadCount();
-    return;
+    return true;
 }
@@ -46,8 +46,9 @@
 #undef DYNAMIC_TEXTURE_SHOW_BORDER
 
 #include "FactoryObject.h"
+#include "DynamicTextureLoader.h"
+#include "SharedTileCache.h"
 #include <QGLWidget>
-#include <QtConcurrentRun>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
@@ -62,12 +63,15 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         void loadImage(bool convertToGLFormat=true); // thread needs access to this method
         void getDimensions(int &width, int &height);
         void render(float tX, float tY, float tW, float tH, bool computeOnDemand=true, bool considerChildren=true);
+        void prefetch(float tX, float tY, float tW, float tH); // request low-priority loads for the tiles render() would use for this view
         void clearOldChildren(long minFrameCount); // clear children of nodes with renderChildrenFrameCount_ < minFrameCount
-        void computeImagePyramid(std::string imagePyramidPath);
-        void decrementThreadCount(); // thread needs access to this method
+        bool computeImagePyramid(std::string imagePyramidPath);
 
     private:
 
+        // the loader manages our load state and needs access to our ancestors
+        friend class DynamicTextureLoader;
+
         int depth_;
 
         // for root only: image location
@@ -77,10 +81,6 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         std::string imagePyramidPath_;
         bool useImagePyramid_;
 
-        // thread count
-        int threadCount_;
-        QMutex threadCountMutex_;
-
         // for children:
 
         // pointer to parent object, if we have one
@@ -94,9 +94,10 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         // path through the tree
         std::vector<int> treePath_;
 
-        // thread for loading images
-        QFuture<void> loadImageThread_;
-        bool loadImageThreadStarted_;
+        // image loading state, managed by g_dynamicTextureLoader
+        DYNAMIC_TEXTURE_LOAD_STATE loadImageState_;
+        long loadImageRequestFrameCount_;
+        bool loadImagePrefetched_;
 
         // full scale image and dimensions; image may be deleted, but dimensions are necessary for later use
         QImage image_;
@@ -106,9 +107,26 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         // scaled image used for texture construction
         QImage scaledImage_;
 
+        // DCT scaling denominator (1, 2, 4, or 8) for decoding pyramid tiles shown much smaller than TEXTURE_SIZE
+        // set by g_dynamicTextureLoader from the request when the load starts
+        int loadImageScaleDenominator_;
+
+        // scaling denominator scaledImage_ was actually decoded with
+        int scaledImageScaleDenominator_;
+
+        // if scaledImage_ came from the shared tile cache, this keeps it pinned until the texture is uploaded
+        boost::shared_ptr<SharedTileReference> sharedTileReference_;
+
         // texture information
         bool textureBound_;
         GLuint textureId_;
+        int textureWidth_;
+
+        // scaling denominator of the texture; 1 if it is at the tile's native resolution
+        int textureScaleDenominator_;
+
+        // a reduced resolution texture is being reloaded at a higher resolution
+        bool textureRefinePending_;
 
         // children
         std::vector<boost::shared_ptr<DynamicTexture> > children_;
@@ -120,17 +138,14 @@ class DynamicTexture : public boost::enable_shared_from_this<DynamicTexture>, pu
         void getObjectsAscending(std::vector<boost::shared_ptr<DynamicTexture> > &objects);
         QRect getRootImageCoordinates(float x, float y, float w, float h);
         QImage getImageFromParent(float x, float y, float w, float h, DynamicTexture * start);
+        bool loadJpegImage(std::string filename, int scaleDenominator);
         void uploadTexture();
-        void renderChildren(float tX, float tY, float tW, float tH);
+        void renderChildren(float tX, float tY, float tW, float tH, bool prefetchOnly=false);
+        bool getRenderChildren();
         double getProjectedPixelArea(bool onScreenOnly);
+        double getLoadPriority();
+        int getLoadImageScaleDenominator();
         bool getThreadsDoneDescending();
-        int getThreadCount();
-        void incrementThreadCount();
 };
 
-// this wrapper is used by child objects to prevent its ancestors from being destructed during thread execution.
-extern void loadImageThread(boost::shared_ptr<DynamicTexture> dynamicTexture, std::vector<boost::shared_ptr<DynamicTexture> > objects);
-
-extern void loadImageThread(DynamicTexture * dynamicTexture);
-
 #endif
@@ -50,15 +50,59 @@ CONTENT_TYPE DynamicTextureContent::getType()
 void DynamicTextureContent::advance(boost::shared_ptr<ContentWindowManager> window)
 {
     // recall that advance() is called after rendering and before g_frameCount is incremented for the current frame
-    g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(getURI())->clearOldChildren(g_frameCount);
+    if(imageSourceURI_.empty() == true)
+    {
+        return;
+    }
+
+    g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(imageSourceURI_)->clearOldChildren(g_frameCount);
 }
 
 void DynamicTextureContent::getFactoryObjectDimensions(int &width, int &height)
 {
-    g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(getURI())->getDimensions(width, height);
+    // other image sources may be downsampled previews; use the dimensions of the image itself
+    if(imageSourceURI_.empty() == true || imageSourceURI_ != getURI())
+    {
+        getDimensions(width, height);
+        return;
+    }
+
+    g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(imageSourceURI_)->getDimensions(width, height);
+}
+
+std::string DynamicTextureContent::getImageSourceURI()
+{
+    return imageSourceURI_;
+}
+
+void DynamicTextureContent::setImageSourceURI(std::string uri)
+{
+    if(uri == imageSourceURI_)
+    {
+        return;
+    }
+
+    imageSourceURI_ = uri;
+
+    emit(modified());
 }
 
 void DynamicTextureContent::renderFactoryObject(float tX, float tY, float tW, float tH)
 {
-    g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(getURI())->render(tX, tY, tW, tH);
+    if(imageSourceURI_.empty() == true)
+    {
+        return;
+    }
+
+    g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(imageSourceURI_)->render(tX, tY, tW, tH);
+}
+
+void DynamicTextureContent::prefetchFactoryObject(float tX, float tY, float tW, float tH)
+{
+    if(imageSourceURI_.empty() == true)
+    {
+        return;
+    }
+
+    g_mainWindow->getGLWindow()->getDynamicTextureFactory().getObject(imageSourceURI_)->prefetch(tX, tY, tW, tH);
 }
@@ -46,12 +46,17 @@
 class DynamicTextureContent : public Content {
 
     public:
-        DynamicTextureContent(std::string uri = "") : Content(uri) { }
+        DynamicTextureContent(std::string uri = "") : Content(uri) { imageSourceURI_ = uri; }
 
         CONTENT_TYPE getType();
 
         void getFactoryObjectDimensions(int &width, int &height);
 
+        // the file the image is rendered from, e.g. a preview or an image pyramid of the image at the URI
+        // nothing is rendered while it is empty
+        std::string getImageSourceURI();
+        void setImageSourceURI(std::string uri);
+
     private:
         friend class boost::serialization::access;
 
@@ -60,11 +65,15 @@ class DynamicTextureContent : public Content {
         {
             // serialize base class information
             ar & boost::serialization::base_object<Content>(*this);
+            ar & imageSourceURI_;
         }
 
+        std::string imageSourceURI_;
+
         void advance(boost::shared_ptr<ContentWindowManager> window);
 
         void renderFactoryObject(float tX, float tY, float tW, float tH);
+        void prefetchFactoryObject(float tX, float tY, float tW, float tH);
 };
 
 #endif
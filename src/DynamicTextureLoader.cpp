@@ -0,0 +1,375 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DynamicTextureLoader.h"
+#include "DynamicTexture.h"
+#include "main.h"
+#include "log.h"
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+
+DynamicTextureLoader g_dynamicTextureLoader;
+
+// leave threads for the render and main threads; pixel stream decoding has its own pool
+DynamicTextureLoader::DynamicTextureLoader() : TileWorkQueue<DynamicTexture *, DynamicTextureLoadRequest>(std::max(QThread::idealThreadCount() - 2, 1))
+{
+    // defaults
+    runningCount_ = 0;
+    cancelledLoadCount_ = 0;
+    wastedLoadCount_ = 0;
+    prefetchLoadCount_ = 0;
+    prefetchHitCount_ = 0;
+    lastTimeToSharp_ = 0;
+}
+
+void DynamicTextureLoader::requestLoad(boost::shared_ptr<DynamicTexture> dynamicTexture, double priority, int scaleDenominator, bool prefetch)
+{
+    QMutexLocker locker(&mutex_);
+
+    DynamicTexture * dt = dynamicTexture.get();
+
+    // renew the request; this also marks a running load as still wanted
+    dt->loadImageRequestFrameCount_ = frameCount_;
+
+    if(dt->loadImageState_ == DYNAMIC_TEXTURE_LOAD_IDLE || (dt->loadImageState_ == DYNAMIC_TEXTURE_LOAD_QUEUED && prefetch == false))
+    {
+        DynamicTextureLoadRequest request;
+        request.dynamicTexture = dynamicTexture;
+        request.priority = priority;
+        request.scaleDenominator = scaleDenominator;
+        request.persistent = false;
+        request.prefetch = prefetch;
+
+        insertRequest(dt, request);
+    }
+}
+
+void DynamicTextureLoader::requestPersistentLoad(DynamicTexture * dynamicTexture)
+{
+    QMutexLocker locker(&mutex_);
+
+    dynamicTexture->loadImageRequestFrameCount_ = frameCount_;
+
+    if(dynamicTexture->loadImageState_ == DYNAMIC_TEXTURE_LOAD_IDLE)
+    {
+        DynamicTextureLoadRequest request;
+        request.priority = std::numeric_limits<double>::max();
+        request.scaleDenominator = 1;
+        request.persistent = true;
+        request.prefetch = false;
+
+        insertRequest(dynamicTexture, request);
+    }
+}
+
+void DynamicTextureLoader::resetLoad(DynamicTexture * dynamicTexture)
+{
+    QMutexLocker locker(&mutex_);
+
+    if(dynamicTexture->loadImageState_ == DYNAMIC_TEXTURE_LOAD_FINISHED)
+    {
+        dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_IDLE;
+    }
+}
+
+bool DynamicTextureLoader::cancelLoad(DynamicTexture * dynamicTexture)
+{
+    QMutexLocker locker(&mutex_);
+
+    if(requests_.erase(dynamicTexture) > 0)
+    {
+        dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_IDLE;
+        cancelledLoadCount_++;
+
+        return true;
+    }
+
+    return false;
+}
+
+void DynamicTextureLoader::waitForLoad(DynamicTexture * dynamicTexture)
+{
+    QMutexLocker locker(&mutex_);
+
+    if(dynamicTexture->loadImageState_ == DYNAMIC_TEXTURE_LOAD_QUEUED)
+    {
+        // don't wait for a worker to get to it; do the load now in this thread
+        bool persistent = requests_[dynamicTexture].persistent;
+        dynamicTexture->loadImagePrefetched_ = requests_[dynamicTexture].prefetch;
+        dynamicTexture->loadImageScaleDenominator_ = requests_[dynamicTexture].scaleDenominator;
+        requests_.erase(dynamicTexture);
+
+        dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_RUNNING;
+        runningCount_++;
+
+        locker.unlock();
+        dynamicTexture->loadImage();
+        locker.relock();
+
+        loadFinished(dynamicTexture, persistent);
+
+        return;
+    }
+
+    while(dynamicTexture->loadImageState_ == DYNAMIC_TEXTURE_LOAD_RUNNING)
+    {
+        loadFinishedCondition_.wait(&mutex_);
+    }
+}
+
+bool DynamicTextureLoader::isLoadFinished(DynamicTexture * dynamicTexture)
+{
+    QMutexLocker locker(&mutex_);
+
+    return (dynamicTexture->loadImageState_ == DYNAMIC_TEXTURE_LOAD_FINISHED);
+}
+
+bool DynamicTextureLoader::isLoadRunning(DynamicTexture * dynamicTexture)
+{
+    QMutexLocker locker(&mutex_);
+
+    return (dynamicTexture->loadImageState_ == DYNAMIC_TEXTURE_LOAD_RUNNING);
+}
+
+void DynamicTextureLoader::clearStaleRequests()
+{
+    QMutexLocker locker(&mutex_);
+
+    std::map<DynamicTexture *, DynamicTextureLoadRequest>::iterator it = requests_.begin();
+
+    while(it != requests_.end())
+    {
+        if(isRequestCancelled(it->first, it->second) == true)
+        {
+            requestCancelled(it->first, it->second);
+
+            requests_.erase(it++);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    // if everything was cancelled, the view never became sharp
+    if(requests_.size() == 0 && runningCount_ == 0)
+    {
+        timeToSharpTimer_ = QTime();
+    }
+}
+
+void DynamicTextureLoader::finalize()
+{
+    finalizeQueue();
+}
+
+int DynamicTextureLoader::getQueueDepth()
+{
+    QMutexLocker locker(&mutex_);
+
+    return requests_.size();
+}
+
+long DynamicTextureLoader::getCancelledLoadCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    return cancelledLoadCount_;
+}
+
+long DynamicTextureLoader::getWastedLoadCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    return wastedLoadCount_;
+}
+
+long DynamicTextureLoader::getPrefetchLoadCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    return prefetchLoadCount_;
+}
+
+long DynamicTextureLoader::getPrefetchHitCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    return prefetchHitCount_;
+}
+
+int DynamicTextureLoader::getLastTimeToSharp()
+{
+    QMutexLocker locker(&mutex_);
+
+    return lastTimeToSharp_;
+}
+
+std::string DynamicTextureLoader::getStatistics()
+{
+    QMutexLocker locker(&mutex_);
+
+    char statistics[256];
+    snprintf(statistics, sizeof(statistics), "tiles: %i queued, %i loading, %li cancelled, %li wasted, prefetch hits %li / %li, time to sharp %i ms", (int)requests_.size(), runningCount_, cancelledLoadCount_, wastedLoadCount_, prefetchHitCount_, prefetchLoadCount_, lastTimeToSharp_);
+
+    return std::string(statistics);
+}
+
+void DynamicTextureLoader::incrementPrefetchHitCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    prefetchHitCount_++;
+}
+
+void DynamicTextureLoader::processQueue()
+{
+    while(true)
+    {
+        DynamicTexture * dynamicTexture = NULL;
+        bool persistent = false;
+
+        // shared_ptr's to the object and all of its ancestors, preventing their destruction during the load
+        // these must be released without mutex_ locked, since the destructor cancels requests
+        boost::shared_ptr<DynamicTexture> dynamicTextureSharedPtr;
+        std::vector<boost::shared_ptr<DynamicTexture> > objects;
+
+        {
+            QMutexLocker locker(&mutex_);
+
+            DynamicTextureLoadRequest request;
+
+            if(takeRequest(dynamicTexture, request) != true)
+            {
+                return;
+            }
+
+            persistent = request.persistent;
+
+            dynamicTextureSharedPtr = request.dynamicTexture.lock();
+
+            if(persistent == false && dynamicTextureSharedPtr == NULL)
+            {
+                // the object is being destructed
+                dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_IDLE;
+                continue;
+            }
+
+            dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_RUNNING;
+            dynamicTexture->loadImagePrefetched_ = request.prefetch;
+            dynamicTexture->loadImageScaleDenominator_ = request.scaleDenominator;
+            runningCount_++;
+
+            if(dynamicTexture->loadImagePrefetched_ == true)
+            {
+                prefetchLoadCount_++;
+            }
+        }
+
+        if(dynamicTextureSharedPtr != NULL)
+        {
+            dynamicTextureSharedPtr->getObjectsAscending(objects);
+        }
+
+        dynamicTexture->loadImage();
+
+        // unlock before the shared_ptr's go out of scope
+        QMutexLocker locker(&mutex_);
+        loadFinished(dynamicTexture, persistent);
+        locker.unlock();
+    }
+}
+
+bool DynamicTextureLoader::isRequestCancelled(DynamicTexture * const & dynamicTexture, const DynamicTextureLoadRequest & request)
+{
+    return (request.persistent == false && isRequestStale(dynamicTexture) == true);
+}
+
+void DynamicTextureLoader::requestCancelled(DynamicTexture * const & dynamicTexture, const DynamicTextureLoadRequest & request)
+{
+    dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_IDLE;
+    cancelledLoadCount_++;
+}
+
+bool DynamicTextureLoader::isHigherPriority(const DynamicTextureLoadRequest & request, const DynamicTextureLoadRequest & other)
+{
+    // tiles in view come before prefetched tiles, then order by priority
+    return ((request.prefetch == false && other.prefetch == true) || (request.prefetch == other.prefetch && request.priority > other.priority));
+}
+
+void DynamicTextureLoader::insertRequest(DynamicTexture * dynamicTexture, DynamicTextureLoadRequest request)
+{
+    // start timing when new work arrives on an idle loader
+    if(requests_.size() == 0 && runningCount_ == 0 && timeToSharpTimer_.isNull() == true)
+    {
+        timeToSharpTimer_.start();
+    }
+
+    requests_[dynamicTexture] = request;
+    dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_QUEUED;
+
+    startWorkers();
+}
+
+bool DynamicTextureLoader::isRequestStale(DynamicTexture * dynamicTexture)
+{
+    return isFrameCountStale(dynamicTexture->loadImageRequestFrameCount_);
+}
+
+void DynamicTextureLoader::loadFinished(DynamicTexture * dynamicTexture, bool persistent)
+{
+    dynamicTexture->loadImageState_ = DYNAMIC_TEXTURE_LOAD_FINISHED;
+    runningCount_--;
+
+    // the tile left the view while it was loading
+    if(persistent == false && isRequestStale(dynamicTexture) == true)
+    {
+        wastedLoadCount_++;
+    }
+
+    if(requests_.size() == 0 && runningCount_ == 0 && timeToSharpTimer_.isNull() != true)
+    {
+        lastTimeToSharp_ = timeToSharpTimer_.elapsed();
+        timeToSharpTimer_ = QTime();
+
+        put_flog(LOG_DEBUG, "time to sharp: %i ms (cancelled loads: %li, wasted loads: %li, prefetch hits: %li / %li)", lastTimeToSharp_, cancelledLoadCount_, wastedLoadCount_, prefetchHitCount_, prefetchLoadCount_);
+    }
+
+    loadFinishedCondition_.wakeAll();
+}
@@ -0,0 +1,157 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DYNAMIC_TEXTURE_LOADER_H
+#define DYNAMIC_TEXTURE_LOADER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "TileWorkQueue.h"
+#include <QtGui>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+class DynamicTexture;
+
+// load states for a DynamicTexture object's image
+enum DYNAMIC_TEXTURE_LOAD_STATE { DYNAMIC_TEXTURE_LOAD_IDLE, DYNAMIC_TEXTURE_LOAD_QUEUED, DYNAMIC_TEXTURE_LOAD_RUNNING, DYNAMIC_TEXTURE_LOAD_FINISHED };
+
+struct DynamicTextureLoadRequest {
+
+    // weak pointer so queued requests don't keep tiles alive; empty for root objects queued during construction
+    boost::weak_ptr<DynamicTexture> dynamicTexture;
+
+    // higher priorities are loaded first
+    double priority;
+
+    // DCT scaling denominator to decode the tile at
+    int scaleDenominator;
+
+    // persistent requests are never cancelled
+    bool persistent;
+
+    // prefetch requests are loaded only when no tiles currently in view are waiting
+    bool prefetch;
+};
+
+// schedules DynamicTexture image loads on a dedicated thread pool. the most important visible tile is loaded next;
+// prefetched tiles are loaded only when no visible tiles are waiting.
+class DynamicTextureLoader : public TileWorkQueue<DynamicTexture *, DynamicTextureLoadRequest> {
+
+    public:
+
+        DynamicTextureLoader();
+
+        // request a load, or renew an existing request with an updated priority
+        // a prefetch request renews, but never replaces, an existing request
+        void requestLoad(boost::shared_ptr<DynamicTexture> dynamicTexture, double priority, int scaleDenominator, bool prefetch=false);
+
+        // request a load that is never cancelled; used for root objects, which cannot call shared_from_this() during construction
+        void requestPersistentLoad(DynamicTexture * dynamicTexture);
+
+        // allow a finished load to be requested again
+        void resetLoad(DynamicTexture * dynamicTexture);
+
+        // remove a queued request; returns true if a request was removed
+        bool cancelLoad(DynamicTexture * dynamicTexture);
+
+        // block until the load finishes; a queued load is taken from the queue and done in the calling thread
+        void waitForLoad(DynamicTexture * dynamicTexture);
+
+        bool isLoadFinished(DynamicTexture * dynamicTexture);
+        bool isLoadRunning(DynamicTexture * dynamicTexture);
+
+        // cancel requests that were not renewed in the last frame
+        void clearStaleRequests();
+
+        // cancel all requests and wait for running loads to finish
+        void finalize();
+
+        // statistics
+        int getQueueDepth();
+        long getCancelledLoadCount();
+        long getWastedLoadCount();
+        long getPrefetchLoadCount();
+        long getPrefetchHitCount();
+        int getLastTimeToSharp();
+
+        // one line summary of the statistics, for the streaming statistics overlay
+        std::string getStatistics();
+
+        // called when a tile loaded by a prefetch request is first rendered; hits and prefetch loads are shown with
+        // the other statistics
+        void incrementPrefetchHitCount();
+
+        // called by the worker threads
+        void processQueue();
+
+    protected:
+
+        // mutex_ also protects the statistics and load state of all DynamicTexture objects
+        bool isRequestCancelled(DynamicTexture * const & dynamicTexture, const DynamicTextureLoadRequest & request);
+        void requestCancelled(DynamicTexture * const & dynamicTexture, const DynamicTextureLoadRequest & request);
+        bool isHigherPriority(const DynamicTextureLoadRequest & request, const DynamicTextureLoadRequest & other);
+
+    private:
+
+        // signaled whenever a load finishes
+        QWaitCondition loadFinishedCondition_;
+
+        // number of loads currently running
+        int runningCount_;
+
+        // statistics
+        long cancelledLoadCount_;
+        long wastedLoadCount_;
+        long prefetchLoadCount_;
+        long prefetchHitCount_;
+
+        // time from the queue becoming busy to all requested loads being finished
+        QTime timeToSharpTimer_;
+        int lastTimeToSharp_;
+
+        // these must be called with mutex_ locked
+        void insertRequest(DynamicTexture * dynamicTexture, DynamicTextureLoadRequest request);
+        bool isRequestStale(DynamicTexture * dynamicTexture);
+        void loadFinished(DynamicTexture * dynamicTexture, bool persistent);
+};
+
+extern DynamicTextureLoader g_dynamicTextureLoader;
+
+#endif
@@ -40,6 +40,7 @@
 #include "main.h"
 #include "Marker.h"
 #include "ContentWindowManager.h"
+#include "DynamicTextureLoader.h"
 #include "log.h"
 #include <QtOpenGL>
 #include <boost/shared_ptr.hpp>
@@ -171,6 +172,12 @@ void GLWindow::paintGL()
         markers[i]->render();
     }
 
+    // the tile loader is shared by all windows of this process
+    if(g_displayGroupManager->getOptions()->getShowStreamingStatistics() == true)
+    {
+        renderLoaderStatistics();
+    }
+
 #if ENABLE_SKELETON_SUPPORT
     if(g_displayGroupManager->getOptions()->getShowSkeletons() == true)
     {
@@ -362,6 +369,11 @@ bool GLWindow::setPerspectiveView(double x, double y, double w, double h)
     return true;
 }
 
+QRectF GLWindow::getScreenRectangle()
+{
+    return QRectF(left_, bottom_, right_-left_, top_-bottom_);
+}
+
 bool GLWindow::isScreenRectangleVisible(double x, double y, double w, double h)
 {
     // works in "screen space" where the rectangle for the entire tiled display is (0,0,1,1)
@@ -520,3 +532,20 @@ void GLWindow::renderTestPattern()
     glPopMatrix();
     glPopAttrib();
 }
+
+void GLWindow::renderLoaderStatistics()
+{
+    glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT);
+    glDisable(GL_DEPTH_TEST);
+
+    int fontSize = 32;
+
+    QFont font;
+    font.setPixelSize(fontSize);
+
+    glColor4f(1.,0.,0.,1.);
+
+    renderText(50, height() - fontSize, QString(g_dynamicTextureLoader.getStatistics().c_str()), font);
+
+    glPopAttrib();
+}
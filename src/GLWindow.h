@@ -73,6 +73,9 @@ class GLWindow : public QGLWidget
         void setOrthographicView();
         bool setPerspectiveView(double x=0., double y=0., double w=1., double h=1.);
 
+        // this window's area of the tiled display, where the entire display is (0,0,1,1)
+        QRectF getScreenRectangle();
+
         bool isScreenRectangleVisible(double x, double y, double w, double h);
 
         static bool isRectangleVisible(double x, double y, double w, double h);
@@ -102,6 +105,7 @@ class GLWindow : public QGLWidget
         std::vector<GLuint> purgeTextureIds_;
 
         void renderTestPattern();
+        void renderLoaderStatistics();
 };
 
 #endif
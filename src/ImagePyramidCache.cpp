@@ -0,0 +1,309 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ImagePyramidCache.h"
+#include "DynamicTexture.h"
+#include "DynamicTextureContent.h"
+#include "main.h"
+#include "log.h"
+#include <QtConcurrentRun>
+
+ImagePyramidCache g_imagePyramidCache;
+
+ImagePyramidCache::ImagePyramidCache()
+{
+    // the worker thread signals new sources; handle them in the main thread
+    connect(this, SIGNAL(imageSourceChanged(QString, QString, QString, bool)), this, SLOT(updateImageSource(QString, QString, QString, bool)), Qt::QueuedConnection);
+}
+
+void ImagePyramidCache::requestImageSource(boost::shared_ptr<DynamicTextureContent> content)
+{
+    std::string imageFilename = content->getURI();
+    std::string sourceFilename;
+
+    // only a stat; the file is not read here
+    std::string imageVersion = getVersion(imageFilename);
+
+    {
+        QMutexLocker locker(&mutex_);
+
+        if(imageSources_.count(imageFilename) > 0)
+        {
+            if(imageVersions_[imageFilename] == imageVersion)
+            {
+                sourceFilename = imageSources_[imageFilename];
+            }
+            else
+            {
+                // the file changed since it was resolved; don't show its old source
+                put_flog(LOG_DEBUG, "image %s changed, invalidating its source", imageFilename.c_str());
+
+                imageSources_.erase(imageFilename);
+                imageVersions_.erase(imageFilename);
+            }
+        }
+
+        if(waitingContents_.count(imageFilename) == 0)
+        {
+            QtConcurrent::run(resolveImageSourceThread, imageFilename);
+        }
+
+        waitingContents_[imageFilename].push_back(content);
+    }
+
+    if(sourceFilename.empty() != true)
+    {
+        content->setImageSourceURI(sourceFilename);
+    }
+}
+
+void ImagePyramidCache::resolveImageSource(std::string imageFilename)
+{
+    QString imageVersion = QString(getVersion(imageFilename).c_str());
+    std::string key = getKey(imageFilename);
+
+    if(key.empty() == true || QDir().mkpath(getDirectory().c_str()) != true)
+    {
+        put_flog(LOG_WARN, "could not use image pyramid cache for %s", imageFilename.c_str());
+
+        emit(imageSourceChanged(QString(imageFilename.c_str()), imageVersion, QString(imageFilename.c_str()), true));
+        return;
+    }
+
+    // another image with the same content may be generating this pyramid
+    {
+        QMutexLocker locker(&mutex_);
+
+        while(generating_.count(key) > 0)
+        {
+            generatingFinished_.wait(&mutex_);
+        }
+
+        generating_.insert(key);
+    }
+
+    // use the cached pyramid if we have a complete one
+    // otherwise show a preview while the pyramid is generated, or the image itself if that's not possible
+    std::string sourceFilename = getImagePyramidFilename(key);
+
+    // the metadata file is written last, so it only exists for complete pyramids
+    if(QFile::exists(sourceFilename.c_str()) == true)
+    {
+        put_flog(LOG_DEBUG, "using cached image pyramid for %s", imageFilename.c_str());
+    }
+    else
+    {
+        std::string previewFilename = getPreviewFilename(key);
+
+        if(QFile::exists(previewFilename.c_str()) == true || createPreview(imageFilename, previewFilename) == true)
+        {
+            emit(imageSourceChanged(QString(imageFilename.c_str()), imageVersion, QString(previewFilename.c_str()), false));
+        }
+        else
+        {
+            previewFilename = imageFilename;
+        }
+
+        put_flog(LOG_INFO, "generating image pyramid for %s", imageFilename.c_str());
+
+        if(generateImagePyramid(imageFilename, key) == true)
+        {
+            put_flog(LOG_INFO, "generated image pyramid for %s", imageFilename.c_str());
+        }
+        else
+        {
+            put_flog(LOG_ERROR, "failed to generate image pyramid for %s", imageFilename.c_str());
+            sourceFilename = previewFilename;
+        }
+    }
+
+    {
+        QMutexLocker locker(&mutex_);
+
+        generating_.erase(key);
+        generatingFinished_.wakeAll();
+    }
+
+    emit(imageSourceChanged(QString(imageFilename.c_str()), imageVersion, QString(sourceFilename.c_str()), true));
+}
+
+void ImagePyramidCache::updateImageSource(QString imageFilename, QString imageVersion, QString sourceFilename, bool final)
+{
+    std::string filename = imageFilename.toStdString();
+
+    std::vector<boost::weak_ptr<DynamicTextureContent> > contents;
+
+    {
+        QMutexLocker locker(&mutex_);
+
+        imageSources_[filename] = sourceFilename.toStdString();
+        imageVersions_[filename] = imageVersion.toStdString();
+
+        contents = waitingContents_[filename];
+
+        if(final == true)
+        {
+            waitingContents_.erase(filename);
+        }
+    }
+
+    for(unsigned int i=0; i<contents.size(); i++)
+    {
+        boost::shared_ptr<DynamicTextureContent> content = contents[i].lock();
+
+        if(content != NULL)
+        {
+            put_flog(LOG_DEBUG, "showing %s from %s", filename.c_str(), sourceFilename.toStdString().c_str());
+
+            // this triggers a display group update
+            content->setImageSourceURI(sourceFilename.toStdString());
+        }
+    }
+}
+
+std::string ImagePyramidCache::getDirectory()
+{
+    return g_configuration->getImagePyramidCacheDirectory();
+}
+
+std::string ImagePyramidCache::getVersion(std::string imageFilename)
+{
+    QFileInfo fileInfo(imageFilename.c_str());
+
+    if(fileInfo.exists() != true)
+    {
+        return std::string();
+    }
+
+    return QString("%1:%2").arg(fileInfo.size()).arg(fileInfo.lastModified().toTime_t()).toStdString();
+}
+
+std::string ImagePyramidCache::getKey(std::string imageFilename)
+{
+    // hash the file size, modification time, and the first and last blocks of the file
+    // this identifies the content without reading all of a (possibly very large) image
+    const qint64 blockSize = 1024 * 1024;
+
+    QFile file(imageFilename.c_str());
+
+    if(file.open(QIODevice::ReadOnly) != true)
+    {
+        return std::string();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    QFileInfo fileInfo(file);
+    hash.addData(QByteArray::number(fileInfo.size()));
+    hash.addData(QByteArray::number(fileInfo.lastModified().toTime_t()));
+
+    hash.addData(file.read(blockSize));
+
+    if(file.size() > blockSize)
+    {
+        file.seek(std::max(file.size() - blockSize, blockSize));
+        hash.addData(file.read(blockSize));
+    }
+
+    return QString(hash.result().toHex()).toStdString();
+}
+
+std::string ImagePyramidCache::getImagePyramidPath(std::string key)
+{
+    return getDirectory() + "/" + key + ".pyramid/";
+}
+
+std::string ImagePyramidCache::getImagePyramidFilename(std::string key)
+{
+    return getImagePyramidPath(key) + "pyramid.pyr";
+}
+
+std::string ImagePyramidCache::getPreviewFilename(std::string key)
+{
+    return getDirectory() + "/" + key + ".preview.jpg";
+}
+
+bool ImagePyramidCache::generateImagePyramid(std::string imageFilename, std::string key)
+{
+    boost::shared_ptr<DynamicTexture> dt(new DynamicTexture(imageFilename));
+
+    // partial pyramids from interrupted or failed runs have no metadata file and are regenerated
+    return dt->computeImagePyramid(getImagePyramidPath(key));
+}
+
+bool ImagePyramidCache::createPreview(std::string imageFilename, std::string previewFilename)
+{
+    QImageReader imageReader(imageFilename.c_str());
+
+    QSize size = imageReader.size();
+
+    if(size.isValid() != true)
+    {
+        put_flog(LOG_ERROR, "could not get size of %s", imageFilename.c_str());
+        return false;
+    }
+
+    // let the reader scale while decoding where the format supports it (e.g. JPEG DCT scaling)
+    size.scale(IMAGE_PYRAMID_PREVIEW_SIZE, IMAGE_PYRAMID_PREVIEW_SIZE, Qt::KeepAspectRatio);
+    imageReader.setScaledSize(size);
+
+    QImage image = imageReader.read();
+
+    if(image.isNull() == true)
+    {
+        put_flog(LOG_ERROR, "could not read preview of %s", imageFilename.c_str());
+        return false;
+    }
+
+    // write to a temporary file first so a partial preview is never used
+    QString temporaryFilename = QString(previewFilename.c_str()) + ".tmp";
+
+    if(image.save(temporaryFilename, "jpg") != true || QFile::rename(temporaryFilename, previewFilename.c_str()) != true)
+    {
+        put_flog(LOG_ERROR, "could not write preview %s", previewFilename.c_str());
+        QFile::remove(temporaryFilename);
+        return false;
+    }
+
+    return true;
+}
+
+void resolveImageSourceThread(std::string imageFilename)
+{
+    g_imagePyramidCache.resolveImageSource(imageFilename);
+}
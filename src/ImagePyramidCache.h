@@ -0,0 +1,117 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef IMAGE_PYRAMID_CACHE_H
+#define IMAGE_PYRAMID_CACHE_H
+
+// maximum dimension of the preview shown while an image pyramid is generated
+#define IMAGE_PYRAMID_PREVIEW_SIZE 2048
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <QtGui>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+class DynamicTextureContent;
+
+// content-addressed on-disk cache of image pyramids for large images.
+// the content keeps the image's own filename as its URI; the cache resolves the image source it is rendered from.
+// the first time a large image is opened, a downsampled preview is shown while its pyramid is generated in the
+// background; when the pyramid is complete all contents showing the preview are switched to it.
+// hashing, preview creation, and pyramid generation are all done on a worker thread, never on the GUI thread.
+class ImagePyramidCache : public QObject {
+    Q_OBJECT
+
+    public:
+
+        ImagePyramidCache();
+
+        // resolve the image source of a large image content in the background
+        // the content is given the latest known source now, if the image is unchanged since it was resolved, and is
+        // updated as sources become available
+        void requestImageSource(boost::shared_ptr<DynamicTextureContent> content);
+
+        // called by the worker thread
+        void resolveImageSource(std::string imageFilename);
+
+    signals:
+
+        // imageVersion identifies the version of the image the source was resolved from
+        // final is true once no better source will follow
+        void imageSourceChanged(QString imageFilename, QString imageVersion, QString sourceFilename, bool final);
+
+    private slots:
+
+        void updateImageSource(QString imageFilename, QString imageVersion, QString sourceFilename, bool final);
+
+    private:
+
+        // mutex for everything below
+        QMutex mutex_;
+
+        // latest known source of each image filename
+        std::map<std::string, std::string> imageSources_;
+
+        // version of each image filename its latest known source was resolved from
+        std::map<std::string, std::string> imageVersions_;
+
+        // contents waiting for better sources of each image filename; an entry exists while a worker resolves it
+        std::map<std::string, std::vector<boost::weak_ptr<DynamicTextureContent> > > waitingContents_;
+
+        // keys of pyramids currently being generated, and signaled when one finishes
+        std::set<std::string> generating_;
+        QWaitCondition generatingFinished_;
+
+        std::string getDirectory();
+        std::string getVersion(std::string imageFilename);
+        std::string getKey(std::string imageFilename);
+        std::string getImagePyramidPath(std::string key);
+        std::string getImagePyramidFilename(std::string key);
+        std::string getPreviewFilename(std::string key);
+        bool createPreview(std::string imageFilename, std::string previewFilename);
+        bool generateImagePyramid(std::string imageFilename, std::string key);
+};
+
+extern ImagePyramidCache g_imagePyramidCache;
+
+extern void resolveImageSourceThread(std::string imageFilename);
+
+#endif
@@ -40,6 +40,11 @@
 #include "main.h"
 #include "Content.h"
 #include "ContentWindowManager.h"
+#include "DynamicTextureLoader.h"
+#include "PixelStreamDecoder.h"
+#include "ParallelPixelStreamSynchronizer.h"
+#include "SVGTileRasterizer.h"
+#include "StreamMetrics.h"
 #include "log.h"
 #include "DisplayGroupGraphicsViewProxy.h"
 #include "DisplayGroupListWidgetProxy.h"
@@ -473,7 +478,11 @@ void MainWindow::computeImagePyramid()
         put_flog(LOG_DEBUG, "got image pyramid path %s", imagePyramidPath.c_str());
 
         boost::shared_ptr<DynamicTexture> dt(new DynamicTexture(imageFilename.toStdString()));
-        dt->computeImagePyramid(imagePyramidPath);
+        if(dt->computeImagePyramid(imagePyramidPath) != true)
+        {
+            QMessageBox::warning(this, "Error", "Could not compute image pyramid.", QMessageBox::Ok, QMessageBox::Ok);
+            return;
+        }
 
         put_flog(LOG_DEBUG, "done");
     }
@@ -527,6 +536,9 @@ void MainWindow::updateGLWindows()
         g_displayGroupManager->receiveFrameClockUpdate();
     }
 
+    // synchronize parallel pixel streams; the reduction started here completes during rendering
+    g_parallelPixelStreamSynchronizer.synchronize();
+
     // render all GLWindows
     for(unsigned int i=0; i<glWindows_.size(); i++)
     {
@@ -543,6 +555,19 @@ void MainWindow::updateGLWindows()
         glWindows_[i]->swapBuffers();
     }
 
+    // the frames rendered are now displayed; record the latency of the parallel pixel stream frames among them
+    if(glWindows_.size() > 0)
+    {
+        long long swapTimestamp = DisplayGroupManager::getClusterTimestamp();
+
+        std::map<std::string, boost::shared_ptr<ParallelPixelStream> > map = glWindows_[0]->getParallelPixelStreamFactory().getMap();
+
+        for(std::map<std::string, boost::shared_ptr<ParallelPixelStream> >::iterator it = map.begin(); it != map.end(); it++)
+        {
+            (*it).second->framesSwapped(swapTimestamp);
+        }
+    }
+
     // advance all contents
     g_displayGroupManager->advanceContents();
 
@@ -558,14 +583,29 @@ void MainWindow::updateGLWindows()
         glWindows_[0]->purgeTextures();
     }
 
+    // cancel image loads for tiles that are no longer visible
+    g_dynamicTextureLoader.clearStaleRequests();
+
+    // export the stream metrics of this process periodically
+    g_streamMetrics.update();
+
     // increment frame counter
     g_frameCount = g_frameCount + 1;
 
+    g_dynamicTextureLoader.setFrameCount(g_frameCount);
+    g_svgTileRasterizer.setFrameCount(g_frameCount);
+
     emit(updateGLWindowsFinished());
 }
 
 void MainWindow::finalize()
 {
+    // stop loading images, rasterizing SVGs, and decoding pixel streams before the factories are cleared
+    g_dynamicTextureLoader.finalize();
+    g_svgTileRasterizer.finalize();
+    g_pixelStreamDecoder.finalize();
+    g_parallelPixelStreamSynchronizer.finalize();
+
     for(unsigned int i=0; i<glWindows_.size(); i++)
     {
         glWindows_[i]->finalize();
@@ -45,7 +45,7 @@
     #include <stdint.h>
 #endif
 
-enum MESSAGE_TYPE { MESSAGE_TYPE_CONTENTS, MESSAGE_TYPE_CONTENTS_DIMENSIONS, MESSAGE_TYPE_PIXELSTREAM, MESSAGE_TYPE_PIXELSTREAM_DIMENSIONS_CHANGED, MESSAGE_TYPE_PARALLEL_PIXELSTREAM, MESSAGE_TYPE_SVG_STREAM, MESSAGE_TYPE_BIND_INTERACTION, MESSAGE_TYPE_INTERACTION, MESSAGE_TYPE_FRAME_CLOCK, MESSAGE_TYPE_QUIT, MESSAGE_TYPE_ACK };
+enum MESSAGE_TYPE { MESSAGE_TYPE_CONTENTS, MESSAGE_TYPE_CONTENTS_DIMENSIONS, MESSAGE_TYPE_PIXELSTREAM, MESSAGE_TYPE_PIXELSTREAM_DIMENSIONS_CHANGED, MESSAGE_TYPE_PARALLEL_PIXELSTREAM, MESSAGE_TYPE_SVG_STREAM, MESSAGE_TYPE_BIND_INTERACTION, MESSAGE_TYPE_INTERACTION, MESSAGE_TYPE_FRAME_CLOCK, MESSAGE_TYPE_QUIT, MESSAGE_TYPE_ACK, MESSAGE_TYPE_BIND_WALL_LAYOUT, MESSAGE_TYPE_WALL_LAYOUT, MESSAGE_TYPE_BIND_SHARED_MEMORY, MESSAGE_TYPE_SVG_STREAM_UPDATE, MESSAGE_TYPE_SVG_STREAM_CACHED, MESSAGE_TYPE_STREAM_METRICS };
 
 #define MESSAGE_HEADER_URI_LENGTH 64
 
@@ -44,6 +44,7 @@
 #include "SVGStreamSource.h"
 #include "ContentWindowManager.h"
 #include <stdint.h>
+#include <algorithm>
 
 NetworkListenerThread::NetworkListenerThread(int socketDescriptor)
 {
@@ -51,6 +52,9 @@ NetworkListenerThread::NetworkListenerThread(int socketDescriptor)
     tcpSocket_ = NULL;
     interactionBound_ = false;
     updatedInteractionState_ = false;
+    wallLayoutBound_ = false;
+    updatedWallLayout_ = false;
+    wallLayoutTime_.start();
 
     // assign values
     socketDescriptor_ = socketDescriptor;
@@ -128,6 +132,20 @@ void NetworkListenerThread::process()
 
             interactionBound_ = bindInteraction();
         }
+
+        // same for the wall layout
+        if(wallLayoutName_.empty() != true && wallLayoutBound_ == false)
+        {
+            put_flog(LOG_DEBUG, "attempting to bind wall layout again...");
+
+            wallLayoutBound_ = bindWallLayout();
+        }
+    }
+
+    // receive messages from shared memory
+    if(sharedMemoryRing_.isAttached() == true)
+    {
+        receiveSharedMemoryMessages();
     }
 
     // send messages if needed
@@ -138,6 +156,18 @@ void NetworkListenerThread::process()
         updatedInteractionState_ = false;
     }
 
+    if(wallLayoutBound_ == true && wallLayoutTime_.elapsed() > WALL_LAYOUT_UPDATE_INTERVAL)
+    {
+        updatedWallLayout_ = true;
+    }
+
+    if(updatedWallLayout_ == true)
+    {
+        sendWallLayout();
+
+        updatedWallLayout_ = false;
+    }
+
     // flush the socket
     tcpSocket_->flush();
 }
@@ -208,6 +238,11 @@ void NetworkListenerThread::setInteractionState(InteractionState interactionStat
     interactionState_ = interactionState;
 }
 
+void NetworkListenerThread::updateWallLayout()
+{
+    updatedWallLayout_ = true;
+}
+
 void NetworkListenerThread::handleMessage(MessageHeader messageHeader, QByteArray byteArray)
 {
     if(messageHeader.type == MESSAGE_TYPE_PIXELSTREAM)
@@ -225,6 +260,12 @@ void NetworkListenerThread::handleMessage(MessageHeader messageHeader, QByteArra
     {
         std::string uri(messageHeader.uri);
 
+        if(byteArray.size() < 2 * (int)sizeof(int))
+        {
+            put_flog(LOG_ERROR, "dimensions message too small (%i bytes), dropping", byteArray.size());
+            return;
+        }
+
         const int * dimensions = (const int *)byteArray.constData();
 
         g_pixelStreamSourceFactory.getObject(uri)->setDimensions(dimensions[0], dimensions[1]);
@@ -238,12 +279,21 @@ void NetworkListenerThread::handleMessage(MessageHeader messageHeader, QByteArra
         // sendParallelPixelStreams() runs in a polling loop on the main thread
         std::string uri(messageHeader.uri);
 
+        if(byteArray.size() < (int)sizeof(ParallelPixelStreamSegmentParameters))
+        {
+            put_flog(LOG_ERROR, "segment message too small for its parameters (%i bytes), dropping", byteArray.size());
+            return;
+        }
+
         ParallelPixelStreamSegment segment;
 
         // read parameters
         ParallelPixelStreamSegmentParameters * parameters = (ParallelPixelStreamSegmentParameters *)(byteArray.data());
         segment.parameters = *parameters;
 
+        segment.timestamps.capture = segment.parameters.captureTimestamp;
+        segment.timestamps.received = DisplayGroupManager::getClusterTimestamp();
+
         // read image data
         QByteArray imageData = byteArray.right(byteArray.size() - sizeof(ParallelPixelStreamSegmentParameters));
         segment.imageData = imageData;
@@ -262,6 +312,14 @@ void NetworkListenerThread::handleMessage(MessageHeader messageHeader, QByteArra
 
         emit(updatedSVGStreamSource());
     }
+    else if(messageHeader.type == MESSAGE_TYPE_SVG_STREAM_UPDATE)
+    {
+        std::string uri(messageHeader.uri);
+
+        g_SVGStreamSourceFactory.getObject(uri)->appendUpdates(byteArray);
+
+        emit(updatedSVGStreamSource());
+    }
     else if(messageHeader.type == MESSAGE_TYPE_BIND_INTERACTION)
     {
         std::string uri(messageHeader.uri);
@@ -272,6 +330,102 @@ void NetworkListenerThread::handleMessage(MessageHeader messageHeader, QByteArra
 
         interactionBound_ = bindInteraction();
     }
+    else if(messageHeader.type == MESSAGE_TYPE_BIND_WALL_LAYOUT)
+    {
+        std::string uri(messageHeader.uri);
+
+        put_flog(LOG_INFO, "binding wall layout to %s", uri.c_str());
+
+        wallLayoutName_ = uri;
+
+        wallLayoutBound_ = bindWallLayout();
+    }
+    else if(messageHeader.type == MESSAGE_TYPE_BIND_SHARED_MEMORY)
+    {
+        std::string uri(messageHeader.uri);
+
+        put_flog(LOG_INFO, "binding shared memory %s", uri.c_str());
+
+        int32_t result = bindSharedMemory(uri) == true ? 1 : 0;
+
+        socketSendMessage(MESSAGE_TYPE_BIND_SHARED_MEMORY, (const char *)&result, sizeof(int32_t));
+    }
+}
+
+void NetworkListenerThread::receiveSharedMemoryMessages()
+{
+    const char * data;
+    int size;
+
+    // messages are acknowledged by removing them from the ring
+    while(sharedMemoryRing_.peek(data, size) == true)
+    {
+        // a record size outside the ring means the ring itself can't be trusted anymore: stop reading it, and close
+        // the connection so the client doesn't wait for acks that will never come
+        if(size < 0 || size > sharedMemoryRing_.getMaximumRecordSize())
+        {
+            put_flog(LOG_ERROR, "invalid shared memory record size %i, closing shared memory", size);
+
+            sharedMemoryRing_.finalize();
+            tcpSocket_->disconnectFromHost();
+
+            return;
+        }
+
+        // malformed messages are dropped; the record framing is still valid, so the following records can be read
+        if(size < (int)sizeof(MessageHeader))
+        {
+            put_flog(LOG_ERROR, "shared memory record too small for a message header (%i bytes), dropping", size);
+
+            sharedMemoryRing_.pop();
+            continue;
+        }
+
+        MessageHeader mh = *(const MessageHeader *)data;
+        data += sizeof(MessageHeader);
+
+        // the URI is used as a string below
+        mh.uri[MESSAGE_HEADER_URI_LENGTH - 1] = '\0';
+
+        if(mh.size != size - (int)sizeof(MessageHeader))
+        {
+            put_flog(LOG_ERROR, "message size %i doesn't match shared memory record size %i, dropping", mh.size, size);
+
+            sharedMemoryRing_.pop();
+            continue;
+        }
+
+        if(mh.type == MESSAGE_TYPE_PARALLEL_PIXELSTREAM)
+        {
+            if(mh.size < (int)sizeof(ParallelPixelStreamSegmentParameters))
+            {
+                put_flog(LOG_ERROR, "segment message too small for its parameters (%i bytes), dropping", mh.size);
+
+                sharedMemoryRing_.pop();
+                continue;
+            }
+
+            // copy the segment directly out of shared memory
+            ParallelPixelStreamSegment segment;
+            segment.parameters = *(const ParallelPixelStreamSegmentParameters *)data;
+            segment.imageData = QByteArray(data + sizeof(ParallelPixelStreamSegmentParameters), mh.size - (int)sizeof(ParallelPixelStreamSegmentParameters));
+
+            segment.timestamps.capture = segment.parameters.captureTimestamp;
+            segment.timestamps.received = DisplayGroupManager::getClusterTimestamp();
+
+            sharedMemoryRing_.pop();
+
+            g_parallelPixelStreamSourceFactory.getObject(std::string(mh.uri))->insertSegment(segment);
+        }
+        else
+        {
+            QByteArray byteArray(data, mh.size);
+
+            sharedMemoryRing_.pop();
+
+            handleMessage(mh, byteArray);
+        }
+    }
 }
 
 bool NetworkListenerThread::bindInteraction()
@@ -300,11 +454,133 @@ bool NetworkListenerThread::bindInteraction()
 }
 
 void NetworkListenerThread::sendInteractionState()
+{
+    socketSendMessage(MESSAGE_TYPE_INTERACTION, (const char *)&interactionState_, sizeof(InteractionState));
+}
+
+bool NetworkListenerThread::bindWallLayout()
+{
+    // try to bind to the ContentWindowManager corresponding to wallLayoutName
+    boost::shared_ptr<ContentWindowManager> cwm = displayGroupInterface_->getContentWindowManager(wallLayoutName_);
+
+    if(cwm != NULL)
+    {
+        put_flog(LOG_DEBUG, "found window");
+
+        // the layout is sent again whenever the window moves, is resized, is zoomed, or is panned
+        connect(cwm.get(), SIGNAL(coordinatesChanged(double, double, double, double, ContentWindowInterface *)), this, SLOT(updateWallLayout()), Qt::QueuedConnection);
+        connect(cwm.get(), SIGNAL(positionChanged(double, double, ContentWindowInterface *)), this, SLOT(updateWallLayout()), Qt::QueuedConnection);
+        connect(cwm.get(), SIGNAL(sizeChanged(double, double, ContentWindowInterface *)), this, SLOT(updateWallLayout()), Qt::QueuedConnection);
+        connect(cwm.get(), SIGNAL(zoomChanged(double, ContentWindowInterface *)), this, SLOT(updateWallLayout()), Qt::QueuedConnection);
+        connect(cwm.get(), SIGNAL(centerChanged(double, double, ContentWindowInterface *)), this, SLOT(updateWallLayout()), Qt::QueuedConnection);
+
+        wallLayoutContentWindowManager_ = cwm;
+
+        // send the current layout
+        wallLayout_ = WallLayout();
+        updatedWallLayout_ = true;
+
+        return true;
+    }
+    else
+    {
+        put_flog(LOG_WARN, "could not find window");
+
+        return false;
+    }
+}
+
+void NetworkListenerThread::sendWallLayout()
+{
+    boost::shared_ptr<ContentWindowManager> cwm = wallLayoutContentWindowManager_.lock();
+
+    if(cwm == NULL)
+    {
+        return;
+    }
+
+    WallLayout wallLayout;
+
+    wallLayout.numTilesWidth = g_configuration->getNumTilesWidth();
+    wallLayout.numTilesHeight = g_configuration->getNumTilesHeight();
+    wallLayout.screenWidth = g_configuration->getScreenWidth();
+    wallLayout.screenHeight = g_configuration->getScreenHeight();
+    wallLayout.mullionWidth = g_configuration->getMullionWidth();
+    wallLayout.mullionHeight = g_configuration->getMullionHeight();
+
+    cwm->getCoordinates(wallLayout.x, wallLayout.y, wallLayout.w, wallLayout.h);
+    wallLayout.zoom = cwm->getZoom();
+    cwm->getCenter(wallLayout.centerX, wallLayout.centerY);
+    wallLayout.visible = isWindowVisible(cwm);
+
+    wallLayoutTime_.restart();
+
+    // only send changes
+    if(wallLayout == wallLayout_)
+    {
+        return;
+    }
+
+    wallLayout_ = wallLayout;
+
+    socketSendMessage(MESSAGE_TYPE_WALL_LAYOUT, (const char *)&wallLayout, sizeof(WallLayout));
+}
+
+bool NetworkListenerThread::isWindowVisible(boost::shared_ptr<ContentWindowManager> contentWindowManager)
+{
+    double x, y, w, h;
+    contentWindowManager->getCoordinates(x, y, w, h);
+
+    // the part of the window on the tiled display
+    QRectF rect = QRectF(x, y, w, h).intersected(QRectF(0., 0., 1., 1.));
+
+    if(rect.isEmpty() == true)
+    {
+        return false;
+    }
+
+    // windows after this one are rendered on top of it; the window is hidden if one of them covers it
+    std::vector<boost::shared_ptr<ContentWindowManager> > contentWindowManagers = displayGroupInterface_->getContentWindowManagers();
+
+    std::vector<boost::shared_ptr<ContentWindowManager> >::iterator it = find(contentWindowManagers.begin(), contentWindowManagers.end(), contentWindowManager);
+
+    if(it == contentWindowManagers.end())
+    {
+        return true;
+    }
+
+    for(it++; it != contentWindowManagers.end(); it++)
+    {
+        (*it)->getCoordinates(x, y, w, h);
+
+        if(QRectF(x, y, w, h).contains(rect) == true)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool NetworkListenerThread::bindSharedMemory(std::string name)
+{
+    // only clients on this host can share memory with us
+    if(tcpSocket_->peerAddress() != tcpSocket_->localAddress())
+    {
+        put_flog(LOG_WARN, "client is not on this host");
+
+        return false;
+    }
+
+    return sharedMemoryRing_.attach(name);
+}
+
+void NetworkListenerThread::socketSendMessage(MESSAGE_TYPE type, const char * data, int size)
 {
     // send message header
     MessageHeader mh;
-    mh.size = sizeof(InteractionState);
-    mh.type = MESSAGE_TYPE_INTERACTION;
+    mh.size = size;
+    mh.type = type;
 
     int sent = tcpSocket_->write((const char *)&mh, sizeof(MessageHeader));
 
@@ -313,12 +589,12 @@ void NetworkListenerThread::sendInteractionState()
         sent += tcpSocket_->write((const char *)&mh + sent, sizeof(MessageHeader) - sent);
     }
 
-    // send interaction state
-    sent = tcpSocket_->write((const char *)&interactionState_, sizeof(InteractionState));
+    // send message
+    sent = tcpSocket_->write(data, size);
 
-    while(sent < (int)sizeof(InteractionState))
+    while(sent < size)
     {
-        sent += tcpSocket_->write((const char *)&interactionState_ + sent, sizeof(InteractionState) - sent);
+        sent += tcpSocket_->write(data + sent, size - sent);
     }
 
     // we want the message to be sent immediately
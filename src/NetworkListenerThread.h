@@ -42,8 +42,13 @@
 // increment this every time the network protocol changes in a major way
 #include "NetworkProtocol.h"
 
+// a window's visibility also depends on other windows, so a bound wall layout is checked this often (milliseconds)
+#define WALL_LAYOUT_UPDATE_INTERVAL 250
+
 #include "DisplayGroupManager.h"
 #include "InteractionState.h"
+#include "WallLayout.h"
+#include "SharedMemoryRing.h"
 #include <QtCore>
 #include <QtNetwork/QTcpSocket>
 
@@ -65,6 +70,8 @@ class NetworkListenerThread : public QObject {
 
         void setInteractionState(InteractionState interactionState);
 
+        void updateWallLayout();
+
     signals:
 
         void finished();
@@ -87,10 +94,32 @@ class NetworkListenerThread : public QObject {
         bool updatedInteractionState_;
         InteractionState interactionState_;
 
+        // wall layout information for the bound window
+        std::string wallLayoutName_;
+        bool wallLayoutBound_;
+        bool updatedWallLayout_;
+        boost::weak_ptr<ContentWindowManager> wallLayoutContentWindowManager_;
+
+        // the last wall layout sent, and when it was last checked
+        WallLayout wallLayout_;
+        QTime wallLayoutTime_;
+
+        // messages from a client on this host, if it negotiated shared memory
+        SharedMemoryRing sharedMemoryRing_;
+
         void handleMessage(MessageHeader messageHeader, QByteArray byteArray);
+        void receiveSharedMemoryMessages();
 
         bool bindInteraction();
         void sendInteractionState();
+
+        bool bindWallLayout();
+        void sendWallLayout();
+        bool isWindowVisible(boost::shared_ptr<ContentWindowManager> contentWindowManager);
+
+        bool bindSharedMemory(std::string name);
+
+        void socketSendMessage(MESSAGE_TYPE type, const char * data, int size);
 };
 
 #endif
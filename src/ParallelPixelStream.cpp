@@ -40,6 +40,19 @@
 #include "main.h"
 #include "ContentWindowManager.h"
 #include "log.h"
+#include <algorithm>
+
+ParallelPixelStreamSourceState::ParallelPixelStreamSourceState() : segments(PARALLEL_PIXEL_STREAM_QUEUE_CAPACITY), renderTimes(PARALLEL_PIXEL_STREAM_STATISTICS_HISTORY)
+{
+    // defaults
+    active = false;
+    retained = false;
+    visibilityValid = false;
+    displayedTextureUpdateCount = 0;
+    displayPending = false;
+    latencyValid = false;
+    overflowCount = 0;
+}
 
 ParallelPixelStream::ParallelPixelStream(std::string uri)
 {
@@ -47,8 +60,20 @@ ParallelPixelStream::ParallelPixelStream(std::string uri)
     width_ = 0;
     height_ = 0;
 
+    syncState_.synchronizing = false;
+    syncState_.localDecodesPending = false;
+    syncState_.localLatestFrameIndex = INT_MAX;
+    syncState_.globalDecodesPending = false;
+    syncState_.globalLatestFrameIndex = INT_MAX;
+    syncState_.synchronizedFrameIndex = -1;
+    syncState_.waitCount = 0;
+
+    visibilityReceivedCount_ = -1;
+    visibilityWindowFound_ = false;
+
     // assign values
     uri_ = uri;
+    metrics_ = g_streamMetrics.getCounters(uri);
 }
 
 void ParallelPixelStream::getDimensions(int &width, int &height)
@@ -63,13 +88,25 @@ void ParallelPixelStream::render(float tX, float tY, float tW, float tH)
 {
     updateRenderedFrameCount();
 
-    for(std::map<int, boost::shared_ptr<PixelStream> >::iterator it=pixelStreams_.begin(); it != pixelStreams_.end(); it++)
+    bool showStreamingSegments = g_displayGroupManager->getOptions()->getShowStreamingSegments();
+    bool showStreamingStatistics = g_displayGroupManager->getOptions()->getShowStreamingStatistics();
+
+    // whether any segment rendered shows a new frame
+    bool frameDisplayed = false;
+
+    for(unsigned int sourceIndex=0; sourceIndex<sources_.size(); sourceIndex++)
     {
-        int sourceIndex = (*it).first;
-        boost::shared_ptr<PixelStream> pixelStream = (*it).second;
+        ParallelPixelStreamSourceState & source = sources_[sourceIndex];
+
+        if(source.pixelStream == NULL || source.active != true)
+        {
+            continue;
+        }
+
+        boost::shared_ptr<PixelStream> pixelStream = source.pixelStream;
 
         // skip segments not visible
-        if(isSegmentVisible(pixelStreamParameters_[sourceIndex]) == false)
+        if(isSourceVisible(sourceIndex) == false)
         {
             // don't render, continue to next segment
             continue;
@@ -78,20 +115,23 @@ void ParallelPixelStream::render(float tX, float tY, float tW, float tH)
         // OpenGL transformation
         glPushMatrix();
 
-        float x = (float)(pixelStreamParameters_[sourceIndex].x) / (float)width_;
-        float y = (float)(pixelStreamParameters_[sourceIndex].y) / (float)height_;
-        float width = (float)(pixelStreamParameters_[sourceIndex].width) / (float)width_;
-        float height = (float)(pixelStreamParameters_[sourceIndex].height) / (float)height_;
+        float x = (float)(source.parameters.x) / (float)width_;
+        float y = (float)(source.parameters.y) / (float)height_;
+        float width = (float)(source.parameters.width) / (float)width_;
+        float height = (float)(source.parameters.height) / (float)height_;
 
         glTranslatef(x, y, 0.);
         glScalef(width, height, 0.);
 
         // todo: compute actual texture bounds to render considering zoom, pan
 
-        pixelStream->render(0.,0.,1.,1.);
-
-        bool showStreamingSegments = g_displayGroupManager->getOptions()->getShowStreamingSegments();
-        bool showStreamingStatistics = g_displayGroupManager->getOptions()->getShowStreamingStatistics();
+        if(pixelStream->render(0.,0.,1.,1.) == true && pixelStream->getTextureUpdateCount() != source.displayedTextureUpdateCount)
+        {
+            source.displayedTextureUpdateCount = pixelStream->getTextureUpdateCount();
+            source.displayedTimestamps = pixelStream->getTextureTimestamps();
+            source.displayPending = true;
+            frameDisplayed = true;
+        }
 
         if(showStreamingSegments == true || showStreamingStatistics == true)
         {
@@ -120,7 +160,7 @@ void ParallelPixelStream::render(float tX, float tY, float tW, float tH)
             if(showStreamingStatistics == true)
             {
                 // render statistics
-                std::string statisticsString = getStatistics((*it).first);
+                std::string statisticsString = getStatistics(sourceIndex);
 
                 QFont font;
                 font.setPixelSize(48);
@@ -137,6 +177,11 @@ void ParallelPixelStream::render(float tX, float tY, float tW, float tH)
         glPopMatrix();
     }
 
+    if(frameDisplayed == true)
+    {
+        metrics_->framesDisplayed.fetch_add(1, std::memory_order_relaxed);
+    }
+
     // get rid of old / stale pixel streams
     clearStalePixelStreams();
 }
@@ -145,6 +190,17 @@ void ParallelPixelStream::insertSegment(ParallelPixelStreamSegment segment)
 {
     QMutexLocker locker(&segmentsMutex_);
 
+    int sourceIndex = segment.parameters.sourceIndex;
+
+    metrics_->addReceived(segment.imageData.size());
+
+    if(sourceIndex < 0 || sourceIndex >= PARALLEL_PIXEL_STREAM_MAX_SOURCES)
+    {
+        put_flog(LOG_WARN, "dropping segment with invalid source index %i", sourceIndex);
+        metrics_->segmentsDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
     // update total dimensions if we have non-blank parameters
     if(segment.parameters.totalWidth != 0 && segment.parameters.totalHeight != 0)
     {
@@ -152,8 +208,24 @@ void ParallelPixelStream::insertSegment(ParallelPixelStreamSegment segment)
         height_ = segment.parameters.totalHeight;
     }
 
+    if(sourceIndex >= (int)sources_.size())
+    {
+        sources_.resize(sourceIndex + 1);
+    }
+
+    ParallelPixelStreamSourceState & source = sources_[sourceIndex];
+
+    // the segment layout changed
+    ParallelPixelStreamSegmentParameters & p = source.parameters;
+
+    if(source.active != true || p.x != segment.parameters.x || p.y != segment.parameters.y || p.width != segment.parameters.width || p.height != segment.parameters.height || p.totalWidth != segment.parameters.totalWidth || p.totalHeight != segment.parameters.totalHeight)
+    {
+        source.visibilityValid = false;
+    }
+
     // update parameters
-    pixelStreamParameters_[segment.parameters.sourceIndex] = segment.parameters;
+    source.active = true;
+    source.parameters = segment.parameters;
 
     // delete any blank segments
     // filter out segments that are not visible (only for rank != 0)
@@ -162,27 +234,72 @@ void ParallelPixelStream::insertSegment(ParallelPixelStreamSegment segment)
         if(segment.parameters.totalWidth == 0 && segment.parameters.totalHeight == 0)
         {
             // this is a blank segment, clear out everything for its sourceIndex...
-            segments_.erase(segment.parameters.sourceIndex);
-            pixelStreams_.erase(segment.parameters.sourceIndex);
-            pixelStreamParameters_.erase(segment.parameters.sourceIndex);
+            source = ParallelPixelStreamSourceState();
 
             // drop the segment
             return;
         }
-        else if(isSegmentVisible(segment.parameters) == false)
+        else if(isSourceVisible(sourceIndex) == false)
         {
-            // clear any unprocessed segments for this source index
-            if(segments_.count(segment.parameters.sourceIndex) != 0)
+            // retain the latest image data, in case the segment becomes visible while unchanged
+            if(segment.isUnchanged() != true)
             {
-                segments_.erase(segment.parameters.sourceIndex);
+                source.retained = true;
+                swap(source.retainedSegment, segment);
+            }
+            else
+            {
+                for(int i=source.segments.size()-1; i>=0; i--)
+                {
+                    if(source.segments[i].isUnchanged() != true)
+                    {
+                        source.retained = true;
+                        swap(source.retainedSegment, source.segments[i]);
+                        break;
+                    }
+                }
             }
 
+            // clear any unprocessed segments for this source index
+            metrics_->segmentsDropped.fetch_add(source.segments.size() + 1, std::memory_order_relaxed);
+            source.segments.clear();
+
             // drop the segment
             return;
         }
+        else if(source.retained == true)
+        {
+            // the segment is visible again; if it is unchanged, its retained image data is still current
+            if(segment.isUnchanged() == true)
+            {
+                qSwap(segment.imageData, source.retainedSegment.imageData);
+                segment.parameters.codec = source.retainedSegment.parameters.codec;
+            }
+
+            source.retained = false;
+            source.retainedSegment = ParallelPixelStreamSegment();
+        }
     }
 
-    segments_[(int)segment.parameters.sourceIndex].push_back(segment);
+    // the queue is full; drop the oldest segment, keeping its image data if the next one is unchanged
+    if(source.segments.size() == source.segments.capacity())
+    {
+        ParallelPixelStreamSegment oldest;
+        source.segments.take(oldest);
+
+        if(source.segments.empty() != true && source.segments.front().isUnchanged() == true && oldest.isUnchanged() != true)
+        {
+            qSwap(source.segments.front().imageData, oldest.imageData);
+            source.segments.front().parameters.codec = oldest.parameters.codec;
+        }
+
+        source.overflowCount++;
+        metrics_->segmentsDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    source.segments.push(segment);
+
+    metrics_->setQueueDepth(source.segments.size());
 }
 
 std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopLatestSegments()
@@ -191,17 +308,15 @@ std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopLatestSegm
 
     std::vector<ParallelPixelStreamSegment> latestSegments;
 
-    for(std::map<int, std::vector<ParallelPixelStreamSegment> >::iterator it=segments_.begin(); it != segments_.end(); it++)
+    for(unsigned int i=0; i<sources_.size(); i++)
     {
-        if((*it).second.size() > 0)
+        if(sources_[i].segments.empty() != true)
         {
-            latestSegments.push_back((*it).second.back());
+            latestSegments.push_back(ParallelPixelStreamSegment());
+            takeSegment(sources_[i], sources_[i].segments.size() - 1, latestSegments.back());
         }
     }
 
-    // clear the map since we got all the latest segments
-    segments_.clear();
-
     return latestSegments;
 }
 
@@ -211,17 +326,15 @@ std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopAllSegment
 
     std::vector<ParallelPixelStreamSegment> allSegments;
 
-    for(std::map<int, std::vector<ParallelPixelStreamSegment> >::iterator it=segments_.begin(); it != segments_.end(); it++)
+    for(unsigned int i=0; i<sources_.size(); i++)
     {
-        if((*it).second.size() > 0)
+        while(sources_[i].segments.empty() != true)
         {
-            allSegments.insert(allSegments.end(), (*it).second.begin(), (*it).second.end());
+            allSegments.push_back(ParallelPixelStreamSegment());
+            sources_[i].segments.take(allSegments.back());
         }
     }
 
-    // clear the map since we got all the segments
-    segments_.clear();
-
     return allSegments;
 }
 
@@ -231,18 +344,19 @@ std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopSegments(i
 
     std::vector<ParallelPixelStreamSegment> frameIndexSegments;
 
-    for(std::map<int, std::vector<ParallelPixelStreamSegment> >::iterator it=segments_.begin(); it != segments_.end(); it++)
+    for(unsigned int i=0; i<sources_.size(); i++)
     {
-        for(unsigned int i=0; i<(*it).second.size(); i++)
+        RingBuffer<ParallelPixelStreamSegment> & segments = sources_[i].segments;
+
+        // the requested frame is usually one of the latest, so search from the back
+        for(int j=segments.size()-1; j>=0; j--)
         {
-            if((*it).second[i].parameters.frameIndex == frameIndex)
+            if(segments[j].parameters.frameIndex == frameIndex)
             {
-                frameIndexSegments.push_back((*it).second[i]);
-
-                // erase this segment and the earlier segments (i+1 segments will be erased)
-                (*it).second.erase((*it).second.begin(), (*it).second.begin() + i+1);
+                // take this segment, dropping the earlier segments
+                frameIndexSegments.push_back(ParallelPixelStreamSegment());
+                takeSegment(sources_[i], j, frameIndexSegments.back());
 
-                // continue to next source index in the map (breaking from this for loop)
                 break;
             }
         }
@@ -253,114 +367,191 @@ std::vector<ParallelPixelStreamSegment> ParallelPixelStream::getAndPopSegments(i
 
 void ParallelPixelStream::updatePixelStreams()
 {
-    // segments we want to process
-    std::vector<ParallelPixelStreamSegment> segments;
-
-    // process differently depending on synchronization option
-    bool enableStreamingSynchronization = g_displayGroupManager->getOptions()->getEnableStreamingSynchronization();
-
-    // make sure all of our segments have a valid frame index
-    // if this is not the case, then we can't have synchronization
-    if(enableStreamingSynchronization == true && getValidFrameIndices() != true)
+    // with synchronization, segments are taken by synchronize() once per frame
+    if(getEnableStreamingSynchronization() == true)
     {
-        enableStreamingSynchronization = false;
+        return;
     }
 
-    if(enableStreamingSynchronization == true)
-    {
-        // determine if threads are running on any processes for this ParallelPixelStream
-
-        // first, for this local process
-        int localThreadsRunning = 0;
-
-        std::map<int, boost::shared_ptr<PixelStream> >::iterator it = pixelStreams_.begin();
-
-        while(it != pixelStreams_.end())
-        {
-            localThreadsRunning += (int)(*it).second->getLoadImageDataThreadRunning();
-            it++;
-        }
-
-        // now, globally for all render processes
-        int globalThreadsRunning;
-
-        MPI_Allreduce((void *)&localThreadsRunning, (void *)&globalThreadsRunning, 1, MPI_INT, MPI_SUM, g_mpiRenderComm);
+    processSegments(getAndPopLatestSegments(), false);
+}
 
-        // do nothing if threads are still running
-        if(globalThreadsRunning > 0)
-        {
-            return;
-        }
+void ParallelPixelStream::getLocalSyncState(bool & synchronizing, bool & decodesPending, int & latestFrameIndex)
+{
+    synchronizing = getEnableStreamingSynchronization();
 
-        // if no threads are running, attempt to update textures (this will be synchronous across all streams!)
-        it = pixelStreams_.begin();
+    // determine if decodes are pending on this process
+    decodesPending = false;
 
-        while(it != pixelStreams_.end())
+    for(unsigned int i=0; i<sources_.size(); i++)
+    {
+        if(sources_[i].pixelStream != NULL && sources_[i].pixelStream->getImageDataPending() == true)
         {
-            (*it).second->updateTextureIfAvailable();
-            it++;
+            decodesPending = true;
         }
+    }
 
-        // find the latest frame index we have locally for all visible parameters
+    // find the latest frame index we have locally for all visible source indices
+    latestFrameIndex = INT_MAX;
 
-        // the visible source indices
+    if(synchronizing == true)
+    {
         std::vector<int> visibleSourceIndices = getSourceIndicesVisible();
 
-        // the latest frame index we have for all visible source indices
-        int latestFrameIndex = INT_MAX;
-
         for(unsigned int i=0; i<visibleSourceIndices.size(); i++)
         {
-            if(segments_.count(visibleSourceIndices[i]) == 0 || segments_[visibleSourceIndices[i]].size() == 0)
+            RingBuffer<ParallelPixelStreamSegment> & segments = sources_[visibleSourceIndices[i]].segments;
+
+            if(segments.empty() == true)
             {
                 latestFrameIndex = -1;
             }
             else
             {
-                latestFrameIndex = std::min(latestFrameIndex, segments_[visibleSourceIndices[i]].back().parameters.frameIndex);
+                latestFrameIndex = std::min(latestFrameIndex, segments.back().parameters.frameIndex);
             }
         }
+    }
+
+    syncState_.localDecodesPending = decodesPending;
+    syncState_.localLatestFrameIndex = latestFrameIndex;
+}
 
-        // now, find the latest frame index for visible source indices across all nodes
-        int globalLatestFrameIndex;
+void ParallelPixelStream::synchronize(bool synchronizing, bool decodesPending, int latestFrameIndex)
+{
+    syncState_.synchronizing = synchronizing;
+    syncState_.globalDecodesPending = decodesPending;
+    syncState_.globalLatestFrameIndex = latestFrameIndex;
 
-        MPI_Allreduce((void *)&latestFrameIndex, (void *)&globalLatestFrameIndex, 1, MPI_INT, MPI_MIN, g_mpiRenderComm);
+    if(synchronizing != true)
+    {
+        return;
+    }
+
+    // do nothing if decodes are still pending on any process
+    if(decodesPending == true)
+    {
+        syncState_.waitCount++;
+        return;
+    }
 
-        if(globalLatestFrameIndex > 0 && globalLatestFrameIndex != INT_MAX)
+    // update textures (this is synchronous across all processes)
+    for(unsigned int i=0; i<sources_.size(); i++)
+    {
+        if(sources_[i].pixelStream != NULL)
         {
-            segments = getAndPopSegments(globalLatestFrameIndex);
+            sources_[i].pixelStream->updateTextureIfAvailable();
         }
     }
-    else
+
+    // decode the latest frame available on all processes
+    std::vector<ParallelPixelStreamSegment> segments;
+
+    if(latestFrameIndex > 0 && latestFrameIndex != INT_MAX)
     {
-        // synchronization disabled
-        segments = getAndPopLatestSegments();
+        segments = getAndPopSegments(latestFrameIndex);
+
+        syncState_.synchronizedFrameIndex = latestFrameIndex;
     }
 
+    processSegments(segments, true);
+}
+
+bool ParallelPixelStream::getEnableStreamingSynchronization()
+{
+    // make sure all of our segments have a valid frame index
+    // if this is not the case, then we can't have synchronization
+    return (g_displayGroupManager->getOptions()->getEnableStreamingSynchronization() == true && getValidFrameIndices() == true);
+}
+
+void ParallelPixelStream::processSegments(const std::vector<ParallelPixelStreamSegment> & segments, bool enableStreamingSynchronization)
+{
     for(unsigned int i=0; i<segments.size(); i++)
     {
         int sourceIndex = segments[i].parameters.sourceIndex;
 
-        if(pixelStreams_[sourceIndex] == NULL)
+        // unchanged segments satisfy synchronization without decoding anything
+        if(segments[i].isUnchanged() == true)
+        {
+            continue;
+        }
+
+        ParallelPixelStreamSourceState & source = sources_[sourceIndex];
+
+        if(source.pixelStream == NULL)
         {
             boost::shared_ptr<PixelStream> ps(new PixelStream("ParallelPixelStreamSegment"));
-            pixelStreams_[sourceIndex] = ps;
+            ps->setMetrics(metrics_);
+            source.pixelStream = ps;
         }
 
         // auto texture uploading depending on synchronous setting
-        pixelStreams_[sourceIndex]->setAutoUpdateTexture(!enableStreamingSynchronization);
+        source.pixelStream->setAutoUpdateTexture(!enableStreamingSynchronization);
 
-        bool success = pixelStreams_[sourceIndex]->setImageData(segments[i].imageData);
+        // only decode the part of the segment visible on this process
+        QRectF visibleRegion = getSourceVisibleRegion(sourceIndex);
+
+        bool success = source.pixelStream->setImageData(segments[i].imageData, visibleRegion, segments[i].parameters.codec, segments[i].timestamps);
 
         if(success == true)
         {
             frameUpdated(sourceIndex);
         }
     }
+
+    // if the window has moved, segments may need to be decoded again for their new visible regions
+    for(unsigned int i=0; i<sources_.size(); i++)
+    {
+        if(sources_[i].pixelStream != NULL && sources_[i].active == true)
+        {
+            sources_[i].pixelStream->setRegionOfInterest(getSourceVisibleRegion(i));
+        }
+    }
 }
 
-bool ParallelPixelStream::isSegmentVisible(ParallelPixelStreamSegmentParameters parameters)
+void ParallelPixelStream::takeSegment(ParallelPixelStreamSourceState & source, int dropCount, ParallelPixelStreamSegment & segment)
 {
+    // the latest image data dropped
+    QByteArray imageData;
+    int codec = 0;
+
+    for(int i=0; i<dropCount; i++)
+    {
+        ParallelPixelStreamSegment dropped;
+        source.segments.take(dropped);
+
+        if(dropped.isUnchanged() != true)
+        {
+            qSwap(imageData, dropped.imageData);
+            codec = dropped.parameters.codec;
+        }
+    }
+
+    metrics_->segmentsSuperseded.fetch_add(dropCount, std::memory_order_relaxed);
+
+    source.segments.take(segment);
+
+    // if the segment is unchanged, the latest image data that hasn't been processed yet is still current
+    if(segment.isUnchanged() == true && imageData.isEmpty() != true)
+    {
+        qSwap(segment.imageData, imageData);
+        segment.parameters.codec = codec;
+    }
+}
+
+void ParallelPixelStream::updateVisibility()
+{
+    // on the render processes, window coordinates only change when a display group is received
+    if(g_mpiRank != 0 && DisplayGroupManager::getReceivedCount() == visibilityReceivedCount_)
+    {
+        return;
+    }
+
+    visibilityReceivedCount_ = DisplayGroupManager::getReceivedCount();
+
+    bool windowFound = false;
+    QRectF windowRect;
+
     boost::shared_ptr<ContentWindowManager> cwm = g_displayGroupManager->getContentWindowManager(uri_, CONTENT_TYPE_PARALLEL_PIXEL_STREAM);
 
     if(cwm != NULL)
@@ -370,50 +561,126 @@ bool ParallelPixelStream::isSegmentVisible(ParallelPixelStreamSegmentParameters
         double x, y, w, h;
         cwm->getCoordinates(x, y, w, h);
 
-        // coordinates of segment in tiled display space
-        double segmentX = x + (double)parameters.x / (double)parameters.totalWidth * w;
-        double segmentY = y + (double)parameters.y / (double)parameters.totalHeight * h;
-        double segmentW = (double)parameters.width / (double)parameters.totalWidth * w;
-        double segmentH = (double)parameters.height / (double)parameters.totalHeight * h;
+        windowFound = true;
+        windowRect = QRectF(x, y, w, h);
+    }
+    else
+    {
+        put_flog(LOG_WARN, "could not find window for segments");
+    }
 
-        bool segmentVisible = false;
+    std::vector<QRectF> screenRects;
 
-        std::vector<boost::shared_ptr<GLWindow> > glWindows = g_mainWindow->getGLWindows();
+    std::vector<boost::shared_ptr<GLWindow> > glWindows = g_mainWindow->getGLWindows();
 
-        for(unsigned int i=0; i<glWindows.size(); i++)
-        {
-            if(glWindows[i]->isScreenRectangleVisible(segmentX, segmentY, segmentW, segmentH) == true)
-            {
-                segmentVisible = true;
-                break;
-            }
-        }
+    for(unsigned int i=0; i<glWindows.size(); i++)
+    {
+        screenRects.push_back(glWindows[i]->getScreenRectangle());
+    }
 
-        return segmentVisible;
+    if(windowFound == visibilityWindowFound_ && windowRect == visibilityWindowRect_ && screenRects == visibilityScreenRects_)
+    {
+        return;
     }
-    else
+
+    visibilityWindowFound_ = windowFound;
+    visibilityWindowRect_ = windowRect;
+    visibilityScreenRects_ = screenRects;
+
+    for(unsigned int i=0; i<sources_.size(); i++)
     {
-        // return true if we can't find a window
-        put_flog(LOG_WARN, "could not find window for segment");
+        sources_[i].visibilityValid = false;
+    }
+}
+
+bool ParallelPixelStream::isSourceVisible(int sourceIndex)
+{
+    updateVisibility();
 
-        return true;
+    if(sources_[sourceIndex].visibilityValid != true)
+    {
+        computeSourceVisibility(sourceIndex);
     }
+
+    return visibilityMask_[sourceIndex];
 }
 
-std::vector<int> ParallelPixelStream::getSourceIndicesVisible()
+QRectF ParallelPixelStream::getSourceVisibleRegion(int sourceIndex)
 {
-    std::vector<int> sourceIndices;
+    updateVisibility();
+
+    if(sources_[sourceIndex].visibilityValid != true)
+    {
+        computeSourceVisibility(sourceIndex);
+    }
 
-    std::map<int, ParallelPixelStreamSegmentParameters>::iterator it = pixelStreamParameters_.begin();
+    return sources_[sourceIndex].visibleRegion;
+}
+
+void ParallelPixelStream::computeSourceVisibility(int sourceIndex)
+{
+    ParallelPixelStreamSourceState & source = sources_[sourceIndex];
+    ParallelPixelStreamSegmentParameters & parameters = source.parameters;
 
-    while(it != pixelStreamParameters_.end())
+    if((int)visibilityMask_.size() < (int)sources_.size())
     {
-        if(isSegmentVisible((*it).second) == true)
+        visibilityMask_.resize(sources_.size());
+    }
+
+    source.visibilityValid = true;
+
+    if(visibilityWindowFound_ != true)
+    {
+        // show and decode the whole segment if we can't find a window
+        visibilityMask_[sourceIndex] = true;
+        source.visibleRegion = QRectF(0.,0.,1.,1.);
+
+        return;
+    }
+
+    const QRectF & w = visibilityWindowRect_;
+
+    // coordinates of segment in tiled display space
+    QRectF segmentRect(w.x() + (double)parameters.x / (double)parameters.totalWidth * w.width(),
+                       w.y() + (double)parameters.y / (double)parameters.totalHeight * w.height(),
+                       (double)parameters.width / (double)parameters.totalWidth * w.width(),
+                       (double)parameters.height / (double)parameters.totalHeight * w.height());
+
+    // visibility, and bounding rectangle of the segment's visible parts on all screens
+    bool visible = false;
+    QRectF visibleRect;
+
+    for(unsigned int i=0; i<visibilityScreenRects_.size(); i++)
+    {
+        if(visibilityScreenRects_[i].intersects(segmentRect) == true)
         {
-            sourceIndices.push_back((*it).first);
+            visible = true;
+            visibleRect = visibleRect.united(visibilityScreenRects_[i].intersected(segmentRect));
         }
+    }
+
+    visibilityMask_[sourceIndex] = visible;
 
-        it++;
+    if(visibleRect.isEmpty() == true || segmentRect.isEmpty() == true)
+    {
+        source.visibleRegion = QRectF();
+        return;
+    }
+
+    // normalize to the segment
+    source.visibleRegion = QRectF((visibleRect.x() - segmentRect.x()) / segmentRect.width(), (visibleRect.y() - segmentRect.y()) / segmentRect.height(), visibleRect.width() / segmentRect.width(), visibleRect.height() / segmentRect.height());
+}
+
+std::vector<int> ParallelPixelStream::getSourceIndicesVisible()
+{
+    std::vector<int> sourceIndices;
+
+    for(unsigned int i=0; i<sources_.size(); i++)
+    {
+        if(sources_[i].active == true && isSourceVisible(i) == true)
+        {
+            sourceIndices.push_back(i);
+        }
     }
 
     return sourceIndices;
@@ -421,16 +688,12 @@ std::vector<int> ParallelPixelStream::getSourceIndicesVisible()
 
 bool ParallelPixelStream::getValidFrameIndices()
 {
-    std::map<int, ParallelPixelStreamSegmentParameters>::iterator it = pixelStreamParameters_.begin();
-
-    while(it != pixelStreamParameters_.end())
+    for(unsigned int i=0; i<sources_.size(); i++)
     {
-        if((*it).second.frameIndex == FRAME_INDEX_UNDEFINED)
+        if(sources_[i].active == true && sources_[i].parameters.frameIndex == FRAME_INDEX_UNDEFINED)
         {
             return false;
         }
-
-        it++;
     }
 
     return true;
@@ -438,49 +701,126 @@ bool ParallelPixelStream::getValidFrameIndices()
 
 void ParallelPixelStream::clearStalePixelStreams()
 {
-    std::map<int, boost::shared_ptr<PixelStream> >::iterator it = pixelStreams_.begin();
-
-    while(it != pixelStreams_.end())
+    for(unsigned int i=0; i<sources_.size(); i++)
     {
-        boost::shared_ptr<PixelStream> pixelStream = (*it).second;
+        ParallelPixelStreamSourceState & source = sources_[i];
 
-        if(g_frameCount - pixelStream->getRenderedFrameCount() > 1)
+        if(source.pixelStream != NULL && g_frameCount - source.pixelStream->getRenderedFrameCount() > 1)
         {
             put_flog(LOG_DEBUG, "erasing stale pixel stream");
-            pixelStreams_.erase(it++);  // note the post increment; increments the iterator but returns original value for erase
+
+            // retain its image data, in case the segment becomes visible again while unchanged
+            ParallelPixelStreamSegment segment;
+            segment.imageData = source.pixelStream->getImageData(segment.parameters.codec);
+
+            if(segment.imageData.isEmpty() != true)
+            {
+                QMutexLocker locker(&segmentsMutex_);
+
+                if(source.active == true)
+                {
+                    int codec = segment.parameters.codec;
+                    segment.parameters = source.parameters;
+                    segment.parameters.codec = codec;
+                }
+
+                source.retained = true;
+                swap(source.retainedSegment, segment);
+            }
+
+            source.pixelStream.reset();
         }
-        else
+    }
+}
+
+void ParallelPixelStream::framesSwapped(long long swapTimestamp)
+{
+    for(unsigned int i=0; i<sources_.size(); i++)
+    {
+        ParallelPixelStreamSourceState & source = sources_[i];
+
+        if(source.displayPending != true)
         {
-            it++;
+            continue;
+        }
+
+        source.displayPending = false;
+
+        // frames without complete timestamps (e.g. re-decodes, or senders without capture timestamps) aren't measured
+        long long latency[STREAM_LATENCY_STAGES];
+
+        if(source.displayedTimestamps.getLatency(swapTimestamp, latency) == true)
+        {
+            metrics_->addLatency(latency);
+
+            std::copy(latency, latency + STREAM_LATENCY_STAGES, source.latency);
+            source.latencyValid = true;
         }
     }
 }
 
 void ParallelPixelStream::frameUpdated(int sourceIndex)
 {
-    static unsigned int numHistory = 30;
-
-    segmentsRenderTimes_[sourceIndex].push_back(QTime::currentTime());
+    RingBuffer<QTime> & renderTimes = sources_[sourceIndex].renderTimes;
 
-    // see if we need to remove an entry
-    while(segmentsRenderTimes_[sourceIndex].size() > numHistory)
+    // keep the latest PARALLEL_PIXEL_STREAM_STATISTICS_HISTORY entries
+    if(renderTimes.size() == renderTimes.capacity())
     {
-        segmentsRenderTimes_[sourceIndex].erase(segmentsRenderTimes_[sourceIndex].begin());
+        renderTimes.pop();
     }
+
+    renderTimes.push(QTime::currentTime());
 }
 
 std::string ParallelPixelStream::getStatistics(int sourceIndex)
 {
     QString result;
 
-    if(segmentsRenderTimes_[sourceIndex].size() > 0)
+    ParallelPixelStreamSourceState & source = sources_[sourceIndex];
+
+    if(source.renderTimes.size() > 0)
     {
-        float fps = (float)segmentsRenderTimes_[sourceIndex].size() / (float)segmentsRenderTimes_[sourceIndex].front().msecsTo(segmentsRenderTimes_[sourceIndex].back()) * 1000.;
+        float fps = (float)source.renderTimes.size() / (float)source.renderTimes.front().msecsTo(source.renderTimes.back()) * 1000.;
 
         result += QString::number(fps, 'g', 4);
         result += " fps";
     }
 
+    if(source.pixelStream != NULL)
+    {
+        result += QString(" ") + QString::number(source.pixelStream->getDecodeLatency()) + " ms, ";
+        result += QString::number(source.pixelStream->getDroppedFrameCount()) + " dropped";
+    }
+
+    if(source.latencyValid == true)
+    {
+        long long total = 0;
+
+        for(int i=0; i<STREAM_LATENCY_STAGES; i++)
+        {
+            total += source.latency[i];
+        }
+
+        result += QString(", latency ") + QString::number(total / 1000) + " ms (";
+
+        for(int i=0; i<STREAM_LATENCY_STAGES; i++)
+        {
+            result += QString(i > 0 ? ", " : "") + g_streamLatencyStageNames[i] + " " + QString::number(source.latency[i] / 1000);
+        }
+
+        result += ")";
+    }
+
+    if(source.overflowCount > 0)
+    {
+        result += QString(", ") + QString::number(source.overflowCount) + " overflowed";
+    }
+
+    if(syncState_.synchronizing == true)
+    {
+        result += QString(", sync frame ") + QString::number(syncState_.synchronizedFrameIndex) + ", " + QString::number(syncState_.waitCount) + " waits";
+    }
+
     return result.toStdString();
 }
 
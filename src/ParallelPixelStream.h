@@ -43,6 +43,8 @@
 #include "FactoryObject.h"
 #include "PixelStream.h"
 #include "Factory.hpp"
+#include "RingBuffer.h"
+#include "StreamMetrics.h"
 #include <QtGui>
 #include <boost/shared_ptr.hpp>
 #include <boost/archive/binary_oarchive.hpp>
@@ -53,6 +55,15 @@
 #include <map>
 #include <vector>
 
+// maximum number of queued segments per source index; the oldest are dropped beyond this
+#define PARALLEL_PIXEL_STREAM_QUEUE_CAPACITY 64
+
+// source indices must be less than this
+#define PARALLEL_PIXEL_STREAM_MAX_SOURCES 4096
+
+// number of frame update times kept per source index for the frame rate statistic
+#define PARALLEL_PIXEL_STREAM_STATISTICS_HISTORY 30
+
 // define serialize method separately from ParallelPixelStreamSegmentParameters definition
 // so other (external) code can more easily include that header
 namespace boost {
@@ -69,6 +80,8 @@ void serialize(Archive & ar, ParallelPixelStreamSegmentParameters & p, const uns
     ar & p.height;
     ar & p.totalWidth;
     ar & p.totalHeight;
+    ar & p.codec;
+    ar & p.captureTimestamp;
 }
 
 } // namespace serialization
@@ -82,6 +95,16 @@ struct ParallelPixelStreamSegment {
     // image data for segment
     QByteArray imageData;
 
+    // times the segment passed through the streaming pipeline, for latency measurement
+    StreamTimestamps timestamps;
+
+    // segments with valid parameters but no image data mark the segment as unchanged for their frame index
+    // (blank parameters, with zero total dimensions, mark the segment for deletion instead)
+    bool isUnchanged() const
+    {
+        return imageData.isEmpty() == true && parameters.totalWidth != 0 && parameters.totalHeight != 0;
+    }
+
     private:
         friend class boost::serialization::access;
 
@@ -89,6 +112,7 @@ struct ParallelPixelStreamSegment {
         void save(Archive & ar, const unsigned int) const
         {
             ar & parameters;
+            ar & timestamps;
 
             int size = imageData.size();
             ar & size;
@@ -100,6 +124,7 @@ struct ParallelPixelStreamSegment {
         void load(Archive & ar, const unsigned int)
         {
             ar & parameters;
+            ar & timestamps;
 
             int size;
             ar & size;
@@ -111,6 +136,74 @@ struct ParallelPixelStreamSegment {
         BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
+// swap without copying the image data, used when taking segments from queues
+inline void swap(ParallelPixelStreamSegment & a, ParallelPixelStreamSegment & b)
+{
+    std::swap(a.parameters, b.parameters);
+    qSwap(a.imageData, b.imageData);
+    std::swap(a.timestamps, b.timestamps);
+}
+
+// state for one source index of a ParallelPixelStream
+struct ParallelPixelStreamSourceState {
+
+    ParallelPixelStreamSourceState();
+
+    // whether parameters have been received for this source index
+    bool active;
+    ParallelPixelStreamSegmentParameters parameters;
+
+    // queued segments, oldest first
+    RingBuffer<ParallelPixelStreamSegment> segments;
+
+    // pixel stream object for image decoding
+    boost::shared_ptr<PixelStream> pixelStream;
+
+    // without a pixel stream (e.g. not visible), the latest segment received with image data
+    // unchanged segments are sent without image data, so this is used if the segment becomes visible
+    bool retained;
+    ParallelPixelStreamSegment retainedSegment;
+
+    // visible region of the segment on the screens of this process, normalized to (0,0,1,1) over the segment
+    // cached by ParallelPixelStream until the window, the segment layout, or the screens change
+    bool visibilityValid;
+    QRectF visibleRegion;
+
+    // statistics
+    RingBuffer<QTime> renderTimes;
+
+    // texture update count of the pixel stream when it was last rendered, to count displayed frames
+    long displayedTextureUpdateCount;
+
+    // timestamps of the frame last rendered; its latency is measured when the buffers are swapped
+    StreamTimestamps displayedTimestamps;
+    bool displayPending;
+
+    // latency of the last frame displayed, in microseconds per stage
+    bool latencyValid;
+    long long latency[STREAM_LATENCY_STAGES];
+
+    // segments dropped because the queue was full
+    long overflowCount;
+};
+
+// streaming synchronization state of a ParallelPixelStream, for diagnostics
+// local values are for this process; global values are reduced over all render processes
+struct ParallelPixelStreamSyncState {
+
+    bool synchronizing;
+
+    bool localDecodesPending;
+    int localLatestFrameIndex;
+
+    bool globalDecodesPending;
+    int globalLatestFrameIndex;
+
+    // last frame index shown, and the number of frames spent waiting for decodes
+    int synchronizedFrameIndex;
+    long waitCount;
+};
+
 class ParallelPixelStream : public FactoryObject {
 
     public:
@@ -122,18 +215,26 @@ class ParallelPixelStream : public FactoryObject {
 
         void insertSegment(ParallelPixelStreamSegment segment);
 
-        // retrieve latest segments and remove them (and older segments) from the map
+        // retrieve latest segments and remove them (and older segments) from the queues
         std::vector<ParallelPixelStreamSegment> getAndPopLatestSegments();
 
-        // retrieve all segments and clear the map
+        // retrieve all segments and clear the queues
         std::vector<ParallelPixelStreamSegment> getAndPopAllSegments();
 
-        // retrieve all segments for the given frame index and clear older entries in the map
+        // retrieve all segments for the given frame index and clear older entries in the queues
         std::vector<ParallelPixelStreamSegment> getAndPopSegments(int frameIndex);
 
         // update pixel streams corresponding to latest segments
+        // with streaming synchronization, this is deferred to synchronize()
         void updatePixelStreams();
 
+        // streaming synchronization, done once per frame for all streams by g_parallelPixelStreamSynchronizer
+        void getLocalSyncState(bool & synchronizing, bool & decodesPending, int & latestFrameIndex);
+        void synchronize(bool synchronizing, bool decodesPending, int latestFrameIndex);
+
+        // record the latency of frames rendered since the last call; swapTimestamp is the cluster time the buffers were swapped
+        void framesSwapped(long long swapTimestamp);
+
     private:
 
         // parallel pixel stream identifier
@@ -146,16 +247,35 @@ class ParallelPixelStream : public FactoryObject {
         // segments mutex
         QMutex segmentsMutex_;
 
-        // for each source, vector of pixel stream segments
-        // use a vector here since it may allow for easier frame synchronization later
-        std::map<int, std::vector<ParallelPixelStreamSegment> > segments_;
+        // state for each source index, indexed by source index
+        std::vector<ParallelPixelStreamSourceState> sources_;
+
+        // streaming synchronization state
+        ParallelPixelStreamSyncState syncState_;
+
+        // streaming metrics of this process, from g_streamMetrics
+        boost::shared_ptr<StreamMetricsCounters> metrics_;
+
+        // visibility of each source's segment on the screens of this process, one bit per source index
+        std::vector<bool> visibilityMask_;
+
+        // the display group, window, and screens the cached visibility is for
+        long visibilityReceivedCount_;
+        bool visibilityWindowFound_;
+        QRectF visibilityWindowRect_;
+        std::vector<QRectF> visibilityScreenRects_;
 
-        // for each source, pixel stream object for image decoding and parameters
-        std::map<int, boost::shared_ptr<PixelStream> > pixelStreams_;
-        std::map<int, ParallelPixelStreamSegmentParameters> pixelStreamParameters_;
+        // invalidate the cached visibility if the window or the screens changed
+        void updateVisibility();
 
         // determine if segment is visible on any of the screens of this process
-        bool isSegmentVisible(ParallelPixelStreamSegmentParameters parameters);
+        bool isSourceVisible(int sourceIndex);
+
+        // get the region of the segment visible on the screens of this process, normalized to (0,0,1,1) over the segment
+        // only this region needs to be decoded; empty if the segment is not visible
+        QRectF getSourceVisibleRegion(int sourceIndex);
+
+        void computeSourceVisibility(int sourceIndex);
 
         // get vector of source indices visible on any of the screens of this process
         std::vector<int> getSourceIndicesVisible();
@@ -163,11 +283,18 @@ class ParallelPixelStream : public FactoryObject {
         // get whether or not we have valid frame indices for all segments
         bool getValidFrameIndices();
 
-        // clear old / stale pixel streams from map
+        // clear old / stale pixel streams
         void clearStalePixelStreams();
 
-        // statistics
-        std::map<int, std::vector<QTime> > segmentsRenderTimes_;
+        // whether streaming synchronization is enabled and possible for this stream
+        bool getEnableStreamingSynchronization();
+
+        // decode segments, and update the regions of interest of all pixel streams
+        void processSegments(const std::vector<ParallelPixelStreamSegment> & segments, bool enableStreamingSynchronization);
+
+        // drop the given number of queued segments and take the next one
+        // an unchanged segment taken gets the image data of the latest changed segment dropped
+        void takeSegment(ParallelPixelStreamSourceState & source, int dropCount, ParallelPixelStreamSegment & segment);
 
         void frameUpdated(int sourceIndex);
         std::string getStatistics(int sourceIndex);
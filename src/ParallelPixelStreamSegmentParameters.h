@@ -36,14 +36,21 @@
 /* or implied, of The University of Texas at Austin.                 */
 /*********************************************************************/
 
+#ifndef PARALLEL_PIXEL_STREAM_SEGMENT_PARAMETERS_H
+#define PARALLEL_PIXEL_STREAM_SEGMENT_PARAMETERS_H
+
 #ifdef _WIN32
     typedef __int32 int32_t;
+    typedef __int64 int64_t;
 #else
     #include <stdint.h>
 #endif
 
 #define FRAME_INDEX_UNDEFINED -1
 
+// codecs used to encode segment image data
+enum PIXEL_STREAM_CODEC { PIXEL_STREAM_CODEC_JPEG=0, PIXEL_STREAM_CODEC_RAW=1, PIXEL_STREAM_CODEC_LZ4=2 };
+
 struct ParallelPixelStreamSegmentParameters {
 
     // source identifier
@@ -62,9 +69,23 @@ struct ParallelPixelStreamSegmentParameters {
     int32_t totalWidth;
     int32_t totalHeight;
 
+    // codec of the segment image data (PIXEL_STREAM_CODEC)
+    int32_t codec;
+
+    // explicit padding, so captureTimestamp has the same offset on all platforms
+    int32_t reserved;
+
+    // time the frame was captured, in microseconds since the epoch (UTC) on the sender's clock; 0 if unknown
+    int64_t captureTimestamp;
+
     ParallelPixelStreamSegmentParameters()
     {
         // defaults
         frameIndex = FRAME_INDEX_UNDEFINED;
+        codec = PIXEL_STREAM_CODEC_JPEG;
+        reserved = 0;
+        captureTimestamp = 0;
     }
 };
+
+#endif
@@ -0,0 +1,130 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "ParallelPixelStreamSynchronizer.h"
+#include "ParallelPixelStream.h"
+#include "main.h"
+
+// values per stream: whether the stream is synchronizing, whether no decodes are pending, and the latest frame index
+#define SYNC_VALUE_COUNT 3
+
+ParallelPixelStreamSynchronizer g_parallelPixelStreamSynchronizer;
+
+ParallelPixelStreamSynchronizer::ParallelPixelStreamSynchronizer()
+{
+    // defaults
+    reductionStarted_ = false;
+}
+
+void ParallelPixelStreamSynchronizer::addStream(std::string uri, boost::shared_ptr<ParallelPixelStream> parallelPixelStream)
+{
+    streams_[uri] = parallelPixelStream;
+}
+
+void ParallelPixelStreamSynchronizer::synchronize()
+{
+    // finish the reduction started last frame
+    if(reductionStarted_ == true)
+    {
+#if MPI_VERSION >= 3
+        MPI_Wait(&reductionRequest_, MPI_STATUS_IGNORE);
+#endif
+
+        for(unsigned int i=0; i<reductionStreams_.size(); i++)
+        {
+            int * values = &globalValues_[i * SYNC_VALUE_COUNT];
+
+            reductionStreams_[i]->synchronize(values[0] != 0, values[1] == 0, values[2]);
+        }
+
+        reductionStarted_ = false;
+    }
+
+    // gather the local state of all streams, including decodes started above
+    reductionStreams_.clear();
+
+    for(std::map<std::string, boost::shared_ptr<ParallelPixelStream> >::iterator it = streams_.begin(); it != streams_.end(); it++)
+    {
+        reductionStreams_.push_back((*it).second);
+    }
+
+    if(reductionStreams_.size() == 0)
+    {
+        return;
+    }
+
+    localValues_.resize(reductionStreams_.size() * SYNC_VALUE_COUNT);
+    globalValues_.resize(reductionStreams_.size() * SYNC_VALUE_COUNT);
+
+    for(unsigned int i=0; i<reductionStreams_.size(); i++)
+    {
+        int * values = &localValues_[i * SYNC_VALUE_COUNT];
+
+        bool synchronizing, decodesPending;
+        reductionStreams_[i]->getLocalSyncState(synchronizing, decodesPending, values[2]);
+
+        values[0] = (int)synchronizing;
+        values[1] = (int)(decodesPending != true);
+    }
+
+    // a stream synchronizes if it does so on all processes and no decodes are pending on any of them
+    // it then shows the minimum over all processes of the latest frame index available
+#if MPI_VERSION >= 3
+    MPI_Iallreduce((void *)&localValues_[0], (void *)&globalValues_[0], localValues_.size(), MPI_INT, MPI_MIN, g_mpiRenderComm, &reductionRequest_);
+#else
+    MPI_Allreduce((void *)&localValues_[0], (void *)&globalValues_[0], localValues_.size(), MPI_INT, MPI_MIN, g_mpiRenderComm);
+#endif
+
+    reductionStarted_ = true;
+}
+
+void ParallelPixelStreamSynchronizer::finalize()
+{
+#if MPI_VERSION >= 3
+    if(reductionStarted_ == true)
+    {
+        MPI_Wait(&reductionRequest_, MPI_STATUS_IGNORE);
+    }
+#endif
+
+    reductionStarted_ = false;
+
+    // release the streams before the main window is destroyed
+    streams_.clear();
+    reductionStreams_.clear();
+}
@@ -0,0 +1,85 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef PARALLEL_PIXEL_STREAM_SYNCHRONIZER_H
+#define PARALLEL_PIXEL_STREAM_SYNCHRONIZER_H
+
+#include <mpi.h>
+#include <boost/shared_ptr.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+class ParallelPixelStream;
+
+// synchronizes parallel pixel streams across the render processes with a single collective per frame.
+// the local synchronization state of all streams is reduced together; the reduction is started before rendering
+// and completed at the beginning of the next frame, so it overlaps with rendering.
+class ParallelPixelStreamSynchronizer {
+
+    public:
+
+        ParallelPixelStreamSynchronizer();
+
+        // streams must be added in the same order on all render processes, i.e. when their messages are received
+        void addStream(std::string uri, boost::shared_ptr<ParallelPixelStream> parallelPixelStream);
+
+        // called once per frame by all render processes
+        void synchronize();
+
+        // wait for the reduction in progress and release all streams
+        void finalize();
+
+    private:
+
+        // all streams ever added; parallel pixel streams are never deleted
+        std::map<std::string, boost::shared_ptr<ParallelPixelStream> > streams_;
+
+        // the streams, local values, and reduced values of the reduction in progress
+        // each stream has SYNC_VALUE_COUNT values, reduced with MPI_MIN
+        std::vector<boost::shared_ptr<ParallelPixelStream> > reductionStreams_;
+        std::vector<int> localValues_;
+        std::vector<int> globalValues_;
+
+        bool reductionStarted_;
+        MPI_Request reductionRequest_;
+};
+
+extern ParallelPixelStreamSynchronizer g_parallelPixelStreamSynchronizer;
+
+#endif
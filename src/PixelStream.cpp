@@ -37,6 +37,7 @@
 /*********************************************************************/
 
 #include "PixelStream.h"
+#include "PixelStreamDecoder.h"
 #include "main.h"
 #include "log.h"
 
@@ -47,14 +48,18 @@ PixelStream::PixelStream(std::string uri)
     textureWidth_ = 0;
     textureHeight_ = 0;
     textureBound_ = false;
+    textureRegion_ = QRectF(0.,0.,1.,1.);
     imageReady_ = false;
     autoUpdateTexture_ = true;
+    imageDataCodec_ = PIXEL_STREAM_CODEC_JPEG;
+    imageDataPending_ = false;
+    decodeScheduled_ = false;
+    droppedFrameCount_ = 0;
+    decodeLatency_ = 0;
+    textureUpdateCount_ = 0;
 
     // assign values
     uri_ = uri;
-
-    // initialize libjpeg-turbo handle
-    handle_ = tjInitDecompress();
 }
 
 PixelStream::~PixelStream()
@@ -67,9 +72,6 @@ PixelStream::~PixelStream()
 
         textureBound_ = false;
     }
-
-    // destroy libjpeg-turbo handle
-    tjDestroy(handle_);
 }
 
 void PixelStream::getDimensions(int &width, int &height)
@@ -103,19 +105,25 @@ bool PixelStream::render(float tX, float tY, float tW, float tH)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+    // the texture may only cover a region of the full image
+    float x = textureRegion_.x();
+    float y = textureRegion_.y();
+    float w = textureRegion_.width();
+    float h = textureRegion_.height();
+
     glBegin(GL_QUADS);
 
     glTexCoord2f(tX,tY);
-    glVertex2f(0.,0.);
+    glVertex2f(x,y);
 
     glTexCoord2f(tX+tW,tY);
-    glVertex2f(1.,0.);
+    glVertex2f(x+w,y);
 
     glTexCoord2f(tX+tW,tY+tH);
-    glVertex2f(1.,1.);
+    glVertex2f(x+w,y+h);
 
     glTexCoord2f(tX,tY+tH);
-    glVertex2f(0.,1.);
+    glVertex2f(x,y+h);
 
     glEnd();
 
@@ -124,22 +132,103 @@ bool PixelStream::render(float tX, float tY, float tW, float tH)
     return true;
 }
 
-bool PixelStream::setImageData(QByteArray imageData)
+bool PixelStream::setImageData(QByteArray imageData, QRectF regionOfInterest, int codec, StreamTimestamps timestamps)
 {
-    // drop frames if we're currently processing
-    if(loadImageDataThread_.isRunning() == true)
+    bool dropped = false;
+    bool scheduleDecode = false;
+
     {
-        return false;
+        QMutexLocker locker(&imageDataMutex_);
+
+        // latest wins: replace image data that hasn't been decoded yet
+        if(imageDataPending_ == true)
+        {
+            droppedFrameCount_++;
+            dropped = true;
+        }
+
+        imageData_ = imageData;
+        imageDataCodec_ = codec;
+        imageDataReceivedTime_.start();
+        imageDataTimestamps_ = timestamps;
+        imageDataPending_ = false;
+        decodedRegionOfInterest_ = QRectF();
+
+        // don't decode images that aren't visible; setRegionOfInterest() will decode it if that changes
+        if(regionOfInterest.isEmpty() != true)
+        {
+            imageDataPending_ = true;
+            imageDataRegionOfInterest_ = regionOfInterest;
+            decodedRegionOfInterest_ = regionOfInterest;
+
+            if(decodeScheduled_ == false)
+            {
+                decodeScheduled_ = true;
+                scheduleDecode = true;
+            }
+        }
     }
 
-    loadImageDataThread_ = QtConcurrent::run(loadImageDataThread, shared_from_this(), imageData);
+    if(dropped == true)
+    {
+        g_pixelStreamDecoder.frameDropped();
+    }
 
-    return true;
+    if(scheduleDecode == true)
+    {
+        g_pixelStreamDecoder.requestDecode(shared_from_this());
+    }
+
+    return !dropped;
+}
+
+void PixelStream::setRegionOfInterest(QRectF regionOfInterest)
+{
+    bool scheduleDecode = false;
+
+    {
+        QMutexLocker locker(&imageDataMutex_);
+
+        if(regionOfInterest.isEmpty() == true || imageData_.isNull() == true || decodedRegionOfInterest_.contains(regionOfInterest) == true)
+        {
+            return;
+        }
+
+        imageDataReceivedTime_.start();
+        imageDataPending_ = true;
+
+        // the image data was received long ago; don't count this decode as stream latency
+        imageDataTimestamps_ = StreamTimestamps();
+        imageDataRegionOfInterest_ = regionOfInterest;
+        decodedRegionOfInterest_ = regionOfInterest;
+
+        if(decodeScheduled_ == false)
+        {
+            decodeScheduled_ = true;
+            scheduleDecode = true;
+        }
+    }
+
+    if(scheduleDecode == true)
+    {
+        g_pixelStreamDecoder.requestDecode(shared_from_this());
+    }
+}
+
+QByteArray PixelStream::getImageData(int & codec)
+{
+    QMutexLocker locker(&imageDataMutex_);
+
+    codec = imageDataCodec_;
+
+    return imageData_;
 }
 
-bool PixelStream::getLoadImageDataThreadRunning()
+bool PixelStream::getImageDataPending()
 {
-    return loadImageDataThread_.isRunning();
+    QMutexLocker locker(&imageDataMutex_);
+
+    return decodeScheduled_;
 }
 
 void PixelStream::setAutoUpdateTexture(bool set)
@@ -155,24 +244,100 @@ void PixelStream::updateTextureIfAvailable()
     if(imageReady_ == true)
     {
         updateTexture(image_);
+        textureRegion_ = imageRegion_;
         imageReady_ = false;
+
+        textureTimestamps_ = imageTimestamps_;
+
+        if(textureTimestamps_.decoded != 0)
+        {
+            textureTimestamps_.uploaded = DisplayGroupManager::getClusterTimestamp();
+        }
     }
 }
 
-tjhandle PixelStream::getHandle()
+long PixelStream::getDroppedFrameCount()
 {
-    return handle_;
+    QMutexLocker locker(&imageDataMutex_);
+
+    return droppedFrameCount_;
 }
 
-void PixelStream::imageReady(QImage image)
+int PixelStream::getDecodeLatency()
 {
+    QMutexLocker locker(&imageDataMutex_);
+
+    return decodeLatency_;
+}
+
+long PixelStream::getTextureUpdateCount()
+{
+    return textureUpdateCount_;
+}
+
+StreamTimestamps PixelStream::getTextureTimestamps()
+{
+    return textureTimestamps_;
+}
+
+void PixelStream::setMetrics(boost::shared_ptr<StreamMetricsCounters> metrics)
+{
+    metrics_ = metrics;
+}
+
+bool PixelStream::takePendingImageData(QByteArray & imageData, int & codec, QRectF & regionOfInterest, QTime & receivedTime)
+{
+    QMutexLocker locker(&imageDataMutex_);
+
+    if(imageDataPending_ != true)
+    {
+        // the decode ends here; the next setImageData() will schedule a new one
+        decodeScheduled_ = false;
+        return false;
+    }
+
+    imageData = imageData_;
+    codec = imageDataCodec_;
+    regionOfInterest = imageDataRegionOfInterest_;
+    receivedTime = imageDataReceivedTime_;
+    decodingTimestamps_ = imageDataTimestamps_;
+
+    imageDataPending_ = false;
+
+    return true;
+}
+
+void PixelStream::imageReady(QImage image, QRectF imageRegion, int latency, long long decodeTime)
+{
+    StreamTimestamps timestamps;
+
+    {
+        QMutexLocker locker(&imageDataMutex_);
+        decodeLatency_ = latency;
+        timestamps = decodingTimestamps_;
+    }
+
+    if(timestamps.rankReceived != 0)
+    {
+        timestamps.decoded = DisplayGroupManager::getClusterTimestamp();
+    }
+
+    if(metrics_ != NULL)
+    {
+        metrics_->addDecode(decodeTime);
+    }
+
     QMutexLocker locker(&imageReadyMutex_);
     imageReady_ = true;
     image_ = image;
+    imageRegion_ = imageRegion;
+    imageTimestamps_ = timestamps;
 }
 
 void PixelStream::updateTexture(QImage & image)
 {
+    long long uploadStartTime = StreamMetrics::getTime();
+
     // todo: consider if the image has changed dimensions
 
     if(textureBound_ == false)
@@ -206,51 +371,11 @@ void PixelStream::updateTexture(QImage & image)
             glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0, image.width(), image.height(), GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
         }
     }
-}
-
-void loadImageDataThread(boost::shared_ptr<PixelStream> pixelStream, QByteArray imageData)
-{
-
-
-
-
-
-    // use libjpeg-turbo for JPEG conversion
-    tjhandle handle = pixelStream->getHandle();
-
-    // get information from header
-    int width, height, jpegSubsamp;
-    int success =  tjDecompressHeader2(handle, (unsigned char *)imageData.data(), (unsigned long)imageData.size(), &width, &height, &jpegSubsamp);
-
-    if(success != 0)
-    {
-        put_flog(LOG_ERROR, "libjpeg-turbo header decompression failure");
-        return;
-    }
-
-    // decompress image data
-    int pixelFormat = TJPF_BGRX;
-    int pitch = width * tjPixelSize[pixelFormat];
-    int flags = TJ_FASTUPSAMPLE;
-
-    QImage image = QImage(width, height, QImage::Format_RGB32);
 
-    success = tjDecompress2(handle, (unsigned char *)imageData.data(), (unsigned long)imageData.size(), (unsigned char *)image.scanLine(0), width, pitch, height, pixelFormat, flags);
+    textureUpdateCount_++;
 
-    if(success != 0)
+    if(metrics_ != NULL)
     {
-        put_flog(LOG_ERROR, "libjpeg-turbo image decompression failure");
-        return;
+        metrics_->addUpload(StreamMetrics::getTime() - uploadStartTime);
     }
-    /*
-    uint c = 0x0000ff00;
-    int width=64;
-    int height=64;
-    QImage image = QImage(width, height, QImage::Format_RGB32);
-    for (int i=0; i<height; i++) {
-        for (int j=0; j<height; j++)
-            image.setPixel(i,j,c);
-    }*/
-
-    pixelStream->imageReady(image);
 }
@@ -40,10 +40,11 @@
 #define PIXEL_STREAM_H
 
 #include "FactoryObject.h"
+#include "ParallelPixelStreamSegmentParameters.h"
+#include "StreamMetrics.h"
 #include <boost/enable_shared_from_this.hpp>
+#include <QtGui>
 #include <QGLWidget>
-#include <QtConcurrentRun>
-#include <turbojpeg.h>
 
 class PixelStream : public boost::enable_shared_from_this<PixelStream>, public FactoryObject {
 
@@ -54,14 +55,25 @@ class PixelStream : public boost::enable_shared_from_this<PixelStream>, public F
 
         void getDimensions(int &width, int &height);
         bool render(float tX, float tY, float tW, float tH); // return true on successful render; false if no texture available
-        bool setImageData(QByteArray imageData); // returns true if load image thread was spawned; false if frame was dropped
-        bool getLoadImageDataThreadRunning();
+        // regionOfInterest is the part of the image, normalized to (0,0,1,1), that needs to be decoded; nothing is decoded if it is empty
+        // codec is the PIXEL_STREAM_CODEC of the image data; timestamps are carried through decode and upload for latency measurement
+        bool setImageData(QByteArray imageData, QRectF regionOfInterest=QRectF(0.,0.,1.,1.), int codec=PIXEL_STREAM_CODEC_JPEG, StreamTimestamps timestamps=StreamTimestamps()); // returns true if queued for decoding; false if an older undecoded frame was dropped in its place
+        void setRegionOfInterest(QRectF regionOfInterest); // decode the last image data again if it was decoded for a region not covering regionOfInterest
+        bool getImageDataPending(); // true while image data is queued or being decoded
+        QByteArray getImageData(int & codec); // the latest image data received, and its codec
         void setAutoUpdateTexture(bool set);
         void updateTextureIfAvailable();
 
-        // for use by loadImageDataThread()
-        tjhandle getHandle();
-        void imageReady(QImage image);
+        // statistics
+        long getDroppedFrameCount();
+        int getDecodeLatency(); // milliseconds from receipt of image data to decoded image, for the last decoded frame
+        long getTextureUpdateCount();
+        StreamTimestamps getTextureTimestamps(); // timestamps of the image data in the current texture; zero for re-decodes
+        void setMetrics(boost::shared_ptr<StreamMetricsCounters> metrics); // decode and upload times are added to these counters; set before image data
+
+        // for use by the decoder worker threads
+        bool takePendingImageData(QByteArray & imageData, int & codec, QRectF & regionOfInterest, QTime & receivedTime); // returns false and ends the decode if nothing is pending
+        void imageReady(QImage image, QRectF imageRegion, int latency, long long decodeTime); // decodeTime in microseconds
 
     private:
 
@@ -72,18 +84,46 @@ class PixelStream : public boost::enable_shared_from_this<PixelStream>, public F
         GLuint textureId_;
         int textureWidth_;
         int textureHeight_;
+
+        // region of the full image covered by the texture, normalized to (0,0,1,1)
+        QRectF textureRegion_;
         bool textureBound_;
 
-        // thread for generating images from image data
-        QFuture<void> loadImageDataThread_;
+        // latest image data and its mutex; it is kept after decoding in case a different region is needed later
+        QMutex imageDataMutex_;
+        QByteArray imageData_;
+        int imageDataCodec_;
+        QTime imageDataReceivedTime_;
+        StreamTimestamps imageDataTimestamps_;
+
+        // timestamps of the image data being decoded
+        StreamTimestamps decodingTimestamps_;
+
+        // image data is waiting to be decoded by g_pixelStreamDecoder, for the given region
+        bool imageDataPending_;
+        QRectF imageDataRegionOfInterest_;
 
-        // libjpeg-turbo handle for decompression
-        tjhandle handle_;
+        // region of the latest image data that was (or is being) decoded
+        QRectF decodedRegionOfInterest_;
+
+        // a decode is queued or running for this stream
+        bool decodeScheduled_;
+
+        // statistics
+        long droppedFrameCount_;
+        int decodeLatency_;
+        long textureUpdateCount_;
+        boost::shared_ptr<StreamMetricsCounters> metrics_;
 
         // image, mutex, and ready status
         QMutex imageReadyMutex_;
         bool imageReady_;
         QImage image_;
+        QRectF imageRegion_;
+        StreamTimestamps imageTimestamps_;
+
+        // timestamps of the texture
+        StreamTimestamps textureTimestamps_;
 
         // whether updateTexture() should be called automatically every render() or not
         // this can be set to false to allow for synchronization across multiple streams, for example.
@@ -92,6 +132,4 @@ class PixelStream : public boost::enable_shared_from_this<PixelStream>, public F
         void updateTexture(QImage & image);
 };
 
-extern void loadImageDataThread(boost::shared_ptr<PixelStream> pixelStream, QByteArray imageData);
-
 #endif
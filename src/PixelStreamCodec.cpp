@@ -0,0 +1,277 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "PixelStreamCodec.h"
+#include "log.h"
+#include <math.h>
+#include <string.h>
+#include <turbojpeg.h>
+#include <lz4.h>
+
+// sample every nth pixel of every nth line for the entropy estimate
+#define PIXEL_STREAM_CODEC_ENTROPY_SAMPLE_STEP 4
+
+float pixelStreamComputeEntropy(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat)
+{
+    int bytesPerPixel = tjPixelSize[tjPixelFormat];
+    int redOffset = tjRedOffset[tjPixelFormat];
+    int greenOffset = tjGreenOffset[tjPixelFormat];
+    int blueOffset = tjBlueOffset[tjPixelFormat];
+
+    // histogram of colors quantized to 4 bits per channel
+    int histogram[4096];
+    memset(histogram, 0, sizeof(histogram));
+
+    int count = 0;
+
+    for(int j=0; j<height; j+=PIXEL_STREAM_CODEC_ENTROPY_SAMPLE_STEP)
+    {
+        const unsigned char * line = imageBuffer + j*pitch;
+
+        for(int i=0; i<width; i+=PIXEL_STREAM_CODEC_ENTROPY_SAMPLE_STEP)
+        {
+            const unsigned char * pixel = line + i*bytesPerPixel;
+
+            histogram[((pixel[redOffset] >> 4) << 8) | ((pixel[greenOffset] >> 4) << 4) | (pixel[blueOffset] >> 4)]++;
+            count++;
+        }
+    }
+
+    if(count == 0)
+    {
+        return 0.;
+    }
+
+    float entropy = 0.;
+
+    for(int i=0; i<4096; i++)
+    {
+        if(histogram[i] > 0)
+        {
+            float p = (float)histogram[i] / (float)count;
+            entropy -= p * log2f(p);
+        }
+    }
+
+    return entropy;
+}
+
+PIXEL_STREAM_CODEC pixelStreamChooseCodec(float entropy, int width, int height, float bandwidth, float frameRate)
+{
+    if(entropy < PIXEL_STREAM_CODEC_LZ4_MAX_ENTROPY)
+    {
+        return PIXEL_STREAM_CODEC_LZ4;
+    }
+
+    // megabits per second needed to send the image uncompressed
+    float rawBandwidth = (float)width * (float)height * (float)(PIXEL_STREAM_CODEC_BYTES_PER_PIXEL * 8) * frameRate / 1000000.;
+
+    if(bandwidth > 0. && frameRate > 0. && rawBandwidth <= bandwidth)
+    {
+        return PIXEL_STREAM_CODEC_RAW;
+    }
+
+    return PIXEL_STREAM_CODEC_JPEG;
+}
+
+// copy the image to top-down BGRX pixels at pixels
+static void pixelStreamConvertImage(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, unsigned char * pixels)
+{
+    int bytesPerPixel = tjPixelSize[tjPixelFormat];
+    int redOffset = tjRedOffset[tjPixelFormat];
+    int greenOffset = tjGreenOffset[tjPixelFormat];
+    int blueOffset = tjBlueOffset[tjPixelFormat];
+
+    int lineSize = width * PIXEL_STREAM_CODEC_BYTES_PER_PIXEL;
+
+    for(int j=0; j<height; j++)
+    {
+        const unsigned char * line = imageBuffer + (bottomUp == true ? height-1-j : j) * pitch;
+        unsigned char * outLine = pixels + j*lineSize;
+
+        if(tjPixelFormat == TJPF_BGRX || tjPixelFormat == TJPF_BGRA)
+        {
+            memcpy(outLine, line, lineSize);
+            continue;
+        }
+
+        for(int i=0; i<width; i++)
+        {
+            outLine[4*i] = line[i*bytesPerPixel + blueOffset];
+            outLine[4*i + 1] = line[i*bytesPerPixel + greenOffset];
+            outLine[4*i + 2] = line[i*bytesPerPixel + redOffset];
+            outLine[4*i + 3] = 255;
+        }
+    }
+}
+
+// per-thread buffers for converting images before LZ4 compression, reused so encoding doesn't allocate
+static QThreadStorage<QByteArray *> g_pixelStreamCodecScratchBuffers;
+
+int pixelStreamGetMaxEncodedSize(int codec, int width, int height)
+{
+    int rawSize = width * height * PIXEL_STREAM_CODEC_BYTES_PER_PIXEL;
+
+    if(codec == PIXEL_STREAM_CODEC_LZ4)
+    {
+        return sizeof(PixelStreamCodecHeader) + LZ4_compressBound(rawSize);
+    }
+
+    return sizeof(PixelStreamCodecHeader) + rawSize;
+}
+
+int pixelStreamEncodeRaw(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, char * imageData, int imageDataCapacity)
+{
+    if(width <= 0 || height <= 0)
+    {
+        put_flog(LOG_ERROR, "invalid image dimensions %i x %i", width, height);
+        return 0;
+    }
+
+    int size = pixelStreamGetMaxEncodedSize(PIXEL_STREAM_CODEC_RAW, width, height);
+
+    if(size > imageDataCapacity)
+    {
+        put_flog(LOG_ERROR, "image data buffer too small");
+        return 0;
+    }
+
+    PixelStreamCodecHeader header;
+    header.width = width;
+    header.height = height;
+
+    memcpy(imageData, &header, sizeof(PixelStreamCodecHeader));
+
+    pixelStreamConvertImage(imageBuffer, width, pitch, height, tjPixelFormat, bottomUp, (unsigned char *)imageData + sizeof(PixelStreamCodecHeader));
+
+    return size;
+}
+
+int pixelStreamEncodeLz4(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, char * imageData, int imageDataCapacity)
+{
+    if(width <= 0 || height <= 0)
+    {
+        put_flog(LOG_ERROR, "invalid image dimensions %i x %i", width, height);
+        return 0;
+    }
+
+    if(imageDataCapacity < (int)sizeof(PixelStreamCodecHeader))
+    {
+        put_flog(LOG_ERROR, "image data buffer too small");
+        return 0;
+    }
+
+    int rawSize = width * height * PIXEL_STREAM_CODEC_BYTES_PER_PIXEL;
+
+    // top-down BGRX images can be compressed in place; others are converted first
+    const char * pixels = (const char *)imageBuffer;
+
+    if((tjPixelFormat != TJPF_BGRX && tjPixelFormat != TJPF_BGRA) || bottomUp == true || pitch != width * PIXEL_STREAM_CODEC_BYTES_PER_PIXEL)
+    {
+        if(g_pixelStreamCodecScratchBuffers.hasLocalData() != true)
+        {
+            g_pixelStreamCodecScratchBuffers.setLocalData(new QByteArray());
+        }
+
+        QByteArray * scratchBuffer = g_pixelStreamCodecScratchBuffers.localData();
+
+        if(scratchBuffer->size() < rawSize)
+        {
+            scratchBuffer->resize(rawSize);
+        }
+
+        pixelStreamConvertImage(imageBuffer, width, pitch, height, tjPixelFormat, bottomUp, (unsigned char *)scratchBuffer->data());
+
+        pixels = scratchBuffer->constData();
+    }
+
+    PixelStreamCodecHeader header;
+    header.width = width;
+    header.height = height;
+
+    memcpy(imageData, &header, sizeof(PixelStreamCodecHeader));
+
+    int compressedSize = LZ4_compress_default(pixels, imageData + sizeof(PixelStreamCodecHeader), rawSize, imageDataCapacity - (int)sizeof(PixelStreamCodecHeader));
+
+    if(compressedSize <= 0)
+    {
+        put_flog(LOG_ERROR, "LZ4 compression failure");
+        return 0;
+    }
+
+    return sizeof(PixelStreamCodecHeader) + compressedSize;
+}
+
+bool pixelStreamEncodeRaw(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, QByteArray & imageData)
+{
+    imageData.resize(pixelStreamGetMaxEncodedSize(PIXEL_STREAM_CODEC_RAW, width, height));
+
+    int size = pixelStreamEncodeRaw(imageBuffer, width, pitch, height, tjPixelFormat, bottomUp, imageData.data(), imageData.size());
+
+    imageData.resize(size);
+
+    return size > 0;
+}
+
+bool pixelStreamEncodeLz4(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, QByteArray & imageData)
+{
+    imageData.resize(pixelStreamGetMaxEncodedSize(PIXEL_STREAM_CODEC_LZ4, width, height));
+
+    int size = pixelStreamEncodeLz4(imageBuffer, width, pitch, height, tjPixelFormat, bottomUp, imageData.data(), imageData.size());
+
+    imageData.resize(size);
+
+    return size > 0;
+}
+
+bool pixelStreamDecodeHeader(const QByteArray & imageData, int & width, int & height)
+{
+    if(imageData.size() < (int)sizeof(PixelStreamCodecHeader))
+    {
+        return false;
+    }
+
+    PixelStreamCodecHeader header;
+    memcpy(&header, imageData.constData(), sizeof(PixelStreamCodecHeader));
+
+    width = header.width;
+    height = header.height;
+
+    // limit dimensions so the decoded size can't overflow
+    return width > 0 && height > 0 && width <= 16384 && height <= 16384;
+}
@@ -0,0 +1,82 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef PIXEL_STREAM_CODEC_H
+#define PIXEL_STREAM_CODEC_H
+
+#include "ParallelPixelStreamSegmentParameters.h"
+#include <QtCore>
+
+// segments with a color entropy below this (bits per pixel, see pixelStreamComputeEntropy()) are encoded losslessly with LZ4
+// flat UI, text, and plots are well below this; photographic content and video are well above
+#define PIXEL_STREAM_CODEC_LZ4_MAX_ENTROPY 4.
+
+// bytes per pixel of RAW and (decompressed) LZ4 image data
+#define PIXEL_STREAM_CODEC_BYTES_PER_PIXEL 4
+
+// RAW and LZ4 image data begins with this header, followed by top-down BGRX pixels (compressed for LZ4)
+struct PixelStreamCodecHeader {
+    int32_t width;
+    int32_t height;
+};
+
+// Shannon entropy of the colors of an image in bits per pixel, from a sampled histogram of colors quantized to 4 bits per
+// channel; between 0 (a single color) and 12. tjPixelFormat is a libjpeg-turbo TJPF_* value.
+float pixelStreamComputeEntropy(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat);
+
+// choose a codec for an image of width x height with the given entropy: LZ4 for low-entropy content, RAW if the
+// uncompressed image fits in bandwidth (megabits per second) at frameRate, and JPEG otherwise. RAW is never chosen if
+// bandwidth or frameRate is 0.
+PIXEL_STREAM_CODEC pixelStreamChooseCodec(float entropy, int width, int height, float bandwidth, float frameRate);
+
+// the largest size of encoded RAW or LZ4 image data for an image of width x height
+int pixelStreamGetMaxEncodedSize(int codec, int width, int height);
+
+// encode an image as RAW or LZ4 image data. bottomUp indicates the first line of imageBuffer is the bottom of the image.
+// these encode into an existing buffer of imageDataCapacity bytes, and return the size of the image data or 0 on failure.
+int pixelStreamEncodeRaw(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, char * imageData, int imageDataCapacity);
+int pixelStreamEncodeLz4(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, char * imageData, int imageDataCapacity);
+
+// the same as above, but encode into imageData, resizing it as needed
+bool pixelStreamEncodeRaw(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, QByteArray & imageData);
+bool pixelStreamEncodeLz4(const unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, bool bottomUp, QByteArray & imageData);
+
+// decode the header of RAW or LZ4 image data; returns false if the image data is invalid
+bool pixelStreamDecodeHeader(const QByteArray & imageData, int & width, int & height);
+
+#endif
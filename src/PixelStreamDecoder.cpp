@@ -0,0 +1,395 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "PixelStreamDecoder.h"
+#include "PixelStream.h"
+#include "PixelStreamCodec.h"
+#include "main.h"
+#include "log.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <turbojpeg.h>
+#include <lz4.h>
+
+PixelStreamDecoder g_pixelStreamDecoder;
+
+// libjpeg-turbo handle owned by a worker thread; destroyed when the thread exits
+// a transform handle is used so images can be cropped; it can also be used for decompression
+class PixelStreamDecodeHandle {
+
+    public:
+
+        PixelStreamDecodeHandle()
+        {
+            handle_ = tjInitTransform();
+        }
+
+        ~PixelStreamDecodeHandle()
+        {
+            tjDestroy(handle_);
+        }
+
+        tjhandle getHandle()
+        {
+            return handle_;
+        }
+
+    private:
+
+        tjhandle handle_;
+};
+
+// per-thread decompression handles
+static QThreadStorage<PixelStreamDecodeHandle *> g_pixelStreamDecodeHandles;
+
+static bool decodeLosslessImageData(QByteArray & imageData, int codec, QRectF regionOfInterest, QImage & image, QRectF & imageRegion)
+{
+    int width, height;
+
+    if(pixelStreamDecodeHeader(imageData, width, height) != true)
+    {
+        put_flog(LOG_ERROR, "invalid image data header");
+        return false;
+    }
+
+    int lineSize = width * PIXEL_STREAM_CODEC_BYTES_PER_PIXEL;
+
+    // the uncompressed top-down BGRX pixels
+    const char * pixels = imageData.constData() + sizeof(PixelStreamCodecHeader);
+
+    QByteArray decompressedPixels;
+
+    if(codec == PIXEL_STREAM_CODEC_LZ4)
+    {
+        // LZ4 data can't be decompressed partially, so the whole image is decompressed
+        decompressedPixels.resize(lineSize * height);
+
+        int size = LZ4_decompress_safe(pixels, decompressedPixels.data(), imageData.size() - sizeof(PixelStreamCodecHeader), decompressedPixels.size());
+
+        if(size != decompressedPixels.size())
+        {
+            put_flog(LOG_ERROR, "LZ4 decompression failure");
+            return false;
+        }
+
+        pixels = decompressedPixels.constData();
+    }
+    else if(imageData.size() != (int)sizeof(PixelStreamCodecHeader) + lineSize * height)
+    {
+        put_flog(LOG_ERROR, "invalid raw image data size");
+        return false;
+    }
+
+    // region of interest in pixels; no alignment is needed
+    int x0 = std::max((int)floor(regionOfInterest.left() * (double)width), 0);
+    int y0 = std::max((int)floor(regionOfInterest.top() * (double)height), 0);
+    int x1 = std::min((int)ceil(regionOfInterest.right() * (double)width), width);
+    int y1 = std::min((int)ceil(regionOfInterest.bottom() * (double)height), height);
+
+    if(x1 <= x0 || y1 <= y0)
+    {
+        return false;
+    }
+
+    // the pixels are already in the QImage::Format_RGB32 memory layout
+    image = QImage(x1 - x0, y1 - y0, QImage::Format_RGB32);
+
+    for(int j=y0; j<y1; j++)
+    {
+        memcpy(image.scanLine(j - y0), pixels + j*lineSize + x0*PIXEL_STREAM_CODEC_BYTES_PER_PIXEL, (x1 - x0) * PIXEL_STREAM_CODEC_BYTES_PER_PIXEL);
+    }
+
+    imageRegion = QRectF((double)x0 / (double)width, (double)y0 / (double)height, (double)(x1 - x0) / (double)width, (double)(y1 - y0) / (double)height);
+
+    return true;
+}
+
+static bool decodeImageData(QByteArray & imageData, int codec, QRectF regionOfInterest, QImage & image, QRectF & imageRegion)
+{
+    if(codec == PIXEL_STREAM_CODEC_RAW || codec == PIXEL_STREAM_CODEC_LZ4)
+    {
+        return decodeLosslessImageData(imageData, codec, regionOfInterest, image, imageRegion);
+    }
+    else if(codec != PIXEL_STREAM_CODEC_JPEG)
+    {
+        put_flog(LOG_ERROR, "unknown codec %i", codec);
+        return false;
+    }
+
+    if(g_pixelStreamDecodeHandles.hasLocalData() != true)
+    {
+        g_pixelStreamDecodeHandles.setLocalData(new PixelStreamDecodeHandle());
+    }
+
+    // use libjpeg-turbo for JPEG conversion
+    tjhandle handle = g_pixelStreamDecodeHandles.localData()->getHandle();
+
+    // get information from header
+    int width, height, jpegSubsamp;
+    int success = tjDecompressHeader2(handle, (unsigned char *)imageData.data(), (unsigned long)imageData.size(), &width, &height, &jpegSubsamp);
+
+    if(success != 0)
+    {
+        put_flog(LOG_ERROR, "libjpeg-turbo header decompression failure");
+        return false;
+    }
+
+    // region of interest in pixels, expanded to MCU boundaries since the JPEG can only be cropped on those
+    int mcuWidth = tjMCUWidth[jpegSubsamp];
+    int mcuHeight = tjMCUHeight[jpegSubsamp];
+
+    int x0 = std::max((int)floor(regionOfInterest.left() * (double)width), 0) / mcuWidth * mcuWidth;
+    int y0 = std::max((int)floor(regionOfInterest.top() * (double)height), 0) / mcuHeight * mcuHeight;
+    int x1 = std::min(((int)ceil(regionOfInterest.right() * (double)width) + mcuWidth - 1) / mcuWidth * mcuWidth, width);
+    int y1 = std::min(((int)ceil(regionOfInterest.bottom() * (double)height) + mcuHeight - 1) / mcuHeight * mcuHeight, height);
+
+    if(x1 <= x0 || y1 <= y0)
+    {
+        return false;
+    }
+
+    // the JPEG to decompress; either the original image data or a cropped copy
+    unsigned char * jpegBuf = (unsigned char *)imageData.data();
+    unsigned long jpegSize = (unsigned long)imageData.size();
+
+    unsigned char * croppedJpegBuf = NULL;
+
+    if(x0 != 0 || y0 != 0 || x1 != width || y1 != height)
+    {
+        // lossless crop; this skips the inverse DCT, upsampling, and color conversion for the rest of the image
+        tjtransform transform;
+        memset(&transform, 0, sizeof(tjtransform));
+
+        transform.r.x = x0;
+        transform.r.y = y0;
+        transform.r.w = x1 - x0;
+        transform.r.h = y1 - y0;
+        transform.op = TJXOP_NONE;
+        transform.options = TJXOPT_CROP;
+
+        unsigned long croppedJpegSize = 0;
+
+        success = tjTransform(handle, jpegBuf, jpegSize, 1, &croppedJpegBuf, &croppedJpegSize, &transform, 0);
+
+        if(success != 0)
+        {
+            put_flog(LOG_ERROR, "libjpeg-turbo crop failure: %s", tjGetErrorStr());
+            return false;
+        }
+
+        jpegBuf = croppedJpegBuf;
+        jpegSize = croppedJpegSize;
+    }
+
+    // decompress image data
+    int decodeWidth = x1 - x0;
+    int decodeHeight = y1 - y0;
+
+    int pixelFormat = TJPF_BGRX;
+    int pitch = decodeWidth * tjPixelSize[pixelFormat];
+    int flags = TJ_FASTUPSAMPLE;
+
+    image = QImage(decodeWidth, decodeHeight, QImage::Format_RGB32);
+
+    success = tjDecompress2(handle, jpegBuf, jpegSize, (unsigned char *)image.scanLine(0), decodeWidth, pitch, decodeHeight, pixelFormat, flags);
+
+    if(croppedJpegBuf != NULL)
+    {
+        tjFree(croppedJpegBuf);
+    }
+
+    if(success != 0)
+    {
+        put_flog(LOG_ERROR, "libjpeg-turbo image decompression failure");
+        return false;
+    }
+
+    imageRegion = QRectF((double)x0 / (double)width, (double)y0 / (double)height, (double)decodeWidth / (double)width, (double)decodeHeight / (double)height);
+
+    return true;
+}
+
+class PixelStreamDecodeRunnable : public QRunnable {
+
+    public:
+
+        PixelStreamDecodeRunnable(PixelStreamDecoder * decoder, boost::shared_ptr<PixelStream> pixelStream)
+        {
+            decoder_ = decoder;
+            pixelStream_ = pixelStream;
+        }
+
+        void run()
+        {
+            // don't keep the pixel stream alive while queued; it may be deleted by its factory in the meantime
+            boost::shared_ptr<PixelStream> pixelStream = pixelStream_.lock();
+
+            if(pixelStream == NULL)
+            {
+                return;
+            }
+
+            // decode until no newer image data is pending for this stream
+            QByteArray imageData;
+            int codec;
+            QRectF regionOfInterest;
+            QTime receivedTime;
+
+            while(pixelStream->takePendingImageData(imageData, codec, regionOfInterest, receivedTime) == true)
+            {
+                QImage image;
+                QRectF imageRegion;
+
+                QTime decodeTime;
+                decodeTime.start();
+
+                long long decodeStartTime = StreamMetrics::getTime();
+
+                if(decodeImageData(imageData, codec, regionOfInterest, image, imageRegion) == true)
+                {
+                    int latency = receivedTime.elapsed();
+
+                    pixelStream->imageReady(image, imageRegion, latency, StreamMetrics::getTime() - decodeStartTime);
+                    decoder_->decodeFinished(latency, image.width() * image.height(), decodeTime.elapsed());
+                }
+            }
+        }
+
+    private:
+
+        PixelStreamDecoder * decoder_;
+        boost::weak_ptr<PixelStream> pixelStream_;
+};
+
+PixelStreamDecoder::PixelStreamDecoder()
+{
+    // defaults
+    decodedFrameCount_ = 0;
+    droppedFrameCount_ = 0;
+    totalDecodeLatency_ = 0;
+    maxDecodeLatency_ = 0;
+    decodedPixelCount_ = 0;
+    totalDecodeTime_ = 0;
+
+    // use all cores; segments of a frame should all decode at once
+    threadPool_.setMaxThreadCount(QThread::idealThreadCount());
+
+    // keep the worker threads (and their decompression handles) alive between frames
+    threadPool_.setExpiryTimeout(-1);
+}
+
+void PixelStreamDecoder::requestDecode(boost::shared_ptr<PixelStream> pixelStream)
+{
+    threadPool_.start(new PixelStreamDecodeRunnable(this, pixelStream));
+}
+
+void PixelStreamDecoder::finalize()
+{
+    threadPool_.waitForDone();
+
+    put_flog(LOG_INFO, "decoded %i frames, dropped %i frames, average latency %i ms, max latency %i ms", (int)getDecodedFrameCount(), (int)getDroppedFrameCount(), getAverageDecodeLatency(), getMaxDecodeLatency());
+
+    // decode work of this process; segments crossing screen boundaries are decoded by each process showing them
+    put_flog(LOG_INFO, "rank %i decode work: %i megapixels, %i ms", g_mpiRank, (int)(getDecodedPixelCount() / 1000000), (int)getDecodeTime());
+}
+
+long PixelStreamDecoder::getDecodedFrameCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    return decodedFrameCount_;
+}
+
+long PixelStreamDecoder::getDroppedFrameCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    return droppedFrameCount_;
+}
+
+int PixelStreamDecoder::getAverageDecodeLatency()
+{
+    QMutexLocker locker(&mutex_);
+
+    if(decodedFrameCount_ == 0)
+    {
+        return 0;
+    }
+
+    return (int)(totalDecodeLatency_ / decodedFrameCount_);
+}
+
+int PixelStreamDecoder::getMaxDecodeLatency()
+{
+    QMutexLocker locker(&mutex_);
+
+    return maxDecodeLatency_;
+}
+
+long PixelStreamDecoder::getDecodedPixelCount()
+{
+    QMutexLocker locker(&mutex_);
+
+    return decodedPixelCount_;
+}
+
+long PixelStreamDecoder::getDecodeTime()
+{
+    QMutexLocker locker(&mutex_);
+
+    return totalDecodeTime_;
+}
+
+void PixelStreamDecoder::decodeFinished(int latency, int pixels, int decodeTime)
+{
+    QMutexLocker locker(&mutex_);
+
+    decodedFrameCount_++;
+    totalDecodeLatency_ += latency;
+    maxDecodeLatency_ = std::max(maxDecodeLatency_, latency);
+    decodedPixelCount_ += pixels;
+    totalDecodeTime_ += decodeTime;
+}
+
+void PixelStreamDecoder::frameDropped()
+{
+    QMutexLocker locker(&mutex_);
+
+    droppedFrameCount_++;
+}
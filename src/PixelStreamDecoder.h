@@ -0,0 +1,96 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef PIXEL_STREAM_DECODER_H
+#define PIXEL_STREAM_DECODER_H
+
+#include <QtGui>
+#include <boost/shared_ptr.hpp>
+
+class PixelStream;
+
+// decodes pixel stream image data (JPEG, or RAW / LZ4 for lossless segments) on a dedicated thread pool using all cores, so stream decoding doesn't compete with
+// DynamicTexture loads. each worker thread owns its own libjpeg-turbo handle. a PixelStream is decoded by at most one
+// worker at a time; frames arriving while a decode is queued replace the queued frame (latest wins), so stale frames
+// are never decoded. segments of a parallel pixel stream are independent PixelStream objects and decode in parallel.
+class PixelStreamDecoder {
+
+    public:
+
+        PixelStreamDecoder();
+
+        // schedule decoding of the pixel stream's pending image data, if not already scheduled
+        void requestDecode(boost::shared_ptr<PixelStream> pixelStream);
+
+        // wait for all running decodes to finish
+        void finalize();
+
+        // statistics
+        long getDecodedFrameCount();
+        long getDroppedFrameCount();
+        int getAverageDecodeLatency(); // milliseconds from receipt of image data to decoded image
+        int getMaxDecodeLatency();
+
+        // decode work: pixels decoded, and milliseconds spent decoding by all worker threads
+        long getDecodedPixelCount();
+        long getDecodeTime();
+
+        // called by the worker threads
+        void decodeFinished(int latency, int pixels, int decodeTime);
+        void frameDropped();
+
+    private:
+
+        // mutex protecting the statistics
+        QMutex mutex_;
+
+        // dedicated thread pool
+        QThreadPool threadPool_;
+
+        // statistics
+        long decodedFrameCount_;
+        long droppedFrameCount_;
+        long totalDecodeLatency_;
+        int maxDecodeLatency_;
+        long decodedPixelCount_;
+        long totalDecodeTime_;
+};
+
+extern PixelStreamDecoder g_pixelStreamDecoder;
+
+#endif
@@ -0,0 +1,130 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "PixelStreamSegmentation.h"
+#include <algorithm>
+#include <math.h>
+
+// boundaries of the segments along one dimension of the range [start, end) of a stream image of totalSize pixels, shown
+// at windowPosition with windowSize in tiled display space, zoomed by zoom around center (in image space)
+static std::vector<int> pixelStreamComputeBoundaries(int numTiles, int screenSize, int mullionSize, double windowPosition, double windowSize, double zoom, double center, int nominalSegmentSize, int start, int end, int totalSize)
+{
+    // screen boundaries within the range
+    std::vector<int> cuts;
+    cuts.push_back(start);
+
+    double wallSize = (double)(numTiles * screenSize + (numTiles - 1) * mullionSize);
+
+    if(numTiles > 1 && wallSize > 0. && windowSize > 0. && zoom > 0. && totalSize > 0)
+    {
+        // the window shows the part of the image from imageStart, 1/zoom of the image wide (see Content::render())
+        double imageStart = center - 0.5 / zoom;
+
+        for(int i=1; i<numTiles; i++)
+        {
+            // center of the mullion before screen i, in tiled display space
+            double boundary = ((double)(i * (screenSize + mullionSize)) - 0.5 * (double)mullionSize) / wallSize;
+
+            // in stream image pixels
+            int cut = (int)floor((imageStart + (boundary - windowPosition) / (windowSize * zoom)) * (double)totalSize + 0.5);
+
+            if(cut > cuts.back() && cut < end)
+            {
+                cuts.push_back(cut);
+            }
+        }
+    }
+
+    cuts.push_back(end);
+
+    // subdivide the range on each screen
+    std::vector<int> boundaries;
+
+    for(unsigned int i=0; i+1<cuts.size(); i++)
+    {
+        int size = cuts[i+1] - cuts[i];
+
+        int numSubdivisions = 1;
+
+        if(nominalSegmentSize > 0)
+        {
+            numSubdivisions = std::max(1, (int)floor((float)size / (float)nominalSegmentSize + 0.5));
+        }
+
+        for(int j=0; j<numSubdivisions; j++)
+        {
+            boundaries.push_back(cuts[i] + j * size / numSubdivisions);
+        }
+    }
+
+    boundaries.push_back(end);
+
+    return boundaries;
+}
+
+std::vector<ParallelPixelStreamSegmentParameters> pixelStreamComputeSegments(const WallLayout & layout, int nominalSegmentWidth, int nominalSegmentHeight, int x, int y, int width, int height, int totalWidth, int totalHeight)
+{
+    std::vector<ParallelPixelStreamSegmentParameters> segments;
+
+    if(width <= 0 || height <= 0)
+    {
+        return segments;
+    }
+
+    std::vector<int> boundariesX = pixelStreamComputeBoundaries(layout.numTilesWidth, layout.screenWidth, layout.mullionWidth, layout.x, layout.w, layout.zoom, layout.centerX, nominalSegmentWidth, x, x + width, totalWidth);
+    std::vector<int> boundariesY = pixelStreamComputeBoundaries(layout.numTilesHeight, layout.screenHeight, layout.mullionHeight, layout.y, layout.h, layout.zoom, layout.centerY, nominalSegmentHeight, y, y + height, totalHeight);
+
+    for(unsigned int i=0; i+1<boundariesX.size(); i++)
+    {
+        for(unsigned int j=0; j+1<boundariesY.size(); j++)
+        {
+            ParallelPixelStreamSegmentParameters p;
+
+            p.x = boundariesX[i];
+            p.y = boundariesY[j];
+            p.width = boundariesX[i+1] - boundariesX[i];
+            p.height = boundariesY[j+1] - boundariesY[j];
+            p.totalWidth = totalWidth;
+            p.totalHeight = totalHeight;
+
+            segments.push_back(p);
+        }
+    }
+
+    return segments;
+}
@@ -0,0 +1,152 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <algorithm>
+#include <vector>
+
+// FIFO queue in a circular buffer. unlike std::queue, memory is only allocated when the queue grows beyond its
+// capacity, so a queue that is repeatedly filled and drained doesn't allocate.
+template <class T>
+class RingBuffer {
+
+    public:
+
+        RingBuffer(int capacity=16)
+        {
+            // defaults
+            head_ = 0;
+            size_ = 0;
+
+            // assign values
+            buffer_.resize(capacity > 0 ? capacity : 1);
+        }
+
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        int size() const
+        {
+            return size_;
+        }
+
+        // number of elements that fit without allocating
+        int capacity() const
+        {
+            return (int)buffer_.size();
+        }
+
+        T & front()
+        {
+            return buffer_[head_];
+        }
+
+        T & back()
+        {
+            return buffer_[(head_ + size_ - 1) % buffer_.size()];
+        }
+
+        T & operator[](int index)
+        {
+            return buffer_[(head_ + index) % buffer_.size()];
+        }
+
+        void push(const T & value)
+        {
+            if(size_ == (int)buffer_.size())
+            {
+                grow();
+            }
+
+            buffer_[(head_ + size_) % buffer_.size()] = value;
+            size_++;
+        }
+
+        void pop()
+        {
+            // release the element, since it may hold a reference to shared data
+            buffer_[head_] = T();
+
+            head_ = (head_ + 1) % buffer_.size();
+            size_--;
+        }
+
+        // pop the front element into value by swapping, so its data isn't copied
+        void take(T & value)
+        {
+            using std::swap;
+            swap(value, buffer_[head_]);
+
+            pop();
+        }
+
+        void clear()
+        {
+            while(empty() != true)
+            {
+                pop();
+            }
+
+            head_ = 0;
+        }
+
+    private:
+
+        std::vector<T> buffer_;
+        int head_;
+        int size_;
+
+        void grow()
+        {
+            std::vector<T> buffer(buffer_.size() * 2);
+
+            for(int i=0; i<size_; i++)
+            {
+                buffer[i] = buffer_[(head_ + i) % buffer_.size()];
+            }
+
+            buffer_.swap(buffer);
+            head_ = 0;
+        }
+};
+
+#endif
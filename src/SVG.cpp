@@ -37,8 +37,12 @@
 /*********************************************************************/
 
 #include "SVG.h"
+#include "SVGDocumentCache.h"
 #include "main.h"
 #include "log.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 #ifdef __APPLE__
     #include <OpenGL/glu.h>
@@ -51,6 +55,7 @@ SVG::SVG(std::string uri)
     // defaults
     imageWidth_ = 0;
     imageHeight_ = 0;
+    domDocumentParsed_ = false;
 
     // assign values
     uri_ = uri;
@@ -72,7 +77,13 @@ SVG::SVG(std::string uri)
 
 SVG::~SVG()
 {
-    // no need to delete textures, that's handled in FBO destructor
+    // queued requests only hold weak pointers, and running rasterizations keep their tiles alive
+    std::map<long long, boost::shared_ptr<SVGTile> >::iterator it;
+
+    for(it = tiles_.begin(); it != tiles_.end(); it++)
+    {
+        purgeTile(it->second);
+    }
 }
 
 void SVG::getDimensions(int &width, int &height)
@@ -90,131 +101,410 @@ void SVG::render(float tX, float tY, float tW, float tH)
     QRectF fullRect = getProjectedPixelRect(false); // corresponds to original [tX, tY, tW, tH]
 
     // if we're not visible or we don't have a valid SVG, we're done...
-    if(screenRect.isEmpty() == true || svgRenderer_.isValid() != true)
+    if(screenRect.isEmpty() == true || document_ == NULL)
     {
-        // clear existing FBO for this OpenGL window
-        fbos_.erase(g_mainWindow->getActiveGLWindow());
-
         return;
     }
 
-    // generate texture corresponding to the visible part of these texture coordinates
-    generateTexture(screenRect, fullRect, tX, tY, tW, tH);
+    // figure out what visible [tX, tY, tW, tH] is for screenRect
+    double tXp = tX + (screenRect.x() - fullRect.x()) / fullRect.width() * tW;
+    double tYp = tY + (screenRect.y() - fullRect.y()) / fullRect.height() * tH;
+    double tWp = screenRect.width() / fullRect.width() * tW;
+    double tHp = screenRect.height() / fullRect.height() * tH;
+
+    QRectF textureRect(tXp, tYp, tWp, tHp);
 
-    // we'll now render the entire generated texture
-    tX = tY = 0.;
-    tW = tH = 1.;
+    // choose the coarsest level with at least one tile pixel per screen pixel
+    double documentPixels = std::max(fullRect.width() / tW, fullRect.height() / tH);
 
-    // figure out what visible region is for screenRect, a subregion of [0, 0, 1, 1]
-    double xp = (screenRect.x() - fullRect.x()) / fullRect.width();
-    double yp = (screenRect.y() - fullRect.y()) / fullRect.height();
-    double wp = screenRect.width() / fullRect.width();
-    double hp = screenRect.height() / fullRect.height();
+    int level = (int)ceil(log(documentPixels / (double)SVG_TILE_SIZE) / log(2.));
+    level = std::max(0, std::min(level, SVG_TILE_MAX_LEVEL));
+
+    int n = 1 << level;
+
+    // range of visible tiles
+    int iMin = std::max((int)floor(textureRect.left() * (double)n), 0);
+    int iMax = std::min((int)ceil(textureRect.right() * (double)n), n);
+    int jMin = std::max((int)floor(textureRect.top() * (double)n), 0);
+    int jMax = std::min((int)ceil(textureRect.bottom() * (double)n), n);
 
-    // draw the texture
     glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
 
     glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, textureId_);
 
-    // on zoom-out, clamp to edge (instead of showing the texture tiled / repeated)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    bool rootTileRequested = false;
 
-    glBegin(GL_QUADS);
+    for(int i=iMin; i<iMax; i++)
+    {
+        for(int j=jMin; j<jMax; j++)
+        {
+            QRectF tileRect((double)i / (double)n, (double)j / (double)n, 1. / (double)n, 1. / (double)n);
+            QRectF drawRect = tileRect.intersected(textureRect);
+
+            if(drawRect.isEmpty() == true)
+            {
+                continue;
+            }
+
+            boost::shared_ptr<SVGTile> tile = getTile(level, i, j);
+
+            if(isTileFinished(tile) == true)
+            {
+                renderTile(tile, drawRect, tX, tY, tW, tH);
+
+                // no longer need the tile for the previous document
+                if(tile->previous != NULL)
+                {
+                    purgeTile(tile->previous);
+                    tile->previous.reset();
+                }
+
+                continue;
+            }
+
+            // tiles nearest the center of the view are rasterized first
+            double priority = -(tileRect.center() - textureRect.center()).manhattanLength();
+
+            g_svgTileRasterizer.requestTile(tile, priority);
+
+            // meanwhile, show the tile for the previous document or the nearest finished coarser tile, scaled
+            boost::shared_ptr<SVGTile> fallbackTile = tile->previous;
+
+            for(int l=level-1; l>=0 && fallbackTile == NULL; l--)
+            {
+                fallbackTile = getFinishedTile(l, i >> (level-l), j >> (level-l));
+            }
+
+            if(fallbackTile != NULL)
+            {
+                renderTile(fallbackTile, drawRect, tX, tY, tW, tH);
+            }
+            else if(level > 0 && rootTileRequested == false)
+            {
+                // the root tile is cheap and covers the whole document, so rasterize it first
+                g_svgTileRasterizer.requestTile(getTile(0, 0, 0), std::numeric_limits<double>::max());
+
+                rootTileRequested = true;
+            }
+        }
+    }
 
-    // note we need to flip the y coordinate since the textures are loaded upside down
-    glTexCoord2f(tX,1.-tY);
-    glVertex2f(xp, yp);
+    glPopAttrib();
 
-    glTexCoord2f(tX+tW,1.-tY);
-    glVertex2f(xp+wp,yp);
+    evictTiles();
+}
 
-    glTexCoord2f(tX+tW,1.-(tY+tH));
-    glVertex2f(xp+wp,yp+hp);
+bool SVG::setImageData(QByteArray imageData)
+{
+    // a new document; the DOM is only needed for incremental updates
+    domDocumentParsed_ = false;
+    domDocument_.clear();
+    domElements_.clear();
 
-    glTexCoord2f(tX,1.-(tY+tH));
-    glVertex2f(xp,yp+hp);
+    return setDocument(imageData);
+}
 
-    glEnd();
+bool SVG::applyUpdates(QByteArray updates)
+{
+    std::vector<SVGElementUpdate> elementUpdates;
 
-    glPopAttrib();
+    if(SVGDocumentCache::parseUpdates(updates, elementUpdates) != true)
+    {
+        return false;
+    }
+
+    if(domDocumentParsed_ != true && parseDomDocument() != true)
+    {
+        return false;
+    }
+
+    bool idUpdated = false;
+
+    for(unsigned int i=0; i<elementUpdates.size(); i++)
+    {
+        std::map<QString, QDomElement>::iterator it = domElements_.find(elementUpdates[i].id);
+
+        if(it == domElements_.end())
+        {
+            put_flog(LOG_WARN, "%s: no element with id %s", uri_.c_str(), elementUpdates[i].id.toStdString().c_str());
+            continue;
+        }
+
+        std::map<QString, QString>::iterator attributesIt;
+
+        for(attributesIt = elementUpdates[i].attributes.begin(); attributesIt != elementUpdates[i].attributes.end(); attributesIt++)
+        {
+            it->second.setAttribute(attributesIt->first, attributesIt->second);
+        }
+
+        if(elementUpdates[i].attributes.count("id") > 0)
+        {
+            idUpdated = true;
+        }
+    }
+
+    // an element was renamed
+    if(idUpdated == true)
+    {
+        parseDomDocument();
+    }
+
+    return setDocument(domDocument_.toByteArray(-1));
 }
 
-bool SVG::setImageData(QByteArray imageData)
+bool SVG::setDocument(QByteArray imageData)
 {
-    if(svgRenderer_.load(imageData) != true || svgRenderer_.isValid() == false)
+    QRectF extents;
+
+    // read the dimensions from the root element; the rasterizer threads parse the full document
+    std::map<QString, QString> rootAttributes;
+
+    if(SVGDocumentCache::probeRootAttributes(imageData, rootAttributes) != true || SVGDocumentCache::getDefaultSize(rootAttributes, imageWidth_, imageHeight_, extents) != true)
     {
-        put_flog(LOG_ERROR, "error loading %s", uri_.c_str());
-        return false;
+        // compressed documents, or dimensions depending on the content
+        QSvgRenderer svgRenderer;
+
+        if(svgRenderer.load(imageData) != true || svgRenderer.isValid() == false)
+        {
+            put_flog(LOG_ERROR, "error loading %s", uri_.c_str());
+            return false;
+        }
+
+        extents = svgRenderer.viewBoxF();
+
+        imageWidth_ = svgRenderer.defaultSize().width();
+        imageHeight_ = svgRenderer.defaultSize().height();
     }
 
-    // save logical coordinates
-    svgExtents_ = svgRenderer_.viewBoxF();
+    // new document version; existing tiles are shown until they are rasterized again
+    static long documentCount = 0;
 
-    // save image dimensions
-    imageWidth_ = svgRenderer_.defaultSize().width();
-    imageHeight_ = svgRenderer_.defaultSize().height();
+    boost::shared_ptr<SVGTileDocument> document(new SVGTileDocument());
+    document->id = documentCount++;
+    document->data = imageData;
+    document->extents = extents;
 
-    // reset rendered texture information
-    textureRect_ = QRectF();
-    textureSize_ = QSizeF(0,0);
+    document_ = document;
 
     return true;
 }
 
-void SVG::generateTexture(QRectF screenRect, QRectF fullRect, float tX, float tY, float tW, float tH)
+bool SVG::parseDomDocument()
 {
-    // figure out what visible [tX, tY, tW, tH] is for screenRect
-    double tXp = tX + (screenRect.x() - fullRect.x()) / fullRect.width() * tW;
-    double tYp = tY + (screenRect.y() - fullRect.y()) / fullRect.height() * tH;
-    double tWp = screenRect.width() / fullRect.width() * tW;
-    double tHp = screenRect.height() / fullRect.height() * tH;
+    if(domDocumentParsed_ != true)
+    {
+        if(document_ == NULL)
+        {
+            put_flog(LOG_ERROR, "%s: no document to update", uri_.c_str());
+            return false;
+        }
 
-    QRectF textureRect(tXp, tYp, tWp, tHp);
+        QString errorMessage;
+
+        if(domDocument_.setContent(document_->data, &errorMessage) != true)
+        {
+            put_flog(LOG_ERROR, "error parsing %s: %s", uri_.c_str(), errorMessage.toStdString().c_str());
+            return false;
+        }
+
+        domDocumentParsed_ = true;
+    }
+
+    // index elements by id
+    domElements_.clear();
+
+    QDomElement root = domDocument_.documentElement();
+    QDomNodeList elements = root.elementsByTagName("*");
+
+    if(root.hasAttribute("id") == true)
+    {
+        domElements_[root.attribute("id")] = root;
+    }
 
-    if(textureRect == textureRect_ && screenRect.size() == textureSize_)
+    for(int i=0; i<elements.count(); i++)
+    {
+        QDomElement element = elements.at(i).toElement();
+
+        if(element.hasAttribute("id") == true)
+        {
+            domElements_[element.attribute("id")] = element;
+        }
+    }
+
+    return true;
+}
+
+long long SVG::getTileKey(int level, int i, int j)
+{
+    return ((long long)level << 48) | ((long long)i << 24) | (long long)j;
+}
+
+boost::shared_ptr<SVGTile> SVG::getTile(int level, int i, int j)
+{
+    boost::shared_ptr<SVGTile> & tile = tiles_[getTileKey(level, i, j)];
+
+    if(tile == NULL)
+    {
+        tile = boost::shared_ptr<SVGTile>(new SVGTile(document_, level, i, j));
+    }
+    else if(tile->document != document_)
+    {
+        // keep the most recent finished tile at this position for display until the new one is finished
+        boost::shared_ptr<SVGTile> previous;
+
+        if(isTileFinished(tile) == true)
+        {
+            previous = tile;
+            purgeTile(tile->previous);
+            tile->previous.reset();
+        }
+        else
+        {
+            previous = tile->previous;
+        }
+
+        tile = boost::shared_ptr<SVGTile>(new SVGTile(document_, level, i, j));
+        tile->previous = previous;
+    }
+
+    tile->lastUsedFrameCount = g_frameCount;
+
+    return tile;
+}
+
+boost::shared_ptr<SVGTile> SVG::getFinishedTile(int level, int i, int j)
+{
+    std::map<long long, boost::shared_ptr<SVGTile> >::iterator it = tiles_.find(getTileKey(level, i, j));
+
+    if(it == tiles_.end())
+    {
+        return boost::shared_ptr<SVGTile>();
+    }
+
+    boost::shared_ptr<SVGTile> tile = it->second;
+    tile->lastUsedFrameCount = g_frameCount;
+
+    if(isTileFinished(tile) == true)
+    {
+        return tile;
+    }
+
+    return tile->previous;
+}
+
+bool SVG::isTileFinished(boost::shared_ptr<SVGTile> tile)
+{
+    // once uploaded, the tile is finished for good
+    return (tile->textureBound == true || g_svgTileRasterizer.isTileFinished(tile.get()) == true);
+}
+
+void SVG::renderTile(boost::shared_ptr<SVGTile> tile, QRectF drawRect, float tX, float tY, float tW, float tH)
+{
+    if(tile->textureBound != true)
+    {
+        // generate new texture
+        // the rasterized image is premultiplied ARGB (32 bits per pixel), so we can use GL_BGRA on it directly
+        glGenTextures(1, &tile->textureId);
+        glBindTexture(GL_TEXTURE_2D, tile->textureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tile->image.width(), tile->image.height(), 0, GL_BGRA, GL_UNSIGNED_BYTE, tile->image.constBits());
+
+        // tiles are scaled while sharper ones are rasterized
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        tile->textureBound = true;
+
+        // no longer need the image
+        tile->image = QImage();
+    }
+
+    // tile rectangle in texture coordinates
+    int n = 1 << tile->level;
+
+    QRectF tileRect((double)tile->i / (double)n, (double)tile->j / (double)n, 1. / (double)n, 1. / (double)n);
+
+    // vertices in object space, where [tX, tY, tW, tH] spans [0, 0, 1, 1]
+    double x0 = (drawRect.left() - tX) / tW;
+    double y0 = (drawRect.top() - tY) / tH;
+    double x1 = (drawRect.right() - tX) / tW;
+    double y1 = (drawRect.bottom() - tY) / tH;
+
+    // texture coordinates within the tile; no flip, since the first image row is the top of the tile
+    double s0 = (drawRect.left() - tileRect.left()) / tileRect.width();
+    double t0 = (drawRect.top() - tileRect.top()) / tileRect.height();
+    double s1 = (drawRect.right() - tileRect.left()) / tileRect.width();
+    double t1 = (drawRect.bottom() - tileRect.top()) / tileRect.height();
+
+    glBindTexture(GL_TEXTURE_2D, tile->textureId);
+
+    // don't bleed into neighboring tiles at the edges
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBegin(GL_QUADS);
+
+    glTexCoord2f(s0, t0);
+    glVertex2f(x0, y0);
+
+    glTexCoord2f(s1, t0);
+    glVertex2f(x1, y0);
+
+    glTexCoord2f(s1, t1);
+    glVertex2f(x1, y1);
+
+    glTexCoord2f(s0, t1);
+    glVertex2f(x0, y1);
+
+    glEnd();
+}
+
+void SVG::purgeTile(boost::shared_ptr<SVGTile> tile)
+{
+    if(tile == NULL)
     {
-        // no need to regenerate texture
         return;
     }
 
-    // keep rendered texture information so we know when to rerender
-    // todo: this works great when the SVG is only rendered once per GLWindow
-    // however, it will rerender every time otherwise, for example if the zoom context is shown
-    textureRect_ = textureRect;
-    textureSize_ = screenRect.size();
+    // let the OpenGL window delete the texture
+    if(tile->textureBound == true)
+    {
+        g_mainWindow->getGLWindow()->insertPurgeTextureId(tile->textureId);
 
-    // generate and set view box in logical coordinates
-    QRectF viewbox(svgExtents_.x() + tXp * svgExtents_.width(), svgExtents_.y() + tYp * svgExtents_.height(), tWp * svgExtents_.width(), tHp * svgExtents_.height());
+        tile->textureBound = false;
+    }
 
-    svgRenderer_.setViewBox(viewbox);
+    purgeTile(tile->previous);
+    tile->previous.reset();
+}
 
-    // save OpenGL state
-    glPushAttrib(GL_ALL_ATTRIB_BITS);
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
+void SVG::evictTiles()
+{
+    if(tiles_.size() <= SVG_MAX_CACHED_TILES)
+    {
+        return;
+    }
 
-    // generate new texture
-    boost::shared_ptr<QGLFramebufferObject> fbo(new QGLFramebufferObject(screenRect.width(), screenRect.height(), QGLFramebufferObject::CombinedDepthStencil));
+    // least recently used tiles first; tiles used this frame are never evicted
+    std::vector<std::pair<long, long long> > candidates;
 
-    // keep fbos in a map so they stick around -- they're needed for the texture to be rendered
-    fbos_[g_mainWindow->getActiveGLWindow()] = fbo;
+    std::map<long long, boost::shared_ptr<SVGTile> >::iterator it;
 
-    QPainter painter(fbo.get());
-    svgRenderer_.render(&painter);
-    painter.end();
+    for(it = tiles_.begin(); it != tiles_.end(); it++)
+    {
+        if(it->second->lastUsedFrameCount < g_frameCount)
+        {
+            candidates.push_back(std::pair<long, long long>(it->second->lastUsedFrameCount, it->first));
+        }
+    }
 
-    // restore OpenGL state
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
-    glPopAttrib();
+    std::sort(candidates.begin(), candidates.end());
 
-    textureId_ = fbo->texture();
+    for(unsigned int i=0; i<candidates.size() && tiles_.size() > SVG_MAX_CACHED_TILES; i++)
+    {
+        // a running rasterization keeps its tile alive until it is finished
+        purgeTile(tiles_[candidates[i].second]);
+        tiles_.erase(candidates[i].second);
+    }
 }
 
 QRectF SVG::getProjectedPixelRect(bool onScreenOnly)
@@ -40,13 +40,15 @@
 #define SVG_H
 
 #include "FactoryObject.h"
+#include "SVGTileRasterizer.h"
 #include <QtSvg>
+#include <QtXml>
 #include <QGLWidget>
-#include <QGLFramebufferObject>
 #include <boost/shared_ptr.hpp>
 #include <map>
 
-class GLWindow;
+// maximum number of cached tiles per SVG; least recently used tiles beyond this are evicted
+#define SVG_MAX_CACHED_TILES 64
 
 class SVG : public FactoryObject {
 
@@ -59,27 +61,38 @@ class SVG : public FactoryObject {
         void render(float tX, float tY, float tW, float tH);
         bool setImageData(QByteArray imageData);
 
+        // apply incremental updates, see SVGDocumentCache::parseUpdates()
+        bool applyUpdates(QByteArray updates);
+
     private:
 
         // image location
         std::string uri_;
 
-        // SVG renderer
-        QRectF svgExtents_;
-        QSvgRenderer svgRenderer_;
+        // current document, rasterized by g_svgTileRasterizer
+        boost::shared_ptr<SVGTileDocument> document_;
 
-        std::map<boost::shared_ptr<GLWindow>, boost::shared_ptr<QGLFramebufferObject> > fbos_;
+        // DOM of the current document, parsed on the first incremental update, and its elements by id
+        bool domDocumentParsed_;
+        QDomDocument domDocument_;
+        std::map<QString, QDomElement> domElements_;
 
         // current rasterized image dimensions
         int imageWidth_;
         int imageHeight_;
 
-        // texture information
-        QRectF textureRect_;
-        QSizeF textureSize_;
-        GLuint textureId_;
+        // cached tiles, keyed by level and position
+        std::map<long long, boost::shared_ptr<SVGTile> > tiles_;
 
-        void generateTexture(QRectF screenRect, QRectF fullRect, float tX, float tY, float tW, float tH);
+        bool setDocument(QByteArray imageData);
+        bool parseDomDocument();
+        long long getTileKey(int level, int i, int j);
+        boost::shared_ptr<SVGTile> getTile(int level, int i, int j);
+        boost::shared_ptr<SVGTile> getFinishedTile(int level, int i, int j);
+        bool isTileFinished(boost::shared_ptr<SVGTile> tile);
+        void renderTile(boost::shared_ptr<SVGTile> tile, QRectF drawRect, float tX, float tY, float tW, float tH);
+        void purgeTile(boost::shared_ptr<SVGTile> tile);
+        void evictTiles();
         QRectF getProjectedPixelRect(bool onScreenOnly);
 };
 
@@ -0,0 +1,269 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "SVGDocumentCache.h"
+#include "log.h"
+
+SVGDocumentCache::SVGDocumentCache()
+{
+    // defaults
+    useCount_ = 0;
+}
+
+SVGDocumentCache & SVGDocumentCache::getProcessCache()
+{
+    static SVGDocumentCache processCache;
+
+    return processCache;
+}
+
+QByteArray SVGDocumentCache::getHash(QByteArray data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+MESSAGE_TYPE SVGDocumentCache::prepareMessage(QByteArray data, QByteArray & message)
+{
+    QByteArray hash = getHash(data);
+    QByteArray cachedData;
+
+    if(get(hash, cachedData) == true)
+    {
+        message = hash;
+        return MESSAGE_TYPE_SVG_STREAM_CACHED;
+    }
+
+    insert(hash, data);
+
+    message = data;
+    return MESSAGE_TYPE_SVG_STREAM;
+}
+
+bool SVGDocumentCache::receiveMessage(MESSAGE_TYPE type, QByteArray message, QByteArray & data)
+{
+    if(type == MESSAGE_TYPE_SVG_STREAM)
+    {
+        insert(getHash(message), message);
+
+        data = message;
+        return true;
+    }
+
+    return get(message, data);
+}
+
+bool SVGDocumentCache::get(QByteArray hash, QByteArray & data)
+{
+    std::map<QByteArray, CachedDocument>::iterator it = documents_.find(hash);
+
+    if(it == documents_.end())
+    {
+        return false;
+    }
+
+    it->second.lastUsedCount = useCount_++;
+    data = it->second.data;
+
+    return true;
+}
+
+void SVGDocumentCache::insert(QByteArray hash, QByteArray data)
+{
+    if(documents_.size() >= SVG_DOCUMENT_CACHE_SIZE && documents_.count(hash) == 0)
+    {
+        std::map<QByteArray, CachedDocument>::iterator oldest = documents_.begin();
+
+        for(std::map<QByteArray, CachedDocument>::iterator it = documents_.begin(); it != documents_.end(); it++)
+        {
+            if(it->second.lastUsedCount < oldest->second.lastUsedCount)
+            {
+                oldest = it;
+            }
+        }
+
+        documents_.erase(oldest);
+    }
+
+    CachedDocument document;
+    document.data = data;
+    document.lastUsedCount = useCount_++;
+
+    documents_[hash] = document;
+}
+
+bool SVGDocumentCache::probeRootAttributes(QByteArray data, std::map<QString, QString> & attributes)
+{
+    QXmlStreamReader reader(data);
+
+    // skip the prolog, doctype, and comments up to the root element
+    while(reader.atEnd() != true)
+    {
+        if(reader.readNext() == QXmlStreamReader::StartElement)
+        {
+            if(reader.name() != QLatin1String("svg"))
+            {
+                return false;
+            }
+
+            attributes.clear();
+
+            QXmlStreamAttributes xmlAttributes = reader.attributes();
+
+            for(int i=0; i<xmlAttributes.size(); i++)
+            {
+                attributes[xmlAttributes[i].qualifiedName().toString()] = xmlAttributes[i].value().toString();
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool SVGDocumentCache::getDefaultSize(std::map<QString, QString> & attributes, int & width, int & height, QRectF & viewBox)
+{
+    viewBox = QRectF();
+
+    if(attributes.count("viewBox") > 0)
+    {
+        QStringList values = attributes["viewBox"].split(QRegExp("[\\s,]+"), QString::SkipEmptyParts);
+
+        if(values.size() == 4)
+        {
+            viewBox = QRectF(values[0].toDouble(), values[1].toDouble(), values[2].toDouble(), values[3].toDouble());
+        }
+    }
+
+    // a missing width or height is 100% of the view box
+    QString widthString = attributes.count("width") > 0 ? attributes["width"] : QString("100%");
+    QString heightString = attributes.count("height") > 0 ? attributes["height"] : QString("100%");
+
+    if(viewBox.isEmpty() == true && (widthString.endsWith("%") == true || heightString.endsWith("%") == true))
+    {
+        return false;
+    }
+
+    width = (int)getLength(widthString, viewBox.width());
+    height = (int)getLength(heightString, viewBox.height());
+
+    if(viewBox.isEmpty() == true)
+    {
+        viewBox = QRectF(0., 0., (double)width, (double)height);
+    }
+
+    return true;
+}
+
+bool SVGDocumentCache::parseUpdates(QByteArray data, std::vector<SVGElementUpdate> & updates)
+{
+    QXmlStreamReader reader(data);
+
+    while(reader.atEnd() != true)
+    {
+        if(reader.readNext() == QXmlStreamReader::StartElement && reader.name() == QLatin1String("set"))
+        {
+            SVGElementUpdate update;
+
+            QXmlStreamAttributes xmlAttributes = reader.attributes();
+
+            for(int i=0; i<xmlAttributes.size(); i++)
+            {
+                if(xmlAttributes[i].qualifiedName() == QLatin1String("id"))
+                {
+                    update.id = xmlAttributes[i].value().toString();
+                }
+                else
+                {
+                    update.attributes[xmlAttributes[i].qualifiedName().toString()] = xmlAttributes[i].value().toString();
+                }
+            }
+
+            if(update.id.isEmpty() == true)
+            {
+                put_flog(LOG_WARN, "ignoring SVG update without an element id");
+                continue;
+            }
+
+            updates.push_back(update);
+        }
+    }
+
+    if(reader.hasError() == true)
+    {
+        put_flog(LOG_ERROR, "error parsing SVG updates: %s", reader.errorString().toStdString().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+double SVGDocumentCache::getLength(QString length, double percentageBase)
+{
+    length = length.trimmed();
+
+    // matches QSvgRenderer's unit handling: only mm, cm, and in are converted
+    double scale = 1.;
+
+    if(length.endsWith("%") == true)
+    {
+        scale = percentageBase / 100.;
+        length.chop(1);
+    }
+    else if(length.endsWith("mm") == true)
+    {
+        scale = 3.543307;
+        length.chop(2);
+    }
+    else if(length.endsWith("cm") == true)
+    {
+        scale = 35.43307;
+        length.chop(2);
+    }
+    else if(length.endsWith("in") == true)
+    {
+        scale = 90.;
+        length.chop(2);
+    }
+    else if(length.endsWith("px") == true || length.endsWith("pt") == true || length.endsWith("pc") == true)
+    {
+        length.chop(2);
+    }
+
+    return length.toDouble() * scale;
+}
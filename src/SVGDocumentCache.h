@@ -0,0 +1,112 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef SVG_DOCUMENT_CACHE_H
+#define SVG_DOCUMENT_CACHE_H
+
+// number of SVG documents kept by each process
+#define SVG_DOCUMENT_CACHE_SIZE 16
+
+#include "MessageHeader.h"
+#include <QtGui>
+#include <map>
+#include <vector>
+
+// an incremental SVG stream update: new attribute values for the element with the given id
+struct SVGElementUpdate {
+
+    QString id;
+    std::map<QString, QString> attributes;
+};
+
+// SVG documents recently sent to the render processes, keyed by a hash of their content.
+// the master and every render process apply the same sequence of operations, so their caches stay identical and
+// the master can send just the hash of a document the render processes already have.
+class SVGDocumentCache {
+
+    public:
+
+        SVGDocumentCache();
+
+        // the cache of this process. render processes replace their display group with every update they receive, so
+        // a cache owned by the display group would be emptied while the master still sends hashes
+        static SVGDocumentCache & getProcessCache();
+
+        static QByteArray getHash(QByteArray data);
+
+        // on the master: the message to send for a document. documents the render processes already have are sent as a
+        // MESSAGE_TYPE_SVG_STREAM_CACHED message with their hash; others are cached and sent as MESSAGE_TYPE_SVG_STREAM
+        MESSAGE_TYPE prepareMessage(QByteArray data, QByteArray & message);
+
+        // on the render processes: the document of a received MESSAGE_TYPE_SVG_STREAM or MESSAGE_TYPE_SVG_STREAM_CACHED
+        // message, applying the same cache operations as the master. returns false if the document is not cached
+        bool receiveMessage(MESSAGE_TYPE type, QByteArray message, QByteArray & data);
+
+        // get a document and mark it as recently used; returns false if it is not cached
+        bool get(QByteArray hash, QByteArray & data);
+
+        // insert a document, evicting the least recently used one if the cache is full
+        void insert(QByteArray hash, QByteArray data);
+
+        // read the attributes of the root svg element without parsing the rest of the document
+        static bool probeRootAttributes(QByteArray data, std::map<QString, QString> & attributes);
+
+        // the dimensions and view box QSvgRenderer would report for a document with these root attributes
+        // returns false if they depend on the document's content, i.e. there is neither a size nor a view box
+        static bool getDefaultSize(std::map<QString, QString> & attributes, int & width, int & height, QRectF & viewBox);
+
+        // parse incremental updates of the form <updates><set id="..." attribute="value" ... /></updates>
+        static bool parseUpdates(QByteArray data, std::vector<SVGElementUpdate> & updates);
+
+    private:
+
+        struct CachedDocument {
+
+            QByteArray data;
+            long lastUsedCount;
+        };
+
+        std::map<QByteArray, CachedDocument> documents_;
+
+        // incremented on every access, for LRU eviction
+        long useCount_;
+
+        static double getLength(QString length, double percentageBase);
+};
+
+#endif
@@ -43,12 +43,13 @@ SVGStreamSource::SVGStreamSource(std::string uri)
     // defaults
     imageDataCount_ = 0;
     getImageDataCount_ = 0;
+    imageDataUpdated_ = false;
 
     // assign values
     uri_ = uri;
 }
 
-QByteArray SVGStreamSource::getImageData(bool & updated)
+QByteArray SVGStreamSource::getImageData(bool & updated, std::vector<QByteArray> & updates)
 {
     QMutexLocker locker(&imageDataMutex_);
 
@@ -64,6 +65,9 @@ QByteArray SVGStreamSource::getImageData(bool & updated)
 
     getImageDataCount_ = imageDataCount_;
 
+    updates.swap(updates_);
+    updates_.clear();
+
     return imageData_;
 }
 
@@ -72,11 +76,30 @@ void SVGStreamSource::setImageData(QByteArray imageData)
     QMutexLocker locker(&imageDataMutex_);
 
     // only take the update if the image data has changed
-    if(imageData_ != imageData)
+    if(imageData_ != imageData || imageDataUpdated_ == true)
     {
         imageData_ = imageData;
         imageDataCount_++;
+        imageDataUpdated_ = false;
+
+        // the new document replaces any pending updates
+        updates_.clear();
     }
 }
 
+void SVGStreamSource::appendUpdates(QByteArray updates)
+{
+    QMutexLocker locker(&imageDataMutex_);
+
+    updates_.push_back(updates);
+
+    // the displayed document no longer matches the image data, so take a resend of it
+    imageDataUpdated_ = true;
+}
+
+std::map<QString, QString> & SVGStreamSource::getRootAttributes()
+{
+    return rootAttributes_;
+}
+
 Factory<SVGStreamSource> g_SVGStreamSourceFactory;
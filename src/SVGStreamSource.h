@@ -41,6 +41,8 @@
 
 #include "Factory.hpp"
 #include <QtGui>
+#include <map>
+#include <vector>
 
 class SVGStreamSource {
 
@@ -48,8 +50,13 @@ class SVGStreamSource {
 
         SVGStreamSource(std::string uri);
 
-        QByteArray getImageData(bool & updated);
+        // also returns the incremental updates received since the last call, which apply after the image data
+        QByteArray getImageData(bool & updated, std::vector<QByteArray> & updates);
         void setImageData(QByteArray imageData);
+        void appendUpdates(QByteArray updates);
+
+        // root element attributes of the current document, kept by the master to track the dimensions
+        std::map<QString, QString> & getRootAttributes();
 
     private:
 
@@ -63,6 +70,12 @@ class SVGStreamSource {
 
         // imageDataCount of last retrieval via getImageData()
         long getImageDataCount_;
+
+        // incremental updates not yet retrieved, and whether any were applied since imageData_ was set
+        std::vector<QByteArray> updates_;
+        bool imageDataUpdated_;
+
+        std::map<QString, QString> rootAttributes_;
 };
 
 // global SVG stream source factory
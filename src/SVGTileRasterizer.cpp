@@ -0,0 +1,249 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "SVGTileRasterizer.h"
+#include "log.h"
+#include <QtSvg>
+#include <algorithm>
+#include <list>
+
+// number of parsed documents each worker thread keeps
+#define SVG_TILE_THREAD_RENDERER_COUNT 4
+
+SVGTileRasterizer g_svgTileRasterizer;
+
+// each worker thread keeps its own parsed documents, since QSvgRenderer is not thread-safe. the most recently used
+// documents are kept, so rasterizing tiles of several SVGs in turn doesn't reparse them for every tile.
+class SVGTileThreadRenderers {
+
+    public:
+
+        ~SVGTileThreadRenderers()
+        {
+            std::list<std::pair<long, QSvgRenderer *> >::iterator it;
+
+            for(it = renderers_.begin(); it != renderers_.end(); it++)
+            {
+                delete it->second;
+            }
+        }
+
+        QSvgRenderer * getRenderer(SVGTileDocument * document)
+        {
+            std::list<std::pair<long, QSvgRenderer *> >::iterator it;
+
+            for(it = renderers_.begin(); it != renderers_.end(); it++)
+            {
+                if(it->first == document->id)
+                {
+                    // move to the front
+                    renderers_.splice(renderers_.begin(), renderers_, it);
+
+                    return renderers_.front().second;
+                }
+            }
+
+            // invalid documents are kept too, so they aren't reparsed for every tile
+            QSvgRenderer * renderer = new QSvgRenderer();
+
+            if(renderer->load(document->data) != true)
+            {
+                put_flog(LOG_ERROR, "error loading SVG document");
+            }
+
+            renderers_.push_front(std::pair<long, QSvgRenderer *>(document->id, renderer));
+
+            if(renderers_.size() > SVG_TILE_THREAD_RENDERER_COUNT)
+            {
+                delete renderers_.back().second;
+                renderers_.pop_back();
+            }
+
+            return renderer;
+        }
+
+    private:
+
+        // document ids and their renderers, most recently used first
+        std::list<std::pair<long, QSvgRenderer *> > renderers_;
+};
+
+static QThreadStorage<SVGTileThreadRenderers *> g_svgTileThreadRenderers;
+
+SVGTile::SVGTile(boost::shared_ptr<SVGTileDocument> document, int level, int i, int j)
+{
+    // defaults
+    state = SVG_TILE_IDLE;
+    requestFrameCount = 0;
+    textureBound = false;
+    textureId = 0;
+    lastUsedFrameCount = 0;
+
+    // assign values
+    this->document = document;
+    this->level = level;
+    this->i = i;
+    this->j = j;
+}
+
+// rasterization shares the cores with tile loads and pixel stream decoding, which have their own pools; use half of
+// them, so the three don't oversubscribe the host as much when they are busy at the same time
+SVGTileRasterizer::SVGTileRasterizer() : TileWorkQueue<SVGTile *, SVGTileRequest>(std::max(QThread::idealThreadCount() / 2, 1))
+{
+}
+
+void SVGTileRasterizer::requestTile(boost::shared_ptr<SVGTile> tile, double priority)
+{
+    QMutexLocker locker(&mutex_);
+
+    // renew the request; this also marks a running rasterization as still wanted
+    tile->requestFrameCount = frameCount_;
+
+    if(tile->state == SVG_TILE_IDLE || tile->state == SVG_TILE_QUEUED)
+    {
+        SVGTileRequest request;
+        request.tile = tile;
+        request.priority = priority;
+
+        requests_[tile.get()] = request;
+        tile->state = SVG_TILE_QUEUED;
+
+        startWorkers();
+    }
+}
+
+bool SVGTileRasterizer::isTileFinished(SVGTile * tile)
+{
+    QMutexLocker locker(&mutex_);
+
+    return (tile->state == SVG_TILE_FINISHED);
+}
+
+void SVGTileRasterizer::finalize()
+{
+    finalizeQueue();
+}
+
+void SVGTileRasterizer::processQueue()
+{
+    while(true)
+    {
+        // keeps the tile alive during rasterization, even if it is evicted meanwhile
+        boost::shared_ptr<SVGTile> tile;
+
+        {
+            QMutexLocker locker(&mutex_);
+
+            SVGTile * key;
+            SVGTileRequest request;
+
+            if(takeRequest(key, request) != true)
+            {
+                return;
+            }
+
+            tile = request.tile.lock();
+
+            // evicted after the queue was searched
+            if(tile == NULL)
+            {
+                continue;
+            }
+
+            tile->state = SVG_TILE_RUNNING;
+        }
+
+        rasterize(tile.get());
+
+        QMutexLocker locker(&mutex_);
+        tile->state = SVG_TILE_FINISHED;
+        locker.unlock();
+    }
+}
+
+bool SVGTileRasterizer::isRequestCancelled(SVGTile * const & tile, const SVGTileRequest & request)
+{
+    // the key may be dangling if the tile was evicted; only use the request's weak pointer
+    boost::shared_ptr<SVGTile> t = request.tile.lock();
+
+    return (t == NULL || isFrameCountStale(t->requestFrameCount) == true);
+}
+
+void SVGTileRasterizer::requestCancelled(SVGTile * const & tile, const SVGTileRequest & request)
+{
+    boost::shared_ptr<SVGTile> t = request.tile.lock();
+
+    if(t != NULL)
+    {
+        t->state = SVG_TILE_IDLE;
+    }
+}
+
+void SVGTileRasterizer::rasterize(SVGTile * tile)
+{
+    SVGTileDocument * document = tile->document.get();
+
+    if(g_svgTileThreadRenderers.hasLocalData() != true)
+    {
+        g_svgTileThreadRenderers.setLocalData(new SVGTileThreadRenderers());
+    }
+
+    QSvgRenderer * renderer = g_svgTileThreadRenderers.localData()->getRenderer(document);
+
+    // transparent tile, so partially covered tiles at the document edges blend correctly
+    QImage image(SVG_TILE_SIZE, SVG_TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+    image.fill(0);
+
+    if(renderer->isValid() == true)
+    {
+        // view box of this tile in logical coordinates
+        int n = 1 << tile->level;
+
+        QRectF extents = document->extents;
+        QRectF viewbox(extents.x() + extents.width() * (double)tile->i / (double)n, extents.y() + extents.height() * (double)tile->j / (double)n, extents.width() / (double)n, extents.height() / (double)n);
+
+        renderer->setViewBox(viewbox);
+
+        QPainter painter(&image);
+        renderer->render(&painter);
+        painter.end();
+    }
+
+    // published to the render thread when the state becomes finished
+    tile->image = image;
+}
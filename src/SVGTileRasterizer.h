@@ -0,0 +1,142 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef SVG_TILE_RASTERIZER_H
+#define SVG_TILE_RASTERIZER_H
+
+// tiles are square images of this size, in pixels
+#define SVG_TILE_SIZE 512
+
+// tiles at level L divide the document into 2^L x 2^L tiles
+#define SVG_TILE_MAX_LEVEL 8
+
+#include <map>
+#include "TileWorkQueue.h"
+#include <QtGui>
+#include <QGLWidget>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+// rasterization states for an SVGTile
+enum SVG_TILE_STATE { SVG_TILE_IDLE, SVG_TILE_QUEUED, SVG_TILE_RUNNING, SVG_TILE_FINISHED };
+
+// SVG document data shared by an SVG object and the rasterizer threads; replaced, never modified, when the SVG changes
+struct SVGTileDocument {
+
+    // unique id, so the worker threads know when to reparse
+    long id;
+
+    QByteArray data;
+
+    // logical coordinates of the document
+    QRectF extents;
+};
+
+struct SVGTile {
+
+    SVGTile(boost::shared_ptr<SVGTileDocument> document, int level, int i, int j);
+
+    // the document version this tile is rasterized from
+    boost::shared_ptr<SVGTileDocument> document;
+
+    // level and column / row of this tile
+    int level;
+    int i;
+    int j;
+
+    // rasterization state, managed by g_svgTileRasterizer
+    SVG_TILE_STATE state;
+    long requestFrameCount;
+
+    // rasterized image; released once the texture is uploaded
+    QImage image;
+
+    // the following are only used by the render thread
+
+    // texture information
+    bool textureBound;
+    GLuint textureId;
+
+    // last frame this tile was wanted, for LRU eviction
+    long lastUsedFrameCount;
+
+    // the tile at this position for the previous document, shown until this one is finished
+    boost::shared_ptr<SVGTile> previous;
+};
+
+struct SVGTileRequest {
+
+    // weak pointer so queued requests don't keep evicted tiles alive
+    boost::weak_ptr<SVGTile> tile;
+
+    // higher priorities are rasterized first
+    double priority;
+};
+
+// rasterizes SVG tiles into QImages on a dedicated thread pool, so the render thread never waits on QPainter.
+class SVGTileRasterizer : public TileWorkQueue<SVGTile *, SVGTileRequest> {
+
+    public:
+
+        SVGTileRasterizer();
+
+        // request rasterization, or renew an existing request with an updated priority
+        void requestTile(boost::shared_ptr<SVGTile> tile, double priority);
+
+        bool isTileFinished(SVGTile * tile);
+
+        // cancel all requests and wait for running rasterizations to finish
+        void finalize();
+
+        // called by the worker threads
+        void processQueue();
+
+    protected:
+
+        // mutex_ also protects the state of all SVGTile objects
+        bool isRequestCancelled(SVGTile * const & tile, const SVGTileRequest & request);
+        void requestCancelled(SVGTile * const & tile, const SVGTileRequest & request);
+
+    private:
+
+        void rasterize(SVGTile * tile);
+};
+
+extern SVGTileRasterizer g_svgTileRasterizer;
+
+#endif
@@ -0,0 +1,349 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "SharedMemoryRing.h"
+#include "log.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+// each record is a 32-bit size followed by the data, padded to this alignment
+#define SHARED_MEMORY_RING_ALIGNMENT 8
+
+// size of a padding record, which fills the end of the ring when the next record doesn't fit there
+#define SHARED_MEMORY_RING_PADDING -1
+
+static std::atomic<int> g_sharedMemoryRingCount(0);
+
+static uint64_t sharedMemoryRingGetRecordLength(int size)
+{
+    return SHARED_MEMORY_RING_ALIGNMENT + ((uint64_t)size + SHARED_MEMORY_RING_ALIGNMENT - 1) / SHARED_MEMORY_RING_ALIGNMENT * SHARED_MEMORY_RING_ALIGNMENT;
+}
+
+SharedMemoryRing::SharedMemoryRing()
+{
+    // defaults
+    fd_ = -1;
+    memory_ = NULL;
+    size_ = 0;
+    created_ = false;
+    header_ = NULL;
+    data_ = NULL;
+    capacity_ = 0;
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    finalize();
+}
+
+bool SharedMemoryRing::create(size_t capacity)
+{
+    finalize();
+
+    // unique per process and ring
+    char name[64];
+    snprintf(name, sizeof(name), "/displaycluster-stream-%i-%i", (int)getpid(), g_sharedMemoryRingCount.fetch_add(1));
+
+    name_ = std::string(name);
+
+    capacity_ = capacity / SHARED_MEMORY_RING_ALIGNMENT * SHARED_MEMORY_RING_ALIGNMENT;
+    size_ = sizeof(SharedMemoryRingHeader) + capacity_;
+
+    fd_ = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if(fd_ == -1)
+    {
+        put_flog(LOG_ERROR, "could not create shared memory %s: %s", name_.c_str(), strerror(errno));
+        return false;
+    }
+
+    created_ = true;
+
+    if(ftruncate(fd_, size_) != 0)
+    {
+        put_flog(LOG_ERROR, "could not size shared memory %s: %s", name_.c_str(), strerror(errno));
+        finalize();
+        return false;
+    }
+
+    memory_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if(memory_ == MAP_FAILED)
+    {
+        put_flog(LOG_ERROR, "could not map shared memory %s: %s", name_.c_str(), strerror(errno));
+        memory_ = NULL;
+        finalize();
+        return false;
+    }
+
+    header_ = (SharedMemoryRingHeader *)memory_;
+    data_ = (char *)memory_ + sizeof(SharedMemoryRingHeader);
+
+    // the segment is zero-filled, so the ring is empty
+    header_->version = SHARED_MEMORY_RING_VERSION;
+    header_->capacity = capacity_;
+
+    // publish the header
+    header_->magic.store(SHARED_MEMORY_RING_MAGIC);
+
+    return true;
+}
+
+bool SharedMemoryRing::attach(std::string name)
+{
+    finalize();
+
+    name_ = name;
+
+    fd_ = shm_open(name_.c_str(), O_RDWR, 0600);
+
+    if(fd_ == -1)
+    {
+        put_flog(LOG_ERROR, "could not open shared memory %s: %s", name_.c_str(), strerror(errno));
+        return false;
+    }
+
+    // the creating process has already sized and initialized the segment
+    struct stat st;
+
+    if(fstat(fd_, &st) != 0 || (size_t)st.st_size < sizeof(SharedMemoryRingHeader))
+    {
+        put_flog(LOG_ERROR, "invalid shared memory %s", name_.c_str());
+        finalize();
+        return false;
+    }
+
+    size_ = st.st_size;
+
+    memory_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if(memory_ == MAP_FAILED)
+    {
+        put_flog(LOG_ERROR, "could not map shared memory %s: %s", name_.c_str(), strerror(errno));
+        memory_ = NULL;
+        finalize();
+        return false;
+    }
+
+    header_ = (SharedMemoryRingHeader *)memory_;
+    data_ = (char *)memory_ + sizeof(SharedMemoryRingHeader);
+
+    if(header_->magic.load() != SHARED_MEMORY_RING_MAGIC || header_->version != SHARED_MEMORY_RING_VERSION || sizeof(SharedMemoryRingHeader) + header_->capacity != size_)
+    {
+        put_flog(LOG_ERROR, "incompatible shared memory %s", name_.c_str());
+        finalize();
+        return false;
+    }
+
+    capacity_ = header_->capacity;
+
+    return true;
+}
+
+void SharedMemoryRing::unlink()
+{
+    if(created_ == true)
+    {
+        shm_unlink(name_.c_str());
+        created_ = false;
+    }
+}
+
+void SharedMemoryRing::finalize()
+{
+    unlink();
+
+    if(memory_ != NULL)
+    {
+        munmap(memory_, size_);
+        memory_ = NULL;
+    }
+
+    header_ = NULL;
+    data_ = NULL;
+    capacity_ = 0;
+
+    if(fd_ != -1)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool SharedMemoryRing::isAttached()
+{
+    return header_ != NULL;
+}
+
+std::string SharedMemoryRing::getName()
+{
+    return name_;
+}
+
+int SharedMemoryRing::getMaximumRecordSize()
+{
+    // a record of half the capacity fits either before or after the wrap point
+    return (int)(capacity_ / 2) - SHARED_MEMORY_RING_ALIGNMENT;
+}
+
+bool SharedMemoryRing::write(const char * data, int size)
+{
+    if(header_ == NULL || size > getMaximumRecordSize())
+    {
+        return false;
+    }
+
+    uint64_t recordLength = sharedMemoryRingGetRecordLength(size);
+
+    // only this process writes the write position
+    uint64_t writePosition = header_->writePosition.load(std::memory_order_relaxed);
+    uint64_t readPosition = header_->readPosition.load(std::memory_order_acquire);
+
+    uint64_t offset = writePosition % capacity_;
+    uint64_t remaining = capacity_ - offset;
+
+    // records are contiguous, so a record that doesn't fit at the end of the ring starts over at the beginning
+    bool wrap = recordLength > remaining;
+
+    if((wrap == true ? remaining : 0) + recordLength > capacity_ - (writePosition - readPosition))
+    {
+        return false;
+    }
+
+    if(wrap == true)
+    {
+        *(int32_t *)(data_ + offset) = SHARED_MEMORY_RING_PADDING;
+
+        writePosition += remaining;
+        offset = 0;
+    }
+
+    *(int32_t *)(data_ + offset) = size;
+    memcpy(data_ + offset + SHARED_MEMORY_RING_ALIGNMENT, data, size);
+
+    // publish the record
+    header_->writePosition.store(writePosition + recordLength, std::memory_order_release);
+
+    return true;
+}
+
+bool SharedMemoryRing::isEmpty()
+{
+    if(header_ == NULL)
+    {
+        return true;
+    }
+
+    return header_->readPosition.load(std::memory_order_acquire) == header_->writePosition.load(std::memory_order_acquire);
+}
+
+bool SharedMemoryRing::peek(const char * & data, int & size)
+{
+    if(header_ == NULL)
+    {
+        return false;
+    }
+
+    // only this process writes the read position
+    uint64_t readPosition = header_->readPosition.load(std::memory_order_relaxed);
+    uint64_t writePosition = header_->writePosition.load(std::memory_order_acquire);
+
+    if(readPosition == writePosition)
+    {
+        return false;
+    }
+
+    uint64_t offset = readPosition % capacity_;
+
+    // skip padding at the end of the ring
+    if(*(int32_t *)(data_ + offset) == SHARED_MEMORY_RING_PADDING)
+    {
+        readPosition += capacity_ - offset;
+        header_->readPosition.store(readPosition, std::memory_order_release);
+
+        if(readPosition == writePosition)
+        {
+            return false;
+        }
+
+        offset = 0;
+    }
+
+    size = *(int32_t *)(data_ + offset);
+    data = data_ + offset + SHARED_MEMORY_RING_ALIGNMENT;
+
+    // records never wrap; one that would is corrupt
+    if(size < 0 || offset + SHARED_MEMORY_RING_ALIGNMENT + (uint64_t)size > capacity_)
+    {
+        size = -1;
+    }
+
+    return true;
+}
+
+void SharedMemoryRing::pop()
+{
+    const char * data;
+    int size;
+
+    if(peek(data, size) != true || size < 0)
+    {
+        return;
+    }
+
+    uint64_t readPosition = header_->readPosition.load(std::memory_order_relaxed);
+
+    // the record may now be overwritten
+    header_->readPosition.store(readPosition + sharedMemoryRingGetRecordLength(size), std::memory_order_release);
+    header_->readCount.fetch_add(1);
+}
+
+uint64_t SharedMemoryRing::getReadCount()
+{
+    if(header_ == NULL)
+    {
+        return 0;
+    }
+
+    return header_->readCount.load();
+}
@@ -0,0 +1,118 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef SHARED_MEMORY_RING_H
+#define SHARED_MEMORY_RING_H
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+#define SHARED_MEMORY_RING_MAGIC 0x44435352 // "DCSR"
+#define SHARED_MEMORY_RING_VERSION 1
+
+// this structure lives at the start of the shared memory, followed by the ring data
+struct SharedMemoryRingHeader {
+
+    std::atomic<uint32_t> magic; // written last by the creating process
+    uint32_t version;
+    uint64_t capacity;
+
+    // byte positions; these only increase, and are taken modulo the capacity
+    std::atomic<uint64_t> writePosition;
+    std::atomic<uint64_t> readPosition;
+
+    // number of records read
+    std::atomic<uint64_t> readCount;
+};
+
+// a single-producer, single-consumer ring of variable size records in POSIX shared memory, for passing messages between
+// two processes on the same host without copying them through a socket. the producer creates the segment and the
+// consumer attaches to it by name. neither side ever blocks; the producer retries when the ring is full.
+class SharedMemoryRing {
+
+    public:
+
+        SharedMemoryRing();
+        ~SharedMemoryRing();
+
+        // producer: create a new segment with a unique name, with room for capacity bytes of records
+        bool create(size_t capacity);
+
+        // consumer: attach to a segment created by another process
+        bool attach(std::string name);
+
+        // remove the name of the segment; the memory stays mapped until both processes finalize
+        void unlink();
+
+        void finalize();
+
+        bool isAttached();
+        std::string getName();
+
+        // largest record that can ever be written
+        int getMaximumRecordSize();
+
+        // producer: copy a record into the ring. returns false if the ring doesn't have room for it right now.
+        bool write(const char * data, int size);
+
+        // producer: true if all records written have been read
+        bool isEmpty();
+
+        // consumer: get the oldest record without copying it; it stays valid until pop(). size is -1 if the record is
+        // corrupt, in which case the ring shouldn't be read anymore.
+        bool peek(const char * & data, int & size);
+        void pop();
+
+        // number of records read by the consumer, for the producer
+        uint64_t getReadCount();
+
+    private:
+
+        std::string name_;
+        int fd_;
+        void * memory_;
+        size_t size_;
+        bool created_;
+
+        SharedMemoryRingHeader * header_;
+        char * data_;
+        uint64_t capacity_;
+};
+
+#endif
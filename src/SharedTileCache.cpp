@@ -0,0 +1,574 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "SharedTileCache.h"
+#include "log.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <algorithm>
+#include <limits>
+
+SharedTileCache g_sharedTileCache;
+
+SharedTileReference::SharedTileReference(SharedTileCache * cache, int slotIndex, SharedTileCacheSlot * slot, const uchar * data)
+{
+    cache_ = cache;
+    slotIndex_ = slotIndex;
+    slot_ = slot;
+    data_ = data;
+}
+
+SharedTileReference::~SharedTileReference()
+{
+    cache_->unpin(slotIndex_);
+}
+
+QImage SharedTileReference::getImage()
+{
+    return QImage(data_, slot_->width, slot_->height, (QImage::Format)slot_->format);
+}
+
+SharedTileCache::SharedTileCache()
+{
+    // defaults
+    created_ = false;
+    linked_ = false;
+    fd_ = -1;
+    memory_ = NULL;
+    size_ = 0;
+    header_ = NULL;
+    slots_ = NULL;
+    data_ = NULL;
+    processIndex_ = -1;
+    processBit_ = 0;
+    insertCount_ = 0;
+    hitCount_ = 0;
+    missCount_ = 0;
+    evictionCount_ = 0;
+    reclaimCount_ = 0;
+}
+
+SharedTileCache::~SharedTileCache()
+{
+    finalize();
+}
+
+bool SharedTileCache::initialize(size_t budget, int slotSize, std::string runId)
+{
+    unsigned int numSlots = budget / slotSize;
+
+    if(numSlots == 0)
+    {
+        put_flog(LOG_ERROR, "budget %li too small for slot size %i", budget, slotSize);
+        return false;
+    }
+
+    // one cache per user per host per run
+    name_ = "/displaycluster-tiles-" + QString::number(getuid()).toStdString() + "-" + runId;
+
+    // layout: header, slot table, then page-aligned tile data
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t indexSize = sizeof(SharedTileCacheHeader) + numSlots * sizeof(SharedTileCacheSlot);
+    size_t dataOffset = (indexSize + pageSize - 1) / pageSize * pageSize;
+
+    size_ = dataOffset + (size_t)numSlots * (size_t)slotSize;
+
+    // the first process on the host creates the segment
+    bool created = true;
+
+    fd_ = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if(fd_ == -1)
+    {
+        created = false;
+        fd_ = shm_open(name_.c_str(), O_RDWR, 0600);
+    }
+    else
+    {
+        created_ = true;
+        linked_ = true;
+    }
+
+    if(fd_ == -1)
+    {
+        put_flog(LOG_ERROR, "could not open shared memory %s: %s", name_.c_str(), strerror(errno));
+        return false;
+    }
+
+    if(created == true)
+    {
+        if(ftruncate(fd_, size_) != 0)
+        {
+            put_flog(LOG_ERROR, "could not size shared memory %s: %s", name_.c_str(), strerror(errno));
+            finalize();
+            return false;
+        }
+    }
+    else
+    {
+        // wait for the creating process to size the segment
+        struct stat st;
+
+        for(int i=0; i<1000 && (fstat(fd_, &st) != 0 || (size_t)st.st_size != size_); i++)
+        {
+            usleep(1000);
+        }
+
+        if((size_t)st.st_size != size_)
+        {
+            put_flog(LOG_WARN, "shared memory %s has size %li, expected %li; not using shared tile cache", name_.c_str(), (long)st.st_size, size_);
+            finalize();
+            return false;
+        }
+    }
+
+    memory_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+
+    if(memory_ == MAP_FAILED)
+    {
+        put_flog(LOG_ERROR, "could not map shared memory %s: %s", name_.c_str(), strerror(errno));
+        memory_ = NULL;
+        finalize();
+        return false;
+    }
+
+    header_ = (SharedTileCacheHeader *)memory_;
+    slots_ = (SharedTileCacheSlot *)((uchar *)memory_ + sizeof(SharedTileCacheHeader));
+    data_ = (uchar *)memory_ + dataOffset;
+
+    if(created == true)
+    {
+        // the segment is zero-filled, so all slots are empty
+        header_->version = SHARED_TILE_CACHE_VERSION;
+        header_->numSlots = numSlots;
+        header_->slotSize = slotSize;
+        header_->clock = 0;
+
+        // publish the header
+        header_->magic.store(SHARED_TILE_CACHE_MAGIC);
+    }
+    else
+    {
+        for(int i=0; i<1000 && header_->magic.load() != SHARED_TILE_CACHE_MAGIC; i++)
+        {
+            usleep(1000);
+        }
+
+        if(header_->magic.load() != SHARED_TILE_CACHE_MAGIC || header_->version != SHARED_TILE_CACHE_VERSION || header_->numSlots != numSlots || header_->slotSize != (uint32_t)slotSize)
+        {
+            put_flog(LOG_WARN, "incompatible shared memory %s; not using shared tile cache", name_.c_str());
+            finalize();
+            return false;
+        }
+    }
+
+    // take an entry in the process table, after releasing the entries of processes that exited
+    reclaimSlots();
+
+    for(int i=0; i<SHARED_TILE_CACHE_MAX_PROCESSES; i++)
+    {
+        int32_t expected = 0;
+
+        if(header_->processes[i].compare_exchange_strong(expected, (int32_t)getpid()) == true)
+        {
+            processIndex_ = i;
+            processBit_ = (uint64_t)1 << i;
+            break;
+        }
+    }
+
+    if(processIndex_ == -1)
+    {
+        put_flog(LOG_WARN, "more than %i processes attached to shared memory %s; not using shared tile cache", SHARED_TILE_CACHE_MAX_PROCESSES, name_.c_str());
+        finalize();
+        return false;
+    }
+
+    pinCounts_.assign(numSlots, 0);
+
+    put_flog(LOG_INFO, "%s shared tile cache %s with %i slots of %i bytes", created == true ? "created" : "attached to", name_.c_str(), numSlots, slotSize);
+
+    return true;
+}
+
+void SharedTileCache::finalize()
+{
+    // references may outlive the cache; they find slots_ NULL when they unpin
+    QMutexLocker locker(&pinMutex_);
+
+    if(processIndex_ != -1)
+    {
+        // release our pins and our process table entry
+        for(unsigned int i=0; i<pinCounts_.size(); i++)
+        {
+            if(pinCounts_[i] > 0)
+            {
+                slots_[i].readers.fetch_and(~processBit_);
+            }
+        }
+
+        header_->processes[processIndex_].store(0);
+
+        processIndex_ = -1;
+        processBit_ = 0;
+        pinCounts_.clear();
+    }
+
+    if(memory_ != NULL)
+    {
+        put_flog(LOG_INFO, "shared tile cache: %li hits, %li misses, %li evictions, %li reclaimed", hitCount_.load(), missCount_.load(), evictionCount_.load(), reclaimCount_.load());
+
+        munmap(memory_, size_);
+        memory_ = NULL;
+    }
+
+    header_ = NULL;
+    slots_ = NULL;
+    data_ = NULL;
+
+    if(fd_ != -1)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+
+    // in case we never got to unlink it after startup
+    unlinkName();
+}
+
+void SharedTileCache::unlinkName()
+{
+    if(created_ == true && linked_ == true)
+    {
+        shm_unlink(name_.c_str());
+        linked_ = false;
+    }
+}
+
+uint64_t SharedTileCache::getKey(std::string filename)
+{
+    struct stat st;
+
+    if(stat(filename.c_str(), &st) != 0)
+    {
+        return 0;
+    }
+
+    std::string string = filename + ":" + QString::number((qlonglong)st.st_size).toStdString() + ":" + QString::number((qlonglong)st.st_mtime).toStdString();
+
+    // 64-bit FNV-1a hash
+    uint64_t hash = 14695981039346656037ULL;
+
+    for(unsigned int i=0; i<string.size(); i++)
+    {
+        hash ^= (unsigned char)string[i];
+        hash *= 1099511628211ULL;
+    }
+
+    // zero marks an unused key
+    if(hash == 0)
+    {
+        hash = 1;
+    }
+
+    return hash;
+}
+
+boost::shared_ptr<SharedTileReference> SharedTileCache::find(uint64_t key)
+{
+    if(slots_ == NULL || key == 0)
+    {
+        return boost::shared_ptr<SharedTileReference>();
+    }
+
+    unsigned int numSlots = header_->numSlots;
+    unsigned int start = key % numSlots;
+
+    for(unsigned int probe=0; probe<SHARED_TILE_CACHE_PROBE_LENGTH && probe<numSlots; probe++)
+    {
+        unsigned int i = (start + probe) % numSlots;
+
+        SharedTileCacheSlot * slot = &slots_[i];
+
+        if(slot->key.load() != key)
+        {
+            continue;
+        }
+
+        if(pin(i, key) == true)
+        {
+            slot->lastUsed.store(header_->clock.fetch_add(1) + 1);
+            hitCount_++;
+
+            return boost::shared_ptr<SharedTileReference>(new SharedTileReference(this, i, slot, data_ + (size_t)i * header_->slotSize));
+        }
+    }
+
+    missCount_++;
+
+    return boost::shared_ptr<SharedTileReference>();
+}
+
+void SharedTileCache::insert(uint64_t key, const QImage &image)
+{
+    if(slots_ == NULL || key == 0 || image.isNull() == true || image.byteCount() > (int)header_->slotSize)
+    {
+        return;
+    }
+
+    // check for slots left behind by crashed processes every so often
+    if(insertCount_.fetch_add(1) % SHARED_TILE_CACHE_RECLAIM_INTERVAL == 0)
+    {
+        reclaimSlots();
+    }
+
+    unsigned int numSlots = header_->numSlots;
+    unsigned int start = key % numSlots;
+    unsigned int probeLength = std::min((unsigned int)SHARED_TILE_CACHE_PROBE_LENGTH, numSlots);
+
+    // another process may have published it already
+    for(unsigned int probe=0; probe<probeLength; probe++)
+    {
+        unsigned int i = (start + probe) % numSlots;
+
+        if(slots_[i].key.load() == key && slots_[i].state.load() != SHARED_TILE_EMPTY)
+        {
+            return;
+        }
+    }
+
+    // the state of a slot we write holds our pid
+    uint32_t writingState = SHARED_TILE_WRITING | ((uint32_t)getpid() << SHARED_TILE_STATE_BITS);
+
+    // a few attempts in case we race with other processes for the same victim
+    for(int attempt=0; attempt<4; attempt++)
+    {
+        // find an empty slot, or else the least recently used unpinned slot
+        int victim = -1;
+        uint32_t victimState = SHARED_TILE_EMPTY;
+        uint64_t minLastUsed = std::numeric_limits<uint64_t>::max();
+
+        for(unsigned int probe=0; probe<probeLength; probe++)
+        {
+            unsigned int i = (start + probe) % numSlots;
+
+            uint32_t state = slots_[i].state.load();
+
+            if(state == SHARED_TILE_EMPTY)
+            {
+                victim = i;
+                victimState = state;
+                break;
+            }
+            else if(state == SHARED_TILE_READY && slots_[i].readers.load() == 0 && slots_[i].lastUsed.load() < minLastUsed)
+            {
+                victim = i;
+                victimState = state;
+                minLastUsed = slots_[i].lastUsed.load();
+            }
+        }
+
+        if(victim == -1)
+        {
+            // everything is pinned or being written; once, see if crashed processes are holding the slots
+            if(attempt == 0)
+            {
+                reclaimSlots();
+                continue;
+            }
+
+            return;
+        }
+
+        SharedTileCacheSlot * slot = &slots_[victim];
+
+        // claim the slot
+        uint32_t expected = victimState;
+
+        if(slot->state.compare_exchange_strong(expected, writingState) != true)
+        {
+            continue;
+        }
+
+        // a reader pinned it before we claimed it
+        if(slot->readers.load() != 0)
+        {
+            slot->state.store(victimState);
+            continue;
+        }
+
+        slot->writeTime.store(getTime());
+
+        if(victimState == SHARED_TILE_READY)
+        {
+            evictionCount_++;
+        }
+
+        slot->key.store(key);
+        slot->width = image.width();
+        slot->height = image.height();
+        slot->format = image.format();
+
+        memcpy(data_ + (size_t)victim * header_->slotSize, image.constBits(), image.byteCount());
+
+        slot->lastUsed.store(header_->clock.fetch_add(1) + 1);
+        slot->writeTime.store(0);
+
+        // publish, unless the slot was reclaimed from us
+        expected = writingState;
+        slot->state.compare_exchange_strong(expected, SHARED_TILE_READY);
+
+        return;
+    }
+}
+
+void SharedTileCache::unpin(int slotIndex)
+{
+    QMutexLocker locker(&pinMutex_);
+
+    if(slots_ == NULL)
+    {
+        return;
+    }
+
+    pinCounts_[slotIndex]--;
+
+    if(pinCounts_[slotIndex] == 0)
+    {
+        slots_[slotIndex].readers.fetch_and(~processBit_);
+    }
+}
+
+bool SharedTileCache::pin(int slotIndex, uint64_t key)
+{
+    SharedTileCacheSlot * slot = &slots_[slotIndex];
+
+    {
+        QMutexLocker locker(&pinMutex_);
+
+        pinCounts_[slotIndex]++;
+
+        if(pinCounts_[slotIndex] == 1)
+        {
+            slot->readers.fetch_or(processBit_);
+        }
+    }
+
+    // make sure the slot still holds our tile; a writer may have claimed it in the meantime
+    if(slot->state.load() == SHARED_TILE_READY && slot->key.load() == key)
+    {
+        return true;
+    }
+
+    unpin(slotIndex);
+
+    return false;
+}
+
+void SharedTileCache::reclaimSlots()
+{
+    int32_t pid = (int32_t)getpid();
+
+    // pins of processes that exited
+    for(int i=0; i<SHARED_TILE_CACHE_MAX_PROCESSES; i++)
+    {
+        int32_t processPid = header_->processes[i].load();
+
+        if(processPid == 0 || processPid == pid || isProcessAlive(processPid) == true)
+        {
+            continue;
+        }
+
+        uint64_t processBit = (uint64_t)1 << i;
+
+        for(unsigned int j=0; j<header_->numSlots; j++)
+        {
+            if((slots_[j].readers.fetch_and(~processBit) & processBit) != 0)
+            {
+                reclaimCount_++;
+            }
+        }
+
+        // free the entry for another process
+        header_->processes[i].compare_exchange_strong(processPid, 0);
+    }
+
+    // slots left being written by processes that exited or are stuck
+    uint64_t time = getTime();
+
+    for(unsigned int j=0; j<header_->numSlots; j++)
+    {
+        uint32_t state = slots_[j].state.load();
+
+        if((state & SHARED_TILE_STATE_MASK) != SHARED_TILE_WRITING)
+        {
+            continue;
+        }
+
+        int32_t writerPid = (int32_t)(state >> SHARED_TILE_STATE_BITS);
+        uint64_t writeTime = slots_[j].writeTime.load();
+
+        if(isProcessAlive(writerPid) != true || (writeTime != 0 && time - writeTime > SHARED_TILE_CACHE_WRITE_TIMEOUT))
+        {
+            if(slots_[j].state.compare_exchange_strong(state, SHARED_TILE_EMPTY) == true)
+            {
+                reclaimCount_++;
+            }
+        }
+    }
+}
+
+bool SharedTileCache::isProcessAlive(int32_t pid)
+{
+    // EPERM means the process exists but belongs to someone else
+    return (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+uint64_t SharedTileCache::getTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,198 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef SHARED_TILE_CACHE_H
+#define SHARED_TILE_CACHE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <QtGui>
+#include <boost/shared_ptr.hpp>
+
+#define SHARED_TILE_CACHE_MAGIC 0x44435443 // "DCTC"
+#define SHARED_TILE_CACHE_VERSION 2
+
+// maximum number of processes attached to the cache; each has one bit in the slots' reader masks
+#define SHARED_TILE_CACHE_MAX_PROCESSES 64
+
+// number of slots a key may be stored in, starting at its hashed position
+#define SHARED_TILE_CACHE_PROBE_LENGTH 16
+
+// a slot being written for longer than this (milliseconds) belongs to a stuck or crashed process
+#define SHARED_TILE_CACHE_WRITE_TIMEOUT 10000
+
+// number of inserts by a process between checks for slots left behind by crashed processes
+#define SHARED_TILE_CACHE_RECLAIM_INTERVAL 1024
+
+// a slot's state is one of these in the low bits; a writing slot also holds the writer's pid above them, so the
+// owner of a claimed slot is always known
+enum SHARED_TILE_STATE { SHARED_TILE_EMPTY, SHARED_TILE_WRITING, SHARED_TILE_READY };
+
+#define SHARED_TILE_STATE_BITS 2
+#define SHARED_TILE_STATE_MASK ((1 << SHARED_TILE_STATE_BITS) - 1)
+
+// these structures live in shared memory and are accessed by all processes on the host
+struct SharedTileCacheHeader {
+
+    std::atomic<uint32_t> magic; // written last by the creating process
+    uint32_t version;
+    uint32_t numSlots;
+    uint32_t slotSize;
+
+    // logical clock for LRU ordering
+    std::atomic<uint64_t> clock;
+
+    // pids of the attached processes, indexed by their reader bit; 0 if unused
+    std::atomic<int32_t> processes[SHARED_TILE_CACHE_MAX_PROCESSES];
+};
+
+struct SharedTileCacheSlot {
+
+    std::atomic<uint64_t> key;
+    std::atomic<uint32_t> state;
+    std::atomic<uint64_t> readers; // one bit per process pinning the slot; pinned slots are never evicted
+    std::atomic<uint64_t> lastUsed;
+
+    // when the write started (milliseconds on the monotonic clock); 0 while not written
+    std::atomic<uint64_t> writeTime;
+
+    int32_t width;
+    int32_t height;
+    int32_t format;
+};
+
+class SharedTileCache;
+
+// a pinned, read-only tile in the shared cache; the slot is unpinned on destruction
+class SharedTileReference {
+
+    public:
+
+        SharedTileReference(SharedTileCache * cache, int slotIndex, SharedTileCacheSlot * slot, const uchar * data);
+        ~SharedTileReference();
+
+        // the image refers directly to shared memory and is only valid while this reference exists
+        QImage getImage();
+
+    private:
+
+        SharedTileCache * cache_;
+        int slotIndex_;
+        SharedTileCacheSlot * slot_;
+        const uchar * data_;
+};
+
+// host-wide cache of decoded tiles in POSIX shared memory, shared by all render processes on a host.
+// the first process to decode a tile publishes it, and the others use it without reading or decoding the file.
+// the index is a fixed table of slots updated with atomic operations; no locks are held across processes. a key is
+// stored in one of SHARED_TILE_CACHE_PROBE_LENGTH slots following its hashed position. slots pinned or being written
+// by processes that crashed are reclaimed.
+class SharedTileCache {
+
+    public:
+
+        SharedTileCache();
+        ~SharedTileCache();
+
+        // create or attach to the cache for this host and run; budget is the total size of cached tiles in bytes
+        // runId must be the same for all processes of the run, and differ between runs
+        bool initialize(size_t budget, int slotSize, std::string runId);
+        void finalize();
+
+        // remove the name of the segment once all processes on the host have attached; the memory is freed when the
+        // last process unmaps it, even if processes crash. only the creating process does this
+        void unlinkName();
+
+        // key for a tile file, including its size and modification time so rewritten files aren't served stale
+        // returns 0 if the file can't be found
+        static uint64_t getKey(std::string filename);
+
+        // returns a pinned reference on a hit, or a NULL pointer on a miss
+        boost::shared_ptr<SharedTileReference> find(uint64_t key);
+
+        // publish a tile, evicting the least recently used unpinned tile among the key's slots if necessary
+        void insert(uint64_t key, const QImage &image);
+
+        // called by SharedTileReference
+        void unpin(int slotIndex);
+
+    private:
+
+        std::string name_;
+        bool created_;
+        bool linked_;
+        int fd_;
+        void * memory_;
+        size_t size_;
+
+        SharedTileCacheHeader * header_;
+        SharedTileCacheSlot * slots_;
+        uchar * data_;
+
+        // our index in the header's process table, and our bit in the slots' reader masks
+        int processIndex_;
+        uint64_t processBit_;
+
+        // mutex and number of references this process holds on each slot; a slot's reader bit is set while the
+        // count is non-zero
+        QMutex pinMutex_;
+        std::vector<int> pinCounts_;
+
+        // inserts since the last reclaim
+        std::atomic<long> insertCount_;
+
+        // statistics for this process
+        std::atomic<long> hitCount_;
+        std::atomic<long> missCount_;
+        std::atomic<long> evictionCount_;
+        std::atomic<long> reclaimCount_;
+
+        bool pin(int slotIndex, uint64_t key);
+
+        // release slots pinned by processes that exited, and slots left in SHARED_TILE_WRITING
+        void reclaimSlots();
+
+        static bool isProcessAlive(int32_t pid);
+        static uint64_t getTime();
+};
+
+extern SharedTileCache g_sharedTileCache;
+
+#endif
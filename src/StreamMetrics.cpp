@@ -0,0 +1,431 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#include "StreamMetrics.h"
+#include "main.h"
+#include "log.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+StreamMetrics g_streamMetrics;
+
+const char * g_streamLatencyStageNames[STREAM_LATENCY_STAGES] = { "client", "master", "broadcast", "decode", "upload", "display" };
+
+StreamTimestamps::StreamTimestamps()
+{
+    // defaults
+    capture = 0;
+    received = 0;
+    broadcast = 0;
+    rankReceived = 0;
+    decoded = 0;
+    uploaded = 0;
+}
+
+bool StreamTimestamps::getLatency(long long displayed, long long latency[STREAM_LATENCY_STAGES]) const
+{
+    long long timestamps[STREAM_LATENCY_STAGES + 1] = { capture, received, broadcast, rankReceived, decoded, uploaded, displayed };
+
+    for(int i=0; i<STREAM_LATENCY_STAGES; i++)
+    {
+        if(timestamps[i] == 0 || timestamps[i+1] == 0)
+        {
+            return false;
+        }
+
+        latency[i] = timestamps[i+1] - timestamps[i];
+    }
+
+    return true;
+}
+
+StreamMetricsCounters::StreamMetricsCounters()
+{
+    // defaults
+    bytesReceived = 0;
+    segmentsReceived = 0;
+    segmentsDropped = 0;
+    segmentsSuperseded = 0;
+    segmentsDecoded = 0;
+    decodeTime = 0;
+    texturesUploaded = 0;
+    uploadTime = 0;
+    framesDisplayed = 0;
+    queueDepth = 0;
+    maxQueueDepth = 0;
+    latencyCount = 0;
+    maxLatency = 0;
+
+    for(int i=0; i<STREAM_METRICS_HISTOGRAM_BINS; i++)
+    {
+        decodeTimeHistogram[i] = 0;
+    }
+
+    for(int i=0; i<STREAM_LATENCY_STAGES; i++)
+    {
+        latency[i] = 0;
+    }
+}
+
+void StreamMetricsCounters::addReceived(int bytes)
+{
+    bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+    segmentsReceived.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StreamMetricsCounters::addDecode(long long microseconds)
+{
+    segmentsDecoded.fetch_add(1, std::memory_order_relaxed);
+    decodeTime.fetch_add(microseconds, std::memory_order_relaxed);
+
+    // bin i holds decodes under 2^i milliseconds
+    int bin = 0;
+
+    for(long long milliseconds = microseconds / 1000; milliseconds > 0 && bin < STREAM_METRICS_HISTOGRAM_BINS - 1; milliseconds /= 2)
+    {
+        bin++;
+    }
+
+    decodeTimeHistogram[bin].fetch_add(1, std::memory_order_relaxed);
+}
+
+void StreamMetricsCounters::addUpload(long long microseconds)
+{
+    texturesUploaded.fetch_add(1, std::memory_order_relaxed);
+    uploadTime.fetch_add(microseconds, std::memory_order_relaxed);
+}
+
+void StreamMetricsCounters::setQueueDepth(int depth)
+{
+    queueDepth.store(depth, std::memory_order_relaxed);
+
+    int maxDepth = maxQueueDepth.load(std::memory_order_relaxed);
+
+    while(depth > maxDepth && maxQueueDepth.compare_exchange_weak(maxDepth, depth, std::memory_order_relaxed) != true);
+}
+
+void StreamMetricsCounters::addLatency(const long long stageLatency[STREAM_LATENCY_STAGES])
+{
+    long long total = 0;
+
+    for(int i=0; i<STREAM_LATENCY_STAGES; i++)
+    {
+        latency[i].fetch_add(stageLatency[i], std::memory_order_relaxed);
+        total += stageLatency[i];
+    }
+
+    latencyCount.fetch_add(1, std::memory_order_relaxed);
+
+    long long max = maxLatency.load(std::memory_order_relaxed);
+
+    while(total > max && maxLatency.compare_exchange_weak(max, total, std::memory_order_relaxed) != true);
+}
+
+StreamMetricsSnapshot::StreamMetricsSnapshot()
+{
+    // defaults
+    rank = 0;
+    bytesReceived = 0;
+    segmentsReceived = 0;
+    segmentsDropped = 0;
+    segmentsSuperseded = 0;
+    segmentsDecoded = 0;
+    decodeTime = 0;
+    decodeTimeHistogram.resize(STREAM_METRICS_HISTOGRAM_BINS, 0);
+    texturesUploaded = 0;
+    uploadTime = 0;
+    framesDisplayed = 0;
+    queueDepth = 0;
+    maxQueueDepth = 0;
+    latencyCount = 0;
+    latency.resize(STREAM_LATENCY_STAGES, 0);
+    maxLatency = 0;
+}
+
+StreamMetrics::StreamMetrics()
+{
+    // defaults
+    exportInterval_ = DEFAULT_STREAM_METRICS_EXPORT_INTERVAL;
+}
+
+boost::shared_ptr<StreamMetricsCounters> StreamMetrics::getCounters(std::string uri)
+{
+    QMutexLocker locker(&countersMutex_);
+
+    if(counters_.count(uri) == 0)
+    {
+        counters_[uri] = boost::shared_ptr<StreamMetricsCounters>(new StreamMetricsCounters());
+    }
+
+    return counters_[uri];
+}
+
+std::vector<StreamMetricsSnapshot> StreamMetrics::getSnapshots()
+{
+    QMutexLocker locker(&countersMutex_);
+
+    std::vector<StreamMetricsSnapshot> snapshots;
+
+    std::map<std::string, boost::shared_ptr<StreamMetricsCounters> >::iterator it;
+
+    for(it = counters_.begin(); it != counters_.end(); it++)
+    {
+        StreamMetricsCounters & c = *(it->second);
+
+        StreamMetricsSnapshot s;
+        s.uri = it->first;
+        s.rank = g_mpiRank;
+        s.bytesReceived = c.bytesReceived.load(std::memory_order_relaxed);
+        s.segmentsReceived = c.segmentsReceived.load(std::memory_order_relaxed);
+        s.segmentsDropped = c.segmentsDropped.load(std::memory_order_relaxed);
+        s.segmentsSuperseded = c.segmentsSuperseded.load(std::memory_order_relaxed);
+        s.segmentsDecoded = c.segmentsDecoded.load(std::memory_order_relaxed);
+        s.decodeTime = c.decodeTime.load(std::memory_order_relaxed);
+        s.texturesUploaded = c.texturesUploaded.load(std::memory_order_relaxed);
+        s.uploadTime = c.uploadTime.load(std::memory_order_relaxed);
+        s.framesDisplayed = c.framesDisplayed.load(std::memory_order_relaxed);
+        s.queueDepth = c.queueDepth.load(std::memory_order_relaxed);
+        s.maxQueueDepth = c.maxQueueDepth.load(std::memory_order_relaxed);
+
+        s.latencyCount = c.latencyCount.load(std::memory_order_relaxed);
+        s.maxLatency = c.maxLatency.load(std::memory_order_relaxed);
+
+        for(int i=0; i<STREAM_METRICS_HISTOGRAM_BINS; i++)
+        {
+            s.decodeTimeHistogram[i] = c.decodeTimeHistogram[i].load(std::memory_order_relaxed);
+        }
+
+        for(int i=0; i<STREAM_LATENCY_STAGES; i++)
+        {
+            s.latency[i] = c.latency[i].load(std::memory_order_relaxed);
+        }
+
+        snapshots.push_back(s);
+    }
+
+    return snapshots;
+}
+
+void StreamMetrics::setExport(std::string filename, int interval)
+{
+    // insert the rank before the suffix, so processes sharing a file system don't write to the same file
+    QFileInfo fileInfo(QString(filename.c_str()));
+
+    QString rankFilename = fileInfo.completeBaseName() + "." + QString::number(g_mpiRank);
+
+    if(fileInfo.suffix().isEmpty() != true)
+    {
+        rankFilename += "." + fileInfo.suffix();
+    }
+
+    exportFilename_ = QDir(fileInfo.path()).filePath(rankFilename).toStdString();
+    exportInterval_ = interval > 0 ? interval : DEFAULT_STREAM_METRICS_EXPORT_INTERVAL;
+    exportTime_.start();
+
+    put_flog(LOG_INFO, "exporting stream metrics to %s every %i seconds", exportFilename_.c_str(), exportInterval_);
+}
+
+void StreamMetrics::update()
+{
+    if(exportFilename_.empty() == true || exportTime_.elapsed() < exportInterval_ * 1000)
+    {
+        return;
+    }
+
+    exportTime_.restart();
+
+    std::vector<StreamMetricsSnapshot> snapshots = getSnapshots();
+
+    if(snapshots.size() > 0)
+    {
+        writeSnapshots(exportFilename_, snapshots);
+    }
+}
+
+void StreamMetrics::finalize()
+{
+    if(exportFilename_.empty() == true)
+    {
+        return;
+    }
+
+    std::vector<StreamMetricsSnapshot> snapshots = getSnapshots();
+
+    if(snapshots.size() > 0)
+    {
+        writeSnapshots(exportFilename_, snapshots);
+    }
+
+    exportFilename_.clear();
+}
+
+bool StreamMetrics::writeSnapshots(std::string filename, const std::vector<StreamMetricsSnapshot> & snapshots)
+{
+    bool json = QString(filename.c_str()).endsWith(".json", Qt::CaseInsensitive);
+
+    // write a CSV header if the file doesn't exist yet
+    bool header = (json != true && QFileInfo(QString(filename.c_str())).exists() != true);
+
+    std::ofstream ofs(filename.c_str(), std::ios::app);
+
+    if(ofs.good() != true)
+    {
+        put_flog(LOG_ERROR, "could not open %s", filename.c_str());
+        return false;
+    }
+
+    std::string time = QDateTime::currentDateTime().toString(Qt::ISODate).toStdString();
+
+    if(json == true)
+    {
+        ofs << "{\"time\": \"" << time << "\", \"streams\": " << getJSON(snapshots) << "}" << std::endl;
+
+        return ofs.good();
+    }
+
+    if(header == true)
+    {
+        ofs << "time,uri,rank,bytesReceived,segmentsReceived,segmentsDropped,segmentsSuperseded,segmentsDecoded,decodeTime,texturesUploaded,uploadTime,framesDisplayed,queueDepth,maxQueueDepth";
+
+        for(int i=0; i<STREAM_METRICS_HISTOGRAM_BINS; i++)
+        {
+            ofs << ",decodeTimeHistogram" << i;
+        }
+
+        ofs << ",latencyCount,maxLatency";
+
+        for(int i=0; i<STREAM_LATENCY_STAGES; i++)
+        {
+            ofs << "," << g_streamLatencyStageNames[i] << "Latency";
+        }
+
+        ofs << std::endl;
+    }
+
+    for(unsigned int i=0; i<snapshots.size(); i++)
+    {
+        const StreamMetricsSnapshot & s = snapshots[i];
+
+        // quote the uri, doubling any quotes in it
+        QString uri = QString(s.uri.c_str()).replace("\"", "\"\"");
+
+        ofs << time << ",\"" << uri.toStdString() << "\"," << s.rank << "," << s.bytesReceived << "," << s.segmentsReceived << "," << s.segmentsDropped << "," << s.segmentsSuperseded << "," << s.segmentsDecoded << "," << s.decodeTime << "," << s.texturesUploaded << "," << s.uploadTime << "," << s.framesDisplayed << "," << s.queueDepth << "," << s.maxQueueDepth;
+
+        for(unsigned int j=0; j<s.decodeTimeHistogram.size(); j++)
+        {
+            ofs << "," << s.decodeTimeHistogram[j];
+        }
+
+        ofs << "," << s.latencyCount << "," << s.maxLatency;
+
+        for(unsigned int j=0; j<s.latency.size(); j++)
+        {
+            ofs << "," << s.latency[j];
+        }
+
+        ofs << std::endl;
+    }
+
+    return ofs.good();
+}
+
+std::string StreamMetrics::getJSON(const std::vector<StreamMetricsSnapshot> & snapshots)
+{
+    std::ostringstream oss;
+
+    oss << "[";
+
+    for(unsigned int i=0; i<snapshots.size(); i++)
+    {
+        const StreamMetricsSnapshot & s = snapshots[i];
+
+        // escape the uri as a JSON string
+        std::string uri;
+
+        for(unsigned int j=0; j<s.uri.size(); j++)
+        {
+            char c = s.uri[j];
+
+            if(c == '"' || c == '\\')
+            {
+                uri += '\\';
+                uri += c;
+            }
+            else if((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                sprintf(escaped, "\\u%04x", (unsigned char)c);
+                uri += escaped;
+            }
+            else
+            {
+                uri += c;
+            }
+        }
+
+        if(i > 0)
+        {
+            oss << ", ";
+        }
+
+        oss << "{\"uri\": \"" << uri << "\", \"rank\": " << s.rank << ", \"bytesReceived\": " << s.bytesReceived << ", \"segmentsReceived\": " << s.segmentsReceived << ", \"segmentsDropped\": " << s.segmentsDropped << ", \"segmentsSuperseded\": " << s.segmentsSuperseded << ", \"segmentsDecoded\": " << s.segmentsDecoded << ", \"decodeTime\": " << s.decodeTime << ", \"decodeTimeHistogram\": [";
+
+        for(unsigned int j=0; j<s.decodeTimeHistogram.size(); j++)
+        {
+            oss << (j > 0 ? ", " : "") << s.decodeTimeHistogram[j];
+        }
+
+        oss << "], \"texturesUploaded\": " << s.texturesUploaded << ", \"uploadTime\": " << s.uploadTime << ", \"framesDisplayed\": " << s.framesDisplayed << ", \"queueDepth\": " << s.queueDepth << ", \"maxQueueDepth\": " << s.maxQueueDepth << ", \"latencyCount\": " << s.latencyCount << ", \"maxLatency\": " << s.maxLatency << ", \"latency\": {";
+
+        for(unsigned int j=0; j<s.latency.size() && j<STREAM_LATENCY_STAGES; j++)
+        {
+            oss << (j > 0 ? ", " : "") << "\"" << g_streamLatencyStageNames[j] << "\": " << s.latency[j];
+        }
+
+        oss << "}}";
+    }
+
+    oss << "]";
+
+    return oss.str();
+}
+
+long long StreamMetrics::getTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,234 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#ifndef STREAM_METRICS_H
+#define STREAM_METRICS_H
+
+// number of decode time histogram bins: bin 0 counts decodes under 1 ms, bin i decodes under 2^i ms, and the last bin all longer decodes
+#define STREAM_METRICS_HISTOGRAM_BINS 10
+
+// default interval in seconds between exports of the metrics file
+#define DEFAULT_STREAM_METRICS_EXPORT_INTERVAL 10
+
+// number of stages the latency of a displayed segment is split into (STREAM_LATENCY_STAGE)
+#define STREAM_LATENCY_STAGES 6
+
+#include <QtCore>
+#include <boost/shared_ptr.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+// stages of the streaming pipeline, each ending at the next timestamp in StreamTimestamps:
+// capture by the sender to receipt by rank 0, queued on rank 0 until broadcast, broadcast to receipt by the render process,
+// queued and decoded on the render process, waiting for and uploading the texture, and rendering until the buffer swap
+enum STREAM_LATENCY_STAGE { STREAM_LATENCY_CLIENT, STREAM_LATENCY_MASTER, STREAM_LATENCY_BROADCAST, STREAM_LATENCY_DECODE, STREAM_LATENCY_UPLOAD, STREAM_LATENCY_DISPLAY };
+
+extern const char * g_streamLatencyStageNames[STREAM_LATENCY_STAGES];
+
+// times a segment passed through the streaming pipeline, in microseconds since the epoch on the cluster clock
+// (see DisplayGroupManager::getClusterTimestamp()); 0 if not recorded
+struct StreamTimestamps {
+
+    StreamTimestamps();
+
+    // stamped by the sender on its own clock; the client stage includes any offset between its clock and the cluster clock
+    long long capture;
+
+    // on rank 0
+    long long received;
+    long long broadcast;
+
+    // on the render process
+    long long rankReceived;
+    long long decoded;
+    long long uploaded;
+
+    // get the latency of each stage for the segment displayed at displayed; returns false if a timestamp is missing
+    bool getLatency(long long displayed, long long latency[STREAM_LATENCY_STAGES]) const;
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int)
+    {
+        ar & capture;
+        ar & received;
+        ar & broadcast;
+        ar & rankReceived;
+        ar & decoded;
+        ar & uploaded;
+    }
+};
+
+// counters for one stream on this process. they are updated by the network, decoder and render threads without locking;
+// callers should keep the pointer returned by StreamMetrics::getCounters() rather than look it up for every update
+struct StreamMetricsCounters {
+
+    StreamMetricsCounters();
+
+    // segments inserted and their image data size in bytes
+    std::atomic<long long> bytesReceived;
+    std::atomic<long long> segmentsReceived;
+
+    // segments discarded before decoding because their queue overflowed or they weren't visible
+    std::atomic<long long> segmentsDropped;
+
+    // segments discarded before decoding because a newer segment for the same source was taken instead
+    std::atomic<long long> segmentsSuperseded;
+
+    // decoded segments, total decode time in microseconds, and decode time histogram
+    std::atomic<long long> segmentsDecoded;
+    std::atomic<long long> decodeTime;
+    std::atomic<long long> decodeTimeHistogram[STREAM_METRICS_HISTOGRAM_BINS];
+
+    // texture uploads and total upload time in microseconds
+    std::atomic<long long> texturesUploaded;
+    std::atomic<long long> uploadTime;
+
+    // rendered frames showing at least one new segment
+    std::atomic<long long> framesDisplayed;
+
+    // queue depth of the source that last received a segment, and the maximum queue depth of any source
+    std::atomic<int> queueDepth;
+    std::atomic<int> maxQueueDepth;
+
+    // displayed segments with complete timestamps, their total latency in microseconds for each stage, and the maximum end-to-end latency
+    std::atomic<long long> latencyCount;
+    std::atomic<long long> latency[STREAM_LATENCY_STAGES];
+    std::atomic<long long> maxLatency;
+
+    void addReceived(int bytes);
+    void addDecode(long long microseconds);
+    void addUpload(long long microseconds);
+    void setQueueDepth(int depth);
+    void addLatency(const long long stageLatency[STREAM_LATENCY_STAGES]);
+};
+
+// the values of a stream's counters at one point in time, on one process
+struct StreamMetricsSnapshot {
+
+    std::string uri;
+    int rank;
+
+    long long bytesReceived;
+    long long segmentsReceived;
+    long long segmentsDropped;
+    long long segmentsSuperseded;
+    long long segmentsDecoded;
+    long long decodeTime;
+    std::vector<long long> decodeTimeHistogram;
+    long long texturesUploaded;
+    long long uploadTime;
+    long long framesDisplayed;
+    int queueDepth;
+    int maxQueueDepth;
+    long long latencyCount;
+    std::vector<long long> latency;
+    long long maxLatency;
+
+    StreamMetricsSnapshot();
+
+    template<class Archive>
+    void serialize(Archive & ar, const unsigned int)
+    {
+        ar & uri;
+        ar & rank;
+        ar & bytesReceived;
+        ar & segmentsReceived;
+        ar & segmentsDropped;
+        ar & segmentsSuperseded;
+        ar & segmentsDecoded;
+        ar & decodeTime;
+        ar & decodeTimeHistogram;
+        ar & texturesUploaded;
+        ar & uploadTime;
+        ar & framesDisplayed;
+        ar & queueDepth;
+        ar & maxQueueDepth;
+        ar & latencyCount;
+        ar & latency;
+        ar & maxLatency;
+    }
+};
+
+// registry of the stream counters of this process, with periodic export to a CSV or JSON file
+class StreamMetrics {
+
+    public:
+
+        StreamMetrics();
+
+        // get the counters for a stream, creating them if needed. counters are kept after the stream is deleted
+        boost::shared_ptr<StreamMetricsCounters> getCounters(std::string uri);
+
+        // snapshots of the counters of all streams on this process
+        std::vector<StreamMetricsSnapshot> getSnapshots();
+
+        // export to filename every interval seconds; each process writes its own file, with its rank inserted before the suffix
+        void setExport(std::string filename, int interval);
+
+        // called once per frame; exports the snapshots if the export interval has elapsed
+        void update();
+
+        // export the final snapshots
+        void finalize();
+
+        // append snapshots to a file: as JSON, one line per export, if the filename ends in .json; otherwise as CSV
+        static bool writeSnapshots(std::string filename, const std::vector<StreamMetricsSnapshot> & snapshots);
+
+        static std::string getJSON(const std::vector<StreamMetricsSnapshot> & snapshots);
+
+        // microseconds on a monotonic clock, for timing decodes and uploads
+        static long long getTime();
+
+    private:
+
+        // mutex protecting the map only; the counters themselves are lock-free
+        QMutex countersMutex_;
+        std::map<std::string, boost::shared_ptr<StreamMetricsCounters> > counters_;
+
+        // per-process export filename, or empty if exporting is disabled
+        std::string exportFilename_;
+        int exportInterval_;
+        QTime exportTime_;
+};
+
+extern StreamMetrics g_streamMetrics;
+
+#endif
@@ -0,0 +1,204 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#ifndef TILE_WORK_QUEUE_H
+#define TILE_WORK_QUEUE_H
+
+#include <map>
+#include <QtCore>
+
+// schedules work on tiles (e.g. image loads, SVG rasterizations) on a dedicated thread pool.
+// requests are made every frame a tile is wanted; the highest priority request is processed next, and requests that
+// are not renewed (tiles that left the view) are cancelled before they are processed. Request must have a priority;
+// higher priorities are processed first.
+template <class Key, class Request>
+class TileWorkQueue {
+
+    public:
+
+        TileWorkQueue(int maxThreadCount)
+        {
+            // defaults
+            workerCount_ = 0;
+            frameCount_ = 0;
+
+            threadPool_.setMaxThreadCount(maxThreadCount);
+        }
+
+        virtual ~TileWorkQueue()
+        {
+        }
+
+        // set the current frame, which requests are stamped with; the worker threads don't read g_frameCount
+        void setFrameCount(long frameCount)
+        {
+            QMutexLocker locker(&mutex_);
+
+            frameCount_ = frameCount;
+        }
+
+        // called by the worker threads; process requests taken with takeRequest() until it returns false
+        virtual void processQueue() = 0;
+
+    protected:
+
+        // mutex protecting the queue and everything derived classes schedule with it
+        QMutex mutex_;
+
+        // queued requests; keyed by tile so repeated requests (e.g. from multiple windows) are merged
+        std::map<Key, Request> requests_;
+
+        // copy of g_frameCount, for the worker threads
+        long frameCount_;
+
+        // the following must be called with mutex_ locked
+
+        // true if a request stamped with requestFrameCount was not renewed in the last frame
+        bool isFrameCountStale(long requestFrameCount)
+        {
+            return (frameCount_ - requestFrameCount > 1);
+        }
+
+        // start workers for the queued requests, up to the size of the thread pool
+        void startWorkers()
+        {
+            while(workerCount_ < threadPool_.maxThreadCount() && workerCount_ < (int)requests_.size())
+            {
+                workerCount_++;
+                threadPool_.start(new Runnable(this));
+            }
+        }
+
+        // take the highest priority request, cancelling stale requests along the way
+        // priorities are updated every frame, so we search the queue rather than maintaining a heap
+        // returns false when the queue is empty; the calling worker must then return
+        bool takeRequest(Key & key, Request & request)
+        {
+            typename std::map<Key, Request>::iterator best = requests_.end();
+            typename std::map<Key, Request>::iterator it = requests_.begin();
+
+            while(it != requests_.end())
+            {
+                if(isRequestCancelled(it->first, it->second) == true)
+                {
+                    requestCancelled(it->first, it->second);
+
+                    requests_.erase(it++);
+                }
+                else
+                {
+                    if(best == requests_.end() || isHigherPriority(it->second, best->second) == true)
+                    {
+                        best = it;
+                    }
+
+                    it++;
+                }
+            }
+
+            if(best == requests_.end())
+            {
+                // nothing left to do
+                workerCount_--;
+                return false;
+            }
+
+            key = best->first;
+            request = best->second;
+
+            requests_.erase(best);
+
+            return true;
+        }
+
+        // cancel all requests and wait for running work to finish; must be called with mutex_ unlocked
+        void finalizeQueue()
+        {
+            {
+                QMutexLocker locker(&mutex_);
+
+                typename std::map<Key, Request>::iterator it;
+
+                for(it = requests_.begin(); it != requests_.end(); it++)
+                {
+                    requestCancelled(it->first, it->second);
+                }
+
+                requests_.clear();
+            }
+
+            threadPool_.waitForDone();
+        }
+
+        // true if a queued request should be cancelled, e.g. because it is stale
+        virtual bool isRequestCancelled(const Key & key, const Request & request) = 0;
+
+        // called when a request is removed without being processed
+        virtual void requestCancelled(const Key & key, const Request & request) = 0;
+
+        virtual bool isHigherPriority(const Request & request, const Request & other)
+        {
+            return (request.priority > other.priority);
+        }
+
+    private:
+
+        class Runnable : public QRunnable {
+
+            public:
+
+                Runnable(TileWorkQueue * queue)
+                {
+                    queue_ = queue;
+                }
+
+                void run()
+                {
+                    queue_->processQueue();
+                }
+
+            private:
+
+                TileWorkQueue * queue_;
+        };
+
+        // dedicated thread pool and the number of workers processing the queue
+        QThreadPool threadPool_;
+        int workerCount_;
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef WALL_LAYOUT_H
+#define WALL_LAYOUT_H
+
+#ifdef _WIN32
+    typedef __int32 int32_t;
+#else
+    #include <stdint.h>
+#endif
+
+// the layout of the tiled display, and the placement and visibility of a stream's window on it. sent by the server to
+// clients bound to the window, so they can cut segments along screen boundaries, and send images at the resolution
+// they are shown at.
+struct WallLayout {
+
+    // screens and mullions (pixels); numTilesWidth and numTilesHeight are 0 if the layout is unknown
+    int32_t numTilesWidth;
+    int32_t numTilesHeight;
+    int32_t screenWidth;
+    int32_t screenHeight;
+    int32_t mullionWidth;
+    int32_t mullionHeight;
+
+    // window coordinates in tiled display space, where the entire tiled display is (0,0,1,1)
+    double x, y, w, h;
+
+    // window zoom; the window shows 1/zoom of the image in each dimension
+    double zoom;
+
+    // center of the part of the image shown in the window, where the entire image is (0,0,1,1)
+    double centerX, centerY;
+
+    // false if the window is off the tiled display, or covered by another window
+    bool visible;
+
+    WallLayout()
+    {
+        numTilesWidth = numTilesHeight = 0;
+        screenWidth = screenHeight = 0;
+        mullionWidth = mullionHeight = 0;
+        x = y = w = h = 0.;
+        zoom = 1.;
+        centerX = centerY = 0.5;
+        visible = true;
+    }
+
+    bool operator==(const WallLayout & layout) const
+    {
+        return numTilesWidth == layout.numTilesWidth && numTilesHeight == layout.numTilesHeight &&
+            screenWidth == layout.screenWidth && screenHeight == layout.screenHeight &&
+            mullionWidth == layout.mullionWidth && mullionHeight == layout.mullionHeight &&
+            x == layout.x && y == layout.y && w == layout.w && h == layout.h &&
+            zoom == layout.zoom && centerX == layout.centerX && centerY == layout.centerY &&
+            visible == layout.visible;
+    }
+
+    bool operator!=(const WallLayout & layout) const
+    {
+        return !(*this == layout);
+    }
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DcAsyncSender.h"
+#include "../log.h"
+#include <algorithm>
+#include <string.h>
+
+// defined in dcStream.cpp
+extern bool dcStreamSendFrame(DcStream * stream, DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, int frameIndex, long long captureTimestamp);
+
+DcAsyncSender::DcAsyncSender(DcStream * stream, DcSocket * socket)
+{
+    // defaults
+    policy_ = ASYNC_DROP_OLDEST;
+    maxQueuedFrames_ = 1;
+    sending_ = false;
+    allSuccess_ = true;
+    quit_ = false;
+
+    // assign values
+    stream_ = stream;
+    socket_ = socket;
+
+    start();
+}
+
+DcAsyncSender::~DcAsyncSender()
+{
+    {
+        QMutexLocker locker(&mutex_);
+
+        quit_ = true;
+        framesChanged_.wakeAll();
+    }
+
+    wait();
+
+    for(unsigned int i=0; i<freeFrames_.size(); i++)
+    {
+        delete freeFrames_[i];
+    }
+}
+
+void DcAsyncSender::setPolicy(ASYNC_POLICY policy, int maxQueuedFrames)
+{
+    QMutexLocker locker(&mutex_);
+
+    policy_ = policy;
+    maxQueuedFrames_ = std::max(maxQueuedFrames, 0);
+}
+
+void DcAsyncSender::queueFrame(unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, int frameIndex, long long captureTimestamp, DcStreamSendCallback callback, void * userData)
+{
+    // a frame dropped to make room for this one
+    DcAsyncFrame * droppedFrame = NULL;
+    int droppedFrameIndex = 0;
+    DcStreamSendCallback droppedCallback = NULL;
+    void * droppedUserData = NULL;
+
+    DcAsyncFrame * frame = NULL;
+
+    {
+        QMutexLocker locker(&mutex_);
+
+        if(policy_ == ASYNC_BLOCK)
+        {
+            while(queuedFrames_.size() > 0 && queuedFrames_.size() >= maxQueuedFrames_)
+            {
+                framesChanged_.wait(&mutex_);
+            }
+        }
+        else if(policy_ == ASYNC_DROP_OLDEST && queuedFrames_.size() > 0 && queuedFrames_.size() >= maxQueuedFrames_)
+        {
+            // reuse the dropped frame for this one
+            droppedFrame = queuedFrames_.front();
+            queuedFrames_.pop();
+
+            droppedFrameIndex = droppedFrame->frameIndex;
+            droppedCallback = droppedFrame->callback;
+            droppedUserData = droppedFrame->userData;
+
+            frame = droppedFrame;
+        }
+
+        if(frame == NULL && freeFrames_.size() > 0)
+        {
+            frame = freeFrames_.back();
+            freeFrames_.pop_back();
+        }
+    }
+
+    if(droppedFrame != NULL && droppedCallback != NULL)
+    {
+        droppedCallback(SEND_DROPPED, droppedFrameIndex, droppedUserData);
+    }
+
+    if(frame == NULL)
+    {
+        frame = new DcAsyncFrame();
+    }
+
+    // copy the frame; the application may reuse its buffer as soon as this returns
+    // buffers of recycled frames are reused if they are large enough
+    int imageSize = imageHeight * imagePitch;
+
+    if(frame->image.size() < imageSize)
+    {
+        frame->image.resize(imageSize);
+    }
+
+    memcpy(frame->image.data(), imageBuffer, imageSize);
+
+    frame->imageX = imageX;
+    frame->imageY = imageY;
+    frame->imageWidth = imageWidth;
+    frame->imagePitch = imagePitch;
+    frame->imageHeight = imageHeight;
+    frame->pixelFormat = pixelFormat;
+    frame->parameters = parameters;
+    frame->frameIndex = frameIndex;
+    frame->captureTimestamp = captureTimestamp;
+    frame->callback = callback;
+    frame->userData = userData;
+
+    QMutexLocker locker(&mutex_);
+
+    queuedFrames_.push(frame);
+    framesChanged_.wakeAll();
+}
+
+bool DcAsyncSender::waitForFrames()
+{
+    QMutexLocker locker(&mutex_);
+
+    while(queuedFrames_.size() > 0 || sending_ == true)
+    {
+        framesChanged_.wait(&mutex_);
+    }
+
+    bool allSuccess = allSuccess_;
+    allSuccess_ = true;
+
+    return allSuccess;
+}
+
+void DcAsyncSender::run()
+{
+    while(true)
+    {
+        DcAsyncFrame * frame = NULL;
+
+        {
+            QMutexLocker locker(&mutex_);
+
+            while(queuedFrames_.size() == 0 && quit_ == false)
+            {
+                framesChanged_.wait(&mutex_);
+            }
+
+            if(queuedFrames_.size() == 0)
+            {
+                break;
+            }
+
+            frame = queuedFrames_.front();
+            queuedFrames_.pop();
+
+            sending_ = true;
+            framesChanged_.wakeAll();
+        }
+
+        bool success = dcStreamSendFrame(stream_, socket_, (unsigned char *)frame->image.data(), frame->imageX, frame->imageY, frame->imageWidth, frame->imagePitch, frame->imageHeight, frame->pixelFormat, frame->parameters, frame->frameIndex, frame->captureTimestamp);
+
+        if(success != true)
+        {
+            put_flog(LOG_WARN, "failed to send frame %i", frame->frameIndex);
+        }
+
+        if(frame->callback != NULL)
+        {
+            frame->callback(success == true ? SEND_SUCCESS : SEND_FAILURE, frame->frameIndex, frame->userData);
+        }
+
+        QMutexLocker locker(&mutex_);
+
+        freeFrames_.push_back(frame);
+
+        sending_ = false;
+        allSuccess_ = allSuccess_ && success;
+        framesChanged_.wakeAll();
+    }
+}
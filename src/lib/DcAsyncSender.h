@@ -0,0 +1,111 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DC_ASYNC_SENDER_H
+#define DC_ASYNC_SENDER_H
+
+#include "dcStream.h"
+#include "../RingBuffer.h"
+#include <QtCore>
+
+// a copy of a frame queued by dcStreamSendAsync()
+struct DcAsyncFrame {
+    QByteArray image;
+    int imageX;
+    int imageY;
+    int imageWidth;
+    int imagePitch;
+    int imageHeight;
+    PIXEL_FORMAT pixelFormat;
+    std::vector<DcStreamParameters> parameters;
+    int frameIndex;
+    long long captureTimestamp;
+    DcStreamSendCallback callback;
+    void * userData;
+};
+
+// sends frames queued by dcStreamSendAsync() on its own thread, one frame at a time, for one socket of a stream.
+// frame copies are recycled rather than reallocated for every frame.
+class DcAsyncSender : public QThread {
+
+    public:
+
+        DcAsyncSender(DcStream * stream, DcSocket * socket);
+        ~DcAsyncSender(); // sends any queued frames first
+
+        void setPolicy(ASYNC_POLICY policy, int maxQueuedFrames);
+
+        // copy the frame and queue it, applying the policy if too many frames are queued
+        void queueFrame(unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, int frameIndex, long long captureTimestamp, DcStreamSendCallback callback, void * userData);
+
+        // wait until no frames are queued or being sent; returns false if any frame failed since the last call
+        bool waitForFrames();
+
+    protected:
+
+        void run();
+
+    private:
+
+        DcStream * stream_;
+        DcSocket * socket_;
+
+        // mutex and condition for everything below; the condition is signaled whenever a frame is started or finished
+        QMutex mutex_;
+        QWaitCondition framesChanged_;
+
+        ASYNC_POLICY policy_;
+        int maxQueuedFrames_;
+
+        // frames waiting to be sent, oldest first
+        RingBuffer<DcAsyncFrame *> queuedFrames_;
+
+        // recycled frames
+        std::vector<DcAsyncFrame *> freeFrames_;
+
+        // a frame is being sent
+        bool sending_;
+
+        // no frame failed since the last waitForFrames()
+        bool allSuccess_;
+
+        // the thread exits when set and no frames are queued
+        bool quit_;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#ifndef DC_HIDDEN_FRAME_THROTTLE_H
+#define DC_HIDDEN_FRAME_THROTTLE_H
+
+#include <QtCore>
+#include <map>
+#include <string>
+#include <utility>
+
+// while the window showing a stream is hidden, send frames at most this often (milliseconds)
+#define DC_HIDDEN_FRAME_INTERVAL 1000
+
+// while the window showing a stream is hidden, only send a frame every interval.
+// a frame may be sent in several calls (e.g. by dcStreamParallelSend()), so all segments of a frame that is sent are
+// sent. without a frame index the calls can't be grouped into frames, so each segment is throttled on its own; a call
+// sending a whole frame is then throttled by its first segment.
+class DcHiddenFrameThrottle {
+
+    public:
+
+        DcHiddenFrameThrottle(int interval=DC_HIDDEN_FRAME_INTERVAL); // milliseconds
+
+        // true if a segment of frameIndex (or FRAME_INDEX_UNDEFINED) should be sent now
+        bool send(int frameIndex, const std::string & name, int sourceIndex);
+
+    private:
+
+        int interval_;
+
+        // the last frame sent
+        QTime frameTime_;
+        int frameIndex_;
+
+        // the last time each segment without a frame index was sent, by stream name and source index
+        std::map<std::pair<std::string, int>, QTime> segmentTimes_;
+};
+
+#endif
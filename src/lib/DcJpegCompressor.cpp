@@ -0,0 +1,92 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DcJpegCompressor.h"
+#include "../log.h"
+#include <QtCore>
+
+// per-thread compressors; destroyed when their threads exit
+static QThreadStorage<DcJpegCompressor *> g_dcJpegCompressors;
+
+DcJpegCompressor::DcJpegCompressor()
+{
+    handle_ = tjInitCompress();
+}
+
+DcJpegCompressor::~DcJpegCompressor()
+{
+    tjDestroy(handle_);
+}
+
+DcJpegCompressor & DcJpegCompressor::getThreadCompressor()
+{
+    if(g_dcJpegCompressors.hasLocalData() != true)
+    {
+        g_dcJpegCompressors.setLocalData(new DcJpegCompressor());
+    }
+
+    return *g_dcJpegCompressors.localData();
+}
+
+tjhandle DcJpegCompressor::getHandle()
+{
+    return handle_;
+}
+
+int DcJpegCompressor::compress(unsigned char * imageBuffer, int width, int pitch, int height, int tjPixelFormat, int subsampling, int quality, int flags, char * jpegBuffer, int jpegBufferCapacity)
+{
+    if((unsigned long)jpegBufferCapacity < tjBufSize(width, height, subsampling))
+    {
+        put_flog(LOG_ERROR, "JPEG buffer too small");
+        return 0;
+    }
+
+    unsigned char * tjJpegBuf = (unsigned char *)jpegBuffer;
+    unsigned long tjJpegSize = jpegBufferCapacity;
+
+    // compress directly into the buffer; libjpeg-turbo must not reallocate it
+    int success = tjCompress2(handle_, imageBuffer, width, pitch, height, tjPixelFormat, &tjJpegBuf, &tjJpegSize, subsampling, quality, flags | TJFLAG_NOREALLOC);
+
+    if(success != 0)
+    {
+        put_flog(LOG_ERROR, "libjpeg-turbo image conversion failure: %s", tjGetErrorStr());
+        return 0;
+    }
+
+    return (int)tjJpegSize;
+}
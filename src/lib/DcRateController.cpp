@@ -0,0 +1,282 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DcRateController.h"
+#include "../PixelStreamCodec.h"
+#include "../log.h"
+#include <algorithm>
+
+// settings from highest to lowest quality: JPEG quality and chroma subsampling (TJSAMP_444, TJSAMP_422, TJSAMP_420)
+static const int g_dcRateControllerLevels[][2] = { {90, 0}, {75, 0}, {75, 1}, {75, 2}, {60, 2}, {45, 2}, {30, 2} };
+static const int g_dcRateControllerNumLevels = sizeof(g_dcRateControllerLevels) / sizeof(g_dcRateControllerLevels[0]);
+
+// the previous fixed settings: quality 75, 4:4:4
+#define DC_RATE_CONTROLLER_DEFAULT_LEVEL 1
+
+DcRateController::DcRateController()
+{
+    // defaults
+    targetFrameRate_ = 0.;
+    targetBandwidth_ = 0.;
+    level_ = DC_RATE_CONTROLLER_DEFAULT_LEVEL;
+    codec_ = DC_CODEC_AUTO;
+    windowFrames_ = 0;
+    windowBytes_ = 0;
+    windowLatency_ = 0;
+    segmentsFrameIndex_ = -1;
+    segmentsBytes_ = 0;
+    segmentsLatency_ = 0;
+    frameRate_ = 0.;
+    bandwidth_ = 0.;
+    ackLatency_ = 0;
+
+    windowTime_.start();
+}
+
+void DcRateController::setTargetFrameRate(float frameRate)
+{
+    QMutexLocker locker(&mutex_);
+
+    targetFrameRate_ = frameRate;
+
+    if(targetFrameRate_ <= 0. && targetBandwidth_ <= 0.)
+    {
+        level_ = DC_RATE_CONTROLLER_DEFAULT_LEVEL;
+    }
+}
+
+void DcRateController::setTargetBandwidth(float bandwidth)
+{
+    QMutexLocker locker(&mutex_);
+
+    targetBandwidth_ = bandwidth;
+
+    if(targetFrameRate_ <= 0. && targetBandwidth_ <= 0.)
+    {
+        level_ = DC_RATE_CONTROLLER_DEFAULT_LEVEL;
+    }
+}
+
+float DcRateController::getTargetFrameRate()
+{
+    QMutexLocker locker(&mutex_);
+
+    return targetFrameRate_;
+}
+
+float DcRateController::getTargetBandwidth()
+{
+    QMutexLocker locker(&mutex_);
+
+    return targetBandwidth_;
+}
+
+int DcRateController::getQuality()
+{
+    QMutexLocker locker(&mutex_);
+
+    return g_dcRateControllerLevels[level_][0];
+}
+
+int DcRateController::getSubsampling()
+{
+    QMutexLocker locker(&mutex_);
+
+    return g_dcRateControllerLevels[level_][1];
+}
+
+bool DcRateController::isHighestQuality()
+{
+    QMutexLocker locker(&mutex_);
+
+    return g_dcRateControllerLevels[level_][0] >= DC_REFRESH_JPEG_QUALITY && g_dcRateControllerLevels[level_][1] == DC_REFRESH_JPEG_SUBSAMPLING;
+}
+
+void DcRateController::setCodec(int codec)
+{
+    QMutexLocker locker(&mutex_);
+
+    codec_ = codec;
+}
+
+int DcRateController::getCodec()
+{
+    QMutexLocker locker(&mutex_);
+
+    return codec_;
+}
+
+int DcRateController::chooseCodec(float entropy, int width, int height, int totalWidth, int totalHeight)
+{
+    QMutexLocker locker(&mutex_);
+
+    if(codec_ != DC_CODEC_AUTO)
+    {
+        return codec_;
+    }
+
+    // the segment's share of the target bandwidth
+    float bandwidth = 0.;
+
+    if(totalWidth > 0 && totalHeight > 0)
+    {
+        bandwidth = targetBandwidth_ * (float)width * (float)height / ((float)totalWidth * (float)totalHeight);
+    }
+
+    // uncompressed segments must be sent at the target frame rate, or the measured one if there is no target
+    float frameRate = targetFrameRate_ > 0. ? targetFrameRate_ : frameRate_;
+
+    return pixelStreamChooseCodec(entropy, width, height, bandwidth, frameRate);
+}
+
+float DcRateController::getFrameRate()
+{
+    QMutexLocker locker(&mutex_);
+
+    return frameRate_;
+}
+
+float DcRateController::getBandwidth()
+{
+    QMutexLocker locker(&mutex_);
+
+    return bandwidth_;
+}
+
+int DcRateController::getAckLatency()
+{
+    QMutexLocker locker(&mutex_);
+
+    return ackLatency_;
+}
+
+void DcRateController::frameSent(int bytes, int latency)
+{
+    QMutexLocker locker(&mutex_);
+
+    recordFrame(bytes, latency);
+}
+
+void DcRateController::segmentSent(int frameIndex, int bytes, int latency)
+{
+    QMutexLocker locker(&mutex_);
+
+    // a new frame index finishes the previous frame
+    if(frameIndex != segmentsFrameIndex_ && segmentsBytes_ > 0)
+    {
+        recordFrame(segmentsBytes_, segmentsLatency_);
+
+        segmentsBytes_ = 0;
+        segmentsLatency_ = 0;
+    }
+
+    segmentsFrameIndex_ = frameIndex;
+    segmentsBytes_ += bytes;
+    segmentsLatency_ = std::max(segmentsLatency_, latency);
+}
+
+void DcRateController::recordFrame(int bytes, int latency)
+{
+    windowFrames_++;
+    windowBytes_ += bytes;
+    windowLatency_ += latency;
+
+    int elapsed = windowTime_.elapsed();
+
+    if(elapsed < DC_RATE_CONTROLLER_WINDOW_MILLISECONDS)
+    {
+        return;
+    }
+
+    frameRate_ = (float)windowFrames_ / (float)elapsed * 1000.;
+    bandwidth_ = (float)windowBytes_ * 8. / (float)elapsed / 1000.;
+    ackLatency_ = (int)(windowLatency_ / windowFrames_);
+
+    adjust();
+
+    // start a new window
+    windowTime_.restart();
+    windowFrames_ = 0;
+    windowBytes_ = 0;
+    windowLatency_ = 0;
+}
+
+void DcRateController::adjust()
+{
+    if(targetFrameRate_ <= 0. && targetBandwidth_ <= 0.)
+    {
+        return;
+    }
+
+    // lower quality if any target is missed; raise it only if all targets have headroom
+    bool degrade = false;
+    bool improve = true;
+
+    if(targetBandwidth_ > 0.)
+    {
+        degrade = degrade || bandwidth_ > targetBandwidth_;
+        improve = improve && bandwidth_ < 0.7 * targetBandwidth_;
+    }
+
+    if(targetFrameRate_ > 0.)
+    {
+        // frames must be acknowledged within the frame interval to be drained at the target rate
+        float frameInterval = 1000. / targetFrameRate_;
+
+        degrade = degrade || (float)ackLatency_ > frameInterval;
+        improve = improve && (float)ackLatency_ < 0.5 * frameInterval;
+    }
+
+    int level = level_;
+
+    if(degrade == true)
+    {
+        level = std::min(level_ + 1, g_dcRateControllerNumLevels - 1);
+    }
+    else if(improve == true)
+    {
+        level = std::max(level_ - 1, 0);
+    }
+
+    if(level != level_)
+    {
+        level_ = level;
+
+        put_flog(LOG_DEBUG, "frame rate %f, bandwidth %f Mbps, ack latency %i ms: using quality %i, subsampling %i", frameRate_, bandwidth_, ackLatency_, g_dcRateControllerLevels[level_][0], g_dcRateControllerLevels[level_][1]);
+    }
+}
@@ -0,0 +1,129 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DC_RATE_CONTROLLER_H
+#define DC_RATE_CONTROLLER_H
+
+#include <QtCore>
+
+// statistics are gathered, and settings adjusted, over windows of this length
+#define DC_RATE_CONTROLLER_WINDOW_MILLISECONDS 1000
+
+// let chooseCodec() choose the codec for each segment
+#define DC_CODEC_AUTO -1
+
+// settings for the final refresh of segments that have become static
+#define DC_REFRESH_JPEG_QUALITY 95
+#define DC_REFRESH_JPEG_SUBSAMPLING 0 // TJSAMP_444
+
+// chooses JPEG quality and chroma subsampling for a stream, trading image quality for a target frame rate or bandwidth.
+// the frame rate the link and the wall can sustain is measured by the latency of acknowledgments from the server.
+// subsampling values are the libjpeg-turbo TJSAMP_* values (444, 422, 420).
+// it also chooses the codec (PIXEL_STREAM_CODEC) of each segment, unless a codec is set explicitly.
+class DcRateController {
+
+    public:
+
+        DcRateController();
+
+        // targets; 0 disables the target. with no targets, the default settings are always used
+        void setTargetFrameRate(float frameRate);
+        void setTargetBandwidth(float bandwidth); // megabits per second
+        float getTargetFrameRate();
+        float getTargetBandwidth();
+
+        // current settings
+        int getQuality();
+        int getSubsampling();
+        bool isHighestQuality(); // true if the current settings are at least as good as a refresh
+
+        // codec; DC_CODEC_AUTO (the default) or a PIXEL_STREAM_CODEC
+        void setCodec(int codec);
+        int getCodec();
+
+        // the codec for a width x height segment of a totalWidth x totalHeight image, given the entropy of the segment
+        // (see pixelStreamComputeEntropy()). segments get a share of the target bandwidth by area.
+        int chooseCodec(float entropy, int width, int height, int totalWidth, int totalHeight);
+
+        // measured statistics for the last window
+        float getFrameRate();
+        float getBandwidth(); // megabits per second
+        int getAckLatency(); // milliseconds
+
+        // record a frame: the bytes sent, and the latency from the start of sending until it was acknowledged
+        void frameSent(int bytes, int latency);
+
+        // record a segment sent by itself; frames are delimited by changes of frameIndex
+        void segmentSent(int frameIndex, int bytes, int latency);
+
+    private:
+
+        QMutex mutex_;
+
+        // targets
+        float targetFrameRate_;
+        float targetBandwidth_;
+
+        // index into the table of settings; higher levels have lower quality
+        int level_;
+
+        // codec, or DC_CODEC_AUTO
+        int codec_;
+
+        // statistics for the current window
+        QTime windowTime_;
+        int windowFrames_;
+        long windowBytes_;
+        long windowLatency_;
+
+        // segments of the current frame, for segmentSent()
+        int segmentsFrameIndex_;
+        int segmentsBytes_;
+        int segmentsLatency_;
+
+        // statistics for the last window
+        float frameRate_;
+        float bandwidth_;
+        int ackLatency_;
+
+        // these must be called with mutex_ locked
+        void recordFrame(int bytes, int latency);
+        void adjust();
+};
+
+#endif
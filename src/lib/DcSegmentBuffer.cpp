@@ -0,0 +1,142 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DcSegmentBuffer.h"
+
+// offset of the image data in the buffer
+#define DC_SEGMENT_BUFFER_IMAGE_DATA_OFFSET ((int)(sizeof(MessageHeader) + sizeof(ParallelPixelStreamSegmentParameters)))
+
+DcSegmentBuffer::DcSegmentBuffer()
+{
+    // defaults
+    imageDataSize_ = 0;
+    queued_ = false;
+
+    buffer_.fill(0, DC_SEGMENT_BUFFER_IMAGE_DATA_OFFSET);
+
+    updatePointers();
+}
+
+void DcSegmentBuffer::reserve(int imageDataCapacity)
+{
+    waitForSent();
+
+    if(getImageDataCapacity() < imageDataCapacity)
+    {
+        buffer_.resize(DC_SEGMENT_BUFFER_IMAGE_DATA_OFFSET + imageDataCapacity);
+
+        updatePointers();
+    }
+}
+
+MessageHeader * DcSegmentBuffer::getMessageHeader()
+{
+    return messageHeader_;
+}
+
+ParallelPixelStreamSegmentParameters * DcSegmentBuffer::getParameters()
+{
+    return parameters_;
+}
+
+char * DcSegmentBuffer::getImageData()
+{
+    return imageData_;
+}
+
+int DcSegmentBuffer::getImageDataCapacity()
+{
+    return buffer_.size() - DC_SEGMENT_BUFFER_IMAGE_DATA_OFFSET;
+}
+
+void DcSegmentBuffer::setImageDataSize(int size)
+{
+    waitForSent();
+
+    imageDataSize_ = size;
+
+    messageHeader_->size = sizeof(ParallelPixelStreamSegmentParameters) + size;
+}
+
+int DcSegmentBuffer::getImageDataSize()
+{
+    return imageDataSize_;
+}
+
+QByteArray DcSegmentBuffer::getMessage()
+{
+    // fromRawData() doesn't copy, and doesn't share buffer_, so writing buffer_ never detaches it
+    return QByteArray::fromRawData(buffer_.constData(), getMessageSize());
+}
+
+int DcSegmentBuffer::getMessageSize()
+{
+    return DC_SEGMENT_BUFFER_IMAGE_DATA_OFFSET + imageDataSize_;
+}
+
+void DcSegmentBuffer::setQueued(bool queued)
+{
+    QMutexLocker locker(&queuedMutex_);
+
+    queued_ = queued;
+
+    if(queued_ != true)
+    {
+        queuedCondition_.wakeAll();
+    }
+}
+
+void DcSegmentBuffer::waitForSent()
+{
+    QMutexLocker locker(&queuedMutex_);
+
+    while(queued_ == true)
+    {
+        queuedCondition_.wait(&queuedMutex_);
+    }
+}
+
+void DcSegmentBuffer::updatePointers()
+{
+    // data() only detaches a shared array; buffer_ isn't shared, so this doesn't copy
+    char * data = buffer_.data();
+
+    messageHeader_ = (MessageHeader *)data;
+    parameters_ = (ParallelPixelStreamSegmentParameters *)(data + sizeof(MessageHeader));
+    imageData_ = data + DC_SEGMENT_BUFFER_IMAGE_DATA_OFFSET;
+}
@@ -0,0 +1,97 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DC_SEGMENT_BUFFER_H
+#define DC_SEGMENT_BUFFER_H
+
+#include "../MessageHeader.h"
+#include "../ParallelPixelStreamSegmentParameters.h"
+#include <QtCore>
+
+// a complete parallel pixel stream message for one segment: message header, segment parameters, and image data, in a
+// single buffer. image data is encoded directly into the buffer, and the buffer is reused for every frame of the segment
+// and only grows. the socket sends straight from the buffer (over TCP it is still copied into the socket's write
+// buffer), so the buffer must not be written while its message is queued: reserve() waits until the socket has popped
+// the message from its queue.
+class DcSegmentBuffer {
+
+    public:
+
+        DcSegmentBuffer();
+
+        // wait until the queued message has been sent, then make room for at least imageDataCapacity bytes of image
+        // data. this must be called before the buffer is written for a new message.
+        void reserve(int imageDataCapacity);
+
+        MessageHeader * getMessageHeader();
+        ParallelPixelStreamSegmentParameters * getParameters();
+
+        char * getImageData();
+        int getImageDataCapacity();
+
+        // set the size of the image data in the buffer; this also sets the message header size
+        void setImageDataSize(int size);
+        int getImageDataSize();
+
+        // the message, referencing the buffer without copying it, and its size
+        QByteArray getMessage();
+        int getMessageSize();
+
+        // set by the socket when the message is queued, and cleared when it is popped from the queue
+        void setQueued(bool queued);
+
+    private:
+
+        QByteArray buffer_;
+        int imageDataSize_;
+
+        // pointers into buffer_, updated when it is resized. buffer_ is never shared, so these stay valid.
+        MessageHeader * messageHeader_;
+        ParallelPixelStreamSegmentParameters * parameters_;
+        char * imageData_;
+
+        // mutex, condition and flag for the message being queued on a socket
+        QMutex queuedMutex_;
+        QWaitCondition queuedCondition_;
+        bool queued_;
+
+        void waitForSent();
+        void updatePointers();
+};
+
+#endif
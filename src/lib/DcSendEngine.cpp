@@ -0,0 +1,199 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "DcSendEngine.h"
+
+class DcSendEngineThread : public QThread {
+
+    public:
+
+        DcSendEngineThread(DcSendEngine * engine)
+        {
+            engine_ = engine;
+        }
+
+    protected:
+
+        void run()
+        {
+            engine_->run();
+        }
+
+    private:
+
+        DcSendEngine * engine_;
+};
+
+DcSendEngine::DcSendEngine(int threadCount)
+{
+    // defaults
+    generation_ = 0;
+    count_ = 0;
+    next_ = 0;
+    finished_ = 0;
+    function_ = NULL;
+    data_ = NULL;
+    quit_ = false;
+
+    // the calling thread of parallelFor() is also a worker
+    for(int i=0; i<threadCount-1; i++)
+    {
+        DcSendEngineThread * thread = new DcSendEngineThread(this);
+        thread->start();
+
+        threads_.push_back(thread);
+    }
+}
+
+DcSendEngine::~DcSendEngine()
+{
+    {
+        QMutexLocker locker(&mutex_);
+
+        quit_ = true;
+        workAvailable_.wakeAll();
+    }
+
+    for(unsigned int i=0; i<threads_.size(); i++)
+    {
+        threads_[i]->wait();
+        delete threads_[i];
+    }
+}
+
+void DcSendEngine::parallelFor(int count, void (*function)(int index, void * data), void * data)
+{
+    if(count <= 0)
+    {
+        return;
+    }
+
+    QMutexLocker parallelForLocker(&parallelForMutex_);
+
+    int generation;
+
+    {
+        QMutexLocker locker(&mutex_);
+
+        count_ = count;
+        next_ = 0;
+        finished_ = 0;
+        function_ = function;
+        data_ = data;
+
+        generation = ++generation_;
+
+        // with a single item there is nothing to share
+        if(count > 1)
+        {
+            workAvailable_.wakeAll();
+        }
+    }
+
+    work(generation);
+
+    QMutexLocker locker(&mutex_);
+
+    while(finished_ < count_)
+    {
+        workFinished_.wait(&mutex_);
+    }
+}
+
+void DcSendEngine::run()
+{
+    int generation = 0;
+
+    while(true)
+    {
+        {
+            QMutexLocker locker(&mutex_);
+
+            while(quit_ == false && generation_ == generation)
+            {
+                workAvailable_.wait(&mutex_);
+            }
+
+            if(quit_ == true)
+            {
+                return;
+            }
+
+            generation = generation_;
+        }
+
+        work(generation);
+    }
+}
+
+void DcSendEngine::work(int generation)
+{
+    while(true)
+    {
+        int index;
+        void (*function)(int, void *);
+        void * data;
+
+        {
+            QMutexLocker locker(&mutex_);
+
+            // stop if this work is done, or has been replaced
+            if(generation_ != generation || next_ >= count_)
+            {
+                return;
+            }
+
+            index = next_++;
+            function = function_;
+            data = data_;
+        }
+
+        function(index, data);
+
+        {
+            QMutexLocker locker(&mutex_);
+
+            finished_++;
+
+            if(finished_ == count_)
+            {
+                workFinished_.wakeAll();
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DC_SEND_ENGINE_H
+#define DC_SEND_ENGINE_H
+
+#include <QtCore>
+#include <vector>
+
+class DcSendEngineThread;
+
+// runs the per-segment work of a frame (compression) in parallel on a persistent set of threads. unlike
+// QtConcurrent, no futures or runnables are allocated per call, and each thread keeps its own compressor
+// (see DcJpegCompressor) for its lifetime.
+class DcSendEngine {
+
+    public:
+
+        DcSendEngine(int threadCount=QThread::idealThreadCount());
+        ~DcSendEngine();
+
+        // call function(index, data) for each index in [0, count), in parallel; returns when all calls have finished.
+        // the calling thread also does work. calls from multiple threads are serialized.
+        void parallelFor(int count, void (*function)(int index, void * data), void * data);
+
+    private:
+
+        friend class DcSendEngineThread;
+
+        // serializes parallelFor() calls
+        QMutex parallelForMutex_;
+
+        // mutex and conditions for the current work
+        QMutex mutex_;
+        QWaitCondition workAvailable_;
+        QWaitCondition workFinished_;
+
+        // the current work; generation_ is incremented for each parallelFor() call
+        int generation_;
+        int count_;
+        int next_;
+        int finished_;
+        void (*function_)(int, void *);
+        void * data_;
+
+        // threads exit when set
+        bool quit_;
+
+        std::vector<DcSendEngineThread *> threads_;
+
+        // called by the worker threads
+        void run();
+
+        // do work for the given generation until none is left
+        void work(int generation);
+};
+
+#endif
@@ -41,13 +41,19 @@
 #include "../log.h"
 #include <QtNetwork/QTcpSocket>
 
-DcSocket::DcSocket(const char * hostname)
+DcSocket::DcSocket(const char * hostname, bool sharedMemory)
 {
     // defaults
     socket_ = NULL;
+    sendMessagesQueueOpen_ = false;
     disconnectFlag_ = false;
+    ackLatency_ = 0;
 
-    if(connect(hostname) != true)
+#ifndef _WIN32
+    sharedMemoryAckCount_ = 0;
+#endif
+
+    if(connect(hostname, sharedMemory) != true)
     {
         put_flog(LOG_ERROR, "could not connect to host %s", hostname);
     }
@@ -65,7 +71,36 @@ bool DcSocket::isConnected()
     return isRunning();
 }
 
+bool DcSocket::isSharedMemory()
+{
+#ifndef _WIN32
+    return sharedMemoryRing_.isAttached();
+#else
+    return false;
+#endif
+}
+
 bool DcSocket::queueMessage(QByteArray message)
+{
+    DcSocketMessage socketMessage;
+    socketMessage.data = message;
+    socketMessage.size = message.size();
+    socketMessage.segmentBuffer = NULL;
+
+    return queueMessage(socketMessage);
+}
+
+bool DcSocket::queueMessage(DcSegmentBuffer & segmentBuffer)
+{
+    DcSocketMessage socketMessage;
+    socketMessage.data = segmentBuffer.getMessage();
+    socketMessage.size = segmentBuffer.getMessageSize();
+    socketMessage.segmentBuffer = &segmentBuffer;
+
+    return queueMessage(socketMessage);
+}
+
+bool DcSocket::queueMessage(const DcSocketMessage & socketMessage)
 {
     // only queue the message if we're connected
     if(isConnected() != true)
@@ -73,11 +108,25 @@ bool DcSocket::queueMessage(QByteArray message)
         return false;
     }
 
+    QMutexLocker locker(&sendMessagesQueueMutex_);
+
+    // the thread execution may be finishing; it won't pop the message anymore
+    if(sendMessagesQueueOpen_ != true)
     {
-        QMutexLocker locker(&sendMessagesQueueMutex_);
-        sendMessagesQueue_.push(message);
+        return false;
     }
 
+    if(socketMessage.segmentBuffer != NULL)
+    {
+        socketMessage.segmentBuffer->setQueued(true);
+    }
+
+    sendMessagesQueue_.push(socketMessage);
+
+    QTime queuedTime;
+    queuedTime.start();
+    ackTimes_.push(queuedTime);
+
     return true;
 }
 
@@ -94,6 +143,13 @@ void DcSocket::waitForAck(int count)
     ackSemaphore_.acquire(count);
 }
 
+int DcSocket::getAckLatency()
+{
+    QMutexLocker locker(&ackLatencyMutex_);
+
+    return ackLatency_;
+}
+
 InteractionState DcSocket::getInteractionState()
 {
     QMutexLocker locker(&interactionStateMutex_);
@@ -101,16 +157,32 @@ InteractionState DcSocket::getInteractionState()
     return interactionState_;
 }
 
-bool DcSocket::connect(const char * hostname)
+WallLayout DcSocket::getWallLayout()
+{
+    QMutexLocker locker(&wallLayoutMutex_);
+
+    return wallLayout_;
+}
+
+bool DcSocket::connect(const char * hostname, bool sharedMemory)
 {
     // make sure we're disconnected
     disconnect();
 
     // reset everything
-    sendMessagesQueue_ = std::queue<QByteArray>();
+    {
+        QMutexLocker locker(&sendMessagesQueueMutex_);
+        sendMessagesQueue_.clear();
+        ackTimes_.clear();
+        sendMessagesQueueOpen_ = true;
+    }
     ackSemaphore_.acquire(ackSemaphore_.available()); // should reset semaphore to 0
     disconnectFlag_ = false;
 
+#ifndef _WIN32
+    sharedMemoryAckCount_ = 0;
+#endif
+
     socket_ = new QTcpSocket();
 
     // open connection
@@ -154,6 +226,21 @@ bool DcSocket::connect(const char * hostname)
         return false;
     }
 
+#ifndef _WIN32
+    // use shared memory if the server is on this host
+    if(sharedMemory == true && socket_->peerAddress() == socket_->localAddress())
+    {
+        if(bindSharedMemory() == true)
+        {
+            put_flog(LOG_INFO, "using shared memory %s", sharedMemoryRing_.getName().c_str());
+        }
+        else
+        {
+            put_flog(LOG_WARN, "could not use shared memory, using socket");
+        }
+    }
+#endif
+
     // move the socket to this thread (which is about to start)
     socket_->moveToThread(this);
 
@@ -182,6 +269,55 @@ void DcSocket::disconnect()
             put_flog(LOG_ERROR, "thread did not finish");
         }
     }
+
+#ifndef _WIN32
+    sharedMemoryRing_.finalize();
+#endif
+}
+
+bool DcSocket::bindSharedMemory()
+{
+#ifndef _WIN32
+    if(sharedMemoryRing_.create(DC_SOCKET_SHARED_MEMORY_SIZE) != true)
+    {
+        return false;
+    }
+
+    // the server attaches to the shared memory by name
+    MessageHeader mh;
+    mh.size = 0;
+    mh.type = MESSAGE_TYPE_BIND_SHARED_MEMORY;
+
+    size_t len = sharedMemoryRing_.getName().copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
+    mh.uri[len] = '\0';
+
+    DcSocketMessage bindMessage;
+    bindMessage.data = QByteArray((const char *)&mh, sizeof(MessageHeader));
+    bindMessage.size = sizeof(MessageHeader);
+    bindMessage.segmentBuffer = NULL;
+
+    // the server acks the message, and then replies with the result
+    MessageHeader messageHeader;
+    QByteArray message;
+
+    bool success = socketSendMessage(bindMessage);
+
+    success = success && socketReceiveMessage(messageHeader, message) && messageHeader.type == MESSAGE_TYPE_ACK;
+    success = success && socketReceiveMessage(messageHeader, message) && messageHeader.type == MESSAGE_TYPE_BIND_SHARED_MEMORY;
+    success = success && message.size() == sizeof(int32_t) && *(const int32_t *)message.constData() == 1;
+
+    // both processes have mapped the shared memory now (or never will), so its name is no longer needed
+    sharedMemoryRing_.unlink();
+
+    if(success != true)
+    {
+        sharedMemoryRing_.finalize();
+    }
+
+    return success;
+#else
+    return false;
+#endif
 }
 
 void DcSocket::run()
@@ -195,29 +331,12 @@ void DcSocket::run()
         // exit flag
         bool exitFlag = false;
 
-        // send a message if available
-        QByteArray sendMessage;
-
+        // send messages if available
+        if(sendQueuedMessages() != true)
         {
-            QMutexLocker locker(&sendMessagesQueueMutex_);
-
-            if(sendMessagesQueue_.size() > 0)
-            {
-                sendMessage = sendMessagesQueue_.front();
-                sendMessagesQueue_.pop();
-            }
-        }
+            put_flog(LOG_ERROR, "error sending message");
 
-        if(sendMessage.isEmpty() != true)
-        {
-            bool success = socketSendMessage(sendMessage);
-
-            if(success != true)
-            {
-                put_flog(LOG_ERROR, "error sending message");
-
-                exitFlag = true;
-            }
+            exitFlag = true;
         }
 
         // break here if we had a failure
@@ -241,12 +360,31 @@ void DcSocket::run()
                 // handle the message
                 if(messageHeader.type == MESSAGE_TYPE_ACK)
                 {
-                    ackSemaphore_.release(1);
+                    receivedAck();
                 }
                 else if(messageHeader.type == MESSAGE_TYPE_INTERACTION)
                 {
-                    QMutexLocker locker(&interactionStateMutex_);
-                    interactionState_ = *(InteractionState *)(message.data());
+                    if(message.size() < (int)sizeof(InteractionState))
+                    {
+                        put_flog(LOG_ERROR, "interaction message too small (%i bytes), dropping", message.size());
+                    }
+                    else
+                    {
+                        QMutexLocker locker(&interactionStateMutex_);
+                        interactionState_ = *(InteractionState *)(message.data());
+                    }
+                }
+                else if(messageHeader.type == MESSAGE_TYPE_WALL_LAYOUT)
+                {
+                    if(message.size() < (int)sizeof(WallLayout))
+                    {
+                        put_flog(LOG_ERROR, "wall layout message too small (%i bytes), dropping", message.size());
+                    }
+                    else
+                    {
+                        QMutexLocker locker(&wallLayoutMutex_);
+                        wallLayout_ = *(WallLayout *)(message.data());
+                    }
                 }
                 else
                 {
@@ -261,6 +399,18 @@ void DcSocket::run()
             }
         }
 
+    #ifndef _WIN32
+        // messages in shared memory are acknowledged by the server reading them
+        uint64_t sharedMemoryReadCount = sharedMemoryRing_.getReadCount();
+
+        while(sharedMemoryAckCount_ < sharedMemoryReadCount)
+        {
+            receivedAck();
+
+            sharedMemoryAckCount_++;
+        }
+    #endif
+
         // make sure the socket is still connected
         if(socket_->state() != QAbstractSocket::ConnectedState)
         {
@@ -289,6 +439,9 @@ void DcSocket::run()
         }
     }
 
+    // messages that weren't sent won't be; release their segment buffers
+    closeSendMessagesQueue();
+
     // delete the socket
     delete socket_;
     socket_ = NULL;
@@ -296,15 +449,16 @@ void DcSocket::run()
     put_flog(LOG_DEBUG, "finished");
 }
 
-bool DcSocket::socketSendMessage(QByteArray message)
+bool DcSocket::socketSendMessage(const DcSocketMessage & message)
 {
     if(socket_->state() != QAbstractSocket::ConnectedState)
     {
         return false;
     }
 
-    char * data = message.data();
-    int size = message.size();
+    // use constData(); data() would copy the shared message
+    const char * data = message.data.constData();
+    int size = message.size;
 
     int sent = socket_->write(data, size);
 
@@ -337,18 +491,16 @@ bool DcSocket::socketReceiveMessage(MessageHeader & messageHeader, QByteArray &
         return false;
     }
 
-    QByteArray byteArray = socket_->read(sizeof(MessageHeader));
+    // read the header in place, so receiving acks doesn't allocate
+    int received = socket_->read((char *)&messageHeader, sizeof(MessageHeader));
 
-    while(byteArray.size() < (int)sizeof(MessageHeader))
+    while(received < (int)sizeof(MessageHeader))
     {
         socket_->waitForReadyRead();
 
-        byteArray.append(socket_->read(sizeof(MessageHeader) - byteArray.size()));
+        received += socket_->read((char *)&messageHeader + received, sizeof(MessageHeader) - received);
     }
 
-    // got the header
-    messageHeader = *(MessageHeader *)byteArray.data();
-
     // get the message
     if(messageHeader.size > 0)
     {
@@ -364,3 +516,117 @@ bool DcSocket::socketReceiveMessage(MessageHeader & messageHeader, QByteArray &
 
     return true;
 }
+
+bool DcSocket::sendQueuedMessages()
+{
+    while(true)
+    {
+        DcSocketMessage sendMessage;
+        sendMessage.size = 0;
+        sendMessage.segmentBuffer = NULL;
+
+        {
+            QMutexLocker locker(&sendMessagesQueueMutex_);
+
+            if(sendMessagesQueue_.size() > 0)
+            {
+                sendMessage = sendMessagesQueue_.front();
+            }
+        }
+
+        if(sendMessage.size == 0)
+        {
+            return true;
+        }
+
+        bool success = true;
+
+    #ifndef _WIN32
+        if(sharedMemoryRing_.isAttached() == true)
+        {
+            if(sendMessage.size <= sharedMemoryRing_.getMaximumRecordSize())
+            {
+                // if the ring is full, try again on the next pass
+                if(sharedMemoryRing_.write(sendMessage.data.constData(), sendMessage.size) != true)
+                {
+                    return true;
+                }
+            }
+            else
+            {
+                // messages too large for the ring use the socket, once the server has read the ring so order is kept
+                if(sharedMemoryRing_.isEmpty() != true)
+                {
+                    return true;
+                }
+
+                success = socketSendMessage(sendMessage);
+            }
+        }
+        else
+    #endif
+        {
+            success = socketSendMessage(sendMessage);
+        }
+
+        // release the message right away; the sender may then reuse its segment buffer
+        {
+            QMutexLocker locker(&sendMessagesQueueMutex_);
+            sendMessagesQueue_.pop();
+        }
+
+        sendMessage.data = QByteArray();
+
+        if(sendMessage.segmentBuffer != NULL)
+        {
+            sendMessage.segmentBuffer->setQueued(false);
+        }
+
+        // shared memory writes are cheap, so send everything queued; otherwise one message per pass
+        if(success != true || isSharedMemory() != true)
+        {
+            return success;
+        }
+    }
+}
+
+void DcSocket::closeSendMessagesQueue()
+{
+    QMutexLocker locker(&sendMessagesQueueMutex_);
+
+    while(sendMessagesQueue_.size() > 0)
+    {
+        if(sendMessagesQueue_.front().segmentBuffer != NULL)
+        {
+            sendMessagesQueue_.front().segmentBuffer->setQueued(false);
+        }
+
+        sendMessagesQueue_.pop();
+    }
+
+    sendMessagesQueueOpen_ = false;
+}
+
+void DcSocket::receivedAck()
+{
+    // every message is acked in order, so this is the ack for the oldest message
+    int latency = -1;
+
+    {
+        QMutexLocker locker(&sendMessagesQueueMutex_);
+
+        if(ackTimes_.size() > 0)
+        {
+            latency = ackTimes_.front().elapsed();
+            ackTimes_.pop();
+        }
+    }
+
+    if(latency >= 0)
+    {
+        QMutexLocker locker(&ackLatencyMutex_);
+        ackLatency_ = (ackLatency_ + latency) / 2;
+    }
+
+    ackSemaphore_.release(1);
+}
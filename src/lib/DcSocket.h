@@ -39,15 +39,31 @@
 #ifndef DC_SOCKET_H
 #define DC_SOCKET_H
 
+#include "DcSegmentBuffer.h"
 #include "../MessageHeader.h"
 #include "../InteractionState.h"
+#include "../WallLayout.h"
+#include "../RingBuffer.h"
+#ifndef _WIN32
+    #include "../SharedMemoryRing.h"
+#endif
 #include <QtCore>
-#include <queue>
 
 #include <iostream>
 
 class QTcpSocket;
 
+// a queued message; only the first size bytes of data are sent. segmentBuffer, if set, is released when the message
+// is popped from the queue.
+struct DcSocketMessage {
+    QByteArray data;
+    int size;
+    DcSegmentBuffer * segmentBuffer;
+};
+
+// capacity of the shared memory ring used for connections on the same host (bytes)
+#define DC_SOCKET_SHARED_MEMORY_SIZE (64*1024*1024)
+
 // we can't use the signal / slot model for handling threads without a Qt event
 // loop. so, we make our own thread class and override run()...
 
@@ -55,30 +71,56 @@ class DcSocket : public QThread {
 
     public:
 
-        DcSocket(const char * hostname);
+        // if sharedMemory is set and the server is on this host, messages are passed through shared memory instead of
+        // the socket
+        DcSocket(const char * hostname, bool sharedMemory=true);
         ~DcSocket();
 
         bool isConnected();
 
+        // messages are sent through shared memory
+        bool isSharedMemory();
+
         // queue a message to be sent (non-blocking)
         bool queueMessage(QByteArray message);
 
+        // queue the message in segmentBuffer to be sent (non-blocking), without copying it. the segment buffer is marked
+        // queued until the message is popped from the queue, including when the connection ends.
+        bool queueMessage(DcSegmentBuffer & segmentBuffer);
+
         // wait for count acks to be received
         void waitForAck(int count=1);
 
+        // average latency (milliseconds) from queueing a message until its ack is received
+        int getAckLatency();
+
         InteractionState getInteractionState();
 
+        // the latest wall layout sent by the server; unknown until bound to a window
+        WallLayout getWallLayout();
+
     protected:
 
         QTcpSocket * socket_;
 
         // mutex and queue for messages to send
+        // ring buffers are used for the queues so they are reused rather than reallocated
         QMutex sendMessagesQueueMutex_;
-        std::queue<QByteArray> sendMessagesQueue_;
+        RingBuffer<DcSocketMessage> sendMessagesQueue_;
+
+        // messages are only accepted while the thread execution runs; protected by sendMessagesQueueMutex_
+        bool sendMessagesQueueOpen_;
 
         // semaphore for ack count
         QSemaphore ackSemaphore_;
 
+        // times messages awaiting acks were queued; protected by sendMessagesQueueMutex_
+        RingBuffer<QTime> ackTimes_;
+
+        // mutex and smoothed ack latency
+        QMutex ackLatencyMutex_;
+        int ackLatency_;
+
         // mutex and flag to trigger socket thread to disconnect
         QMutex disconnectFlagMutex_;
         bool disconnectFlag_;
@@ -87,16 +129,37 @@ class DcSocket : public QThread {
         QMutex interactionStateMutex_;
         InteractionState interactionState_;
 
+        // current wall layout
+        QMutex wallLayoutMutex_;
+        WallLayout wallLayout_;
+
+    #ifndef _WIN32
+        // shared memory for messages to a server on the same host; only used by the thread execution once connected.
+        // the server reading a message acknowledges it.
+        SharedMemoryRing sharedMemoryRing_;
+        uint64_t sharedMemoryAckCount_;
+    #endif
+
         // socket connections
-        bool connect(const char * hostname);
+        bool connect(const char * hostname, bool sharedMemory);
         void disconnect();
 
+        // negotiate shared memory with the server during connect()
+        bool bindSharedMemory();
+
         // thread execution
         void run();
 
+        bool queueMessage(const DcSocketMessage & socketMessage);
+
+        // pop all queued messages, releasing their segment buffers, and stop accepting messages
+        void closeSendMessagesQueue();
+
         // these are only called in the thread execution
-        bool socketSendMessage(QByteArray message);
+        bool socketSendMessage(const DcSocketMessage & message);
         bool socketReceiveMessage(MessageHeader & messageHeader, QByteArray & message);
+        bool sendQueuedMessages();
+        void receivedAck();
 };
 
 #endif
@@ -38,49 +38,186 @@
 
 #include "dcStream.h"
 #include "DcSocket.h"
+#include "DcRateController.h"
+#include "DcJpegCompressor.h"
+#include "DcSegmentBuffer.h"
+#include "DcSendEngine.h"
+#include "DcAsyncSender.h"
+#include "DcHiddenFrameThrottle.h"
 #include "../MessageHeader.h"
 #include "../ParallelPixelStreamSegmentParameters.h"
+#include "../PixelStreamCodec.h"
+#include "../PixelStreamSegmentation.h"
 #include "../log.h"
 #include <QtCore>
 #include <cmath>
 #include <turbojpeg.h>
 #include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <unistd.h>
 
-// default to undefined frame index
-int g_dcStreamFrameIndex = FRAME_INDEX_UNDEFINED;
+// send segments at least this often (in frames), even if unchanged
+#define DC_STREAM_SEGMENT_REFRESH_INTERVAL 100
 
 #define USE_MUTEX
 
-#ifdef USE_MUTEX
-std::mutex mut_FrameIndex;
-std::mutex mut_SourceIndices;
-std::mutex mut_Qt;
-std::mutex mut_send;
-#endif
+struct DcSegmentHistory {
+    // hash of the last image sent
+    uint64_t hash;
+
+    // number of unchanged markers sent since then
+    int unchangedCount;
+
+    // the last image sent was at least refresh quality
+    bool refreshed;
+};
 
-// all current source indices for each stream name
-std::map<std::string, std::vector<int> > g_dcStreamSourceIndices;
+// what to send for a segment
+enum DC_SEGMENT_STATE { DC_SEGMENT_CHANGED, DC_SEGMENT_UNCHANGED, DC_SEGMENT_REFRESH };
 
 struct DcImage {
+    DcStream * stream;
+    DcStreamParameters parameters;
     unsigned char * imageBuffer;
     int width;
     int pitch;
     int height;
     PIXEL_FORMAT pixelFormat;
-    char * jpegData;
-    int jpegSize;
+    int codec;
+    int quality;
+    JPEG_SUBSAMPLING subsampling;
+    bool highestQuality;
+    bool sharedMemory; // sent through shared memory, so bandwidth doesn't matter
+    DcSegmentBuffer * segmentBuffer; // holds the encoded image data
+    int scale; // downscaling factor, for the resolution the segment is shown at
+    std::vector<unsigned char> scaledImageBuffer; // holds the downscaled image; reused for every frame
+    bool success;
+    bool unchanged;
+};
+
+// the state of a stream. a stream opened with dcStreamOpen() owns its socket, and shares no state or locks with other
+// streams. the functions taking a DcSocket share the default stream (see dcStreamGetDefaultStream()).
+class DcStream {
+
+    public:
+
+        DcStream(DcSocket * dcSocket=NULL);
+        ~DcStream(); // finishes asynchronous sends, and deletes the socket
+
+        // NULL for the default stream; its functions are given a socket
+        DcSocket * socket;
+
+        // default to undefined frame index
+        int frameIndex;
+
+        // skip unchanged segments in dcStreamSend()
+        bool skipUnchangedSegments;
+
+        // downscale and throttle frames for the window bound with dcStreamBindWallLayout()
+        bool adaptToWindow;
+
+        // frames sent on each socket while its window is hidden
+        std::map<DcSocket *, DcHiddenFrameThrottle> hiddenFrames;
+
+        // all current source indices for each stream name
+        std::map<std::string, std::vector<int> > sourceIndices;
+
+        // history of sent segments for each stream name and source index
+        std::map<std::string, std::map<int, DcSegmentHistory> > segmentHistory;
+
+        // rate controller for each stream name
+        std::map<std::string, DcRateController> rateControllers;
+
+        // message buffers for each stream name and source index, reused for every frame
+        std::map<std::string, std::map<int, DcSegmentBuffer> > segmentBuffers;
+
+        // segments of the current frame for each stream name; kept so the vectors are reused for every frame
+        std::map<std::string, std::vector<DcImage> > images;
+
+        // asynchronous senders for each socket, created by the first dcStreamSendAsync() on the socket
+        std::map<DcSocket *, DcAsyncSender *> asyncSenders;
+
+        // parallel compression, created by the first frame sent
+        DcSendEngine * sendEngine;
+
+#ifdef USE_MUTEX
+        std::mutex mut_FrameIndex;
+        std::mutex mut_SourceIndices;
+        std::mutex mut_Qt;
+        std::mutex mut_send;
+        std::mutex mut_SegmentHistory;
+        std::mutex mut_RateControllers;
+        std::mutex mut_SegmentBuffers;
+        std::mutex mut_Images;
+        std::mutex mut_AsyncSenders;
+        std::mutex mut_SendEngine;
+        std::mutex mut_HiddenFrames;
+#endif
 };
 
 // enum PIXEL_FORMAT { RGB, RGBA, ARGB, BGR, BGRA, ABGR };
 int dcBytesPerPixel[] = { 3, 4, 4, 3, 4, 4 };
+int dcTjPixelFormats[] = { TJPF_RGB, TJPF_RGBX, TJPF_XRGB, TJPF_BGR, TJPF_BGRX, TJPF_XBGR };
+
+DcStream * dcStreamGetDefaultStream();
+bool dcStreamCheckStream(DcStream * stream);
+void dcStreamResetSegments(DcStream * stream, DcSocket * socket);
+bool dcStreamSendImage(DcStream * stream, DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const DcStreamParameters & parameters);
+bool dcStreamSendFrame(DcStream * stream, DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, int frameIndex, long long captureTimestamp);
+bool dcStreamSendFrameAsync(DcStream * stream, DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, DcStreamSendCallback callback, void * userData);
+DcAsyncSender * dcStreamGetAsyncSender(DcStream * stream, DcSocket * socket, bool create);
+void dcStreamDeleteAsyncSender(DcStream * stream, DcSocket * socket);
+bool dcStreamWaitForAsyncSender(DcStream * stream, DcSocket * socket);
+bool dcStreamAdaptToWindow(DcStream * stream, DcSocket * socket, const DcStreamParameters & parameters, int frameIndex, int & scale);
+DcStreamWindowHints dcStreamComputeWindowHints(const WallLayout & layout);
+void dcStreamComputeImage(DcImage & dcImage);
+void dcStreamComputeImageIndexed(int index, void * dcImages);
+void dcStreamScaleImage(DcImage & dcImage);
+bool dcStreamEncodeImage(DcImage & dcImage);
+uint64_t dcStreamHashImage(const DcStreamParameters & parameters, int scale, unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat);
+DC_SEGMENT_STATE dcStreamUpdateSegmentHistory(DcStream * stream, const DcStreamParameters & parameters, uint64_t hash, bool highestQuality);
+DcRateController & dcStreamGetRateController(DcStream * stream, const std::string & name);
+DcStreamRateStatus dcStreamGetStreamRateStatus(DcStream * stream, const std::string & name);
+DcSegmentBuffer & dcStreamGetSegmentBuffer(DcStream * stream, const DcStreamParameters & parameters);
+DcSendEngine & dcStreamGetSendEngine(DcStream * stream);
+int dcStreamGetFrameIndex(DcStream * stream);
+long long dcStreamGetTimestamp();
+void dcStreamUpdateFrameIndex(DcStream * stream, int frameIndex, bool increment);
+int dcStreamChooseCodec(DcRateController & rateController, const DcStreamParameters & parameters, unsigned char * imageBuffer, int pitch, PIXEL_FORMAT pixelFormat, bool sharedMemory);
+bool dcStreamSendSegment(DcStream * stream, DcSocket * socket, const DcStreamParameters & parameters, int codec, const char * imageData, int imageDataSize, bool waitForAck);
+bool dcStreamQueueSegment(DcStream * stream, DcSocket * socket, const DcStreamParameters & parameters, int codec, DcSegmentBuffer & segmentBuffer, int frameIndex, long long captureTimestamp, bool waitForAck);
+void dcStreamAddSourceIndex(DcStream * stream, const DcStreamParameters & parameters);
+bool dcStreamSendMessage(DcStream * stream, DcSocket * socket, MESSAGE_TYPE type, const std::string & name, const char * data, int size);
+
+DcStream::DcStream(DcSocket * dcSocket)
+{
+    // defaults
+    frameIndex = FRAME_INDEX_UNDEFINED;
+    skipUnchangedSegments = true;
+    adaptToWindow = true;
+    sendEngine = NULL;
+
+    // assign values
+    socket = dcSocket;
+}
 
-DcImage dcStreamComputeJpegMapped(const DcImage & dcImage);
+DcStream::~DcStream()
+{
+    // finish asynchronous sends before the socket goes away
+    for(std::map<DcSocket *, DcAsyncSender *>::iterator it=asyncSenders.begin(); it != asyncSenders.end(); it++)
+    {
+        delete (*it).second;
+    }
 
+    delete sendEngine;
+    delete socket;
+}
 
-DcSocket * dcStreamConnect(const char * hostname)
+DcSocket * dcStreamConnect(const char * hostname, bool sharedMemory)
 {
-    DcSocket * dcSocket = new DcSocket(hostname);
+    DcSocket * dcSocket = new DcSocket(hostname, sharedMemory);
 
     if(dcSocket->isConnected() != true)
     {
@@ -97,6 +234,20 @@ DcSocket * dcStreamConnect(const char * hostname)
 void dcStreamDisconnect(DcSocket * & socket)
 {
     if (socket != NULL) {
+        DcStream * stream = dcStreamGetDefaultStream();
+
+        // finish asynchronous sends before the socket goes away
+        dcStreamDeleteAsyncSender(stream, socket);
+
+        // forget the socket's state; a new socket may get the same address
+#ifdef USE_MUTEX
+        stream->mut_HiddenFrames.lock();
+#endif
+        stream->hiddenFrames.erase(socket);
+#ifdef USE_MUTEX
+        stream->mut_HiddenFrames.unlock();
+#endif
+
         delete socket;
         socket = NULL;
     }
@@ -104,30 +255,36 @@ void dcStreamDisconnect(DcSocket * & socket)
 
 void dcStreamReset(DcSocket * socket)
 {
-    for(std::map<std::string, std::vector<int> >::iterator it=g_dcStreamSourceIndices.begin(); it != g_dcStreamSourceIndices.end(); it++)
+    dcStreamResetSegments(dcStreamGetDefaultStream(), socket);
+}
+
+DcStream * dcStreamOpen(const char * hostname, bool sharedMemory)
+{
+    DcSocket * dcSocket = dcStreamConnect(hostname, sharedMemory);
+
+    if(dcSocket == NULL)
     {
-        for(unsigned int i=0; i<(*it).second.size(); i++)
-        {
-            std::string name = (*it).first;
-            int sourceIndex = (*it).second[i];
+        return NULL;
+    }
 
-            // blank parameters object
-            DcStreamParameters parameters = dcStreamGenerateParameters(name, sourceIndex, 0, 0, 0, 0, 0, 0);
+    return new DcStream(dcSocket);
+}
 
-            // send the blank parameters object
-            // this will trigger remote deletion of this segment
-            dcStreamSendJpeg(socket, parameters, NULL, 0);
-        }
+void dcStreamClose(DcStream * & stream)
+{
+    if(stream != NULL)
+    {
+        delete stream;
+        stream = NULL;
     }
+}
 
-    // clear the current source indices for each stream name
-#ifdef USE_MUTEX
-    mut_SourceIndices.lock();
-#endif
-    g_dcStreamSourceIndices.clear();
-#ifdef USE_MUTEX
-    mut_SourceIndices.unlock();
-#endif
+void dcStreamReset(DcStream * stream)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        dcStreamResetSegments(stream, stream->socket);
+    }
 }
 
 DcStreamParameters dcStreamGenerateParameters(std::string name, int sourceIndex, int x, int y, int width, int height, int totalWidth, int totalHeight)
@@ -181,317 +338,193 @@ std::vector<DcStreamParameters> dcStreamGenerateParameters(std::string name, int
     return parameters;
 }
 
-bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, DcStreamParameters parameters)
+std::vector<DcStreamParameters> dcStreamGenerateParameters(std::string name, int firstSourceIndex, int nominalSegmentWidth, int nominalSegmentHeight, int x, int y, int width, int height, int totalWidth, int totalHeight, const WallLayout & layout)
 {
-    // compute imagePitch if necessary, assuming imageBuffer isn't padded
-    if(imagePitch == 0)
-    {
-        imagePitch = imageWidth * dcBytesPerPixel[pixelFormat];
-    }
-
-    // compute JPEG from imageBuffer corresponding to parameters
-    unsigned char * segmentImageBuffer = imageBuffer + (parameters.y - imageY)*imagePitch + (parameters.x - imageX)*dcBytesPerPixel[pixelFormat];
-
-    char * jpegData = NULL;
-    int jpegSize = 0;
+    std::vector<ParallelPixelStreamSegmentParameters> segments = pixelStreamComputeSegments(layout, nominalSegmentWidth, nominalSegmentHeight, x, y, width, height, totalWidth, totalHeight);
 
-    bool success = dcStreamComputeJpeg(segmentImageBuffer, parameters.width, imagePitch, parameters.height, pixelFormat, &jpegData, jpegSize);
+    std::vector<DcStreamParameters> parameters;
 
-    if(success == false)
+    for(unsigned int i=0; i<segments.size(); i++)
     {
-        if (jpegData != NULL)
-            free(jpegData);
-
-        return false;
+        parameters.push_back(dcStreamGenerateParameters(name, firstSourceIndex + i, segments[i].x, segments[i].y, segments[i].width, segments[i].height, totalWidth, totalHeight));
     }
 
-#ifdef USE_MUTEX
-    mut_send.lock();
-#endif
-
-    success = dcStreamSendJpeg(socket, parameters, jpegData, jpegSize, false);
+    return parameters;
+}
 
-#ifdef USE_MUTEX
-    mut_send.unlock();
-#endif
+bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const DcStreamParameters & parameters)
+{
+    return dcStreamSendImage(dcStreamGetDefaultStream(), socket, imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, parameters);
+}
 
-    if (jpegData != NULL)
-        free(jpegData);
+bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters)
+{
+    DcStream * stream = dcStreamGetDefaultStream();
 
-    return success;
+    return dcStreamSendFrame(stream, socket, imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, parameters, dcStreamGetFrameIndex(stream), dcStreamGetTimestamp());
 }
 
-bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, std::vector<DcStreamParameters> parameters)
+bool dcStreamSendAsync(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, DcStreamSendCallback callback, void * userData)
 {
-    // compute imagePitch if necessary, assuming imageBuffer isn't padded
-    if(imagePitch == 0)
-    {
-        imagePitch = imageWidth * dcBytesPerPixel[pixelFormat];
-    }
-
-    // compute JPEGs from imageBuffer corresponding to parameters vector
-    std::vector<DcImage> dcImages;
+    return dcStreamSendFrameAsync(dcStreamGetDefaultStream(), socket, imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, parameters, callback, userData);
+}
 
-    for(unsigned int i=0; i<parameters.size(); i++)
+void dcStreamSetAsyncPolicy(DcSocket * socket, ASYNC_POLICY policy, int maxQueuedFrames)
+{
+    if(socket == NULL)
     {
-        DcImage d;
-
-        // imageBuffer coordinates have the origin at the bottom-left corner.
-        // DisplayCluster's coordinates have the origin at the top-left.
-        // a transformation is needed to find the appropriate memory location within the full imageBuffer...
-        d.imageBuffer = imageBuffer + imageHeight*imagePitch - (parameters[i].y - imageY + parameters[i].height)*imagePitch + (parameters[i].x - imageX)*dcBytesPerPixel[pixelFormat];
-
-        d.width = parameters[i].width;
-        d.pitch = imagePitch;
-        d.height = parameters[i].height;
-        d.pixelFormat = pixelFormat;
-        d.jpegData = NULL;
-        d.jpegSize = 0;
+        put_flog(LOG_ERROR, "socket is NULL");
 
-        dcImages.push_back(d);
+        return;
     }
 
-    // create JPEGs for each segment, in parallel
-
-    dcImages = QtConcurrent::blockingMapped<std::vector<DcImage> >(dcImages, &dcStreamComputeJpegMapped);
+    dcStreamGetAsyncSender(dcStreamGetDefaultStream(), socket, true)->setPolicy(policy, maxQueuedFrames);
+}
 
-    // send each segment, and return true if we were successful for all segments
-    bool allSuccess = true;
+bool dcStreamWaitForAsync(DcSocket * socket)
+{
+    return dcStreamWaitForAsyncSender(dcStreamGetDefaultStream(), socket);
+}
 
-    for(unsigned int i=0; i<dcImages.size(); i++)
-    {
-        // jpegSize == 0 indicates an error
-        if(dcImages[i].jpegSize == 0)
-        {
-            allSuccess = false;
-        }
-        else
-        {
-            bool sendSuccess = dcStreamSendJpeg(socket, parameters[i], dcImages[i].jpegData, dcImages[i].jpegSize, false);
+bool dcStreamSendJpeg(DcSocket * socket, DcStreamParameters parameters, const char * jpegData, int jpegSize, bool waitForAck)
+{
+    return dcStreamSendSegment(dcStreamGetDefaultStream(), socket, parameters, PIXEL_STREAM_CODEC_JPEG, jpegData, jpegSize, waitForAck);
+}
 
-            if(sendSuccess == false)
-            {
-                allSuccess = false;
-            }
-        }
+bool dcStreamSendUnchanged(DcSocket * socket, DcStreamParameters parameters, bool waitForAck)
+{
+    // valid parameters without image data mark the segment as unchanged
+    return dcStreamSendJpeg(socket, parameters, NULL, 0, waitForAck);
+}
 
-        free(dcImages[i].jpegData);
-    }
+void dcStreamSetSkipUnchangedSegments(bool set)
+{
+    dcStreamGetDefaultStream()->skipUnchangedSegments = set;
+}
 
-    // wait for acks for all segments
-    socket->waitForAck(dcImages.size());
+void dcStreamSetTargetFrameRate(std::string name, float frameRate)
+{
+    dcStreamGetRateController(dcStreamGetDefaultStream(), name).setTargetFrameRate(frameRate);
+}
 
-    return allSuccess;
+void dcStreamSetTargetBandwidth(std::string name, float bandwidth)
+{
+    dcStreamGetRateController(dcStreamGetDefaultStream(), name).setTargetBandwidth(bandwidth);
 }
 
-bool dcStreamSendJpeg(DcSocket * socket, DcStreamParameters parameters, const char * jpegData, int jpegSize, bool waitForAck)
+DcStreamRateStatus dcStreamGetRateStatus(std::string name)
 {
-    if(socket == NULL)
-    {
-        put_flog(LOG_ERROR, "socket is NULL");
+    return dcStreamGetStreamRateStatus(dcStreamGetDefaultStream(), name);
+}
 
-        return false;
-    }
+bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize, int quality, JPEG_SUBSAMPLING subsampling)
+{
+    // use libjpeg-turbo for JPEG conversion, with the calling thread's compressor
+    jpegSize = 0;
 
-    if(socket->isConnected() != true)
+    if(pixelFormat < RGB || pixelFormat > ABGR)
     {
-        put_flog(LOG_ERROR, "socket is not connected");
-
+        put_flog(LOG_ERROR, "unknown pixel format");
         return false;
     }
 
-    // this byte array will hold the entire message to be sent over the socket
-    QByteArray message;
-
-    // the message header
-    MessageHeader mh;
-    mh.size = sizeof(ParallelPixelStreamSegmentParameters) + jpegSize;
-    mh.type = MESSAGE_TYPE_PARALLEL_PIXELSTREAM;
-
-    // add the truncated URI to the header
-    size_t len = parameters.name.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
-    mh.uri[len] = '\0';
-
-    message.append((const char *)&mh, sizeof(MessageHeader));
-
-    // message part 1: parameters
-    ParallelPixelStreamSegmentParameters p;
-
-    p.sourceIndex = parameters.sourceIndex;
-#ifdef USE_MUTEX
-    mut_FrameIndex.lock();
-#endif
-    p.frameIndex = g_dcStreamFrameIndex;
-#ifdef USE_MUTEX
-    mut_FrameIndex.unlock();
-#endif
-    p.x = parameters.x;
-    p.y = parameters.y;
-    p.width = parameters.width;
-    p.height = parameters.height;
-    p.totalWidth = parameters.totalWidth;
-    p.totalHeight = parameters.totalHeight;
-
-    message.append((const char *)&p, sizeof(ParallelPixelStreamSegmentParameters));
-
-    // message part 2: image data
-    if(jpegSize > 0)
+    // compute pitch if necessary, assuming imageBuffer isn't padded
+    if(pitch == 0)
     {
-        message.append(jpegData, jpegSize);
+        pitch = width * dcBytesPerPixel[pixelFormat];
     }
 
+    // JPEG_SUBSAMPLING values match TJSAMP_444, TJSAMP_422, TJSAMP_420
+    int capacity = (int)tjBufSize(width, height, (int)subsampling);
 
+    // compress directly into the caller's buffer, growing it to the worst case JPEG size in bytes if necessary
+    // realloc() reuses a buffer from a previous call, or allocates one if *jpegData is NULL
+    char * buffer = (char *)realloc((void *)*jpegData, capacity);
 
-    // queue the message to be sent
-#ifdef USE_MUTEX
-    mut_Qt.lock();
-#endif
-    bool success = socket->queueMessage(message);
-    // wait for acknowledgment if requested. this wait can be disabled to buffer all sends before waiting for acknowledgments, for example.
-    if(waitForAck == true)
+    if(buffer == NULL)
     {
-        socket->waitForAck();
+        put_flog(LOG_ERROR, "could not allocate JPEG buffer");
+        return false;
     }
-#ifdef USE_MUTEX
-    mut_Qt.unlock();
-#endif
-    //return true;
-
-#ifdef USE_MUTEX
-    mut_SourceIndices.lock();
-#endif
-    // make sure this sourceIndex is in the vector of current source indices for this stream name
 
+    *jpegData = buffer;
 
-    int n_streams = g_dcStreamSourceIndices.count(parameters.name);
-    if (n_streams == 1) {
-        std::vector<int> & stream_indexes = g_dcStreamSourceIndices[parameters.name];
-        int index_count = count(stream_indexes.begin(), stream_indexes.end(), parameters.sourceIndex);
-        if (index_count == 0) {
-            stream_indexes.push_back(parameters.sourceIndex);
-        }
-    } else {
+    jpegSize = DcJpegCompressor::getThreadCompressor().compress(imageBuffer, width, pitch, height, dcTjPixelFormats[pixelFormat], (int)subsampling, quality, TJFLAG_BOTTOMUP, buffer, capacity);
 
-    }
+    return jpegSize > 0;
+}
 
-    // if(count(g_dcStreamSourceIndices[parameters.name].begin(), g_dcStreamSourceIndices[parameters.name].end(), parameters.sourceIndex) == 0)
-    // {   // Crashes here.
-    //     g_dcStreamSourceIndices[parameters.name].push_back(parameters.sourceIndex);
-    // }
+void dcStreamSetCodec(std::string name, SEGMENT_CODEC codec)
+{
+    // SEGMENT_CODEC values match DC_CODEC_AUTO and PIXEL_STREAM_CODEC
+    dcStreamGetRateController(dcStreamGetDefaultStream(), name).setCodec((int)codec);
+}
 
+void dcStreamIncrementFrameIndex()
+{
+    dcStreamUpdateFrameIndex(dcStreamGetDefaultStream(), 1, true);
+}
 
-#ifdef USE_MUTEX
-    mut_SourceIndices.unlock();
-#endif
+void dcStreamSetFrameIndex(int frameIndex)
+{
+    dcStreamUpdateFrameIndex(dcStreamGetDefaultStream(), frameIndex, false);
+}
 
-    return success;
+bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData, int svgSize)
+{
+    return dcStreamSendMessage(dcStreamGetDefaultStream(), socket, MESSAGE_TYPE_SVG_STREAM, name, svgData, svgSize);
 }
 
-bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize)
+bool dcStreamSendSVGUpdate(DcSocket * socket, std::string name, const char * updateData, int updateSize)
 {
-    // use libjpeg-turbo for JPEG conversion
+    return dcStreamSendMessage(dcStreamGetDefaultStream(), socket, MESSAGE_TYPE_SVG_STREAM_UPDATE, name, updateData, updateSize);
+}
 
-    // use a new handle each time for thread-safety
-    tjhandle tjHandle = tjInitCompress();
+bool dcStreamBindInteraction(DcSocket * socket, std::string name)
+{
+    return dcStreamSendMessage(dcStreamGetDefaultStream(), socket, MESSAGE_TYPE_BIND_INTERACTION, name, NULL, 0);
+}
 
-    // compute pitch if necessary, assuming imageBuffer isn't padded
-    if(pitch == 0)
+InteractionState dcStreamGetInteractionState(DcSocket * socket)
+{
+    if(socket == NULL)
     {
-        pitch = width * dcBytesPerPixel[pixelFormat];
-    }
-
-    // map pixel format to the libjpeg-turbo equivalent
-    int tjPixelFormat;
+        put_flog(LOG_ERROR, "socket is NULL");
 
-    // enum PIXEL_FORMAT { RGB, RGBA, ARGB, BGR, BGRA, ABGR };
-    switch(pixelFormat)
-    {
-        case RGB:
-            tjPixelFormat = TJPF_RGB;
-            break;
-        case RGBA:
-            tjPixelFormat = TJPF_RGBX;
-            break;
-        case ARGB:
-            tjPixelFormat = TJPF_XRGB;
-            break;
-        case BGR:
-            tjPixelFormat = TJPF_BGR;
-            break;
-        case BGRA:
-            tjPixelFormat = TJPF_BGRX;
-            break;
-        case ABGR:
-            tjPixelFormat = TJPF_XBGR;
-            break;
-        default:
-            put_flog(LOG_ERROR, "unknown pixel format");
-            return false;
+        return InteractionState();
     }
 
-    unsigned char ** tjJpegBuf;
-    unsigned char * tjJpegBufPtr = NULL;
-    tjJpegBuf = &tjJpegBufPtr;
-    unsigned long tjJpegSize = 0;
-    int tjJpegSubsamp = TJSAMP_444;
-    int tjJpegQual = 75;
-    int tjFlags = TJFLAG_BOTTOMUP;
+    return socket->getInteractionState();
+}
 
-    int success = tjCompress2(tjHandle, imageBuffer, width, pitch, height, tjPixelFormat, tjJpegBuf, &tjJpegSize, tjJpegSubsamp, tjJpegQual, tjFlags);
+bool dcStreamBindWallLayout(DcSocket * socket, std::string name)
+{
+    return dcStreamSendMessage(dcStreamGetDefaultStream(), socket, MESSAGE_TYPE_BIND_WALL_LAYOUT, name, NULL, 0);
+}
 
-    if(success != 0)
+WallLayout dcStreamGetWallLayout(DcSocket * socket)
+{
+    if(socket == NULL)
     {
-        put_flog(LOG_ERROR, "libjpeg-turbo image conversion failure");
-
-        jpegSize = 0;
-
-        // destroy libjpeg-turbo handle
-        tjDestroy(tjHandle);
-
-        return false;
-    }
+        put_flog(LOG_ERROR, "socket is NULL");
 
-    // move the JPEG buffer to our own memory and free the libjpeg-turbo allocated memory
-    if (jpegData != NULL) {
-        *jpegData = (char *)realloc((void *)*jpegData, tjJpegSize);
-    } else {
-        *jpegData = (char *)malloc(tjJpegSize * sizeof(char *));
+        return WallLayout();
     }
-    memcpy(*jpegData, tjJpegBufPtr, tjJpegSize);
-    tjFree(tjJpegBufPtr);
-
-    jpegSize = tjJpegSize;
 
-    // destroy libjpeg-turbo handle
-    tjDestroy(tjHandle);
-
-    return true;
+    return socket->getWallLayout();
 }
 
-void dcStreamIncrementFrameIndex()
+DcStreamWindowHints dcStreamGetWindowHints(DcSocket * socket)
 {
-#ifdef USE_MUTEX
-    mut_FrameIndex.lock();
-#endif
-    g_dcStreamFrameIndex++;
-#ifdef USE_MUTEX
-    mut_FrameIndex.unlock();
-#endif
+    return dcStreamComputeWindowHints(dcStreamGetWallLayout(socket));
 }
 
-void dcStreamSetFrameIndex(int frameIndex)
+void dcStreamSetAdaptToWindow(bool set)
 {
-#ifdef USE_MUTEX
-    mut_FrameIndex.lock();
-#endif
-    g_dcStreamFrameIndex = frameIndex;
-
-#ifdef USE_MUTEX
-    mut_FrameIndex.unlock();
-#endif
+    dcStreamSetAdaptToWindow(dcStreamGetDefaultStream(), set);
 }
 
-bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData, int svgSize)
+bool dcStreamIsSharedMemory(DcSocket * socket)
 {
     if(socket == NULL)
     {
@@ -500,47 +533,630 @@ bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData,
         return false;
     }
 
-    if(socket->isConnected() != true)
-    {
-        put_flog(LOG_ERROR, "socket is not connected");
+    return socket->isSharedMemory();
+}
 
+bool dcStreamSend(DcStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const DcStreamParameters & parameters)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
         return false;
     }
 
-    // this byte array will hold the entire message to be sent over the socket
-    QByteArray message;
+    return dcStreamSendImage(stream, stream->socket, imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, parameters);
+}
 
-    // the message header
-    MessageHeader mh;
-    mh.size = svgSize;
-    mh.type = MESSAGE_TYPE_SVG_STREAM;
+bool dcStreamSend(DcStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
 
-    // add the truncated URI to the header
-    size_t len = name.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
-    mh.uri[len] = '\0';
+    return dcStreamSendFrame(stream, stream->socket, imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, parameters, dcStreamGetFrameIndex(stream), dcStreamGetTimestamp());
+}
+
+bool dcStreamSendAsync(DcStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, DcStreamSendCallback callback, void * userData)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamSendFrameAsync(stream, stream->socket, imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, parameters, callback, userData);
+}
+
+void dcStreamSetAsyncPolicy(DcStream * stream, ASYNC_POLICY policy, int maxQueuedFrames)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        dcStreamGetAsyncSender(stream, stream->socket, true)->setPolicy(policy, maxQueuedFrames);
+    }
+}
+
+bool dcStreamWaitForAsync(DcStream * stream)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamWaitForAsyncSender(stream, stream->socket);
+}
+
+bool dcStreamSendJpeg(DcStream * stream, DcStreamParameters parameters, const char * jpegData, int jpegSize, bool waitForAck)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamSendSegment(stream, stream->socket, parameters, PIXEL_STREAM_CODEC_JPEG, jpegData, jpegSize, waitForAck);
+}
+
+bool dcStreamSendUnchanged(DcStream * stream, DcStreamParameters parameters, bool waitForAck)
+{
+    // valid parameters without image data mark the segment as unchanged
+    return dcStreamSendJpeg(stream, parameters, NULL, 0, waitForAck);
+}
+
+void dcStreamSetSkipUnchangedSegments(DcStream * stream, bool set)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        stream->skipUnchangedSegments = set;
+    }
+}
+
+void dcStreamSetTargetFrameRate(DcStream * stream, std::string name, float frameRate)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        dcStreamGetRateController(stream, name).setTargetFrameRate(frameRate);
+    }
+}
+
+void dcStreamSetTargetBandwidth(DcStream * stream, std::string name, float bandwidth)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        dcStreamGetRateController(stream, name).setTargetBandwidth(bandwidth);
+    }
+}
+
+DcStreamRateStatus dcStreamGetRateStatus(DcStream * stream, std::string name)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return DcStreamRateStatus();
+    }
+
+    return dcStreamGetStreamRateStatus(stream, name);
+}
+
+void dcStreamSetCodec(DcStream * stream, std::string name, SEGMENT_CODEC codec)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        dcStreamGetRateController(stream, name).setCodec((int)codec);
+    }
+}
+
+void dcStreamIncrementFrameIndex(DcStream * stream)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        dcStreamUpdateFrameIndex(stream, 1, true);
+    }
+}
+
+void dcStreamSetFrameIndex(DcStream * stream, int frameIndex)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        dcStreamUpdateFrameIndex(stream, frameIndex, false);
+    }
+}
+
+bool dcStreamSendSVG(DcStream * stream, std::string name, const char * svgData, int svgSize)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamSendMessage(stream, stream->socket, MESSAGE_TYPE_SVG_STREAM, name, svgData, svgSize);
+}
+
+bool dcStreamSendSVGUpdate(DcStream * stream, std::string name, const char * updateData, int updateSize)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamSendMessage(stream, stream->socket, MESSAGE_TYPE_SVG_STREAM_UPDATE, name, updateData, updateSize);
+}
+
+bool dcStreamBindInteraction(DcStream * stream, std::string name)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamSendMessage(stream, stream->socket, MESSAGE_TYPE_BIND_INTERACTION, name, NULL, 0);
+}
+
+InteractionState dcStreamGetInteractionState(DcStream * stream)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return InteractionState();
+    }
+
+    return dcStreamGetInteractionState(stream->socket);
+}
+
+bool dcStreamBindWallLayout(DcStream * stream, std::string name)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamSendMessage(stream, stream->socket, MESSAGE_TYPE_BIND_WALL_LAYOUT, name, NULL, 0);
+}
+
+WallLayout dcStreamGetWallLayout(DcStream * stream)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return WallLayout();
+    }
+
+    return dcStreamGetWallLayout(stream->socket);
+}
+
+DcStreamWindowHints dcStreamGetWindowHints(DcStream * stream)
+{
+    return dcStreamComputeWindowHints(dcStreamGetWallLayout(stream));
+}
+
+void dcStreamSetAdaptToWindow(DcStream * stream, bool set)
+{
+    if(dcStreamCheckStream(stream) == true)
+    {
+        stream->adaptToWindow = set;
+    }
+}
+
+bool dcStreamIsSharedMemory(DcStream * stream)
+{
+    if(dcStreamCheckStream(stream) != true)
+    {
+        return false;
+    }
+
+    return dcStreamIsSharedMemory(stream->socket);
+}
+
+DcStream * dcStreamGetDefaultStream()
+{
+    // created on first use
+    static DcStream defaultStream;
+
+    return &defaultStream;
+}
+
+bool dcStreamCheckStream(DcStream * stream)
+{
+    if(stream == NULL)
+    {
+        put_flog(LOG_ERROR, "stream is NULL");
+
+        return false;
+    }
+
+    return true;
+}
+
+void dcStreamResetSegments(DcStream * stream, DcSocket * socket)
+{
+    // asynchronous sends could otherwise recreate segments after they're deleted
+    dcStreamWaitForAsyncSender(stream, socket);
+
+    for(std::map<std::string, std::vector<int> >::iterator it=stream->sourceIndices.begin(); it != stream->sourceIndices.end(); it++)
+    {
+        for(unsigned int i=0; i<(*it).second.size(); i++)
+        {
+            std::string name = (*it).first;
+            int sourceIndex = (*it).second[i];
+
+            // blank parameters object
+            DcStreamParameters parameters = dcStreamGenerateParameters(name, sourceIndex, 0, 0, 0, 0, 0, 0);
+
+            // send the blank parameters object
+            // this will trigger remote deletion of this segment
+            dcStreamSendSegment(stream, socket, parameters, PIXEL_STREAM_CODEC_JPEG, NULL, 0, true);
+        }
+    }
+
+    // clear the current source indices for each stream name
+#ifdef USE_MUTEX
+    stream->mut_SourceIndices.lock();
+#endif
+    stream->sourceIndices.clear();
+#ifdef USE_MUTEX
+    stream->mut_SourceIndices.unlock();
+#endif
+
+    // clear the history of sent segments
+#ifdef USE_MUTEX
+    stream->mut_SegmentHistory.lock();
+#endif
+    stream->segmentHistory.clear();
+#ifdef USE_MUTEX
+    stream->mut_SegmentHistory.unlock();
+#endif
+}
+
+bool dcStreamSendImage(DcStream * stream, DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const DcStreamParameters & parameters)
+{
+    // compute imagePitch if necessary, assuming imageBuffer isn't padded
+    if(imagePitch == 0)
+    {
+        imagePitch = imageWidth * dcBytesPerPixel[pixelFormat];
+    }
+
+    // the image was captured just before it was given to us
+    long long captureTimestamp = dcStreamGetTimestamp();
+
+    // downscale for the window showing the stream, or skip the frame if it's hidden
+    int scale;
+
+    if(dcStreamAdaptToWindow(stream, socket, parameters, dcStreamGetFrameIndex(stream), scale) != true)
+    {
+        return true;
+    }
+
+    // settings chosen by the rate controller
+    DcRateController & rateController = dcStreamGetRateController(stream, parameters.name);
+
+    DcImage d;
+
+    d.stream = stream;
+    d.parameters = parameters;
+    d.imageBuffer = imageBuffer + (parameters.y - imageY)*imagePitch + (parameters.x - imageX)*dcBytesPerPixel[pixelFormat];
+    d.width = parameters.width;
+    d.pitch = imagePitch;
+    d.height = parameters.height;
+    d.pixelFormat = pixelFormat;
+    d.codec = PIXEL_STREAM_CODEC_JPEG;
+    d.quality = rateController.getQuality();
+    d.subsampling = (JPEG_SUBSAMPLING)rateController.getSubsampling();
+    d.highestQuality = rateController.isHighestQuality();
+    d.sharedMemory = socket->isSharedMemory();
+    d.segmentBuffer = &dcStreamGetSegmentBuffer(stream, parameters);
+    d.scale = scale;
+    d.success = false;
+    d.unchanged = false;
+
+    dcStreamComputeImage(d);
+
+    if(d.success != true)
+    {
+        return false;
+    }
+
+#ifdef USE_MUTEX
+    stream->mut_send.lock();
+#endif
+
+    // unchanged segments are sent as markers, without image data
+    bool success = dcStreamQueueSegment(stream, socket, parameters, d.codec, *d.segmentBuffer, dcStreamGetFrameIndex(stream), captureTimestamp, false);
+
+#ifdef USE_MUTEX
+    stream->mut_send.unlock();
+#endif
+
+    rateController.segmentSent(dcStreamGetFrameIndex(stream), d.segmentBuffer->getImageDataSize(), socket->getAckLatency());
+
+    return success;
+}
+
+bool dcStreamSendFrame(DcStream * stream, DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, int frameIndex, long long captureTimestamp)
+{
+    if(parameters.size() == 0)
+    {
+        return true;
+    }
+
+    // compute imagePitch if necessary, assuming imageBuffer isn't padded
+    if(imagePitch == 0)
+    {
+        imagePitch = imageWidth * dcBytesPerPixel[pixelFormat];
+    }
+
+    // downscale for the window showing the stream, or skip the frame if it's hidden
+    int scale;
+
+    if(dcStreamAdaptToWindow(stream, socket, parameters[0], frameIndex, scale) != true)
+    {
+        return true;
+    }
+
+    // time the frame until all segments are acknowledged
+    QTime frameTime;
+    frameTime.start();
+
+    // settings chosen by the rate controller
+    DcRateController & rateController = dcStreamGetRateController(stream, parameters[0].name);
+
+    int quality = rateController.getQuality();
+    JPEG_SUBSAMPLING subsampling = (JPEG_SUBSAMPLING)rateController.getSubsampling();
+    bool highestQuality = rateController.isHighestQuality();
+    bool sharedMemory = socket->isSharedMemory();
+
+    // the segments of this frame; the vector and the segment buffers are reused from previous frames
+#ifdef USE_MUTEX
+    stream->mut_Images.lock();
+#endif
+    std::vector<DcImage> & dcImages = stream->images[parameters[0].name];
+#ifdef USE_MUTEX
+    stream->mut_Images.unlock();
+#endif
+
+    dcImages.resize(parameters.size());
+
+    for(unsigned int i=0; i<parameters.size(); i++)
+    {
+        DcImage & d = dcImages[i];
+
+        d.stream = stream;
+        d.parameters = parameters[i];
+
+        // imageBuffer coordinates have the origin at the bottom-left corner.
+        // DisplayCluster's coordinates have the origin at the top-left.
+        // a transformation is needed to find the appropriate memory location within the full imageBuffer...
+        d.imageBuffer = imageBuffer + imageHeight*imagePitch - (parameters[i].y - imageY + parameters[i].height)*imagePitch + (parameters[i].x - imageX)*dcBytesPerPixel[pixelFormat];
+
+        d.width = parameters[i].width;
+        d.pitch = imagePitch;
+        d.height = parameters[i].height;
+        d.pixelFormat = pixelFormat;
+        d.codec = PIXEL_STREAM_CODEC_JPEG;
+        d.quality = quality;
+        d.subsampling = subsampling;
+        d.highestQuality = highestQuality;
+        d.sharedMemory = sharedMemory;
+        d.segmentBuffer = &dcStreamGetSegmentBuffer(stream, parameters[i]);
+        d.scale = scale;
+        d.success = false;
+        d.unchanged = false;
+    }
+
+    // encode each changed segment, in parallel
+    dcStreamGetSendEngine(stream).parallelFor(dcImages.size(), &dcStreamComputeImageIndexed, (void *)&dcImages);
+
+    // send each segment, and return true if we were successful for all segments
+    // the segment buffers are queued without copying; they aren't modified again until the acks below are received
+    bool allSuccess = true;
+    int frameSize = 0;
+    int sentCount = 0;
+
+    for(unsigned int i=0; i<dcImages.size(); i++)
+    {
+        if(dcImages[i].success != true)
+        {
+            allSuccess = false;
+            continue;
+        }
+
+        // unchanged segments are sent as markers, without image data
+        if(dcStreamQueueSegment(stream, socket, parameters[i], dcImages[i].codec, *dcImages[i].segmentBuffer, frameIndex, captureTimestamp, false) == true)
+        {
+            sentCount++;
+        }
+        else
+        {
+            allSuccess = false;
+        }
+
+        frameSize += dcImages[i].segmentBuffer->getImageDataSize();
+    }
+
+    // wait for acks for all segments
+    socket->waitForAck(sentCount);
+
+    rateController.frameSent(frameSize, frameTime.elapsed());
+
+    return allSuccess;
+}
+
+bool dcStreamSendFrameAsync(DcStream * stream, DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, DcStreamSendCallback callback, void * userData)
+{
+    if(socket == NULL)
+    {
+        put_flog(LOG_ERROR, "socket is NULL");
+
+        return false;
+    }
+
+    if(socket->isConnected() != true)
+    {
+        put_flog(LOG_ERROR, "socket is not connected");
+
+        return false;
+    }
+
+    // compute imagePitch if necessary, assuming imageBuffer isn't padded
+    if(imagePitch == 0)
+    {
+        imagePitch = imageWidth * dcBytesPerPixel[pixelFormat];
+    }
+
+    // the frame index and capture time are taken now, since the application may change the frame index before the frame is sent
+    dcStreamGetAsyncSender(stream, socket, true)->queueFrame(imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, parameters, dcStreamGetFrameIndex(stream), dcStreamGetTimestamp(), callback, userData);
+
+    return true;
+}
+
+DcAsyncSender * dcStreamGetAsyncSender(DcStream * stream, DcSocket * socket, bool create)
+{
+#ifdef USE_MUTEX
+    stream->mut_AsyncSenders.lock();
+#endif
+    DcAsyncSender * asyncSender = NULL;
+
+    std::map<DcSocket *, DcAsyncSender *>::iterator it = stream->asyncSenders.find(socket);
+
+    if(it != stream->asyncSenders.end())
+    {
+        asyncSender = (*it).second;
+    }
+    else if(create == true)
+    {
+        asyncSender = new DcAsyncSender(stream, socket);
+        stream->asyncSenders[socket] = asyncSender;
+    }
+#ifdef USE_MUTEX
+    stream->mut_AsyncSenders.unlock();
+#endif
+
+    return asyncSender;
+}
+
+void dcStreamDeleteAsyncSender(DcStream * stream, DcSocket * socket)
+{
+#ifdef USE_MUTEX
+    stream->mut_AsyncSenders.lock();
+#endif
+    DcAsyncSender * asyncSender = NULL;
 
-    message.append((const char *)&mh, sizeof(MessageHeader));
+    std::map<DcSocket *, DcAsyncSender *>::iterator it = stream->asyncSenders.find(socket);
 
-    // message part 1: image data
-    if(svgSize > 0)
+    if(it != stream->asyncSenders.end())
     {
-        message.append(svgData, svgSize);
+        asyncSender = (*it).second;
+        stream->asyncSenders.erase(it);
     }
+#ifdef USE_MUTEX
+    stream->mut_AsyncSenders.unlock();
+#endif
 
-    // queue the message to be sent
+    // sends any queued frames
+    delete asyncSender;
+}
+
+bool dcStreamWaitForAsyncSender(DcStream * stream, DcSocket * socket)
+{
+    DcAsyncSender * asyncSender = dcStreamGetAsyncSender(stream, socket, false);
+
+    if(asyncSender == NULL)
+    {
+        return true;
+    }
+
+    return asyncSender->waitForFrames();
+}
+
+bool dcStreamSendSegment(DcStream * stream, DcSocket * socket, const DcStreamParameters & parameters, int codec, const char * imageData, int imageDataSize, bool waitForAck)
+{
+    // copy the image data to the segment's buffer
+    DcSegmentBuffer & segmentBuffer = dcStreamGetSegmentBuffer(stream, parameters);
+
+    segmentBuffer.reserve(imageDataSize);
+
+    if(imageDataSize > 0)
+    {
+        memcpy(segmentBuffer.getImageData(), imageData, imageDataSize);
+    }
+
+    segmentBuffer.setImageDataSize(imageDataSize);
+
+    return dcStreamQueueSegment(stream, socket, parameters, codec, segmentBuffer, dcStreamGetFrameIndex(stream), dcStreamGetTimestamp(), waitForAck);
+}
+
+bool dcStreamQueueSegment(DcStream * stream, DcSocket * socket, const DcStreamParameters & parameters, int codec, DcSegmentBuffer & segmentBuffer, int frameIndex, long long captureTimestamp, bool waitForAck)
+{
+    if(socket == NULL)
+    {
+        put_flog(LOG_ERROR, "socket is NULL");
+
+        return false;
+    }
+
+    if(socket->isConnected() != true)
+    {
+        put_flog(LOG_ERROR, "socket is not connected");
+
+        return false;
+    }
+
+    // the message header; its size is set with the image data size
+    MessageHeader * mh = segmentBuffer.getMessageHeader();
+    mh->type = MESSAGE_TYPE_PARALLEL_PIXELSTREAM;
+
+    // add the truncated URI to the header
+    size_t len = parameters.name.copy(mh->uri, MESSAGE_HEADER_URI_LENGTH - 1);
+    mh->uri[len] = '\0';
+
+    // message part 1: parameters
+    ParallelPixelStreamSegmentParameters * p = segmentBuffer.getParameters();
+
+    p->sourceIndex = parameters.sourceIndex;
+    p->frameIndex = frameIndex;
+    p->x = parameters.x;
+    p->y = parameters.y;
+    p->width = parameters.width;
+    p->height = parameters.height;
+    p->totalWidth = parameters.totalWidth;
+    p->totalHeight = parameters.totalHeight;
+    p->codec = codec;
+    p->reserved = 0;
+    p->captureTimestamp = captureTimestamp;
+
+    // message part 2: image data, already in the buffer
+
+    // queue the message to be sent; the buffer isn't written again until the socket has sent it
 #ifdef USE_MUTEX
-    mut_Qt.lock();
+    stream->mut_Qt.lock();
 #endif
-    bool success = socket->queueMessage(message);
-    socket->waitForAck();
+    bool success = socket->queueMessage(segmentBuffer);
+    // wait for acknowledgment if requested. this wait can be disabled to buffer all sends before waiting for acknowledgments, for example.
+    if(waitForAck == true)
+    {
+        socket->waitForAck();
+    }
 #ifdef USE_MUTEX
-    mut_Qt.unlock();
+    stream->mut_Qt.unlock();
 #endif
 
+    dcStreamAddSourceIndex(stream, parameters);
+
     return success;
 }
 
-bool dcStreamBindInteraction(DcSocket * socket, std::string name)
+void dcStreamAddSourceIndex(DcStream * stream, const DcStreamParameters & parameters)
+{
+#ifdef USE_MUTEX
+    stream->mut_SourceIndices.lock();
+#endif
+    // make sure this sourceIndex is in the vector of current source indices for this stream name, so dcStreamReset()
+    // deletes it
+    std::vector<int> & sourceIndices = stream->sourceIndices[parameters.name];
+
+    if(std::count(sourceIndices.begin(), sourceIndices.end(), parameters.sourceIndex) == 0)
+    {
+        sourceIndices.push_back(parameters.sourceIndex);
+    }
+#ifdef USE_MUTEX
+    stream->mut_SourceIndices.unlock();
+#endif
+}
+
+bool dcStreamSendMessage(DcStream * stream, DcSocket * socket, MESSAGE_TYPE type, const std::string & name, const char * data, int size)
 {
     if(socket == NULL)
     {
@@ -561,8 +1177,8 @@ bool dcStreamBindInteraction(DcSocket * socket, std::string name)
 
     // the message header
     MessageHeader mh;
-    mh.size = 0;
-    mh.type = MESSAGE_TYPE_BIND_INTERACTION;
+    mh.size = size;
+    mh.type = type;
 
     // add the truncated URI to the header
     size_t len = name.copy(mh.uri, MESSAGE_HEADER_URI_LENGTH - 1);
@@ -570,36 +1186,414 @@ bool dcStreamBindInteraction(DcSocket * socket, std::string name)
 
     message.append((const char *)&mh, sizeof(MessageHeader));
 
+    // message part 1: data
+    if(size > 0)
+    {
+        message.append(data, size);
+    }
+
     // queue the message to be sent
 #ifdef USE_MUTEX
-    mut_Qt.lock();
+    stream->mut_Qt.lock();
 #endif
     bool success = socket->queueMessage(message);
     socket->waitForAck();
 #ifdef USE_MUTEX
-    mut_Qt.unlock();
+    stream->mut_Qt.unlock();
 #endif
 
     return success;
 }
 
-InteractionState dcStreamGetInteractionState(DcSocket * socket)
+DcStreamRateStatus dcStreamGetStreamRateStatus(DcStream * stream, const std::string & name)
 {
-    if(socket == NULL)
+    DcRateController & rateController = dcStreamGetRateController(stream, name);
+
+    DcStreamRateStatus status;
+
+    status.targetFrameRate = rateController.getTargetFrameRate();
+    status.targetBandwidth = rateController.getTargetBandwidth();
+    status.quality = rateController.getQuality();
+    status.subsampling = (JPEG_SUBSAMPLING)rateController.getSubsampling();
+    status.frameRate = rateController.getFrameRate();
+    status.bandwidth = rateController.getBandwidth();
+    status.ackLatency = rateController.getAckLatency();
+
+    return status;
+}
+
+bool dcStreamAdaptToWindow(DcStream * stream, DcSocket * socket, const DcStreamParameters & parameters, int frameIndex, int & scale)
+{
+    scale = 1;
+
+    if(stream->adaptToWindow != true || socket == NULL)
     {
-        put_flog(LOG_ERROR, "socket is NULL");
+        return true;
+    }
 
-        return InteractionState();
+    DcStreamWindowHints hints = dcStreamComputeWindowHints(socket->getWallLayout());
+
+    // the largest factor that keeps the image at least at the resolution it is shown at
+    if(hints.width > 0 && hints.height > 0)
+    {
+        scale = std::max(1, std::min(parameters.totalWidth / hints.width, parameters.totalHeight / hints.height));
     }
 
-    return socket->getInteractionState();
+#ifdef USE_MUTEX
+    stream->mut_HiddenFrames.lock();
+#endif
+    bool send = true;
+
+    if(hints.visible == true)
+    {
+        stream->hiddenFrames.erase(socket);
+    }
+    else
+    {
+        // while hidden, only send frames occasionally
+        send = stream->hiddenFrames[socket].send(frameIndex, parameters.name, parameters.sourceIndex);
+    }
+#ifdef USE_MUTEX
+    stream->mut_HiddenFrames.unlock();
+#endif
+
+    return send;
+}
+
+DcStreamWindowHints dcStreamComputeWindowHints(const WallLayout & layout)
+{
+    DcStreamWindowHints hints;
+
+    hints.width = 0;
+    hints.height = 0;
+    hints.visible = layout.visible;
+
+    if(layout.numTilesWidth > 0 && layout.numTilesHeight > 0)
+    {
+        // the tiled display in pixels, including mullions
+        double totalWidth = (double)(layout.numTilesWidth * layout.screenWidth + (layout.numTilesWidth - 1) * layout.mullionWidth);
+        double totalHeight = (double)(layout.numTilesHeight * layout.screenHeight + (layout.numTilesHeight - 1) * layout.mullionHeight);
+
+        hints.width = (int)ceil(layout.w * totalWidth * layout.zoom);
+        hints.height = (int)ceil(layout.h * totalHeight * layout.zoom);
+    }
+
+    return hints;
+}
+
+void dcStreamComputeImage(DcImage & dcImage)
+{
+    dcImage.codec = dcStreamChooseCodec(dcStreamGetRateController(dcImage.stream, dcImage.parameters.name), dcImage.parameters, dcImage.imageBuffer, dcImage.pitch, dcImage.pixelFormat, dcImage.sharedMemory);
+
+    DC_SEGMENT_STATE state = DC_SEGMENT_CHANGED;
+
+    if(dcImage.stream->skipUnchangedSegments == true)
+    {
+        // lossless segments don't need a refresh
+        state = dcStreamUpdateSegmentHistory(dcImage.stream, dcImage.parameters, dcStreamHashImage(dcImage.parameters, dcImage.scale, dcImage.imageBuffer, dcImage.width, dcImage.pitch, dcImage.height, dcImage.pixelFormat), dcImage.highestQuality || dcImage.codec != PIXEL_STREAM_CODEC_JPEG);
+    }
+
+    // skip compression of unchanged segments
+    if(state == DC_SEGMENT_UNCHANGED)
+    {
+        dcImage.segmentBuffer->setImageDataSize(0);
+        dcImage.unchanged = true;
+        dcImage.success = true;
+
+        return;
+    }
+    else if(state == DC_SEGMENT_REFRESH)
+    {
+        dcImage.quality = DC_REFRESH_JPEG_QUALITY;
+        dcImage.subsampling = (JPEG_SUBSAMPLING)DC_REFRESH_JPEG_SUBSAMPLING;
+    }
+
+    if(dcImage.scale > 1)
+    {
+        dcStreamScaleImage(dcImage);
+    }
+
+    dcImage.success = dcStreamEncodeImage(dcImage);
+}
+
+void dcStreamComputeImageIndexed(int index, void * dcImages)
+{
+    dcStreamComputeImage((*(std::vector<DcImage> *)dcImages)[index]);
+}
+
+void dcStreamScaleImage(DcImage & dcImage)
+{
+    // box filter; the server shows segment images over the segment's area whatever their resolution
+    int scale = dcImage.scale;
+    int bytesPerPixel = dcBytesPerPixel[dcImage.pixelFormat];
+
+    int width = (dcImage.width + scale - 1) / scale;
+    int height = (dcImage.height + scale - 1) / scale;
+    int pitch = width * bytesPerPixel;
+
+    dcImage.scaledImageBuffer.resize(pitch * height);
+
+    for(int j=0; j<height; j++)
+    {
+        int y0 = j * scale;
+        int y1 = std::min(y0 + scale, dcImage.height);
+
+        for(int i=0; i<width; i++)
+        {
+            int x0 = i * scale;
+            int x1 = std::min(x0 + scale, dcImage.width);
+
+            int sums[4] = { 0, 0, 0, 0 };
+
+            for(int y=y0; y<y1; y++)
+            {
+                unsigned char * pixel = dcImage.imageBuffer + y*dcImage.pitch + x0*bytesPerPixel;
+
+                for(int x=x0; x<x1; x++)
+                {
+                    for(int c=0; c<bytesPerPixel; c++)
+                    {
+                        sums[c] += pixel[c];
+                    }
+
+                    pixel += bytesPerPixel;
+                }
+            }
+
+            int count = (x1 - x0) * (y1 - y0);
+
+            unsigned char * scaledPixel = &dcImage.scaledImageBuffer[j*pitch + i*bytesPerPixel];
+
+            for(int c=0; c<bytesPerPixel; c++)
+            {
+                scaledPixel[c] = (unsigned char)(sums[c] / count);
+            }
+        }
+    }
+
+    dcImage.imageBuffer = &dcImage.scaledImageBuffer[0];
+    dcImage.width = width;
+    dcImage.pitch = pitch;
+    dcImage.height = height;
+}
+
+bool dcStreamEncodeImage(DcImage & dcImage)
+{
+    DcSegmentBuffer & segmentBuffer = *dcImage.segmentBuffer;
+
+    int size = 0;
+
+    // imageBuffer has the origin at the bottom-left corner
+    if(dcImage.codec == PIXEL_STREAM_CODEC_JPEG)
+    {
+        // JPEG_SUBSAMPLING values match TJSAMP_444, TJSAMP_422, TJSAMP_420
+        segmentBuffer.reserve(tjBufSize(dcImage.width, dcImage.height, (int)dcImage.subsampling));
+
+        size = DcJpegCompressor::getThreadCompressor().compress(dcImage.imageBuffer, dcImage.width, dcImage.pitch, dcImage.height, dcTjPixelFormats[dcImage.pixelFormat], (int)dcImage.subsampling, dcImage.quality, TJFLAG_BOTTOMUP, segmentBuffer.getImageData(), segmentBuffer.getImageDataCapacity());
+    }
+    else if(dcImage.codec == PIXEL_STREAM_CODEC_LZ4)
+    {
+        segmentBuffer.reserve(pixelStreamGetMaxEncodedSize(dcImage.codec, dcImage.width, dcImage.height));
+
+        size = pixelStreamEncodeLz4(dcImage.imageBuffer, dcImage.width, dcImage.pitch, dcImage.height, dcTjPixelFormats[dcImage.pixelFormat], true, segmentBuffer.getImageData(), segmentBuffer.getImageDataCapacity());
+    }
+    else if(dcImage.codec == PIXEL_STREAM_CODEC_RAW)
+    {
+        segmentBuffer.reserve(pixelStreamGetMaxEncodedSize(dcImage.codec, dcImage.width, dcImage.height));
+
+        size = pixelStreamEncodeRaw(dcImage.imageBuffer, dcImage.width, dcImage.pitch, dcImage.height, dcTjPixelFormats[dcImage.pixelFormat], true, segmentBuffer.getImageData(), segmentBuffer.getImageDataCapacity());
+    }
+    else
+    {
+        put_flog(LOG_ERROR, "unknown codec %i", dcImage.codec);
+    }
+
+    segmentBuffer.setImageDataSize(size);
+
+    // size 0 indicates an error
+    return size > 0;
+}
+
+uint64_t dcStreamHashImage(const DcStreamParameters & parameters, int scale, unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat)
+{
+    // FNV-1a, over 64-bit words where possible; fast enough to compute for every segment of every frame
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+
+    // segments with changed parameters or resolution must be sent again
+    int32_t geometry[7] = { parameters.x, parameters.y, parameters.width, parameters.height, parameters.totalWidth, parameters.totalHeight, scale };
+
+    for(int i=0; i<7; i++)
+    {
+        hash = (hash ^ (uint64_t)(uint32_t)geometry[i]) * prime;
+    }
+
+    int lineSize = width * dcBytesPerPixel[pixelFormat];
+
+    for(int j=0; j<height; j++)
+    {
+        unsigned char * line = imageBuffer + j*pitch;
+
+        int i=0;
+
+        for(; i+(int)sizeof(uint64_t)<=lineSize; i+=sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, line + i, sizeof(uint64_t));
+
+            hash = (hash ^ word) * prime;
+        }
+
+        for(; i<lineSize; i++)
+        {
+            hash = (hash ^ (uint64_t)line[i]) * prime;
+        }
+    }
+
+    return hash;
+}
+
+DC_SEGMENT_STATE dcStreamUpdateSegmentHistory(DcStream * stream, const DcStreamParameters & parameters, uint64_t hash, bool highestQuality)
+{
+    // unchanged segments are sent once more at refresh quality, and then only as markers
+    DC_SEGMENT_STATE state;
+
+#ifdef USE_MUTEX
+    stream->mut_SegmentHistory.lock();
+#endif
+
+    std::map<int, DcSegmentHistory> & history = stream->segmentHistory[parameters.name];
+
+    bool unchanged = history.count(parameters.sourceIndex) != 0 && history[parameters.sourceIndex].hash == hash;
+
+    if(unchanged == true && history[parameters.sourceIndex].refreshed == true && history[parameters.sourceIndex].unchangedCount < DC_STREAM_SEGMENT_REFRESH_INTERVAL)
+    {
+        history[parameters.sourceIndex].unchangedCount++;
+        state = DC_SEGMENT_UNCHANGED;
+    }
+    else if(unchanged == true)
+    {
+        history[parameters.sourceIndex].unchangedCount = 0;
+        history[parameters.sourceIndex].refreshed = true;
+        state = DC_SEGMENT_REFRESH;
+    }
+    else
+    {
+        history[parameters.sourceIndex].hash = hash;
+        history[parameters.sourceIndex].unchangedCount = 0;
+        history[parameters.sourceIndex].refreshed = highestQuality;
+        state = DC_SEGMENT_CHANGED;
+    }
+
+#ifdef USE_MUTEX
+    stream->mut_SegmentHistory.unlock();
+#endif
+
+    return state;
+}
+
+DcRateController & dcStreamGetRateController(DcStream * stream, const std::string & name)
+{
+#ifdef USE_MUTEX
+    stream->mut_RateControllers.lock();
+#endif
+
+    // references to map elements remain valid as other elements are inserted
+    DcRateController & rateController = stream->rateControllers[name];
+
+#ifdef USE_MUTEX
+    stream->mut_RateControllers.unlock();
+#endif
+
+    return rateController;
+}
+
+DcSegmentBuffer & dcStreamGetSegmentBuffer(DcStream * stream, const DcStreamParameters & parameters)
+{
+#ifdef USE_MUTEX
+    stream->mut_SegmentBuffers.lock();
+#endif
+
+    // references to map elements remain valid as other elements are inserted
+    DcSegmentBuffer & segmentBuffer = stream->segmentBuffers[parameters.name][parameters.sourceIndex];
+
+#ifdef USE_MUTEX
+    stream->mut_SegmentBuffers.unlock();
+#endif
+
+    return segmentBuffer;
+}
+
+DcSendEngine & dcStreamGetSendEngine(DcStream * stream)
+{
+#ifdef USE_MUTEX
+    stream->mut_SendEngine.lock();
+#endif
+    // created on first use, so the library doesn't start threads unless segments are sent in parallel
+    if(stream->sendEngine == NULL)
+    {
+        stream->sendEngine = new DcSendEngine();
+    }
+#ifdef USE_MUTEX
+    stream->mut_SendEngine.unlock();
+#endif
+
+    return *stream->sendEngine;
+}
+
+int dcStreamGetFrameIndex(DcStream * stream)
+{
+#ifdef USE_MUTEX
+    stream->mut_FrameIndex.lock();
+#endif
+    int frameIndex = stream->frameIndex;
+#ifdef USE_MUTEX
+    stream->mut_FrameIndex.unlock();
+#endif
+
+    return frameIndex;
+}
+
+long long dcStreamGetTimestamp()
+{
+    // microseconds since the epoch; DisplayCluster measures latency from this, so the clock should be synchronized with the cluster's (e.g. with NTP)
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void dcStreamUpdateFrameIndex(DcStream * stream, int frameIndex, bool increment)
+{
+#ifdef USE_MUTEX
+    stream->mut_FrameIndex.lock();
+#endif
+    if(increment == true)
+    {
+        stream->frameIndex += frameIndex;
+    }
+    else
+    {
+        stream->frameIndex = frameIndex;
+    }
+#ifdef USE_MUTEX
+    stream->mut_FrameIndex.unlock();
+#endif
 }
 
-DcImage dcStreamComputeJpegMapped(const DcImage & dcImage)
+int dcStreamChooseCodec(DcRateController & rateController, const DcStreamParameters & parameters, unsigned char * imageBuffer, int pitch, PIXEL_FORMAT pixelFormat, bool sharedMemory)
 {
-    DcImage newDcImage = dcImage;
+    int codec = rateController.getCodec();
+
+    if(codec != DC_CODEC_AUTO)
+    {
+        return codec;
+    }
+
+    float entropy = pixelStreamComputeEntropy(imageBuffer, parameters.width, pitch, parameters.height, dcTjPixelFormats[pixelFormat]);
 
-    dcStreamComputeJpeg(newDcImage.imageBuffer, newDcImage.width, newDcImage.pitch, newDcImage.height, newDcImage.pixelFormat, &newDcImage.jpegData, newDcImage.jpegSize);
+    // shared memory isn't limited by bandwidth, so only cheap compression is worth it
+    if(sharedMemory == true)
+    {
+        return entropy < PIXEL_STREAM_CODEC_LZ4_MAX_ENTROPY ? PIXEL_STREAM_CODEC_LZ4 : PIXEL_STREAM_CODEC_RAW;
+    }
 
-    return newDcImage;
+    return rateController.chooseCodec(entropy, parameters.width, parameters.height, parameters.totalWidth, parameters.totalHeight);
 }
@@ -40,13 +40,19 @@
 #define DC_STREAM_H
 
 #include "InteractionState.h"
+#include "WallLayout.h"
 #include <string>
 #include <vector>
 
-#include <mutex>
-
 class DcSocket;
 
+// a stream: a connection to a DisplayCluster instance with its own frame index,
+// segments, and compression resources. streams share no state or locks, so
+// several streams, to one or more DisplayCluster instances, can be sent from
+// one process in parallel. the functions taking a DcSocket share one default
+// stream between all sockets; their frame index is process-wide.
+class DcStream;
+
 struct DcStreamParameters  {
     std::string name;
     int sourceIndex;
@@ -60,10 +66,58 @@ struct DcStreamParameters  {
 
 enum PIXEL_FORMAT { RGB=0, RGBA=1, ARGB=2, BGR=3, BGRA=4, ABGR=5 };
 
+// JPEG chroma subsampling, from highest to lowest quality
+enum JPEG_SUBSAMPLING { SUBSAMPLING_444=0, SUBSAMPLING_422=1, SUBSAMPLING_420=2 };
+
+// segment codecs. CODEC_AUTO chooses per segment: lossless LZ4 for low-entropy
+// content (UI, text, plots), uncompressed RAW if it fits the target bandwidth,
+// and JPEG otherwise.
+enum SEGMENT_CODEC { CODEC_AUTO=-1, CODEC_JPEG=0, CODEC_RAW=1, CODEC_LZ4=2 };
+
+// what dcStreamSendAsync() does when maxQueuedFrames frames are already queued
+// behind the frame being sent: queue the new frame anyway, drop the oldest
+// queued frame, or block until a queued frame is started.
+enum ASYNC_POLICY { ASYNC_QUEUE=0, ASYNC_DROP_OLDEST=1, ASYNC_BLOCK=2 };
+
+// result of an asynchronous send, given to its completion callback
+enum SEND_RESULT { SEND_SUCCESS=0, SEND_FAILURE=1, SEND_DROPPED=2 };
+
+// completion callback for dcStreamSendAsync(). it is called on a library
+// thread, and should return quickly.
+typedef void (*DcStreamSendCallback)(SEND_RESULT result, int frameIndex, void * userData);
+
+// resolution and visibility hints for the window showing a stream
+struct DcStreamWindowHints {
+    // size in pixels the full stream image is shown at on the tiled display, at
+    // the window's current size and zoom; 0 if unknown
+    int width;
+    int height;
+
+    // false if the window is off the tiled display, or covered by another window
+    bool visible;
+};
+
+struct DcStreamRateStatus {
+    // targets; 0 if disabled
+    float targetFrameRate;
+    float targetBandwidth; // megabits per second
+
+    // current JPEG settings
+    int quality;
+    JPEG_SUBSAMPLING subsampling;
+
+    // measured over the last second
+    float frameRate;
+    float bandwidth; // megabits per second
+    int ackLatency; // milliseconds
+};
+
 // make a new connection to the DisplayCluster instance on hostname, and
 // returns a DcSocket. the user is responsible for closing the socket using
-// dcStreamDisconnect().
-extern DcSocket * dcStreamConnect(const char * hostname);
+// dcStreamDisconnect(). if sharedMemory is set and DisplayCluster is running
+// on this host, segments are passed through shared memory instead of the
+// network, and are compressed only if that is cheap.
+extern DcSocket * dcStreamConnect(const char * hostname, bool sharedMemory=true);
 
 // closes a previously opened connection, deleting the socket.
 extern void dcStreamDisconnect(DcSocket *& socket);
@@ -83,25 +137,87 @@ extern DcStreamParameters dcStreamGenerateParameters(std::string name, int sourc
 // firstSourceIndex.
 extern std::vector<DcStreamParameters> dcStreamGenerateParameters(std::string name, int firstSourceIndex, int nominalSegmentWidth, int nominalSegmentHeight, int x, int y, int width, int height, int totalWidth, int totalHeight);
 
+// the same as above, but segments are cut along the screen boundaries of the
+// tiled display given by layout (see dcStreamGetWallLayout()), so each segment
+// is shown on, and decoded by, a single screen. the segments depend on the
+// window's placement; when the layout changes, call dcStreamReset() and send
+// newly generated segments. if the layout is unknown, the region is subdivided
+// uniformly.
+extern std::vector<DcStreamParameters> dcStreamGenerateParameters(std::string name, int firstSourceIndex, int nominalSegmentWidth, int nominalSegmentHeight, int x, int y, int width, int height, int totalWidth, int totalHeight, const WallLayout & layout);
+
 // generates a segment corresponding to parameters from imageBuffer and sends
-// it to a DisplayCluster instance over socket. (imageX, imageY, imageWidth,
+// it to a DisplayCluster instance over socket. if the segment's image is
+// unchanged since it was last sent, only an unchanged marker is sent (see
+// dcStreamSetSkipUnchangedSegments()). (imageX, imageY, imageWidth,
 // imageHeight) give the origin and dimensions of the image relative to the full
 // represented by all streams corresponding to <name>. imagePitch is the bytes
 // per line in imageBuffer. pixelFormat gives the format of the buffer.
-extern bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, DcStreamParameters parameters);
+extern bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const DcStreamParameters & parameters);
 
 // the same as above, excepts sends a group of segments corresponding to the
 // given vector of parameters. compression of segment image data is parallel.
-extern bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, std::vector<DcStreamParameters> parameters);
+// compressors and message buffers are reused across frames rather than
+// reallocated for every segment.
+extern bool dcStreamSend(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters);
+
+// the same as above, but returns immediately. the image is copied, and the
+// segments are compressed and sent on a library thread, so the application can
+// overlap its next frame with compression and transmission. the current frame
+// index is used for the segments. callback, if given, is called when the frame
+// has been acknowledged, has failed, or was dropped (see
+// dcStreamSetAsyncPolicy()). don't mix synchronous and asynchronous sends on a
+// socket without calling dcStreamWaitForAsync() in between.
+extern bool dcStreamSendAsync(DcSocket * socket, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, DcStreamSendCallback callback=NULL, void * userData=NULL);
+
+// sets what dcStreamSendAsync() does when maxQueuedFrames frames are already
+// waiting behind the frame being sent on socket. the default is
+// ASYNC_DROP_OLDEST with 1 queued frame, so the latest frame is always sent
+// next. maxQueuedFrames is ignored for ASYNC_QUEUE.
+extern void dcStreamSetAsyncPolicy(DcSocket * socket, ASYNC_POLICY policy, int maxQueuedFrames=1);
+
+// blocks until all frames sent with dcStreamSendAsync() on socket have been
+// sent or dropped. returns false if any frame failed since the last call.
+extern bool dcStreamWaitForAsync(DcSocket * socket);
 
 // sends a compressed JPEG image corresponding to parameters and sends it to a
 // DisplayCluster instance over socket. if waitForAck is true, this function
 // will block until an acknowledgment is received.
 extern bool dcStreamSendJpeg(DcSocket * socket, DcStreamParameters parameters, const char * jpegData, int jpegSize, bool waitForAck=true);
 
+// sends a marker indicating the segment corresponding to parameters is
+// unchanged for the current frame index. this satisfies frame synchronization
+// for the segment without sending or decoding any image data.
+extern bool dcStreamSendUnchanged(DcSocket * socket, DcStreamParameters parameters, bool waitForAck=true);
+
+// enable or disable the detection of unchanged segments in dcStreamSend().
+// segments are compared to the last image sent for them using a hash, and
+// every segment is still sent periodically. enabled by default.
+extern void dcStreamSetSkipUnchangedSegments(bool set);
+
 // computes a compressed JPEG image corresponding to imageBuffer. results are
-// stored in jpegData and jpegSize.
-extern bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize);
+// stored in jpegData and jpegSize. *jpegData must be NULL or a buffer from a
+// previous call (or malloc()); it is reused and grown as needed, and must be
+// released by the caller with free().
+extern bool dcStreamComputeJpeg(unsigned char * imageBuffer, int width, int pitch, int height, PIXEL_FORMAT pixelFormat, char ** jpegData, int & jpegSize, int quality=75, JPEG_SUBSAMPLING subsampling=SUBSAMPLING_444);
+
+// sets a target frame rate for the stream <name>. dcStreamSend() then adapts
+// the JPEG quality and chroma subsampling of the stream so the server
+// acknowledges frames at this rate. segments that become static are sent once
+// more at a high quality. 0 (the default) disables the target.
+extern void dcStreamSetTargetFrameRate(std::string name, float frameRate);
+
+// sets a target bandwidth, in megabits per second, for the stream <name>. this
+// can be used with or instead of a target frame rate. 0 (the default) disables
+// the target.
+extern void dcStreamSetTargetBandwidth(std::string name, float bandwidth);
+
+// gets the targets, current JPEG settings, and measured rates of the stream
+// <name>.
+extern DcStreamRateStatus dcStreamGetRateStatus(std::string name);
+
+// sets the codec used by dcStreamSend() for the stream <name>. the default is
+// CODEC_AUTO; RAW is only chosen automatically if a target bandwidth is set.
+extern void dcStreamSetCodec(std::string name, SEGMENT_CODEC codec);
 
 // increment the frame index for all segments sent by this process. this is
 // used for frame synchronization.
@@ -116,8 +232,74 @@ extern void dcStreamSetFrameIndex(int frameIndex);
 // streaming vector-based graphics.
 extern bool dcStreamSendSVG(DcSocket * socket, std::string name, const char * svgData, int svgSize);
 
+// sends incremental updates to the last SVG sent with the given name, so small
+// changes don't require the full document to be sent and parsed again. the
+// updates set attributes of elements identified by id:
+// <updates><set id="label" fill="red" x="10" /> ... </updates>
+extern bool dcStreamSendSVGUpdate(DcSocket * socket, std::string name, const char * updateData, int updateSize);
+
 extern bool dcStreamBindInteraction(DcSocket * socket, std::string name);
 
 extern InteractionState dcStreamGetInteractionState(DcSocket * socket);
 
+// requests the layout of the tiled display and the placement of the window
+// showing the stream <name>. the server sends it once the window exists, and
+// again whenever the window is moved or resized.
+extern bool dcStreamBindWallLayout(DcSocket * socket, std::string name);
+
+// gets the latest layout received on socket. it is unknown (numTilesWidth is
+// 0) until the server has sent one.
+extern WallLayout dcStreamGetWallLayout(DcSocket * socket);
+
+// gets resolution and visibility hints from the latest layout received on
+// socket. an application can render its images at the hinted size in the first
+// place, and stop rendering while the window is hidden.
+extern DcStreamWindowHints dcStreamGetWindowHints(DcSocket * socket);
+
+// enable or disable adapting dcStreamSend() to the window bound with
+// dcStreamBindWallLayout(): images larger than the window shows them are
+// downscaled before compression, and frames are sent at most once per second
+// while the window is hidden. enabled by default; it has no effect until a
+// layout has been received.
+extern void dcStreamSetAdaptToWindow(bool set);
+
+// returns true if socket passes segments through shared memory.
+extern bool dcStreamIsSharedMemory(DcSocket * socket);
+
+// opens a stream to the DisplayCluster instance on hostname. returns NULL on
+// failure. the user is responsible for closing the stream using
+// dcStreamClose().
+extern DcStream * dcStreamOpen(const char * hostname, bool sharedMemory=true);
+
+// closes a stream opened with dcStreamOpen(), after any asynchronous sends have
+// finished, deleting it.
+extern void dcStreamClose(DcStream *& stream);
+
+// the functions above, for a stream. settings (target rates, codecs, skipping
+// unchanged segments) and the frame index apply only to the stream.
+extern void dcStreamReset(DcStream * stream);
+extern bool dcStreamSend(DcStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const DcStreamParameters & parameters);
+extern bool dcStreamSend(DcStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters);
+extern bool dcStreamSendAsync(DcStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, const std::vector<DcStreamParameters> & parameters, DcStreamSendCallback callback=NULL, void * userData=NULL);
+extern void dcStreamSetAsyncPolicy(DcStream * stream, ASYNC_POLICY policy, int maxQueuedFrames=1);
+extern bool dcStreamWaitForAsync(DcStream * stream);
+extern bool dcStreamSendJpeg(DcStream * stream, DcStreamParameters parameters, const char * jpegData, int jpegSize, bool waitForAck=true);
+extern bool dcStreamSendUnchanged(DcStream * stream, DcStreamParameters parameters, bool waitForAck=true);
+extern void dcStreamSetSkipUnchangedSegments(DcStream * stream, bool set);
+extern void dcStreamSetTargetFrameRate(DcStream * stream, std::string name, float frameRate);
+extern void dcStreamSetTargetBandwidth(DcStream * stream, std::string name, float bandwidth);
+extern DcStreamRateStatus dcStreamGetRateStatus(DcStream * stream, std::string name);
+extern void dcStreamSetCodec(DcStream * stream, std::string name, SEGMENT_CODEC codec);
+extern void dcStreamIncrementFrameIndex(DcStream * stream);
+extern void dcStreamSetFrameIndex(DcStream * stream, int frameIndex);
+extern bool dcStreamSendSVG(DcStream * stream, std::string name, const char * svgData, int svgSize);
+extern bool dcStreamSendSVGUpdate(DcStream * stream, std::string name, const char * updateData, int updateSize);
+extern bool dcStreamBindInteraction(DcStream * stream, std::string name);
+extern InteractionState dcStreamGetInteractionState(DcStream * stream);
+extern bool dcStreamBindWallLayout(DcStream * stream, std::string name);
+extern WallLayout dcStreamGetWallLayout(DcStream * stream);
+extern DcStreamWindowHints dcStreamGetWindowHints(DcStream * stream);
+extern void dcStreamSetAdaptToWindow(DcStream * stream, bool set);
+extern bool dcStreamIsSharedMemory(DcStream * stream);
+
 #endif
@@ -0,0 +1,395 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#include "dcStreamParallel.h"
+#include "../log.h"
+#include <algorithm>
+#include <string.h>
+
+// defined in dcStream.cpp
+extern int dcBytesPerPixel[];
+
+class DcParallelStream {
+
+    public:
+
+        DcParallelStream();
+        ~DcParallelStream();
+
+        // duplicate of the application's communicator, so our messages can't match the application's
+        MPI_Comm comm;
+        int rank;
+        int size;
+
+        // ranks sending through the same sender; the sender is rank 0 of groupComm and firstGroupRank of comm
+        MPI_Comm groupComm;
+        int groupSize;
+        int firstGroupRank;
+
+        // this rank's stream; NULL unless this rank is a sender
+        DcStream * stream;
+
+        int frameIndex;
+
+        // the current layout: the window name, segment size, and (x, y, width, height) of each rank's piece
+        std::string name;
+        int nominalSegmentSize;
+        std::vector<int> pieces;
+
+        // for senders: segments of each piece of the group, and the source indices of all of them
+        std::vector<std::vector<DcStreamParameters> > groupParameters;
+        std::vector<int> sourceIndices;
+
+        // reused for every frame
+        std::vector<int> newPieces;
+        std::vector<unsigned char> packedImage;
+        std::vector<unsigned char> groupImages;
+        std::vector<int> groupImageSizes;
+        std::vector<int> groupImageOffsets;
+};
+
+void dcStreamParallelUpdateLayout(DcParallelStream * stream, const std::string & name, int nominalSegmentSize);
+std::vector<DcStreamParameters> dcStreamParallelGenerateParameters(const std::string & name, int firstSourceIndex, int nominalSegmentSize, const int * piece, int totalWidth, int totalHeight);
+
+DcParallelStream::DcParallelStream()
+{
+    // defaults
+    comm = MPI_COMM_NULL;
+    rank = 0;
+    size = 0;
+    groupComm = MPI_COMM_NULL;
+    groupSize = 0;
+    firstGroupRank = 0;
+    stream = NULL;
+    frameIndex = 0;
+    nominalSegmentSize = 0;
+}
+
+DcParallelStream::~DcParallelStream()
+{
+    dcStreamClose(stream);
+
+    if(groupComm != MPI_COMM_NULL)
+    {
+        MPI_Comm_free(&groupComm);
+    }
+
+    if(comm != MPI_COMM_NULL)
+    {
+        MPI_Comm_free(&comm);
+    }
+}
+
+DcParallelStream * dcStreamParallelOpen(MPI_Comm comm, const char * hostname, int maxSenders)
+{
+    DcParallelStream * stream = new DcParallelStream();
+
+    MPI_Comm_dup(comm, &stream->comm);
+    MPI_Comm_rank(stream->comm, &stream->rank);
+    MPI_Comm_size(stream->comm, &stream->size);
+
+    int senders = stream->size;
+
+    if(maxSenders > 0 && maxSenders < senders)
+    {
+        senders = maxSenders;
+    }
+
+    // groups of consecutive ranks, as equal in size as possible
+    int group = (int)((long long)stream->rank * (long long)senders / (long long)stream->size);
+
+    MPI_Comm_split(stream->comm, group, stream->rank, &stream->groupComm);
+
+    int groupRank;
+    MPI_Comm_rank(stream->groupComm, &groupRank);
+    MPI_Comm_size(stream->groupComm, &stream->groupSize);
+
+    stream->firstGroupRank = stream->rank - groupRank;
+
+    int connected = 1;
+
+    if(groupRank == 0)
+    {
+        stream->stream = dcStreamOpen(hostname);
+
+        connected = (stream->stream != NULL) ? 1 : 0;
+    }
+
+    int allConnected;
+    MPI_Allreduce(&connected, &allConnected, 1, MPI_INT, MPI_LAND, stream->comm);
+
+    if(allConnected == 0)
+    {
+        if(stream->rank == 0)
+        {
+            put_flog(LOG_ERROR, "could not connect all senders to host %s", hostname);
+        }
+
+        delete stream;
+
+        return NULL;
+    }
+
+    stream->pieces.resize(4 * stream->size, 0);
+    stream->newPieces.resize(4 * stream->size, 0);
+    stream->groupParameters.resize(stream->groupSize);
+    stream->groupImageSizes.resize(stream->groupSize, 0);
+    stream->groupImageOffsets.resize(stream->groupSize, 0);
+
+    return stream;
+}
+
+void dcStreamParallelClose(DcParallelStream * & stream)
+{
+    if(stream != NULL)
+    {
+        delete stream;
+        stream = NULL;
+    }
+}
+
+bool dcStreamParallelSend(DcParallelStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, std::string name, int nominalSegmentSize)
+{
+    if(stream == NULL)
+    {
+        put_flog(LOG_ERROR, "stream is NULL");
+
+        return false;
+    }
+
+    int bytesPerPixel = dcBytesPerPixel[pixelFormat];
+
+    // compute imagePitch if necessary, assuming imageBuffer isn't padded
+    if(imagePitch == 0)
+    {
+        imagePitch = imageWidth * bytesPerPixel;
+    }
+
+    // gather the pieces of all ranks. source indices, segments, and window dimensions are computed from them by each
+    // rank, so this is the only message needed to agree on the layout.
+    int piece[4] = { imageX, imageY, imageWidth, imageHeight };
+
+    if(imageWidth <= 0 || imageHeight <= 0)
+    {
+        memset(piece, 0, sizeof(piece));
+    }
+
+    MPI_Allgather(piece, 4, MPI_INT, &stream->newPieces[0], 4, MPI_INT, stream->comm);
+
+    if(stream->newPieces != stream->pieces || name != stream->name || nominalSegmentSize != stream->nominalSegmentSize)
+    {
+        dcStreamParallelUpdateLayout(stream, name, nominalSegmentSize);
+    }
+
+    // pass the pieces of the group to its sender, without row padding. the sender uses its own piece in place.
+    if(stream->groupSize > 1)
+    {
+        int offset = 0;
+
+        for(int i=0; i<stream->groupSize; i++)
+        {
+            const int * p = &stream->pieces[4 * (stream->firstGroupRank + i)];
+
+            stream->groupImageSizes[i] = (i == 0) ? 0 : p[2] * p[3] * bytesPerPixel;
+            stream->groupImageOffsets[i] = offset;
+
+            offset += stream->groupImageSizes[i];
+        }
+
+        unsigned char * sendBuffer = NULL;
+        int sendSize = 0;
+
+        if(stream->stream != NULL)
+        {
+            stream->groupImages.resize(std::max(offset, 1));
+        }
+        else if(piece[2] > 0)
+        {
+            sendSize = piece[2] * piece[3] * bytesPerPixel;
+
+            if(imagePitch == piece[2] * bytesPerPixel)
+            {
+                sendBuffer = imageBuffer;
+            }
+            else
+            {
+                stream->packedImage.resize(sendSize);
+
+                for(int j=0; j<piece[3]; j++)
+                {
+                    memcpy(&stream->packedImage[j * piece[2] * bytesPerPixel], imageBuffer + j * imagePitch, piece[2] * bytesPerPixel);
+                }
+
+                sendBuffer = &stream->packedImage[0];
+            }
+        }
+
+        MPI_Gatherv(sendBuffer, sendSize, MPI_BYTE, (stream->stream != NULL) ? &stream->groupImages[0] : NULL, &stream->groupImageSizes[0], &stream->groupImageOffsets[0], MPI_BYTE, 0, stream->groupComm);
+    }
+
+    int success = 1;
+
+    if(stream->stream != NULL)
+    {
+        // all segments of the frame have the same frame index
+        dcStreamSetFrameIndex(stream->stream, stream->frameIndex);
+
+        for(int i=0; i<stream->groupSize; i++)
+        {
+            if(stream->groupParameters[i].size() == 0)
+            {
+                continue;
+            }
+
+            bool sent;
+
+            if(i == 0)
+            {
+                sent = dcStreamSend(stream->stream, imageBuffer, imageX, imageY, imageWidth, imagePitch, imageHeight, pixelFormat, stream->groupParameters[i]);
+            }
+            else
+            {
+                const int * p = &stream->pieces[4 * (stream->firstGroupRank + i)];
+
+                sent = dcStreamSend(stream->stream, &stream->groupImages[stream->groupImageOffsets[i]], p[0], p[1], p[2], p[2] * bytesPerPixel, p[3], pixelFormat, stream->groupParameters[i]);
+            }
+
+            if(sent != true)
+            {
+                success = 0;
+            }
+        }
+    }
+
+    int allSuccess;
+    MPI_Allreduce(&success, &allSuccess, 1, MPI_INT, MPI_LAND, stream->comm);
+
+    stream->frameIndex++;
+
+    return allSuccess != 0;
+}
+
+DcStream * dcStreamParallelGetStream(DcParallelStream * stream)
+{
+    if(stream == NULL)
+    {
+        put_flog(LOG_ERROR, "stream is NULL");
+
+        return NULL;
+    }
+
+    return stream->stream;
+}
+
+void dcStreamParallelUpdateLayout(DcParallelStream * stream, const std::string & name, int nominalSegmentSize)
+{
+    if(stream->stream != NULL)
+    {
+        // window dimensions
+        int totalWidth = 0;
+        int totalHeight = 0;
+
+        for(int i=0; i<stream->size; i++)
+        {
+            const int * p = &stream->newPieces[4 * i];
+
+            if(p[2] > 0)
+            {
+                totalWidth = std::max(totalWidth, p[0] + p[2]);
+                totalHeight = std::max(totalHeight, p[1] + p[3]);
+            }
+        }
+
+        // source indices are assigned in rank order
+        std::vector<int> sourceIndices;
+        int firstSourceIndex = 0;
+
+        for(int i=0; i<stream->size; i++)
+        {
+            std::vector<DcStreamParameters> parameters = dcStreamParallelGenerateParameters(name, firstSourceIndex, nominalSegmentSize, &stream->newPieces[4 * i], totalWidth, totalHeight);
+
+            firstSourceIndex += parameters.size();
+
+            if(i >= stream->firstGroupRank && i < stream->firstGroupRank + stream->groupSize)
+            {
+                for(unsigned int j=0; j<parameters.size(); j++)
+                {
+                    sourceIndices.push_back(parameters[j].sourceIndex);
+                }
+
+                stream->groupParameters[i - stream->firstGroupRank].swap(parameters);
+            }
+        }
+
+        // delete segments this sender no longer sends, so the wall doesn't wait for them
+        for(unsigned int i=0; i<stream->sourceIndices.size(); i++)
+        {
+            int sourceIndex = stream->sourceIndices[i];
+
+            if(name != stream->name || std::count(sourceIndices.begin(), sourceIndices.end(), sourceIndex) == 0)
+            {
+                dcStreamSendJpeg(stream->stream, dcStreamGenerateParameters(stream->name, sourceIndex, 0, 0, 0, 0, 0, 0), NULL, 0);
+            }
+        }
+
+        stream->sourceIndices.swap(sourceIndices);
+    }
+
+    stream->name = name;
+    stream->nominalSegmentSize = nominalSegmentSize;
+    stream->pieces = stream->newPieces;
+}
+
+std::vector<DcStreamParameters> dcStreamParallelGenerateParameters(const std::string & name, int firstSourceIndex, int nominalSegmentSize, const int * piece, int totalWidth, int totalHeight)
+{
+    if(piece[2] <= 0 || piece[3] <= 0)
+    {
+        return std::vector<DcStreamParameters>();
+    }
+
+    // pieces smaller than a segment are sent as one segment
+    if(nominalSegmentSize <= 0)
+    {
+        nominalSegmentSize = std::max(piece[2], piece[3]);
+    }
+
+    int nominalSegmentWidth = std::min(nominalSegmentSize, piece[2]);
+    int nominalSegmentHeight = std::min(nominalSegmentSize, piece[3]);
+
+    return dcStreamGenerateParameters(name, firstSourceIndex, nominalSegmentWidth, nominalSegmentHeight, piece[0], piece[1], piece[2], piece[3], totalWidth, totalHeight);
+}
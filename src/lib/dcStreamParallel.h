@@ -0,0 +1,80 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+
+#ifndef DC_STREAM_PARALLEL_H
+#define DC_STREAM_PARALLEL_H
+
+#include "dcStream.h"
+#include <mpi.h>
+
+// collective streaming for MPI-parallel applications, where each rank renders a
+// piece of a window. these functions are collective over the communicator
+// given to dcStreamParallelOpen(): all of its ranks must call them, in the
+// same order.
+
+class DcParallelStream;
+
+// opens a parallel stream to the DisplayCluster instance on hostname. ranks
+// are divided into at most maxSenders groups of consecutive ranks. the first
+// rank of each group connects to hostname, and the others pass their pieces to
+// it over MPI, which reduces the number of connections for many small pieces.
+// 0 (the default) lets every rank connect. returns NULL on all ranks if any
+// sender could not connect. the user is responsible for closing the stream
+// using dcStreamParallelClose().
+extern DcParallelStream * dcStreamParallelOpen(MPI_Comm comm, const char * hostname, int maxSenders=0);
+
+// closes a parallel stream, deleting it.
+extern void dcStreamParallelClose(DcParallelStream *& stream);
+
+// sends this rank's piece of a frame of the window <name>. (imageX, imageY,
+// imageWidth, imageHeight) give the origin and dimensions of the piece in the
+// window, which is the union of all ranks' pieces; pieces may change between
+// frames. ranks without a piece give a width or height of 0. imagePitch and
+// pixelFormat are as for dcStreamSend(), and all ranks must use the same pixel
+// format. source indices and segments of approximately nominalSegmentSize x
+// nominalSegmentSize are assigned from the pieces, and all segments of a
+// frame have the same frame index, which is incremented after each frame.
+// returns true on all ranks if all segments were sent.
+extern bool dcStreamParallelSend(DcParallelStream * stream, unsigned char * imageBuffer, int imageX, int imageY, int imageWidth, int imagePitch, int imageHeight, PIXEL_FORMAT pixelFormat, std::string name, int nominalSegmentSize=512);
+
+// gets the stream of this rank, for the settings functions of dcStream.h
+// (target rates, codecs). returns NULL on ranks that don't connect. this is
+// not collective.
+extern DcStream * dcStreamParallelGetStream(DcParallelStream * stream);
+
+#endif
@@ -0,0 +1,125 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#include "../DcHiddenFrameThrottle.h"
+#include "../../ParallelPixelStreamSegmentParameters.h"
+#include <iostream>
+#include <unistd.h>
+
+// tests the throttling of frames sent while the window showing a stream is hidden, with and without frame indices.
+// returns 0 if all checks pass.
+
+// short, so the test runs quickly; long enough that the checks within an interval finish in it
+#define TEST_INTERVAL 200
+
+#define TEST_NUM_SEGMENTS 4
+
+int g_failures = 0;
+
+void check(bool condition, const char * description)
+{
+    std::cout << (condition == true ? "PASS: " : "FAIL: ") << description << std::endl;
+
+    if(condition != true)
+    {
+        g_failures++;
+    }
+}
+
+// number of the segments of a frame sent with one call per segment
+int sendSegments(DcHiddenFrameThrottle & throttle, int frameIndex)
+{
+    int count = 0;
+
+    for(int i=0; i<TEST_NUM_SEGMENTS; i++)
+    {
+        if(throttle.send(frameIndex, "test", i) == true)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void waitForInterval()
+{
+    usleep((TEST_INTERVAL + 50) * 1000);
+}
+
+int main(int argc, char * argv[])
+{
+    // frames sent one segment per call, without frame indices (e.g. by dcStreamSend() with a single segment)
+    {
+        DcHiddenFrameThrottle throttle(TEST_INTERVAL);
+
+        check(sendSegments(throttle, FRAME_INDEX_UNDEFINED) == TEST_NUM_SEGMENTS, "undefined index: all segments of the first frame are sent");
+        check(sendSegments(throttle, FRAME_INDEX_UNDEFINED) == 0, "undefined index: no segments of the next frame in the interval are sent");
+
+        waitForInterval();
+
+        check(sendSegments(throttle, FRAME_INDEX_UNDEFINED) == TEST_NUM_SEGMENTS, "undefined index: all segments of a frame after the interval are sent");
+        check(throttle.send(FRAME_INDEX_UNDEFINED, "other", 0) == true, "undefined index: segments of other streams are throttled separately");
+    }
+
+    // whole frames sent in one call each, without frame indices; they are throttled by their first segment
+    {
+        DcHiddenFrameThrottle throttle(TEST_INTERVAL);
+
+        check(throttle.send(FRAME_INDEX_UNDEFINED, "test", 0) == true, "undefined index: the first whole frame is sent");
+        check(throttle.send(FRAME_INDEX_UNDEFINED, "test", 0) == false, "undefined index: the next whole frame in the interval is not sent");
+
+        waitForInterval();
+
+        check(throttle.send(FRAME_INDEX_UNDEFINED, "test", 0) == true, "undefined index: a whole frame after the interval is sent");
+    }
+
+    // frames sent one segment per call, with frame indices (e.g. by dcStreamParallelSend())
+    {
+        DcHiddenFrameThrottle throttle(TEST_INTERVAL);
+
+        check(sendSegments(throttle, 0) == TEST_NUM_SEGMENTS, "frame index: all segments of the first frame are sent");
+        check(sendSegments(throttle, 1) == 0, "frame index: no segments of the next frame in the interval are sent");
+
+        waitForInterval();
+
+        check(sendSegments(throttle, 2) == TEST_NUM_SEGMENTS, "frame index: all segments of a frame after the interval are sent");
+        check(sendSegments(throttle, 3) == 0, "frame index: no segments of the frame after it are sent");
+    }
+
+    return g_failures == 0 ? 0 : 1;
+}
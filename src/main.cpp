@@ -39,8 +39,12 @@
 #include "main.h"
 #include "config.h"
 #include "log.h"
+#include "SharedTileCache.h"
+#include "DynamicTexture.h"
+#include "StreamMetrics.h"
 #include <mpi.h>
 #include <unistd.h>
+#include <time.h>
 
 
 #if ENABLE_TUIO_TOUCH_LISTENER
@@ -107,6 +111,29 @@ int main(int argc, char * argv[])
     // calibrate timestamp offset between rank 0 and rank 1 clocks
     g_displayGroupManager->calibrateTimestampOffset();
 
+    // render processes on the same host share decoded image tiles
+    if(g_configuration->getSharedTileCacheSize() > 0)
+    {
+        // the cache is named for this run, so a segment left behind by another run is never attached to
+        long long runId[2] = { (long long)getpid(), (long long)time(NULL) };
+        MPI_Bcast((void *)runId, 2, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+
+        if(g_mpiRank != 0)
+        {
+            g_sharedTileCache.initialize((size_t)g_configuration->getSharedTileCacheSize() * 1024 * 1024, TEXTURE_SIZE * TEXTURE_SIZE * 4, QString::number(runId[0]).toStdString() + "-" + QString::number(runId[1]).toStdString());
+
+            // once every process has attached, the segment no longer needs a name
+            MPI_Barrier(g_mpiRenderComm);
+            g_sharedTileCache.unlinkName();
+        }
+    }
+
+    // each process exports its stream metrics, if enabled
+    if(g_configuration->getStreamMetricsFilename().empty() != true)
+    {
+        g_streamMetrics.setExport(g_configuration->getStreamMetricsFilename(), g_configuration->getStreamMetricsInterval());
+    }
+
 #if ENABLE_TUIO_TOUCH_LISTENER
     if(g_mpiRank == 0)
     {
@@ -169,6 +196,10 @@ int main(int argc, char * argv[])
     // call finalize cleanup actions
     g_mainWindow->finalize();
 
+    g_sharedTileCache.finalize();
+
+    g_streamMetrics.finalize();
+
     // destruct the main window
     delete g_mainWindow;
 
@@ -0,0 +1,113 @@
+/*********************************************************************/
+/* Copyright (c) 2011 - 2012, The University of Texas at Austin.     */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE IS PROVIDED  BY THE  UNIVERSITY OF  TEXAS AT    */
+/*    AUSTIN  ``AS IS''  AND ANY  EXPRESS OR  IMPLIED WARRANTIES,    */
+/*    INCLUDING, BUT  NOT LIMITED  TO, THE IMPLIED  WARRANTIES OF    */
+/*    MERCHANTABILITY  AND FITNESS FOR  A PARTICULAR  PURPOSE ARE    */
+/*    DISCLAIMED.  IN  NO EVENT SHALL THE UNIVERSITY  OF TEXAS AT    */
+/*    AUSTIN OR CONTRIBUTORS BE  LIABLE FOR ANY DIRECT, INDIRECT,    */
+/*    INCIDENTAL,  SPECIAL, EXEMPLARY,  OR  CONSEQUENTIAL DAMAGES    */
+/*    (INCLUDING, BUT  NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE    */
+/*    GOODS  OR  SERVICES; LOSS  OF  USE,  DATA,  OR PROFITS;  OR    */
+/*    BUSINESS INTERRUPTION) HOWEVER CAUSED  AND ON ANY THEORY OF    */
+/*    LIABILITY, WHETHER  IN CONTRACT, STRICT  LIABILITY, OR TORT    */
+/*    (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY WAY OUT    */
+/*    OF  THE  USE OF  THIS  SOFTWARE,  EVEN  IF ADVISED  OF  THE    */
+/*    POSSIBILITY OF SUCH DAMAGE.                                    */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of The University of Texas at Austin.                 */
+/*********************************************************************/
+#include "../SVGDocumentCache.h"
+#include <iostream>
+
+// tests that SVG documents sent by hash still reach a render process after its display group is replaced, and that
+// the master's and the render process's caches stay in step. returns 0 if all checks pass.
+
+int g_failures = 0;
+
+void check(bool condition, const char * description)
+{
+    std::cout << (condition == true ? "PASS: " : "FAIL: ") << description << std::endl;
+
+    if(condition != true)
+    {
+        g_failures++;
+    }
+}
+
+// handles SVG stream messages like a render process's DisplayGroupManager, which is replaced by every display group
+// update the render process receives
+class TestDisplayGroup {
+
+    public:
+
+        bool receive(MESSAGE_TYPE type, QByteArray message, QByteArray & data)
+        {
+            return SVGDocumentCache::getProcessCache().receiveMessage(type, message, data);
+        }
+};
+
+QByteArray getDocument(int index)
+{
+    return QString("<svg width=\"100\" height=\"100\"><rect id=\"r\" width=\"%1\" height=\"10\"/></svg>").arg(index).toAscii();
+}
+
+int main(int argc, char * argv[])
+{
+    // the master has its own cache; in this process, the process cache plays the render process's
+    SVGDocumentCache master;
+
+    QByteArray message;
+    QByteArray data;
+
+    TestDisplayGroup * displayGroup = new TestDisplayGroup();
+
+    QByteArray document = getDocument(0);
+
+    MESSAGE_TYPE type = master.prepareMessage(document, message);
+    check(type == MESSAGE_TYPE_SVG_STREAM && message == document, "a new document is sent in full");
+    check(displayGroup->receive(type, message, data) == true && data == document, "a full document is received");
+
+    // the display group is replaced, as by DisplayGroupManager::receiveDisplayGroup()
+    delete displayGroup;
+    displayGroup = new TestDisplayGroup();
+
+    type = master.prepareMessage(document, message);
+    check(type == MESSAGE_TYPE_SVG_STREAM_CACHED && message == SVGDocumentCache::getHash(document), "a cached document is sent by hash");
+    check(displayGroup->receive(type, message, data) == true && data == document, "a cached document is received after the display group is replaced");
+
+    // push the document out of both caches, then send it again
+    for(int i=1; i<=SVG_DOCUMENT_CACHE_SIZE; i++)
+    {
+        type = master.prepareMessage(getDocument(i), message);
+        displayGroup->receive(type, message, data);
+    }
+
+    type = master.prepareMessage(document, message);
+    check(type == MESSAGE_TYPE_SVG_STREAM, "an evicted document is sent in full again");
+    check(displayGroup->receive(type, message, data) == true && data == document, "an evicted document is received");
+
+    check(displayGroup->receive(MESSAGE_TYPE_SVG_STREAM_CACHED, SVGDocumentCache::getHash("<svg/>"), data) == false, "an unknown hash is reported as not cached");
+
+    delete displayGroup;
+
+    return g_failures == 0 ? 0 : 1;
+}